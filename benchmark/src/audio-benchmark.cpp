@@ -0,0 +1,355 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Benchmark of the audio encoders. Each workload is a signal of 44.1 kHz
+ * 16-bit stereo PCM, written through a guac_audio_stream in packets as the
+ * RDP audio channel delivers them, with all output written to a socket which
+ * only counts bytes. The CPU time spent writing and flushing the stream is
+ * reported per second of audio, along with the ratio of PCM bytes to bytes
+ * sent, which includes the base64 encoding and instruction framing of each
+ * blob. The content of every signal is generated from a fixed seed, so runs
+ * are reproducible and comparable.
+ *
+ * Usage: guac-audio-benchmark [SECONDS] [AGGREGATION_MS]
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/adpcm_encoder.h>
+#include <guacamole/audio.h>
+#include <guacamole/client.h>
+#include <guacamole/raw_encoder.h>
+#include <guacamole/socket.h>
+#include <guacamole/ulaw_encoder.h>
+
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+/**
+ * The seed of the generator of all synthetic content.
+ */
+#define GUAC_BENCHMARK_SEED 0x4755u
+
+/**
+ * The number of samples per second of every signal.
+ */
+#define GUAC_BENCHMARK_RATE 44100
+
+/**
+ * The number of channels of every signal.
+ */
+#define GUAC_BENCHMARK_CHANNELS 2
+
+/**
+ * The number of bits per sample per channel of every signal.
+ */
+#define GUAC_BENCHMARK_BPS 16
+
+/**
+ * The duration of each packet of PCM data written to the stream, in
+ * milliseconds.
+ */
+#define GUAC_BENCHMARK_PACKET_MS 20
+
+/**
+ * The value of pi, which math.h does not define on all platforms.
+ */
+#define GUAC_BENCHMARK_PI 3.14159265358979323846
+
+/**
+ * The state shared by all workloads.
+ */
+typedef struct guac_benchmark_state {
+
+    /**
+     * The client owning each audio stream, whose socket only counts bytes.
+     */
+    guac_client* client;
+
+    /**
+     * The total number of bytes written to the socket of the client.
+     */
+    uint64_t bytes;
+
+    /**
+     * The state of the pseudo-random generator.
+     */
+    uint32_t random;
+
+} guac_benchmark_state;
+
+/**
+ * Generator of a single signal, storing the given number of interleaved
+ * stereo samples within the given buffer.
+ */
+typedef void guac_benchmark_generator(guac_benchmark_state* state,
+        int16_t* samples, int frames);
+
+/**
+ * A single signal, encoded by every encoder.
+ */
+typedef struct guac_benchmark_signal {
+
+    /**
+     * The name of the signal, as printed with its results.
+     */
+    const char* name;
+
+    /**
+     * Generates the PCM data of the signal.
+     */
+    guac_benchmark_generator* generate;
+
+} guac_benchmark_signal;
+
+/**
+ * An encoder under test.
+ */
+typedef struct guac_benchmark_encoder {
+
+    /**
+     * The name of the encoder, as printed with its results.
+     */
+    const char* name;
+
+    /**
+     * The encoder, which is a pointer to the global of libguac, not yet
+     * initialized when this table is.
+     */
+    guac_audio_encoder** encoder;
+
+} guac_benchmark_encoder;
+
+/**
+ * Returns the next value of the pseudo-random generator of the given state.
+ */
+static uint32_t guac_benchmark_random(guac_benchmark_state* state) {
+    state->random = state->random * 1664525u + 1013904223u;
+    return state->random >> 8;
+}
+
+/**
+ * Returns the CPU time consumed by the calling thread, in microseconds.
+ */
+static int64_t guac_benchmark_cpu_usec() {
+
+#ifdef WIN32
+    FILETIME creation, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exited, &kernel,
+                &user))
+        return 0;
+
+    /* Both times are in units of 100 nanoseconds */
+    ULARGE_INTEGER kernel_time, user_time;
+    kernel_time.LowPart = kernel.dwLowDateTime;
+    kernel_time.HighPart = kernel.dwHighDateTime;
+    user_time.LowPart = user.dwLowDateTime;
+    user_time.HighPart = user.dwHighDateTime;
+
+    return (int64_t) ((kernel_time.QuadPart + user_time.QuadPart) / 10);
+#else
+    return (int64_t) clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+
+}
+
+/**
+ * Counts and discards all data written to the socket.
+ */
+static size_t __guac_benchmark_socket_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_benchmark_state* state = (guac_benchmark_state*) socket->data;
+    state->bytes += count;
+
+    return count;
+
+}
+
+/**
+ * Generates digital silence, as sent while nothing is playing.
+ */
+static void guac_benchmark_generate_silence(guac_benchmark_state* state,
+        int16_t* samples, int frames) {
+    memset(samples, 0, sizeof(int16_t) * GUAC_BENCHMARK_CHANNELS * frames);
+}
+
+/**
+ * Generates a chord of pure tones, panned differently within each channel,
+ * as sent for notification sounds and music.
+ */
+static void guac_benchmark_generate_tones(guac_benchmark_state* state,
+        int16_t* samples, int frames) {
+
+    for (int i = 0; i < frames; i++) {
+
+        double t = (double) i / GUAC_BENCHMARK_RATE;
+        double a = sin(2 * GUAC_BENCHMARK_PI * 440 * t);
+        double b = sin(2 * GUAC_BENCHMARK_PI * 554.37 * t);
+        double c = sin(2 * GUAC_BENCHMARK_PI * 659.25 * t);
+
+        samples[i * 2]     = (int16_t) (8000 * (a + 0.6 * b + 0.3 * c));
+        samples[i * 2 + 1] = (int16_t) (8000 * (0.3 * a + 0.6 * b + c));
+
+    }
+
+}
+
+/**
+ * Generates white noise at half of full scale, the worst case for the
+ * predictor of the ADPCM encoder.
+ */
+static void guac_benchmark_generate_noise(guac_benchmark_state* state,
+        int16_t* samples, int frames) {
+
+    for (int i = 0; i < frames * GUAC_BENCHMARK_CHANNELS; i++)
+        samples[i] = (int16_t) ((int) (guac_benchmark_random(state) & 0xFFFF)
+                - 0x8000) / 2;
+
+}
+
+/**
+ * All signals, in the order they are run.
+ */
+static const guac_benchmark_signal guac_benchmark_signals[] = {
+    { "silence", guac_benchmark_generate_silence },
+    { "tones",   guac_benchmark_generate_tones   },
+    { "noise",   guac_benchmark_generate_noise   }
+};
+
+/**
+ * All encoders, in the order they are run. Raw PCM is included as a baseline
+ * of the cost of the stream itself.
+ */
+static const guac_benchmark_encoder guac_benchmark_encoders[] = {
+    { "raw",   &raw16_encoder },
+    { "ulaw",  &ulaw_encoder  },
+    { "adpcm", &adpcm_encoder }
+};
+
+/**
+ * Encodes the given PCM data with the given encoder and prints the results.
+ */
+static void guac_benchmark_run(guac_benchmark_state* state,
+        const guac_benchmark_signal* signal,
+        const guac_benchmark_encoder* encoder,
+        const std::vector<int16_t>& samples, int seconds) {
+
+    int frame_size = GUAC_BENCHMARK_CHANNELS * (GUAC_BENCHMARK_BPS / 8);
+    int packet_size = GUAC_BENCHMARK_RATE * GUAC_BENCHMARK_PACKET_MS / 1000
+                    * frame_size;
+
+    const unsigned char* data = (const unsigned char*) &samples[0];
+    int length = (int) (samples.size() * sizeof(int16_t));
+
+    /* The audio instruction beginning the stream is excluded */
+    guac_audio_stream* audio = guac_audio_stream_alloc(state->client,
+            *encoder->encoder, GUAC_BENCHMARK_RATE, GUAC_BENCHMARK_CHANNELS,
+            GUAC_BENCHMARK_BPS);
+
+    uint64_t bytes = state->bytes;
+    int64_t start = guac_benchmark_cpu_usec();
+
+    for (int offset = 0; offset < length; offset += packet_size) {
+
+        int size = length - offset;
+        if (size > packet_size)
+            size = packet_size;
+
+        guac_audio_stream_write_pcm(audio, data + offset, size);
+        guac_audio_stream_end_packet(audio);
+
+    }
+
+    guac_audio_stream_flush(audio);
+
+    double milliseconds = (guac_benchmark_cpu_usec() - start) / 1000.0;
+    bytes = state->bytes - bytes;
+
+    guac_audio_stream_free(audio);
+
+    printf("%-8s %-6s %12.3f %12.1f %8.2f\n", signal->name, encoder->name,
+            milliseconds / seconds, bytes / 1024.0 / seconds,
+            bytes ? (double) length / bytes : 0.0);
+
+}
+
+int main(int argc, char** argv) {
+
+    int seconds = argc > 1 ? atoi(argv[1]) : 60;
+    int aggregation = argc > 2 ? atoi(argv[2]) : 0;
+
+    if (seconds <= 0 || aggregation < 0) {
+        fprintf(stderr, "Usage: %s [SECONDS] [AGGREGATION_MS]\n", argv[0]);
+        return 1;
+    }
+
+    guac_benchmark_state state;
+    memset(&state, 0, sizeof(state));
+    state.random = GUAC_BENCHMARK_SEED;
+
+    /* Replace the broadcast socket, which has no users to write to */
+    state.client = guac_client_alloc();
+    guac_socket_free(state.client->socket);
+    state.client->socket = guac_socket_alloc();
+    state.client->socket->data = &state;
+    state.client->socket->write_handler = __guac_benchmark_socket_write_handler;
+
+    state.client->audio_aggregation_window = aggregation;
+
+    printf("%d seconds of %d Hz %d-bit stereo, %d ms packets, "
+            "%d ms aggregation\n\n", seconds, GUAC_BENCHMARK_RATE,
+            GUAC_BENCHMARK_BPS, GUAC_BENCHMARK_PACKET_MS, aggregation);
+    printf("%-8s %-6s %12s %12s %8s\n", "signal", "codec", "CPU ms/s",
+            "KiB/s", "ratio");
+
+    int frames = GUAC_BENCHMARK_RATE * seconds;
+    std::vector<int16_t> samples(frames * GUAC_BENCHMARK_CHANNELS);
+
+    int signals = sizeof(guac_benchmark_signals)
+        / sizeof(guac_benchmark_signals[0]);
+    int encoders = sizeof(guac_benchmark_encoders)
+        / sizeof(guac_benchmark_encoders[0]);
+
+    for (int i = 0; i < signals; i++) {
+
+        guac_benchmark_signals[i].generate(&state, &samples[0], frames);
+
+        for (int j = 0; j < encoders; j++)
+            guac_benchmark_run(&state, &guac_benchmark_signals[i],
+                    &guac_benchmark_encoders[j], samples, seconds);
+
+    }
+
+    guac_client_free(state.client);
+
+    return 0;
+
+}
@@ -0,0 +1,632 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Synthetic benchmark of the display pipeline. Each workload drives the
+ * default surface of a guac_common_display the way a remote desktop would,
+ * flushing and ending a frame after every step, with all output written to a
+ * socket which only counts bytes. The content of every workload is generated
+ * from a fixed seed, so runs are reproducible and comparable.
+ *
+ * Usage: guac-display-benchmark [FRAMES] [WIDTH] [HEIGHT] [ENCODER_THREADS]
+ *                               [TILE_CACHE_MB]
+ */
+
+#include <guacamole/config.h>
+
+#include <common/display.h>
+#include <common/surface.h>
+
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/metrics.h>
+#include <guacamole/socket.h>
+
+#include <atomic>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+/**
+ * The width of every synthetic glyph, in pixels.
+ */
+#define GUAC_BENCHMARK_GLYPH_WIDTH 8
+
+/**
+ * The height of every synthetic glyph, and of each line of text, in pixels.
+ */
+#define GUAC_BENCHMARK_GLYPH_HEIGHT 16
+
+/**
+ * The number of distinct synthetic glyphs.
+ */
+#define GUAC_BENCHMARK_GLYPHS 95
+
+/**
+ * The seed of the generator of all synthetic content.
+ */
+#define GUAC_BENCHMARK_SEED 0x4755u
+
+/**
+ * The number of heap allocations made through operator new, which covers all
+ * C++ allocations of the process. Allocations made directly with malloc(),
+ * such as those within Cairo and the image libraries, are not included.
+ */
+static std::atomic<uint64_t> __guac_benchmark_allocations(0);
+
+void* operator new(size_t size) {
+
+    __guac_benchmark_allocations++;
+
+    void* memory = malloc(size ? size : 1);
+    if (memory == NULL)
+        throw std::bad_alloc();
+
+    return memory;
+
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+/**
+ * The state shared by all workloads.
+ */
+typedef struct guac_benchmark_state {
+
+    /**
+     * The client owning the display, whose socket only counts bytes.
+     */
+    guac_client* client;
+
+    /**
+     * The display driven by the workloads.
+     */
+    guac_common_display* display;
+
+    /**
+     * The width of the display, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the display, in pixels.
+     */
+    int height;
+
+    /**
+     * The current state of the pseudo-random generator.
+     */
+    uint32_t random;
+
+    /**
+     * Every synthetic glyph, as an ARGB stencil.
+     */
+    cairo_surface_t* glyphs[GUAC_BENCHMARK_GLYPHS];
+
+    /**
+     * A display-sized image which is refilled with noise on each video frame.
+     */
+    cairo_surface_t* noise;
+
+    /**
+     * The location of the next glyph of the typing workload, or of the
+     * dragged window of the drag workload.
+     */
+    int x;
+
+    /**
+     * The location of the next glyph of the typing workload, or of the
+     * dragged window of the drag workload.
+     */
+    int y;
+
+    /**
+     * The number of bytes written to the socket of the client so far.
+     */
+    uint64_t bytes;
+
+} guac_benchmark_state;
+
+/**
+ * A single synthetic workload.
+ */
+typedef struct guac_benchmark_workload {
+
+    /**
+     * The name of the workload, as reported.
+     */
+    const char* name;
+
+    /**
+     * Prepares the display for the workload. This is not measured.
+     */
+    void (*setup)(guac_benchmark_state* state);
+
+    /**
+     * Applies the changes of a single frame to the display.
+     */
+    void (*frame)(guac_benchmark_state* state, int frame);
+
+} guac_benchmark_workload;
+
+/**
+ * The encode statistics of a single image format, as recorded within the
+ * metrics of the process.
+ */
+typedef struct guac_benchmark_encode_stats {
+
+    /**
+     * The number of images encoded.
+     */
+    uint64_t images;
+
+    /**
+     * The total time spent encoding, in milliseconds.
+     */
+    double milliseconds;
+
+    /**
+     * The total number of bytes written by the encoder.
+     */
+    uint64_t bytes;
+
+} guac_benchmark_encode_stats;
+
+/**
+ * Returns the next value of the pseudo-random generator of the given state.
+ */
+static uint32_t guac_benchmark_random(guac_benchmark_state* state) {
+    state->random = state->random * 1664525u + 1013904223u;
+    return state->random >> 8;
+}
+
+/**
+ * Counts and discards all data written to the socket.
+ */
+static size_t __guac_benchmark_socket_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_benchmark_state* state = (guac_benchmark_state*) socket->data;
+    state->bytes += count;
+
+    return count;
+
+}
+
+/**
+ * Extracts the value of the format label from the given metric name, or
+ * returns an empty string if there is none.
+ */
+static std::string guac_benchmark_format_label(const std::string& name) {
+
+    size_t start = name.find("format=\"");
+    if (start == std::string::npos)
+        return "";
+
+    start += strlen("format=\"");
+    return name.substr(start, name.find('"', start) - start);
+
+}
+
+/**
+ * Reads the encode statistics of every image format from the metrics of the
+ * process.
+ */
+static std::map<std::string, guac_benchmark_encode_stats>
+        guac_benchmark_encode_snapshot() {
+
+    std::map<std::string, guac_benchmark_encode_stats> snapshot;
+
+    char* rendered = guac_metrics_render();
+    std::istringstream lines(rendered);
+    free(rendered);
+
+    std::string line;
+    while (std::getline(lines, line)) {
+
+        std::istringstream fields(line);
+        std::string type, name;
+        fields >> type >> name;
+
+        std::string format = guac_benchmark_format_label(name);
+        if (format.empty())
+            continue;
+
+        guac_benchmark_encode_stats& stats = snapshot[format];
+
+        if (name.compare(0, strlen("guac_encode_milliseconds"),
+                    "guac_encode_milliseconds") == 0)
+            fields >> stats.images >> stats.milliseconds;
+
+        else if (name.compare(0, strlen("guac_encode_bytes_total"),
+                    "guac_encode_bytes_total") == 0)
+            fields >> stats.bytes;
+
+    }
+
+    return snapshot;
+
+}
+
+/**
+ * Returns the peak memory use of the process in bytes, or zero where it
+ * cannot be read.
+ */
+static uint64_t guac_benchmark_peak_memory() {
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+#endif
+    return 0;
+}
+
+/**
+ * Fills the whole display with a solid background.
+ */
+static void guac_benchmark_clear(guac_benchmark_state* state) {
+    guac_common_surface_set(state->display->default_surface, 0, 0,
+            state->width, state->height, 0x20, 0x30, 0x40, 0xFF);
+}
+
+/**
+ * Draws a single glyph as text would be drawn, filling its stencil.
+ */
+static void guac_benchmark_draw_glyph(guac_benchmark_state* state, int x,
+        int y, int glyph) {
+    guac_common_surface_paint(state->display->default_surface, x, y,
+            state->glyphs[glyph % GUAC_BENCHMARK_GLYPHS], 0xE0, 0xE0, 0xE0);
+}
+
+/**
+ * Draws a line of glyphs spanning the given width.
+ */
+static void guac_benchmark_draw_line(guac_benchmark_state* state, int x,
+        int y, int width) {
+
+    for (int gx = x; gx + GUAC_BENCHMARK_GLYPH_WIDTH <= x + width;
+            gx += GUAC_BENCHMARK_GLYPH_WIDTH)
+        guac_benchmark_draw_glyph(state, gx, y, guac_benchmark_random(state));
+
+}
+
+/**
+ * Prepares a blank display with the text cursor at the upper-left corner.
+ */
+static void guac_benchmark_setup_blank(guac_benchmark_state* state) {
+    guac_benchmark_clear(state);
+    state->x = 0;
+    state->y = 0;
+}
+
+/**
+ * Types a single character, wrapping at the end of each line and clearing
+ * the display once it is full.
+ */
+static void guac_benchmark_frame_typing(guac_benchmark_state* state,
+        int frame) {
+
+    guac_benchmark_draw_glyph(state, state->x, state->y, frame);
+
+    state->x += GUAC_BENCHMARK_GLYPH_WIDTH;
+    if (state->x + GUAC_BENCHMARK_GLYPH_WIDTH > state->width) {
+        state->x = 0;
+        state->y += GUAC_BENCHMARK_GLYPH_HEIGHT;
+    }
+
+    if (state->y + GUAC_BENCHMARK_GLYPH_HEIGHT > state->height)
+        guac_benchmark_setup_blank(state);
+
+}
+
+/**
+ * Draws a window of text at the upper-left corner of the display.
+ */
+static void guac_benchmark_setup_window(guac_benchmark_state* state) {
+
+    guac_benchmark_clear(state);
+    state->x = 0;
+    state->y = 0;
+
+    int width = state->width / 3;
+    int height = state->height / 3;
+
+    guac_common_surface_set(state->display->default_surface, 0, 0,
+            width, height, 0xF0, 0xF0, 0xF0, 0xFF);
+
+    for (int y = 0; y + GUAC_BENCHMARK_GLYPH_HEIGHT <= height;
+            y += GUAC_BENCHMARK_GLYPH_HEIGHT)
+        guac_benchmark_draw_line(state, 0, y, width);
+
+}
+
+/**
+ * Drags the window by a few pixels, copying it within the display and
+ * filling the area it uncovered with the background, bouncing off the edges
+ * of the display.
+ */
+static void guac_benchmark_frame_drag(guac_benchmark_state* state,
+        int frame) {
+
+    int width = state->width / 3;
+    int height = state->height / 3;
+    int travel = (state->width - width) / 4;
+
+    /* Move right and down, then back */
+    int step = (frame / travel) % 2 ? -4 : 4;
+    int x = state->x + step;
+    int y = state->y + step * (state->height - height) / (state->width - width);
+
+    if (x < 0 || y < 0 || x + width > state->width
+            || y + height > state->height)
+        return;
+
+    guac_common_surface* surface = state->display->default_surface;
+    guac_common_surface_copy(surface, state->x, state->y, width, height,
+            surface, x, y);
+
+    /* Fill the uncovered strips with the background */
+    int left = step > 0 ? state->x : x + width;
+    int top = step > 0 ? state->y : y + height;
+    guac_common_surface_set(surface, left, state->y, abs(x - state->x),
+            height, 0x20, 0x30, 0x40, 0xFF);
+    guac_common_surface_set(surface, state->x, top, width,
+            abs(y - state->y), 0x20, 0x30, 0x40, 0xFF);
+
+    state->x = x;
+    state->y = y;
+
+}
+
+/**
+ * Replaces the whole display with new noise, as a full-screen video would.
+ */
+static void guac_benchmark_frame_video(guac_benchmark_state* state,
+        int frame) {
+
+    cairo_surface_flush(state->noise);
+
+    unsigned char* data = cairo_image_surface_get_data(state->noise);
+    int stride = cairo_image_surface_get_stride(state->noise);
+
+    for (int y = 0; y < state->height; y++) {
+        uint32_t* row = (uint32_t*) (data + y * stride);
+        for (int x = 0; x < state->width; x++)
+            row[x] = 0xFF000000 | guac_benchmark_random(state);
+    }
+
+    cairo_surface_mark_dirty(state->noise);
+    guac_common_surface_draw(state->display->default_surface, 0, 0,
+            state->noise);
+
+}
+
+/**
+ * Fills the display with text.
+ */
+static void guac_benchmark_setup_text(guac_benchmark_state* state) {
+
+    guac_benchmark_clear(state);
+
+    for (int y = 0; y + GUAC_BENCHMARK_GLYPH_HEIGHT <= state->height;
+            y += GUAC_BENCHMARK_GLYPH_HEIGHT)
+        guac_benchmark_draw_line(state, 0, y, state->width);
+
+}
+
+/**
+ * Scrolls the display up by a line of text and draws a new line at the
+ * bottom.
+ */
+static void guac_benchmark_frame_scroll(guac_benchmark_state* state,
+        int frame) {
+
+    guac_common_surface* surface = state->display->default_surface;
+    int lines = state->height / GUAC_BENCHMARK_GLYPH_HEIGHT;
+    int bottom = (lines - 1) * GUAC_BENCHMARK_GLYPH_HEIGHT;
+
+    guac_common_surface_copy(surface, 0, GUAC_BENCHMARK_GLYPH_HEIGHT,
+            state->width, bottom, surface, 0, 0);
+
+    guac_common_surface_set(surface, 0, bottom, state->width,
+            GUAC_BENCHMARK_GLYPH_HEIGHT, 0x20, 0x30, 0x40, 0xFF);
+    guac_benchmark_draw_line(state, 0, bottom, state->width);
+
+}
+
+/**
+ * Redraws every line of text of the display with different glyphs.
+ */
+static void guac_benchmark_frame_glyphs(guac_benchmark_state* state,
+        int frame) {
+    guac_benchmark_setup_text(state);
+}
+
+/**
+ * All workloads, in the order they are run.
+ */
+static const guac_benchmark_workload guac_benchmark_workloads[] = {
+    { "typing", guac_benchmark_setup_blank,  guac_benchmark_frame_typing },
+    { "drag",   guac_benchmark_setup_window, guac_benchmark_frame_drag   },
+    { "video",  guac_benchmark_setup_blank,  guac_benchmark_frame_video  },
+    { "scroll", guac_benchmark_setup_text,   guac_benchmark_frame_scroll },
+    { "glyphs", guac_benchmark_setup_text,   guac_benchmark_frame_glyphs }
+};
+
+/**
+ * Generates every synthetic glyph, each a distinct pseudo-random stencil
+ * surrounded by a blank border.
+ */
+static void guac_benchmark_alloc_glyphs(guac_benchmark_state* state) {
+
+    for (int i = 0; i < GUAC_BENCHMARK_GLYPHS; i++) {
+
+        cairo_surface_t* glyph = cairo_image_surface_create(
+                CAIRO_FORMAT_ARGB32, GUAC_BENCHMARK_GLYPH_WIDTH,
+                GUAC_BENCHMARK_GLYPH_HEIGHT);
+
+        unsigned char* data = cairo_image_surface_get_data(glyph);
+        int stride = cairo_image_surface_get_stride(glyph);
+
+        for (int y = 0; y < GUAC_BENCHMARK_GLYPH_HEIGHT; y++) {
+            uint32_t* row = (uint32_t*) (data + y * stride);
+            for (int x = 0; x < GUAC_BENCHMARK_GLYPH_WIDTH; x++) {
+                int border = x == 0 || y < 3 || y > GUAC_BENCHMARK_GLYPH_HEIGHT - 4;
+                row[x] = !border && (guac_benchmark_random(state) & 1)
+                    ? 0xFFFFFFFF : 0x00000000;
+            }
+        }
+
+        cairo_surface_mark_dirty(glyph);
+        state->glyphs[i] = glyph;
+
+    }
+
+}
+
+/**
+ * Runs a single workload for the given number of frames and prints its
+ * results.
+ */
+static void guac_benchmark_run(guac_benchmark_state* state,
+        const guac_benchmark_workload* workload, int frames) {
+
+    /* Setup is flushed and excluded from the measurements */
+    workload->setup(state);
+    guac_common_display_flush(state->display);
+    guac_client_end_frame(state->client);
+
+    std::map<std::string, guac_benchmark_encode_stats> before =
+        guac_benchmark_encode_snapshot();
+    uint64_t bytes = state->bytes;
+    uint64_t allocations = __guac_benchmark_allocations;
+    int64_t start = guac_metrics_time_usec();
+
+    for (int frame = 0; frame < frames; frame++) {
+        workload->frame(state, frame);
+        guac_common_display_flush(state->display);
+        guac_client_end_frame(state->client);
+        guac_socket_flush(state->client->socket);
+    }
+
+    double seconds = (guac_metrics_time_usec() - start) / 1000000.0;
+    bytes = state->bytes - bytes;
+    allocations = __guac_benchmark_allocations - allocations;
+
+    printf("%-8s %9.1f %12.1f %12.1f %11.1f",
+            workload->name, frames / seconds,
+            bytes / 1024.0 / frames, bytes / 1024.0 / 1024.0 / seconds,
+            (double) allocations / frames);
+
+    /* Encode time per frame of each format used by this workload */
+    std::map<std::string, guac_benchmark_encode_stats> after =
+        guac_benchmark_encode_snapshot();
+
+    std::map<std::string, guac_benchmark_encode_stats>::const_iterator current;
+    for (current = after.begin(); current != after.end(); current++) {
+
+        guac_benchmark_encode_stats previous = before[current->first];
+        uint64_t images = current->second.images - previous.images;
+        if (images == 0)
+            continue;
+
+        printf("  %s: %.2f ms/frame, %llu images, %.1f KiB",
+                current->first.c_str(),
+                (current->second.milliseconds - previous.milliseconds) / frames,
+                (unsigned long long) images,
+                (current->second.bytes - previous.bytes) / 1024.0);
+
+    }
+
+    printf("\n");
+
+}
+
+int main(int argc, char** argv) {
+
+    int frames = argc > 1 ? atoi(argv[1]) : 300;
+    int width = argc > 2 ? atoi(argv[2]) : 1024;
+    int height = argc > 3 ? atoi(argv[3]) : 768;
+    int encoder_threads = argc > 4 ? atoi(argv[4]) : 0;
+    int tile_cache_mb = argc > 5 ? atoi(argv[5]) : 0;
+
+    if (frames <= 0 || width < 64 || height < 64) {
+        fprintf(stderr, "Usage: %s [FRAMES] [WIDTH] [HEIGHT] "
+                "[ENCODER_THREADS] [TILE_CACHE_MB]\n", argv[0]);
+        return 1;
+    }
+
+    guac_benchmark_state state;
+    memset(&state, 0, sizeof(state));
+    state.width = width;
+    state.height = height;
+    state.random = GUAC_BENCHMARK_SEED;
+
+    /* Replace the broadcast socket, which has no users to write to */
+    state.client = guac_client_alloc();
+    guac_socket_free(state.client->socket);
+    state.client->socket = guac_socket_alloc();
+    state.client->socket->data = &state;
+    state.client->socket->write_handler = __guac_benchmark_socket_write_handler;
+
+    state.client->tile_cache_size = tile_cache_mb * 1024 * 1024;
+    guac_client_set_encoder_threads(state.client, encoder_threads);
+
+    state.display = guac_common_display_alloc(state.client, width, height);
+    state.noise = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width,
+            height);
+    guac_benchmark_alloc_glyphs(&state);
+
+    printf("%d frames of %dx%d, %d encoder threads, %d MiB tile cache\n\n",
+            frames, width, height, encoder_threads, tile_cache_mb);
+    printf("%-8s %9s %12s %12s %11s  %s\n", "workload", "frames/s",
+            "KiB/frame", "MiB/s", "allocs/frame", "encode by format");
+
+    int workloads = sizeof(guac_benchmark_workloads)
+        / sizeof(guac_benchmark_workloads[0]);
+    for (int i = 0; i < workloads; i++)
+        guac_benchmark_run(&state, &guac_benchmark_workloads[i], frames);
+
+    uint64_t peak_memory = guac_benchmark_peak_memory();
+    if (peak_memory)
+        printf("\npeak memory: %.1f MiB\n", peak_memory / 1024.0 / 1024.0);
+
+    for (int i = 0; i < GUAC_BENCHMARK_GLYPHS; i++)
+        cairo_surface_destroy(state.glyphs[i]);
+
+    cairo_surface_destroy(state.noise);
+    guac_common_display_free(state.display);
+    guac_client_free(state.client);
+
+    return 0;
+
+}
@@ -0,0 +1,343 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Microbenchmark of inbound instruction handling. Each workload is a stream
+ * of instructions as sent by a client, read through guac_parser_read() from a
+ * socket serving the stream from memory, the way the instructions of each
+ * user are read by the service. The handler of every instruction read is
+ * then looked up as guac_user_handle_instruction() does, timed apart from the
+ * parsing. The content of every workload is generated from a fixed seed, so
+ * runs are reproducible and comparable.
+ *
+ * Usage: guac-parser-benchmark [INSTRUCTIONS] [PASSES]
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/error.h>
+#include <guacamole/metrics.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+#include <guacamole/user-handlers.h>
+
+#include <string>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The seed of the generator of all synthetic content.
+ */
+#define GUAC_BENCHMARK_SEED 0x4755u
+
+/**
+ * The maximum number of bytes served by a single read of the socket, as
+ * received from the network.
+ */
+#define GUAC_BENCHMARK_READ_SIZE 8192
+
+/**
+ * The instruction stream served by the socket.
+ */
+typedef struct guac_benchmark_stream {
+
+    /**
+     * The entire stream.
+     */
+    std::string data;
+
+    /**
+     * The number of bytes of the stream served so far.
+     */
+    size_t offset;
+
+} guac_benchmark_stream;
+
+/**
+ * Generator of the instructions of a single workload, appending the given
+ * instruction of the workload to the given stream.
+ */
+typedef void guac_benchmark_generator(std::string& data, int instruction,
+        uint32_t* random);
+
+/**
+ * A named workload.
+ */
+typedef struct guac_benchmark_workload {
+
+    /**
+     * The name of the workload, as printed in the results.
+     */
+    const char* name;
+
+    /**
+     * Appends each instruction of the workload.
+     */
+    guac_benchmark_generator* generate;
+
+} guac_benchmark_workload;
+
+/**
+ * Returns the next value of the given pseudo-random generator.
+ */
+static uint32_t guac_benchmark_random(uint32_t* random) {
+    *random = *random * 1664525u + 1013904223u;
+    return *random >> 8;
+}
+
+/**
+ * Appends an element of the given value, prefixed with the given length in
+ * characters, which for UTF-8 values may differ from its length in bytes.
+ */
+static void guac_benchmark_append_element(std::string& data,
+        const std::string& value, size_t length, char terminator) {
+
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%u.", (unsigned int) length);
+
+    data += prefix;
+    data += value;
+    data += terminator;
+
+}
+
+/**
+ * Appends an element containing the given integer.
+ */
+static void guac_benchmark_append_int(std::string& data, long long value,
+        char terminator) {
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%lli", value);
+    guac_benchmark_append_element(data, buffer, strlen(buffer), terminator);
+
+}
+
+/**
+ * Mouse moves, as sent continuously while the mouse is dragged.
+ */
+static void guac_benchmark_generate_mouse(std::string& data, int instruction,
+        uint32_t* random) {
+
+    guac_benchmark_append_element(data, "mouse", 5, ',');
+    guac_benchmark_append_int(data, guac_benchmark_random(random) % 1920, ',');
+    guac_benchmark_append_int(data, guac_benchmark_random(random) % 1080, ',');
+    guac_benchmark_append_int(data, 1, ';');
+
+}
+
+/**
+ * Interactive use: mouse moves, interleaved with key presses and releases,
+ * and with the sync acknowledging each frame.
+ */
+static void guac_benchmark_generate_mixed(std::string& data, int instruction,
+        uint32_t* random) {
+
+    switch (instruction % 8) {
+
+        /* Acknowledge frame */
+        case 0:
+            guac_benchmark_append_element(data, "sync", 4, ',');
+            guac_benchmark_append_int(data, 1500000000000LL + instruction, ';');
+            break;
+
+        /* Type key */
+        case 3:
+        case 4:
+            guac_benchmark_append_element(data, "key", 3, ',');
+            guac_benchmark_append_int(data, 0x61 + instruction % 26, ',');
+            guac_benchmark_append_int(data, instruction % 8 == 3, ';');
+            break;
+
+        default:
+            guac_benchmark_generate_mouse(data, instruction, random);
+
+    }
+
+}
+
+/**
+ * Pasted text, as sent in the blobs of a clipboard stream, with a share of
+ * multibyte characters.
+ */
+static void guac_benchmark_generate_clipboard(std::string& data,
+        int instruction, uint32_t* random) {
+
+    /* Printable ASCII mixed with two and three byte characters */
+    static const char* characters[] = {
+        "a", "b", "c", "d", "e", " ", "1", ".", "\xc3\xa9", "\xe2\x82\xac"
+    };
+
+    std::string text;
+    for (int i = 0; i < 1024; i++)
+        text += characters[guac_benchmark_random(random) % 10];
+
+    guac_benchmark_append_element(data, "blob", 4, ',');
+    guac_benchmark_append_int(data, 1, ',');
+    guac_benchmark_append_element(data, text, 1024, ';');
+
+}
+
+static const guac_benchmark_workload guac_benchmark_workloads[] = {
+    { "mouse",     guac_benchmark_generate_mouse },
+    { "mixed",     guac_benchmark_generate_mixed },
+    { "clipboard", guac_benchmark_generate_clipboard }
+};
+
+/**
+ * Serves the stream in reads no larger than those received from the network.
+ */
+static size_t __guac_benchmark_socket_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_benchmark_stream* stream = (guac_benchmark_stream*) socket->data;
+
+    size_t remaining = stream->data.size() - stream->offset;
+    if (count > remaining)
+        count = remaining;
+    if (count > GUAC_BENCHMARK_READ_SIZE)
+        count = GUAC_BENCHMARK_READ_SIZE;
+
+    memcpy(buf, stream->data.data() + stream->offset, count);
+    stream->offset += count;
+
+    return count;
+
+}
+
+/**
+ * Reports data as always available, as the stream is entirely in memory.
+ */
+static int __guac_benchmark_socket_select_handler(guac_socket* socket,
+        int usec_timeout) {
+    return 1;
+}
+
+/**
+ * Runs a single workload and prints its results.
+ */
+static void guac_benchmark_run(const guac_benchmark_workload* workload,
+        int instructions, int passes) {
+
+    guac_benchmark_stream stream;
+    stream.offset = 0;
+
+    uint32_t random = GUAC_BENCHMARK_SEED;
+    for (int i = 0; i < instructions; i++)
+        workload->generate(stream.data, i, &random);
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = &stream;
+    socket->read_handler = __guac_benchmark_socket_read_handler;
+    socket->select_handler = __guac_benchmark_socket_select_handler;
+
+    /* Opcodes are kept so that dispatch can be timed apart from parsing */
+    std::string opcodes;
+    int64_t parse_usec = 0;
+    int parsed = 0;
+
+    for (int pass = 0; pass < passes; pass++) {
+
+        guac_parser* parser = guac_parser_alloc();
+        stream.offset = 0;
+
+        int64_t start = guac_metrics_time_usec();
+        for (int i = 0; i < instructions; i++) {
+
+            if (guac_parser_read(parser, socket, 0)) {
+                fprintf(stderr, "%s: instruction %i: %s\n", workload->name,
+                        i, guac_status_string(guac_error));
+                break;
+            }
+
+            /* Keep the opcodes of the first pass only */
+            if (pass == 0) {
+                opcodes += parser->opcode;
+                opcodes += '\0';
+            }
+
+            parsed++;
+
+        }
+        parse_usec += guac_metrics_time_usec() - start;
+
+        guac_parser_free(parser);
+
+    }
+
+    /* Time the lookup of the handler of each opcode parsed */
+    int64_t dispatch_usec = 0;
+    int lookups = 0;
+    int unhandled = 0;
+
+    for (int pass = 0; pass < passes; pass++) {
+
+        int64_t start = guac_metrics_time_usec();
+        for (const char* opcode = opcodes.c_str();
+                opcode < opcodes.c_str() + opcodes.size();
+                opcode += strlen(opcode) + 1) {
+            unhandled += __guac_get_instruction_handler(opcode) == NULL;
+            lookups++;
+        }
+        dispatch_usec += guac_metrics_time_usec() - start;
+
+    }
+
+    double bytes = (double) stream.data.size() * passes;
+    double seconds = parse_usec / 1000000.0;
+
+    printf("%-10s %12.0f %10.1f %12.1f %12.1f",
+            workload->name, parsed / seconds, bytes / 1024.0 / 1024.0 / seconds,
+            parse_usec * 1000.0 / parsed, dispatch_usec * 1000.0 / lookups);
+
+    if (unhandled)
+        printf("  (%i unhandled)", unhandled);
+
+    printf("\n");
+
+    socket->data = NULL;
+    guac_socket_free(socket);
+
+}
+
+int main(int argc, char** argv) {
+
+    int instructions = argc > 1 ? atoi(argv[1]) : 100000;
+    int passes = argc > 2 ? atoi(argv[2]) : 20;
+
+    if (instructions <= 0 || passes <= 0) {
+        fprintf(stderr, "Usage: %s [INSTRUCTIONS] [PASSES]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d instructions, %d passes\n\n", instructions, passes);
+    printf("%-10s %12s %10s %12s %12s\n", "workload", "instr/s",
+            "MiB/s", "ns/parse", "ns/dispatch");
+
+    int workloads = sizeof(guac_benchmark_workloads)
+        / sizeof(guac_benchmark_workloads[0]);
+    for (int i = 0; i < workloads; i++)
+        guac_benchmark_run(&guac_benchmark_workloads[i], instructions, passes);
+
+    return 0;
+
+}
@@ -102,6 +102,12 @@ typedef struct guac_common_cursor {
      */
     int y;
 
+    /**
+     * Non-zero if the cursor has been moved by guac_common_cursor_update()
+     * since its location was last sent to all users.
+     */
+    int moved;
+
 } guac_common_cursor;
 
 /**
@@ -133,7 +139,9 @@ void guac_common_cursor_free(guac_common_cursor* cursor);
  *     The cursor to send.
  *
  * @param user
- *     The user receiving the updated cursor.
+ *     The user receiving the updated cursor, or NULL if the cursor is being
+ *     written to a socket not belonging to any one user, such as a session
+ *     recording, in which case streams are allocated from the client.
  *
  * @param socket
  *     The socket over which the updated cursor should be sent.
@@ -161,6 +169,39 @@ void guac_common_cursor_dup(guac_common_cursor* cursor, guac_user* user,
 void guac_common_cursor_move(guac_common_cursor* cursor, guac_user* user,
         int x, int y);
 
+/**
+ * Moves the mouse cursor, marking the given user as the most recent user of
+ * the mouse, as guac_common_cursor_move() does. The new location is not sent
+ * to the other users until guac_common_cursor_flush() is invoked, such that
+ * any number of moves within a frame are sent as one.
+ *
+ * @param cursor
+ *     The cursor being moved.
+ *
+ * @param user
+ *     The user that moved the cursor. This user is only compared against the
+ *     users receiving the location, and may have left by the time the
+ *     location is sent.
+ *
+ * @param x
+ *     The new X coordinate of the cursor.
+ *
+ * @param y
+ *     The new Y coordinate of the cursor.
+ */
+void guac_common_cursor_update(guac_common_cursor* cursor, guac_user* user,
+        int x, int y);
+
+/**
+ * Sends the location of the mouse cursor to all users except the user that
+ * moved the cursor last, if the cursor has been moved by
+ * guac_common_cursor_update() since the location was last sent.
+ *
+ * @param cursor
+ *     The cursor whose location should be sent.
+ */
+void guac_common_cursor_flush(guac_common_cursor* cursor);
+
 /**
  * Sets the cursor image to the given raw image data. This raw image data must
  * be in 32-bit ARGB format, having 8 bits per color component, where the
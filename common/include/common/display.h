@@ -24,6 +24,7 @@
 
 #include <common/cursor.h>
 #include <common/surface.h>
+#include <common/tile_cache.h>
 
 #include <guacamole/client.h>
 #include <guacamole/socket.h>
@@ -105,6 +106,12 @@ typedef struct guac_common_display {
      */
     guac_common_display_layer* buffers;
 
+    /**
+     * Cache of tiles already sent to the client, shared by all surfaces of
+     * this display, or NULL if tile caching is disabled.
+     */
+    guac_common_tile_cache* tile_cache;
+
     /**
      * Mutex which is locked internally when access to the display must be
      * synchronized. All public functions of guac_common_display should be
@@ -155,7 +162,9 @@ void guac_common_display_free(guac_common_display* display);
  *     The display whose state should be sent along the given socket.
  *
  * @param user
- *     The user receiving the display state.
+ *     The user receiving the display state, or NULL if the state is being
+ *     written to a socket not belonging to any one user, such as a session
+ *     recording, in which case streams are allocated from the client.
  *
  * @param socket
  *     The socket over which the display state should be sent.
@@ -165,7 +174,8 @@ void guac_common_display_dup(guac_common_display* display, guac_user* user,
 
 /**
  * Flushes pending changes to the given display. All pending operations will
- * become visible to any connected users.
+ * become visible to any connected users, including any cursor moves made with
+ * guac_common_cursor_update().
  *
  * @param display
  *     The display to flush.
@@ -20,7 +20,13 @@
 #ifndef GUAC_COMMON_RECORDING_H
 #define GUAC_COMMON_RECORDING_H
 
+#include <common/display.h>
+
 #include <guacamole/client.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <stdio.h>
 
 /**
  * The maximum numeric value allowed for the .1, .2, .3, etc. suffix appended
@@ -42,6 +48,60 @@
  */
 #define GUAC_COMMON_RECORDING_MAX_NAME_LENGTH 2048
 
+/**
+ * The size of the in-memory buffer of each session recording, in bytes, if the
+ * client does not specify one.
+ */
+#define GUAC_COMMON_RECORDING_DEFAULT_BUFFER_SIZE 16777216
+
+/**
+ * The suffix appended to the name of compressed session recordings.
+ */
+#define GUAC_COMMON_RECORDING_COMPRESSED_SUFFIX ".gz"
+
+/**
+ * The suffix appended to the full name of a session recording to form the
+ * name of its keyframe index.
+ */
+#define GUAC_COMMON_RECORDING_INDEX_SUFFIX ".idx"
+
+/**
+ * An in-progress session recording, attached to the socket of a client by
+ * guac_common_recording_create().
+ */
+typedef struct guac_common_recording {
+
+    /**
+     * The client whose output is being recorded.
+     */
+    guac_client* client;
+
+    /**
+     * The socket to which the recording is written. This socket is owned by
+     * the socket of the client, and is freed along with it.
+     */
+    guac_socket* socket;
+
+    /**
+     * The keyframe index written alongside the recording, or NULL if the
+     * recording is not indexed.
+     */
+    FILE* index;
+
+    /**
+     * An in-memory socket into which each keyframe is rendered before being
+     * appended to the recording, or NULL if the recording is not indexed.
+     */
+    guac_socket* keyframe;
+
+    /**
+     * The timestamp of the frame at which the last keyframe was written, or
+     * zero if no keyframe has yet been written.
+     */
+    guac_timestamp last_keyframe;
+
+} guac_common_recording;
+
 /**
  * Replaces the socket of the given client such that all further Guacamole
  * protocol output will be copied into a file within the given path and having
@@ -51,6 +111,12 @@
  * written. The recording will automatically be closed once the client is
  * freed.
  *
+ * The recording is written to storage by a dedicated writer thread through a
+ * bounded buffer, such that the client output is not slowed by storage. The
+ * size of that buffer, what happens if it overflows, and whether the
+ * recording is gzip compressed are taken from the recording settings of the
+ * client.
+ *
  * @param client
  *     The client whose output should be copied to a recording file.
  *
@@ -67,12 +133,49 @@
  *     written, or non-zero if the path should be created if it does not yet
  *     exist.
  *
+ * If the recording_keyframe_interval of the client is non-zero, the recording
+ * is indexed: guac_common_recording_keyframe() then periodically writes the
+ * full state of the display to the recording, and lists each such keyframe
+ * in an index file named after the recording, with the suffix
+ * GUAC_COMMON_RECORDING_INDEX_SUFFIX. Each line of the index has the form
+ * "TIMESTAMP,OFFSET", where TIMESTAMP is the timestamp of the frame at which
+ * the keyframe was written, as sent in sync instructions, and OFFSET is the
+ * byte offset of the first instruction of the keyframe within the protocol
+ * stream. For compressed recordings, this offset is within the decompressed
+ * stream. A player may seek by starting from a blank display at the offset of
+ * the last keyframe preceding the desired time.
+ *
  * @return
- *     Zero if the recording file has been successfully created and a recording
- *     will be written, non-zero otherwise.
+ *     The new recording, or NULL if the recording file could not be created.
+ */
+guac_common_recording* guac_common_recording_create(guac_client* client,
+        const char* path, const char* name, int create_path);
+
+/**
+ * Writes a keyframe containing the full state of the given display to the
+ * given recording, if the recording is indexed and the keyframe interval of
+ * the client has elapsed since the last keyframe. This function must be
+ * invoked only at the end of a frame, after the display has been flushed, and
+ * not while the socket of the client is locked.
+ *
+ * @param recording
+ *     The recording to which the keyframe should be written.
+ *
+ * @param display
+ *     The display whose state should be written.
+ */
+void guac_common_recording_keyframe(guac_common_recording* recording,
+        guac_common_display* display);
+
+/**
+ * Frees the given recording, closing its index, if any. The recording file
+ * itself is closed once the socket of the client is freed, thus this function
+ * must be invoked before the client is freed.
+ *
+ * @param recording
+ *     The recording to free.
  */
-int guac_common_recording_create(guac_client* client, const char* path,
-        const char* name, int create_path);
+void guac_common_recording_free(guac_common_recording* recording);
 
 #endif
 
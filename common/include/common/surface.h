@@ -22,11 +22,13 @@
 
 #include <guacamole/config.h>
 #include <common/rect.h>
+#include <common/tile_cache.h>
 
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
 #include <guacamole/layer.h>
 #include <guacamole/protocol.h>
+#include <guacamole/quality.h>
 #include <guacamole/socket.h>
 
 #ifdef HAVE_BOOST
@@ -232,6 +234,45 @@ typedef struct guac_common_surface {
      */
     guac_common_surface_heat_cell* heat_map;
 
+    /**
+     * The tile cache used to replace repeated content with copies from an
+     * off-screen buffer, or NULL if all content should be encoded.
+     */
+    guac_common_tile_cache* tile_cache;
+
+    /**
+     * The number of rects in the tile cache queue.
+     */
+    int tile_cache_queue_length;
+
+    /**
+     * Rects flushed losslessly during the current flush, whose tiles will be
+     * added to the tile cache once the flush completes.
+     */
+    guac_common_rect tile_cache_queue[GUAC_COMMON_SURFACE_QUEUE_SIZE];
+
+    /**
+     * The contents of this surface as currently displayed by the client, with
+     * the same dimensions and stride as buffer. This is used to detect content
+     * which has merely scrolled within a dirty rect, and is NULL for buffers,
+     * which are never checked for scrolling.
+     */
+    unsigned char* shadow_buffer;
+
+    /**
+     * Whether shadow_buffer is known to match the client for all users. This
+     * is cleared when the client contents become unknown, such as when a new
+     * user joins while updates are pending, and restored by the next flush.
+     */
+    int shadow_valid;
+
+    /**
+     * The quality settings of the client as of the start of the current
+     * flush, read once such that all updates of the flush are encoded
+     * consistently.
+     */
+    guac_quality quality;
+
     /**
      * Mutex which is locked internally when access to the surface must be
      * synchronized. All public functions of guac_common_surface should be
@@ -277,6 +318,22 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
  */
 void guac_common_surface_free(guac_common_surface* surface);
 
+/**
+ * Assigns the tile cache used by the given surface when flushing. Tiles of
+ * fully-opaque content found within the cache are drawn with "copy"
+ * instructions instead of being encoded, and tiles which are sent losslessly
+ * are added to the cache.
+ *
+ * @param surface
+ *     The surface to assign the tile cache to.
+ *
+ * @param tile_cache
+ *     The tile cache to use, which must send over the same socket as the
+ *     given surface, or NULL to disable tile caching.
+ */
+void guac_common_surface_set_tile_cache(guac_common_surface* surface,
+        guac_common_tile_cache* tile_cache);
+
  /**
  * Resizes the given surface to the given size.
  *
@@ -486,7 +543,10 @@ void guac_common_surface_flush(guac_common_surface* surface);
  *     The surface to duplicate.
  *
  * @param user
- *     The user receiving the surface.
+ *     The user receiving the surface, or NULL if the surface is being written
+ *     to a socket not belonging to any one user, such as a session recording,
+ *     in which case streams are allocated from the client, and the surface is
+ *     compressed with the fast PNG profile.
  *
  * @param socket
  *     The socket over which the surface contents should be sent.
@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_COMMON_SURFACE_KERNELS_H
+#define GUAC_COMMON_SURFACE_KERNELS_H
+
+#include <guacamole/config.h>
+
+#include <stdint.h>
+
+/**
+ * Per-row pixel kernels used by guac_common_surface. Each kernel is provided
+ * in scalar form and, on x86, as SSE2 and AVX2 variants which produce
+ * bit-for-bit identical results. The fastest variant supported by the CPU is
+ * selected at runtime.
+ */
+
+/**
+ * Copies a row of pixels, writing only those destination pixels which
+ * change, and reporting the range of changed pixels.
+ *
+ * @param dst
+ *     The destination row.
+ *
+ * @param src
+ *     The source row.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param first
+ *     Receives the index of the first changed pixel, if any pixel changed.
+ *
+ * @param last
+ *     Receives the index of the last changed pixel, if any pixel changed.
+ *
+ * @return
+ *     Non-zero if any destination pixel changed, zero otherwise.
+ */
+typedef int guac_common_surface_put_kernel(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last);
+
+/**
+ * Fills each pixel of a row with the given color wherever the corresponding
+ * mask pixel has a non-zero alpha component.
+ *
+ * @param dst
+ *     The destination row.
+ *
+ * @param mask
+ *     The row of mask pixels.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param color
+ *     The ARGB color to fill with.
+ */
+typedef void guac_common_surface_fill_mask_kernel(uint32_t* dst,
+        const uint32_t* mask, int width, uint32_t color);
+
+/**
+ * Counts the pixels within a row which are identical to the pixel
+ * immediately to their left, ignoring the alpha component.
+ *
+ * @param row
+ *     The row of pixels.
+ *
+ * @param width
+ *     The number of pixels in the row.
+ *
+ * @return
+ *     The number of pixels, excluding the first, equal to their left
+ *     neighbour.
+ */
+typedef int guac_common_surface_count_same_kernel(const uint32_t* row,
+        int width);
+
+/**
+ * A set of pixel kernels sharing the same instruction set.
+ */
+typedef struct guac_common_surface_kernels {
+
+    /**
+     * Human-readable name of the instruction set used, for logging.
+     */
+    const char* name;
+
+    /**
+     * Copies an opaque row, forcing the alpha component of every pixel to
+     * 0xFF.
+     */
+    guac_common_surface_put_kernel* put_opaque;
+
+    /**
+     * Blends a row of pre-multiplied ARGB pixels over the destination using
+     * the Porter-Duff "over" operator.
+     */
+    guac_common_surface_put_kernel* put_blend;
+
+    /**
+     * Fills a row with a solid color through a mask.
+     */
+    guac_common_surface_fill_mask_kernel* fill_mask;
+
+    /**
+     * Counts pixels equal to their left neighbour.
+     */
+    guac_common_surface_count_same_kernel* count_same;
+
+} guac_common_surface_kernels;
+
+/**
+ * The portable scalar kernels, always available.
+ */
+extern const guac_common_surface_kernels guac_common_surface_scalar_kernels;
+
+/**
+ * Returns the fastest set of kernels supported by the current CPU. The
+ * selection is made once, on first use.
+ *
+ * @return
+ *     The kernels to use for all surface operations.
+ */
+const guac_common_surface_kernels* guac_common_surface_get_kernels();
+
+/**
+ * Returns every set of kernels supported by the current CPU, including the
+ * scalar kernels, such that each may be verified against the scalar kernels.
+ *
+ * @param count
+ *     Receives the number of sets of kernels returned.
+ *
+ * @return
+ *     An array of the supported sets of kernels, the first always being
+ *     guac_common_surface_scalar_kernels.
+ */
+const guac_common_surface_kernels* const* guac_common_surface_get_supported_kernels(
+        int* count);
+
+#endif
+
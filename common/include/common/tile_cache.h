@@ -0,0 +1,275 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_COMMON_TILE_CACHE_H
+#define GUAC_COMMON_TILE_CACHE_H
+
+#include <guacamole/config.h>
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#ifdef HAVE_BOOST
+#include <boost/thread/mutex.hpp>
+#elif defined HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+/**
+ * The width and height of each cached tile, in pixels. Only tiles aligned to
+ * this grid within their surface are cached.
+ */
+#define GUAC_COMMON_TILE_CACHE_TILE_SIZE 64
+
+/**
+ * The number of bytes occupied by a single cached tile, both on the server
+ * and within the client's off-screen buffer.
+ */
+#define GUAC_COMMON_TILE_CACHE_TILE_BYTES \
+    (GUAC_COMMON_TILE_CACHE_TILE_SIZE * GUAC_COMMON_TILE_CACHE_TILE_SIZE * 4)
+
+/**
+ * The number of tiles stored within each row of the off-screen buffer.
+ */
+#define GUAC_COMMON_TILE_CACHE_COLUMNS 32
+
+/**
+ * The maximum number of rows of tiles within the off-screen buffer, limiting
+ * the buffer to dimensions which browsers will reliably allocate.
+ */
+#define GUAC_COMMON_TILE_CACHE_MAX_ROWS 64
+
+/**
+ * Bookkeeping for a single slot of the tile cache. Slots are referenced by
+ * index, with -1 denoting the absence of a slot.
+ */
+typedef struct guac_common_tile_cache_entry {
+
+    /**
+     * The hash of the tile within this slot, as produced by
+     * guac_hash_surface().
+     */
+    unsigned int hash;
+
+    /**
+     * The next slot within the same hash bucket.
+     */
+    int next;
+
+    /**
+     * The slot used more recently than this slot.
+     */
+    int lru_prev;
+
+    /**
+     * The slot used less recently than this slot.
+     */
+    int lru_next;
+
+} guac_common_tile_cache_entry;
+
+/**
+ * A content-addressed cache of opaque tiles which have already been sent to
+ * the client. Cached tiles are held within an off-screen buffer on the client,
+ * such that repeated content can be drawn with a "copy" instruction rather
+ * than being encoded again. Slots are evicted in least-recently-used order.
+ */
+typedef struct guac_common_tile_cache {
+
+    /**
+     * The client owning the off-screen buffer.
+     */
+    guac_client* client;
+
+    /**
+     * The socket over which cache updates should be sent.
+     */
+    guac_socket* socket;
+
+    /**
+     * The off-screen buffer holding all cached tiles on the client.
+     */
+    guac_layer* buffer;
+
+    /**
+     * The total number of slots within the cache.
+     */
+    int capacity;
+
+    /**
+     * The number of slots which have ever been filled. Slots are filled in
+     * order, thus slots at or beyond this index are unused.
+     */
+    int used;
+
+    /**
+     * Server-side copy of the off-screen buffer, used to verify hash matches
+     * and to synchronize new users.
+     */
+    unsigned char* pixels;
+
+    /**
+     * The number of bytes in each row of pixels.
+     */
+    int stride;
+
+    /**
+     * All slots, indexed by slot number.
+     */
+    guac_common_tile_cache_entry* entries;
+
+    /**
+     * The first slot of each hash bucket, or -1 for empty buckets.
+     */
+    int* buckets;
+
+    /**
+     * The number of hash buckets. This is always a power of two.
+     */
+    int bucket_count;
+
+    /**
+     * The most recently used slot.
+     */
+    int lru_head;
+
+    /**
+     * The least recently used slot, the next to be evicted.
+     */
+    int lru_tail;
+
+    /**
+     * Mutex which is locked internally when access to the cache must be
+     * synchronized. All public functions of guac_common_tile_cache should be
+     * considered threadsafe.
+     */
+#ifdef HAVE_BOOST
+	boost::mutex _lock;
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_t _lock;
+#endif
+
+} guac_common_tile_cache;
+
+/**
+ * Allocates a new tile cache, along with the off-screen buffer backing it on
+ * the client.
+ *
+ * @param client
+ *     The client for which the off-screen buffer should be allocated.
+ *
+ * @param socket
+ *     The socket over which cache updates should be sent.
+ *
+ * @param size
+ *     The memory budget of the cache in bytes. This is rounded down to a whole
+ *     number of tiles, and limited by GUAC_COMMON_TILE_CACHE_MAX_ROWS.
+ *
+ * @return
+ *     A newly-allocated tile cache, or NULL if the budget is too small to hold
+ *     a single row of tiles.
+ */
+guac_common_tile_cache* guac_common_tile_cache_alloc(guac_client* client,
+        guac_socket* socket, int size);
+
+/**
+ * Frees the given tile cache, disposing of its off-screen buffer.
+ *
+ * @param cache
+ *     The tile cache to free.
+ */
+void guac_common_tile_cache_free(guac_common_tile_cache* cache);
+
+/**
+ * Looks up the tile having its upper-left corner at the given location within
+ * the given pixel buffer. If an identical tile is cached, it is marked as most
+ * recently used and its location within the off-screen buffer is returned.
+ *
+ * @param cache
+ *     The tile cache to search.
+ *
+ * @param buffer
+ *     The upper-left pixel of the tile, in 32-bit ARGB format.
+ *
+ * @param stride
+ *     The number of bytes in each row of the given buffer.
+ *
+ * @param sx
+ *     Receives the X coordinate of the cached tile within cache->buffer.
+ *
+ * @param sy
+ *     Receives the Y coordinate of the cached tile within cache->buffer.
+ *
+ * @return
+ *     Non-zero if an identical tile was found, zero otherwise.
+ */
+int guac_common_tile_cache_lookup(guac_common_tile_cache* cache,
+        const unsigned char* buffer, int stride, int* sx, int* sy);
+
+/**
+ * Adds the given tile to the cache, evicting the least recently used tile if
+ * the cache is full. The tile is copied into the off-screen buffer from the
+ * given layer, which must already contain the exact tile contents on the
+ * client. If the tile is already cached, it is simply marked as most recently
+ * used.
+ *
+ * @param cache
+ *     The tile cache to add the tile to.
+ *
+ * @param layer
+ *     The layer currently containing the tile on the client.
+ *
+ * @param x
+ *     The X coordinate of the tile within the given layer.
+ *
+ * @param y
+ *     The Y coordinate of the tile within the given layer.
+ *
+ * @param buffer
+ *     The upper-left pixel of the tile, in 32-bit ARGB format.
+ *
+ * @param stride
+ *     The number of bytes in each row of the given buffer.
+ */
+void guac_common_tile_cache_insert(guac_common_tile_cache* cache,
+        const guac_layer* layer, int x, int y, const unsigned char* buffer,
+        int stride);
+
+/**
+ * Synchronizes the off-screen buffer of the given tile cache to the given
+ * user.
+ *
+ * @param cache
+ *     The tile cache to synchronize.
+ *
+ * @param user
+ *     The user receiving the off-screen buffer, or NULL if the buffer is being
+ *     written to a socket not belonging to any one user, such as a session
+ *     recording, in which case streams are allocated from the client.
+ *
+ * @param socket
+ *     The socket over which the off-screen buffer should be sent.
+ */
+void guac_common_tile_cache_dup(guac_common_tile_cache* cache,
+        guac_user* user, guac_socket* socket);
+
+#endif
+
@@ -62,6 +62,7 @@ guac_common_cursor* guac_common_cursor_alloc(guac_client* client) {
     /* Start cursor in upper-left */
     cursor->x = 0;
     cursor->y = 0;
+    cursor->moved = 0;
 
     return cursor;
 
@@ -99,8 +100,13 @@ void guac_common_cursor_dup(guac_common_cursor* cursor, guac_user* user,
         guac_protocol_send_size(socket, cursor->buffer,
                 cursor->width, cursor->height);
 
-        guac_user_stream_png(user, socket, GUAC_COMP_SRC,
-                cursor->buffer, 0, 0, cursor->surface);
+        /* Stream from the client if not synchronizing a specific user */
+        if (user != NULL)
+            guac_user_stream_png(user, socket, GUAC_COMP_SRC,
+                    cursor->buffer, 0, 0, cursor->surface);
+        else
+            guac_client_stream_png(cursor->client, socket, GUAC_COMP_SRC,
+                    cursor->buffer, 0, 0, cursor->surface);
 
         guac_protocol_send_cursor(socket,
                 cursor->hotspot_x, cursor->hotspot_y,
@@ -151,6 +157,35 @@ void guac_common_cursor_move(guac_common_cursor* cursor, guac_user* user,
     guac_client_foreach_user(cursor->client,
             guac_common_cursor_broadcast_position, cursor);
 
+    cursor->moved = 0;
+
+}
+
+void guac_common_cursor_update(guac_common_cursor* cursor, guac_user* user,
+        int x, int y) {
+
+    /* Update current user of cursor */
+    cursor->user = user;
+
+    /* Update cursor position, to be sent with the frame */
+    cursor->x = x;
+    cursor->y = y;
+    cursor->moved = 1;
+
+}
+
+void guac_common_cursor_flush(guac_common_cursor* cursor) {
+
+    /* Nothing to send if not moved since last sent */
+    if (!cursor->moved)
+        return;
+
+    /* Notify all other users of change in cursor position */
+    guac_client_foreach_user(cursor->client,
+            guac_common_cursor_broadcast_position, cursor);
+
+    cursor->moved = 0;
+
 }
 
 /**
@@ -125,6 +125,17 @@ guac_common_display* guac_common_display_alloc(guac_client* client,
     display->default_surface = guac_common_surface_alloc(client,
             client->socket, GUAC_DEFAULT_LAYER, width, height);
 
+    /* Allocate tile cache if the client has a budget for it */
+    display->tile_cache = NULL;
+#ifdef HAVE_BOOST
+    if (client->tile_cache_size > 0)
+        display->tile_cache = guac_common_tile_cache_alloc(client,
+                client->socket, client->tile_cache_size);
+#endif
+
+    guac_common_surface_set_tile_cache(display->default_surface,
+            display->tile_cache);
+
     /* No initial layers or buffers */
     display->layers = NULL;
     display->buffers = NULL;
@@ -144,6 +155,10 @@ void guac_common_display_free(guac_common_display* display) {
     /* Free all layers and buffers */
     guac_common_display_free_layers(display->buffers, display->client);
     guac_common_display_free_layers(display->layers, display->client);
+
+    /* Free tile cache, now that no surface refers to it */
+    if (display->tile_cache != NULL)
+        guac_common_tile_cache_free(display->tile_cache);
 #ifdef HAVE_LIBPTHREAD
     pthread_mutex_destroy(&display->_lock);
 #endif
@@ -164,6 +179,10 @@ void guac_common_display_dup(guac_common_display* display, guac_user* user,
     /* Sunchronize shared cursor */
     guac_common_cursor_dup(display->cursor, user, socket);
 
+    /* Synchronize cached tiles */
+    if (display->tile_cache != NULL)
+        guac_common_tile_cache_dup(display->tile_cache, user, socket);
+
     /* Synchronize default surface */
     guac_common_surface_dup(display->default_surface, user, socket);
 
@@ -196,6 +215,9 @@ void guac_common_display_flush(guac_common_display* display) {
 
     guac_common_surface_flush(display->default_surface);
 
+    /* Send the cursor location once per frame, however often it moved */
+    guac_common_cursor_flush(display->cursor);
+
 #ifdef HAVE_BOOST
 	display->_lock.unlock();
 #elif defined HAVE_LIBPTHREAD
@@ -293,6 +315,7 @@ guac_common_display_layer* guac_common_display_alloc_layer(
     /* Allocate corresponding surface */
     guac_common_surface* surface = guac_common_surface_alloc(display->client,
             display->client->socket, layer, width, height);
+    guac_common_surface_set_tile_cache(surface, display->tile_cache);
 
     /* Add layer and surface to list */
     guac_common_display_layer* display_layer =
@@ -322,6 +345,7 @@ guac_common_display_layer* guac_common_display_alloc_buffer(
     /* Allocate corresponding surface */
     guac_common_surface* surface = guac_common_surface_alloc(display->client,
             display->client->socket, buffer, width, height);
+    guac_common_surface_set_tile_cache(surface, display->tile_cache);
 
     /* Add buffer and surface to list */
     guac_common_display_layer* display_layer =
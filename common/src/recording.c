@@ -17,10 +17,13 @@
  * under the License.
  */
 
+#include <common/display.h>
 #include <common/recording.h>
 
 #include <guacamole/client.h>
+#include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -30,39 +33,178 @@
 #include <stdio.h>
 #include <string.h>
 
+/**
+ * The growable buffer behind the in-memory socket into which keyframes are
+ * rendered.
+ */
+typedef struct guac_common_recording_buffer {
+
+    /**
+     * The rendered data.
+     */
+    char* data;
+
+    /**
+     * The number of bytes rendered so far.
+     */
+    size_t length;
+
+    /**
+     * The number of bytes allocated for data.
+     */
+    size_t size;
+
+    /**
+     * Non-zero if the buffer could not be grown, in which case the rendered
+     * data is incomplete.
+     */
+    int failed;
+
+} guac_common_recording_buffer;
+
+/**
+ * Write handler of the in-memory keyframe socket, appending the given data to
+ * its buffer.
+ */
+static size_t guac_common_recording_buffer_write(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_common_recording_buffer* buffer =
+        (guac_common_recording_buffer*) socket->data;
+
+    /* Grow geometrically, such that the buffer settles at keyframe size */
+    if (buffer->length + count > buffer->size) {
+
+        size_t size = buffer->size ? buffer->size : 65536;
+        while (size < buffer->length + count)
+            size *= 2;
+
+        char* data = static_cast<char*>(realloc(buffer->data, size));
+        if (data == NULL) {
+            buffer->failed = 1;
+            return -1;
+        }
+
+        buffer->data = data;
+        buffer->size = size;
+
+    }
+
+    memcpy(buffer->data + buffer->length, buf, count);
+    buffer->length += count;
+
+    return count;
+
+}
+
+/**
+ * Free handler of the in-memory keyframe socket, freeing its buffer.
+ */
+static int guac_common_recording_buffer_free(guac_socket* socket) {
+
+    guac_common_recording_buffer* buffer =
+        (guac_common_recording_buffer*) socket->data;
+
+    free(buffer->data);
+    free(buffer);
+
+    return 0;
+
+}
+
+/**
+ * Allocates the recording of the given client, written to the given socket.
+ * If the client requests keyframes, the index of the recording is created at
+ * the given path. Failure to create the index is logged, and leaves the
+ * recording unindexed.
+ *
+ * @param client
+ *     The client being recorded.
+ *
+ * @param socket
+ *     The socket to which the recording is written.
+ *
+ * @param index_path
+ *     The full path of the index of the recording.
+ *
+ * @return
+ *     The new recording.
+ */
+static guac_common_recording* guac_common_recording_alloc(guac_client* client,
+        guac_socket* socket, const char* index_path) {
+
+    guac_common_recording* recording = static_cast<guac_common_recording*>(
+        calloc(1, sizeof(guac_common_recording)));
+
+    recording->client = client;
+    recording->socket = socket;
+
+    if (client->recording_keyframe_interval <= 0)
+        return recording;
+
+    recording->index = fopen(index_path, "w");
+    if (recording->index == NULL) {
+        guac_client_log(client, GUAC_LOG_WARNING,
+                "Recording will not be indexed, creation of index failed: %s",
+                strerror(errno));
+        return recording;
+    }
+
+    /* Keyframes are rendered into memory, then appended whole */
+    recording->keyframe = guac_socket_alloc();
+    recording->keyframe->data = calloc(1, sizeof(guac_common_recording_buffer));
+    recording->keyframe->write_handler = guac_common_recording_buffer_write;
+    recording->keyframe->free_handler = guac_common_recording_buffer_free;
+
+    return recording;
+
+}
+
 #ifdef HAVE_BOOST
 #include <boost/filesystem.hpp>
 
-static guac_socket * guac_common_recording_open(const char* path, const char * name) 
+static guac_socket * guac_common_recording_open(guac_client* client,
+	const boost::filesystem::path & p)
 {
-	boost::filesystem::path p =
-		boost::filesystem::path(path) / boost::filesystem::path(name);
+	size_t buffer_size = client->recording_buffer_size > 0
+		? client->recording_buffer_size : GUAC_COMMON_RECORDING_DEFAULT_BUFFER_SIZE;
 
-	guac_socket * socket = guac_socket_boost_file(p.string().c_str());
+	/* Written by a dedicated thread, so storage does not slow the client */
+	guac_socket * socket = guac_socket_async_file(p.string().c_str(),
+		buffer_size, client->recording_overflow_policy,
+		client->recording_compress);
 
 	return socket;
 }
 
-int guac_common_recording_create(guac_client* client, const char* path,
-	const char* name, int create_path) {
+guac_common_recording* guac_common_recording_create(guac_client* client,
+	const char* path, const char* name, int create_path) {
 	if(create_path)
 	{
 		boost::filesystem::path p(path);
-		if(!boost::filesystem::create_directories(p))
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(p, ec);
+		if(ec)
 		{
 			guac_client_log(client, GUAC_LOG_ERROR,
-				"Creation of recording failed: %s", strerror(errno));
-			return 1;
+				"Creation of recording failed: %s", ec.message().c_str());
+			return NULL;
 		}
 		boost::filesystem::permissions(p, boost::filesystem::owner_all);
 	}
 
+	boost::filesystem::path p =
+		boost::filesystem::path(path) / boost::filesystem::path(name);
+
+	if (client->recording_compress)
+		p += GUAC_COMMON_RECORDING_COMPRESSED_SUFFIX;
+
 	/* Attempt to open recording file */
-	guac_socket * file_socket = guac_common_recording_open(path, name);
+	guac_socket * file_socket = guac_common_recording_open(client, p);
 	if (!file_socket) {
 		guac_client_log(client, GUAC_LOG_ERROR,
 			"Creation of recording failed: %s", strerror(errno));
-		return 1;
+		return NULL;
 	}
 
 	/* Replace client socket with wrapped socket */
@@ -70,10 +212,15 @@ int guac_common_recording_create(guac_client* client, const char* path,
 
 	/* Recording creation succeeded */
 	guac_client_log(client, GUAC_LOG_INFO,
-		"Recording of session will be saved to %s/%s.",
-		path,name);
+		"Recording of session will be saved to %s/%s%s.",
+		path, name, client->recording_compress
+			? GUAC_COMMON_RECORDING_COMPRESSED_SUFFIX : "");
 
-	return 0;
+	boost::filesystem::path index_path = p;
+	index_path += GUAC_COMMON_RECORDING_INDEX_SUFFIX;
+
+	return guac_common_recording_alloc(client, file_socket,
+		index_path.string().c_str());
 
 }
 
@@ -174,16 +321,18 @@ static int guac_common_recording_open(const char* path,
 
 }
 
-int guac_common_recording_create(guac_client* client, const char* path,
-        const char* name, int create_path) {
+guac_common_recording* guac_common_recording_create(guac_client* client,
+        const char* path, const char* name, int create_path) {
 
     char filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
+    char index_filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH
+        + sizeof(GUAC_COMMON_RECORDING_INDEX_SUFFIX)];
 
     /* Create path if it does not exist, fail if impossible */
     if (create_path && mkdir(path, S_IRWXU) && errno != EEXIST) {
         guac_client_log(client, GUAC_LOG_ERROR,
                 "Creation of recording failed: %s", strerror(errno));
-        return 1;
+        return NULL;
     }
 
     /* Attempt to open recording file */
@@ -191,18 +340,101 @@ int guac_common_recording_create(guac_client* client, const char* path,
     if (fd == -1) {
         guac_client_log(client, GUAC_LOG_ERROR,
                 "Creation of recording failed: %s", strerror(errno));
-        return 1;
+        return NULL;
     }
 
     /* Replace client socket with wrapped socket */
-    client->socket = guac_socket_tee(client->socket, guac_socket_open(fd));
+    guac_socket* file_socket = guac_socket_open(fd);
+    client->socket = guac_socket_tee(client->socket, file_socket);
 
     /* Recording creation succeeded */
     guac_client_log(client, GUAC_LOG_INFO,
             "Recording of session will be saved to \"%s\".",
             filename);
 
-    return 0;
+    snprintf(index_filename, sizeof(index_filename), "%s%s",
+            filename, GUAC_COMMON_RECORDING_INDEX_SUFFIX);
+
+    return guac_common_recording_alloc(client, file_socket, index_filename);
 
 }
 #endif
+
+void guac_common_recording_keyframe(guac_common_recording* recording,
+        guac_common_display* display) {
+
+    /* Nothing to do if the recording is not indexed */
+    if (recording->keyframe == NULL)
+        return;
+
+    guac_client* client = recording->client;
+    guac_timestamp timestamp = client->last_sent_timestamp;
+
+    /* Wait for the keyframe interval to elapse */
+    if (recording->last_keyframe != 0 && timestamp - recording->last_keyframe
+            < client->recording_keyframe_interval)
+        return;
+
+#ifdef HAVE_BOOST
+    /* Nothing more reaches the file once recording stopped */
+    if (guac_socket_async_file_stopped(recording->socket))
+        return;
+#endif
+
+    guac_common_recording_buffer* buffer =
+        (guac_common_recording_buffer*) recording->keyframe->data;
+
+    /* Render the keyframe without holding the client socket, as duplicating
+     * the display locks its surfaces, which are locked before the client
+     * socket when flushed. A closing sync lets players render the keyframe
+     * without waiting for the next frame. */
+    buffer->length = 0;
+    buffer->failed = 0;
+    guac_common_display_dup(display, NULL, recording->keyframe);
+    guac_protocol_send_sync(recording->keyframe, timestamp);
+
+    /* Skip this keyframe if it could not be rendered whole */
+    if (buffer->failed) {
+        guac_client_log(client, GUAC_LOG_WARNING,
+                "Keyframe of recording skipped: out of memory");
+        recording->last_keyframe = timestamp;
+        return;
+    }
+
+    /* Append the keyframe whole, between two instructions of the client */
+    guac_socket_instruction_begin(client->socket);
+    int64_t offset = recording->socket->bytes_written;
+    guac_socket_write(recording->socket, buffer->data, buffer->length);
+    guac_socket_instruction_end(client->socket);
+    guac_socket_flush(recording->socket);
+
+#ifdef HAVE_BOOST
+    /* The keyframe may not have been recorded whole, and its offset is past
+     * the end of the recording */
+    if (guac_socket_async_file_stopped(recording->socket)) {
+        guac_client_log(client, GUAC_LOG_WARNING,
+                "Recording stopped, no further keyframes are indexed");
+        return;
+    }
+#endif
+
+    /* Index the keyframe once it is part of the recording */
+    fprintf(recording->index, "%lli,%lli\n",
+            (long long) timestamp, (long long) offset);
+    fflush(recording->index);
+
+    recording->last_keyframe = timestamp;
+
+}
+
+void guac_common_recording_free(guac_common_recording* recording) {
+
+    if (recording->index != NULL)
+        fclose(recording->index);
+
+    if (recording->keyframe != NULL)
+        guac_socket_free(recording->keyframe);
+
+    free(recording);
+
+}
@@ -20,6 +20,7 @@
 #include <guacamole/config.h>
 #include <common/rect.h>
 #include <common/surface.h>
+#include <common/surface_kernels.h>
 
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
@@ -81,13 +82,6 @@
 #define cairo_format_stride_for_width(format, width) (width*4)
 #endif
 
-/**
- * The JPEG image quality ('quantization') setting to use. Range 0-100 where
- * 100 is the highest quality/largest file size, and 0 is the lowest
- * quality/smallest file size.
- */
-#define GUAC_SURFACE_JPEG_IMAGE_QUALITY 90
-
 /**
  * The framerate which, if exceeded, indicates that JPEG is preferred.
  */
@@ -99,13 +93,6 @@
  */
 #define GUAC_SURFACE_JPEG_MIN_BITMAP_SIZE 4096
 
-/**
- * The WebP image quality ('quantization') setting to use. Range 0-100 where
- * 100 is the highest quality/largest file size, and 0 is the lowest
- * quality/smallest file size.
- */
-#define GUAC_SURFACE_WEBP_IMAGE_QUALITY 90
-
 /**
  * The JPEG compression min block size. This defines the optimal rectangle block
  * size factor for JPEG compression. Usually 8x8 would suffice, but use 16 to
@@ -120,6 +107,29 @@
  */
 #define GUAC_SURFACE_WEBP_BLOCK_SIZE 8
 
+/**
+ * The minimum number of rows or columns of content which must have shifted
+ * within a dirty rect for the shift to be sent as a copy.
+ */
+#define GUAC_SURFACE_SCROLL_MIN_LINES 32
+
+/**
+ * The minimum extent, in pixels, of a dirty rect perpendicular to the
+ * direction of scrolling for scroll detection to be attempted.
+ */
+#define GUAC_SURFACE_SCROLL_MIN_EXTENT 64
+
+/**
+ * The maximum number of distinctive lines of the current contents which are
+ * searched for within the previous contents when detecting scrolling.
+ */
+#define GUAC_SURFACE_SCROLL_ANCHORS 8
+
+/**
+ * The maximum number of candidate offsets considered for each anchor line.
+ */
+#define GUAC_SURFACE_SCROLL_CANDIDATES 16
+
 void guac_common_surface_move(guac_common_surface* surface, int x, int y) {
 
 #ifdef HAVE_BOOST
@@ -257,6 +267,37 @@ static void __guac_common_clip_rect(guac_common_surface* surface,
 
 }
 
+/**
+ * Copies the given rect of the surface buffer into the shadow buffer, such
+ * that the shadow buffer reflects content which has been sent to the client.
+ * If the surface has no shadow buffer, this function has no effect.
+ *
+ * @param surface
+ *     The surface whose shadow buffer should be updated.
+ *
+ * @param rect
+ *     The rect to copy, which will be clipped to the bounds of the surface.
+ */
+static void __guac_common_surface_sync_shadow(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    if (surface->shadow_buffer == NULL)
+        return;
+
+    guac_common_rect bounded = *rect;
+    __guac_common_bound_rect(surface, &bounded, NULL, NULL);
+
+    int offset = bounded.y * surface->stride + bounded.x * 4;
+    int y;
+
+    for (y = 0; y < bounded.height; y++) {
+        memcpy(surface->shadow_buffer + offset, surface->buffer + offset,
+                bounded.width * 4);
+        offset += surface->stride;
+    }
+
+}
+
 /**
  * Returns whether a rectangle within the given surface contains only fully
  * opaque pixels.
@@ -489,7 +530,7 @@ static unsigned int __guac_common_surface_calculate_framerate(
 static int __guac_common_surface_png_optimality(guac_common_surface* surface,
         const guac_common_rect* rect) {
 
-    int x, y;
+    int y;
 
     int num_same = 0;
     int num_different = 1;
@@ -506,27 +547,16 @@ static int __guac_common_surface_png_optimality(guac_common_surface* surface,
     if (width < 1 || height < 1)
         return 0;
 
+    const guac_common_surface_kernels* kernels = guac_common_surface_get_kernels();
+
     /* For each row */
     for (y = 0; y < height; y++) {
 
-        uint32_t* row = (uint32_t*) buffer;
-        uint32_t last_pixel = *(row++) | 0xFF000000;
-
-        /* For each pixel in current row */
-        for (x = 1; x < width; x++) {
-
-            /* Get next pixel */
-            uint32_t current_pixel = *(row++) | 0xFF000000;
-
-            /* Update same/different counts according to pixel value */
-            if (current_pixel == last_pixel)
-                num_same++;
-            else
-                num_different++;
+        /* Count pixels matching their left neighbour */
+        int row_same = kernels->count_same((uint32_t*) buffer, width);
 
-            last_pixel = current_pixel;
-
-        }
+        num_same += row_same;
+        num_different += width - 1 - row_same;
 
         /* Advance to next row */
         buffer += stride;
@@ -563,10 +593,12 @@ static int __guac_common_surface_should_use_jpeg(guac_common_surface* surface,
     /* JPEG is preferred if:
      * - frame rate is high enough
      * - image size is large enough
-     * - PNG is not more optimal based on image contents */
+     * - PNG is not more optimal based on image contents, allowing for the
+     *   lossy threshold raised by the quality controller under load */
     return framerate >= GUAC_COMMON_SURFACE_JPEG_FRAMERATE
         && rect_size > GUAC_SURFACE_JPEG_MIN_BITMAP_SIZE
-        && __guac_common_surface_png_optimality(surface, rect) < 0;
+        && __guac_common_surface_png_optimality(surface, rect)
+               < surface->quality.lossy_threshold;
 
 }
 
@@ -596,9 +628,11 @@ static int __guac_common_surface_should_use_webp(guac_common_surface* surface,
 
     /* WebP is preferred if:
      * - frame rate is high enough
-     * - PNG is not more optimal based on image contents */
+     * - PNG is not more optimal based on image contents, allowing for the
+     *   lossy threshold raised by the quality controller under load */
     return framerate >= GUAC_COMMON_SURFACE_JPEG_FRAMERATE
-        && __guac_common_surface_png_optimality(surface, rect) < 0;
+        && __guac_common_surface_png_optimality(surface, rect)
+               < surface->quality.lossy_threshold;
 
 }
 
@@ -895,83 +929,6 @@ static void __guac_common_surface_set(guac_common_surface* dst,
 
 }
 
-/**
- * Applies the Porter-Duff "over" composite operator, blending the two given
- * color components using the given alpha value.
- *
- * @param dst
- *     The destination color component.
- *
- * @param src
- *     The source color component.
- *
- * @param alpha
- *     The alpha value which applies to the blending operation.
- *
- * @return
- *     The result of applying the Porter-Duff "over" composite operator to the
- *     given source and destination components.
- */
-static int guac_common_surface_blend_component(int dst, int src, int alpha) {
-
-    int blended = src + dst * (0xFF - alpha);
-
-    /* Do not exceed maximum component value */
-    if (blended > 0xFF)
-        return 0xFF;
-
-    return blended;
-
-}
-
-/**
- * Applies the Porter-Duff "over" composite operator, blending each component
- * of the two given ARGB colors.
- *
- * @param dst
- *     The destination ARGB color.
- *
- * @param src
- *     The source ARGB color.
- *
- * @return
- *     The result of applying the Porter-Duff "over" composite operator to the
- *     given source and destination colors.
- */
-static uint32_t guac_common_surface_argb_blend(uint32_t dst, uint32_t src) {
-
-    /* Separate destination ARGB color into its components */
-    int dst_a = (dst >> 24) & 0xFF;
-    int dst_r = (dst >> 16) & 0xFF;
-    int dst_g = (dst >>  8) & 0xFF;
-    int dst_b =  dst        & 0xFF;
-
-    /* Separate source ARGB color into its components */
-    int src_a = (src >> 24) & 0xFF;
-    int src_r = (src >> 16) & 0xFF;
-    int src_g = (src >>  8) & 0xFF;
-    int src_b =  src        & 0xFF;
-
-    /* If source is fully opaque (or destination is fully transparent), the
-     * blended result is the source */
-    if (src_a == 0xFF || dst_a == 0x00)
-        return src;
-
-    /* If source is fully transparent, the blended result is the destination */
-    if (src_a == 0x00)
-        return dst;
-
-    /* Otherwise, blend each ARGB component, assuming pre-multiplied alpha */
-    int r = guac_common_surface_blend_component(dst_r, src_r, src_a);
-    int g = guac_common_surface_blend_component(dst_g, src_g, src_a);
-    int b = guac_common_surface_blend_component(dst_b, src_b, src_a);
-    int a = guac_common_surface_blend_component(dst_a, src_a, src_a);
-
-    /* Recombine blended components */
-    return (a << 24) | (r << 16) | (g << 8) | b;
-
-}
-
 /**
  * Copies data from the given buffer to the surface at the given coordinates.
  * The dimensions and location of the destination rectangle will be altered
@@ -994,7 +951,7 @@ static void __guac_common_surface_put(unsigned char* src_buffer, int src_stride,
     unsigned char* dst_buffer = dst->buffer;
     int dst_stride = dst->stride;
 
-    int x, y;
+    int y;
 
     int min_x = rect->width;
     int min_y = rect->height;
@@ -1004,46 +961,26 @@ static void __guac_common_surface_put(unsigned char* src_buffer, int src_stride,
     int orig_x = rect->x;
     int orig_y = rect->y;
 
+    /* Ignore alpha channel if opaque, otherwise perform alpha blending */
+    const guac_common_surface_kernels* kernels = guac_common_surface_get_kernels();
+    guac_common_surface_put_kernel* put =
+        opaque ? kernels->put_opaque : kernels->put_blend;
+
     src_buffer += src_stride * (*sy) + 4 * (*sx);
     dst_buffer += (dst_stride * rect->y) + (4 * rect->x);
 
     /* For each row */
     for (y=0; y < rect->height; y++) {
 
-        uint32_t* src_current = (uint32_t*) src_buffer;
-        uint32_t* dst_current = (uint32_t*) dst_buffer;
-
-        /* Copy row */
-        for (x=0; x < rect->width; x++) {
-
-            uint32_t color;
-
-            /* Get source and destination color values */
-            uint32_t src_color = *src_current;
-            uint32_t dst_color = *dst_current;
-
-            /* Ignore alpha channel if opaque */
-            if (opaque)
-                color = src_color | 0xFF000000;
-
-            /* Otherwise, perform alpha blending operation */
-            else
-                color = guac_common_surface_argb_blend(dst_color, src_color);
-
-            /* If the destination color is changing, update rectangle bounds
-             * and store the new color */
-            if (dst_color != color) {
-                if (x < min_x) min_x = x;
-                if (y < min_y) min_y = y;
-                if (x > max_x) max_x = x;
-                if (y > max_y) max_y = y;
-                *dst_current = color;
-            }
-
-            /* Advance to next pixel */
-            src_current++;
-            dst_current++;
+        int first, last;
 
+        /* Copy row, updating rectangle bounds if any pixels changed */
+        if (put((uint32_t*) dst_buffer, (uint32_t*) src_buffer, rect->width,
+                    &first, &last)) {
+            if (first < min_x) min_x = first;
+            if (last  > max_x) max_x = last;
+            if (y < min_y) min_y = y;
+            max_y = y;
         }
 
         /* Next row */
@@ -1094,7 +1031,9 @@ static void __guac_common_surface_fill_mask(unsigned char* src_buffer, int src_s
     int dst_stride = dst->stride;
 
     uint32_t color = 0xFF000000 | (red << 16) | (green << 8) | blue;
-    int x, y;
+    int y;
+
+    const guac_common_surface_kernels* kernels = guac_common_surface_get_kernels();
 
     src_buffer += src_stride*sy + 4*sx;
     dst_buffer += (dst_stride * rect->y) + (4 * rect->x);
@@ -1102,19 +1041,9 @@ static void __guac_common_surface_fill_mask(unsigned char* src_buffer, int src_s
     /* For each row */
     for (y=0; y < rect->height; y++) {
 
-        uint32_t* src_current = (uint32_t*) src_buffer;
-        uint32_t* dst_current = (uint32_t*) dst_buffer;
-
-        /* Stencil row */
-        for (x=0; x < rect->width; x++) {
-
-            /* Fill with color if opaque */
-            if (*src_current & 0xFF000000)
-                *dst_current = color;
-
-            src_current++;
-            dst_current++;
-        }
+        /* Stencil row, filling with color wherever the mask is opaque */
+        kernels->fill_mask((uint32_t*) dst_buffer, (uint32_t*) src_buffer,
+                rect->width, color);
 
         /* Next row */
         src_buffer += src_stride;
@@ -1269,6 +1198,10 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
     if (layer->index >= 0) {
         guac_protocol_send_size(socket, layer, w, h);
         surface->realized = 1;
+
+        /* New layers are initially blank, as is the buffer */
+        surface->shadow_buffer = (unsigned char *)calloc(h, surface->stride);
+        surface->shadow_valid = 1;
     }
 
     /* Defer creation of buffers */
@@ -1278,6 +1211,26 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
     return surface;
 }
 
+void guac_common_surface_set_tile_cache(guac_common_surface* surface,
+        guac_common_tile_cache* tile_cache) {
+
+#ifdef HAVE_BOOST
+	surface->_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+	pthread_mutex_lock(&surface->_lock);
+#endif
+
+    surface->tile_cache = tile_cache;
+    surface->tile_cache_queue_length = 0;
+
+#ifdef HAVE_BOOST
+	surface->_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&surface->_lock);
+#endif
+
+}
+
 void guac_common_surface_free(guac_common_surface* surface) {
 
     /* Only dispose of surface if it exists */
@@ -1289,6 +1242,7 @@ void guac_common_surface_free(guac_common_surface* surface) {
 #endif
 
     free(surface->heat_map);
+    free(surface->shadow_buffer);
     free(surface->buffer);
     free(surface);
 
@@ -1347,6 +1301,13 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     /* Free old data */
     free(old_buffer);
 
+    /* Client contents are resynchronized by the next flush */
+    if (surface->shadow_buffer != NULL) {
+        free(surface->shadow_buffer);
+        surface->shadow_buffer = (unsigned char *)calloc(h, surface->stride);
+        surface->shadow_valid = 0;
+    }
+
     /* Allocate completely new heat map (can safely discard old stats) */
     free(surface->heat_map);
     surface->heat_map = static_cast<guac_common_surface_heat_cell*>(
@@ -1519,6 +1480,7 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
     }
 
     guac_common_rect drect;
+    int sent = 0;
     guac_common_rect_init(&drect, dx, dy,
             srect.width, srect.height);
 
@@ -1572,6 +1534,7 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
                 drect.width, drect.height, GUAC_COMP_OVER, dst_layer,
                 drect.x, drect.y);
         dst->realized = 1;
+        sent = 1;
     }
 
     /* Update backing surface last if drect can intersect srect */
@@ -1579,6 +1542,10 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
         __guac_common_surface_transfer(src, &srect.x, &srect.y,
                 GUAC_TRANSFER_BINARY_SRC, dst, &drect);
 
+    /* The client has now drawn the same content */
+    if (sent)
+        __guac_common_surface_sync_shadow(dst, &drect);
+
 #ifdef HAVE_BOOST
 	dst->_lock.unlock();
 	if(src != dst)
@@ -1629,6 +1596,7 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
 	}
 
     guac_common_rect drect;
+    int sent = 0;
     guac_common_rect_init(&drect, dx, dy,
             srect.width, srect.height);
 
@@ -1680,12 +1648,17 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
         guac_protocol_send_transfer(socket, src_layer, srect.x, srect.y,
                 drect.width, drect.height, op, dst_layer, drect.x, drect.y);
         dst->realized = 1;
+        sent = 1;
     }
 
     /* Update backing surface last if drect can intersect srect */
     if (src == dst)
         __guac_common_surface_transfer(src, &srect.x, &srect.y, op, dst, &drect);
 
+    /* The client has now drawn the same content */
+    if (sent)
+        __guac_common_surface_sync_shadow(dst, &drect);
+
 #ifdef HAVE_BOOST
 	dst->_lock.unlock();
 	if (src != dst)
@@ -1757,6 +1730,9 @@ void guac_common_surface_set(guac_common_surface* surface,
         guac_protocol_send_rect(socket, layer, rect.x, rect.y, rect.width, rect.height);
         guac_protocol_send_cfill(socket, GUAC_COMP_OVER, layer, red, green, blue, alpha);
         surface->realized = 1;
+
+        /* The client has now drawn the same content */
+        __guac_common_surface_sync_shadow(surface, &rect);
     }
 #ifdef HAVE_BOOST
 	surface->_lock.unlock();
@@ -1805,6 +1781,31 @@ void guac_common_surface_reset_clip(guac_common_surface* surface) {
 #endif
 }
 
+/**
+ * Removes all rects from the tile cache queue of the given surface which
+ * intersect the given rect, as the client-side contents of that rect will no
+ * longer match the surface exactly.
+ *
+ * @param surface
+ *     The surface whose tile cache queue should be updated.
+ *
+ * @param rect
+ *     The rect about to be overwritten with lossy data.
+ */
+static void __guac_common_surface_discard_cached(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int i, kept = 0;
+
+    for (i=0; i < surface->tile_cache_queue_length; i++) {
+        if (!guac_common_rect_intersects(&surface->tile_cache_queue[i], rect))
+            surface->tile_cache_queue[kept++] = surface->tile_cache_queue[i];
+    }
+
+    surface->tile_cache_queue_length = kept;
+
+}
+
 /**
  * Flushes the bitmap update currently described by the dirty rectangle within
  * the given surface directly via an "img" instruction as PNG data. The
@@ -1845,6 +1846,9 @@ static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
                     CAIRO_FORMAT_ARGB32, surface->dirty_rect.width,
                     surface->dirty_rect.height, surface->stride);
 
+            /* Any images still being encoded must land before the clear */
+            guac_client_flush_async_streams(surface->client);
+
             /* Clear destination rect first */
             guac_protocol_send_rect(socket, layer,
                     surface->dirty_rect.x, surface->dirty_rect.y,
@@ -1854,9 +1858,16 @@ static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
 
         }
 
-        /* Send PNG for rect */
-        guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
-                layer, surface->dirty_rect.x, surface->dirty_rect.y, rect);
+        /* Send PNG for rect, favoring encoding time as this is a realtime
+         * update */
+        guac_client_stream_png_async(surface->client, socket, GUAC_COMP_OVER,
+                layer, surface->dirty_rect.x, surface->dirty_rect.y, rect, 1);
+
+        /* Lossless opaque tiles may be cached once the flush completes */
+        if (opaque && surface->tile_cache != NULL
+                && surface->tile_cache_queue_length < GUAC_COMMON_SURFACE_QUEUE_SIZE)
+            surface->tile_cache_queue[surface->tile_cache_queue_length++] =
+                surface->dirty_rect;
 
         cairo_surface_destroy(rect);
         surface->realized = 1;
@@ -1892,6 +1903,9 @@ static void __guac_common_surface_flush_to_jpeg(guac_common_surface* surface) {
         guac_common_rect_expand_to_grid(GUAC_SURFACE_JPEG_BLOCK_SIZE,
                                         &surface->dirty_rect, &max);
 
+        /* Lossy data will replace any tiles queued for caching */
+        __guac_common_surface_discard_cached(surface, &surface->dirty_rect);
+
         /* Get Cairo surface for specified rect */
         unsigned char* buffer = surface->buffer
                               + surface->dirty_rect.y * surface->stride
@@ -1902,9 +1916,9 @@ static void __guac_common_surface_flush_to_jpeg(guac_common_surface* surface) {
                 surface->dirty_rect.height, surface->stride);
 
         /* Send JPEG for rect */
-        guac_client_stream_jpeg(surface->client, socket, GUAC_COMP_OVER, layer,
+        guac_client_stream_jpeg_async(surface->client, socket, GUAC_COMP_OVER, layer,
                 surface->dirty_rect.x, surface->dirty_rect.y, rect,
-                GUAC_SURFACE_JPEG_IMAGE_QUALITY);
+                surface->quality.image_quality);
 
         cairo_surface_destroy(rect);
         surface->realized = 1;
@@ -1944,6 +1958,9 @@ static void __guac_common_surface_flush_to_webp(guac_common_surface* surface,
         guac_common_rect_expand_to_grid(GUAC_SURFACE_WEBP_BLOCK_SIZE,
                                         &surface->dirty_rect, &max);
 
+        /* Lossy data will replace any tiles queued for caching */
+        __guac_common_surface_discard_cached(surface, &surface->dirty_rect);
+
         /* Get Cairo surface for specified rect */
         unsigned char* buffer = surface->buffer
                               + surface->dirty_rect.y * surface->stride
@@ -1964,9 +1981,9 @@ static void __guac_common_surface_flush_to_webp(guac_common_surface* surface,
                     surface->dirty_rect.height, surface->stride);
 
         /* Send WebP for rect */
-        guac_client_stream_webp(surface->client, socket, GUAC_COMP_OVER, layer,
+        guac_client_stream_webp_async(surface->client, socket, GUAC_COMP_OVER, layer,
                 surface->dirty_rect.x, surface->dirty_rect.y, rect,
-                GUAC_SURFACE_WEBP_IMAGE_QUALITY, 0);
+                surface->quality.image_quality, 0);
 
         cairo_surface_destroy(rect);
         surface->realized = 1;
@@ -1978,6 +1995,227 @@ static void __guac_common_surface_flush_to_webp(guac_common_surface* surface,
 
 }
 
+/**
+ * Flushes the bitmap update currently described by the dirty rectangle within
+ * the given surface as an image, choosing the most appropriate format.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @param opaque
+ *     Whether the rectangle being flushed contains only fully-opaque pixels.
+ */
+static void __guac_common_surface_flush_to_image(guac_common_surface* surface,
+        int opaque) {
+
+    /* Prefer WebP when reasonable */
+    if (__guac_common_surface_should_use_webp(surface,
+                &surface->dirty_rect))
+        __guac_common_surface_flush_to_webp(surface, opaque);
+
+    /* If not WebP, JPEG is the next best (lossy) choice */
+    else if (opaque && __guac_common_surface_should_use_jpeg(
+                surface, &surface->dirty_rect))
+        __guac_common_surface_flush_to_jpeg(surface);
+
+    /* Use PNG if no lossy formats are appropriate */
+    else
+        __guac_common_surface_flush_to_png(surface, opaque);
+
+}
+
+/**
+ * Flushes the given horizontal span of the given surface as an image, if the
+ * span is non-empty.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @param x
+ *     The X coordinate of the left edge of the span.
+ *
+ * @param y
+ *     The Y coordinate of the top edge of the span.
+ *
+ * @param width
+ *     The width of the span.
+ *
+ * @param height
+ *     The height of the span.
+ */
+static void __guac_common_surface_flush_span(guac_common_surface* surface,
+        int x, int y, int width, int height) {
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    guac_common_rect_init(&surface->dirty_rect, x, y, width, height);
+    surface->dirty = 1;
+
+    __guac_common_surface_flush_to_image(surface, 1);
+
+}
+
+/**
+ * Flushes the bitmap update currently described by the dirty rectangle within
+ * the given surface using the tile cache wherever possible. Grid-aligned tiles
+ * already present within the tile cache are drawn with "copy" instructions,
+ * while all remaining content is encoded as images in horizontal spans. If no
+ * tile is found within the cache, nothing is flushed, such that the dirty
+ * rectangle can be encoded as a single image.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @param opaque
+ *     Whether the rectangle being flushed contains only fully-opaque pixels.
+ *
+ * @return
+ *     Non-zero if the dirty rectangle was flushed, zero otherwise.
+ */
+static int __guac_common_surface_flush_from_cache(guac_common_surface* surface,
+        int opaque) {
+
+    guac_common_tile_cache* cache = surface->tile_cache;
+
+    /* Only opaque content is cached */
+    if (cache == NULL || !opaque)
+        return 0;
+
+    const int size = GUAC_COMMON_TILE_CACHE_TILE_SIZE;
+    guac_common_rect rect = surface->dirty_rect;
+
+    /* Range of grid-aligned tiles lying entirely within the dirty rect */
+    int left   = (rect.x + size - 1) / size;
+    int top    = (rect.y + size - 1) / size;
+    int right  = (rect.x + rect.width) / size;
+    int bottom = (rect.y + rect.height) / size;
+
+    int columns = right - left;
+    int rows = bottom - top;
+    if (columns <= 0 || rows <= 0)
+        return 0;
+
+    /* Location of each tile within the cache, X of -1 if not cached */
+    int* hits = static_cast<int*>(malloc(columns * rows * 2 * sizeof(int)));
+    int hit_count = 0;
+    int row, column;
+
+    for (row = 0; row < rows; row++) {
+        for (column = 0; column < columns; column++) {
+
+            int* hit = &hits[(row * columns + column) * 2];
+            unsigned char* buffer = surface->buffer
+                                  + (top + row) * size * surface->stride
+                                  + (left + column) * size * 4;
+
+            if (guac_common_tile_cache_lookup(cache, buffer, surface->stride,
+                        &hit[0], &hit[1]))
+                hit_count++;
+            else
+                hit[0] = -1;
+
+        }
+    }
+
+    /* Encode as a whole if nothing can be copied */
+    if (hit_count == 0) {
+        free(hits);
+        return 0;
+    }
+
+    /* Copies must follow any images still being encoded */
+    guac_client_flush_async_streams(surface->client);
+
+    /* Partial band above the first row of tiles */
+    __guac_common_surface_flush_span(surface, rect.x, rect.y,
+            rect.width, top * size - rect.y);
+
+    for (row = 0; row < rows; row++) {
+
+        int y = (top + row) * size;
+
+        /* Start of the current span of uncached content */
+        int span_x = rect.x;
+
+        for (column = 0; column < columns; column++) {
+
+            int* hit = &hits[(row * columns + column) * 2];
+            int x = (left + column) * size;
+
+            if (hit[0] == -1)
+                continue;
+
+            /* Encode everything up to this tile, then copy the tile */
+            __guac_common_surface_flush_span(surface, span_x, y,
+                    x - span_x, size);
+
+            guac_protocol_send_copy(surface->socket, cache->buffer,
+                    hit[0], hit[1], size, size, GUAC_COMP_OVER,
+                    surface->layer, x, y);
+
+            span_x = x + size;
+
+        }
+
+        /* Remainder of row */
+        __guac_common_surface_flush_span(surface, span_x, y,
+                rect.x + rect.width - span_x, size);
+
+    }
+
+    /* Partial band below the last row of tiles */
+    __guac_common_surface_flush_span(surface, rect.x, bottom * size,
+            rect.width, rect.y + rect.height - bottom * size);
+
+    free(hits);
+
+    surface->realized = 1;
+    surface->dirty = 0;
+    return 1;
+
+}
+
+/**
+ * Adds all grid-aligned tiles within the rects of the tile cache queue of the
+ * given surface to the tile cache, emptying the queue. This must only be
+ * invoked once all images of the current flush have been sent, such that the
+ * client-side contents of those tiles are final.
+ *
+ * @param surface
+ *     The surface whose queued tiles should be cached.
+ */
+static void __guac_common_surface_flush_tile_cache(
+        guac_common_surface* surface) {
+
+    const int size = GUAC_COMMON_TILE_CACHE_TILE_SIZE;
+    int i, x, y;
+
+    for (i=0; i < surface->tile_cache_queue_length; i++) {
+
+        guac_common_rect* rect = &surface->tile_cache_queue[i];
+
+        /* Cache each tile lying entirely within the rect */
+        int left   = (rect->x + size - 1) / size * size;
+        int top    = (rect->y + size - 1) / size * size;
+        int right  = (rect->x + rect->width) / size * size;
+        int bottom = (rect->y + rect->height) / size * size;
+
+        for (y = top; y < bottom; y += size) {
+            for (x = left; x < right; x += size) {
+                guac_common_tile_cache_insert(surface->tile_cache,
+                        surface->layer, x, y,
+                        surface->buffer + y * surface->stride + x * 4,
+                        surface->stride);
+            }
+        }
+
+    }
+
+    surface->tile_cache_queue_length = 0;
+
+}
+
 /**
  * Comparator for instances of guac_common_surface_bitmap_rect, the elements
  * which make up a surface's bitmap buffer.
@@ -2033,16 +2271,297 @@ static void __guac_common_surface_flush_properties(
 
 }
 
+/**
+ * Hashes a single row or column of pixels.
+ *
+ * @param data
+ *     The first pixel of the line.
+ *
+ * @param step
+ *     The number of bytes between consecutive pixels of the line.
+ *
+ * @param length
+ *     The number of pixels in the line.
+ *
+ * @return
+ *     An arbitrary hash of the pixels within the line.
+ */
+static uint32_t __guac_common_surface_hash_line(const unsigned char* data,
+        int step, int length) {
+
+    /* FNV-1a over whole pixels */
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ *((const uint32_t*) data)) * 16777619u;
+        data += step;
+    }
+
+    return hash;
+
+}
+
+/**
+ * Returns whether the given lines of two buffers are identical.
+ *
+ * @param a
+ *     The first pixel of the line within the first buffer.
+ *
+ * @param b
+ *     The first pixel of the line within the second buffer.
+ *
+ * @param step
+ *     The number of bytes between consecutive pixels of each line.
+ *
+ * @param length
+ *     The number of pixels in each line.
+ *
+ * @return
+ *     Non-zero if the lines are identical, zero otherwise.
+ */
+static int __guac_common_surface_lines_equal(const unsigned char* a,
+        const unsigned char* b, int step, int length) {
+
+    /* Rows are contiguous */
+    if (step == 4)
+        return memcmp(a, b, length * 4) == 0;
+
+    int i;
+    for (i = 0; i < length; i++) {
+        if (*((const uint32_t*) a) != *((const uint32_t*) b))
+            return 0;
+        a += step;
+        b += step;
+    }
+
+    return 1;
+
+}
+
+/**
+ * Searches the given rect of the surface for content which has shifted
+ * vertically (or horizontally) relative to the shadow buffer. If such a shift
+ * is found, a "copy" instruction moving the shifted content is sent, the
+ * shadow buffer is updated, and the rect is reduced to the content which was
+ * newly exposed. If both sides of the shifted content remain dirty and the
+ * bitmap queue has room, one side is added to the queue as a separate rect.
+ *
+ * @param surface
+ *     The surface to search.
+ *
+ * @param rect
+ *     The dirty rect to search, which will be updated in-place if a shift is
+ *     found.
+ *
+ * @param vertical
+ *     Non-zero to search for vertical scrolling (shifted rows), zero to search
+ *     for horizontal scrolling (shifted columns).
+ *
+ * @return
+ *     Non-zero if a copy was sent, zero otherwise.
+ */
+static int __guac_common_surface_detect_scroll(guac_common_surface* surface,
+        guac_common_rect* rect, int vertical) {
+
+    /* Lines are rows when scrolling vertically, columns otherwise */
+    int lines  = vertical ? rect->height : rect->width;
+    int length = vertical ? rect->width  : rect->height;
+    int line_step  = vertical ? surface->stride : 4;
+    int pixel_step = vertical ? 4 : surface->stride;
+
+    if (lines < GUAC_SURFACE_SCROLL_MIN_LINES * 2
+            || length < GUAC_SURFACE_SCROLL_MIN_EXTENT)
+        return 0;
+
+    int origin = rect->y * surface->stride + rect->x * 4;
+    const unsigned char* current = surface->buffer + origin;
+    const unsigned char* previous = surface->shadow_buffer + origin;
+
+    uint32_t* current_hashes = static_cast<uint32_t*>(
+            malloc(lines * 2 * sizeof(uint32_t)));
+    uint32_t* previous_hashes = current_hashes + lines;
+    int i, j;
+
+    for (i = 0; i < lines; i++) {
+        current_hashes[i] = __guac_common_surface_hash_line(
+                current + i * line_step, pixel_step, length);
+        previous_hashes[i] = __guac_common_surface_hash_line(
+                previous + i * line_step, pixel_step, length);
+    }
+
+    int best_offset = 0;
+    int best_start = 0;
+    int best_length = 0;
+    int anchors = 0;
+
+    /* Try distinctive lines spread across the rect as anchors */
+    int spacing = lines / (GUAC_SURFACE_SCROLL_ANCHORS + 1);
+    for (i = spacing; i < lines - 1 && anchors < GUAC_SURFACE_SCROLL_ANCHORS;
+            i += spacing) {
+
+        /* Uniform content (blank lines) cannot identify an offset */
+        if (current_hashes[i] == current_hashes[i - 1]
+                && current_hashes[i] == current_hashes[i + 1])
+            continue;
+
+        anchors++;
+
+        int candidates = 0;
+        for (j = 0; j < lines && candidates < GUAC_SURFACE_SCROLL_CANDIDATES;
+                j++) {
+
+            if (j == i || previous_hashes[j] != current_hashes[i])
+                continue;
+
+            candidates++;
+
+            /* Find the longest run of lines matching at this offset */
+            int offset = j - i;
+            int first = offset < 0 ? -offset : 0;
+            int last  = offset > 0 ? lines - offset : lines;
+            int run_start = first;
+            int k;
+
+            for (k = first; k <= last; k++) {
+
+                if (k < last && current_hashes[k] == previous_hashes[k + offset])
+                    continue;
+
+                if (k - run_start > best_length) {
+                    best_offset = offset;
+                    best_start = run_start;
+                    best_length = k - run_start;
+                }
+
+                run_start = k + 1;
+
+            }
+
+        }
+
+    }
+
+    free(current_hashes);
+
+    if (best_length < GUAC_SURFACE_SCROLL_MIN_LINES)
+        return 0;
+
+    /* Hashes may collide, so verify the run exactly */
+    for (i = best_start; i < best_start + best_length; i++) {
+        if (!__guac_common_surface_lines_equal(current + i * line_step,
+                    previous + (i + best_offset) * line_step,
+                    pixel_step, length))
+            return 0;
+    }
+
+    guac_common_rect shifted;
+    if (vertical)
+        guac_common_rect_init(&shifted, rect->x, rect->y + best_start,
+                rect->width, best_length);
+    else
+        guac_common_rect_init(&shifted, rect->x + best_start, rect->y,
+                best_length, rect->height);
+
+    /* Copy the shifted content within the client's own layer */
+    guac_protocol_send_copy(surface->socket, surface->layer,
+            shifted.x + (vertical ? 0 : best_offset),
+            shifted.y + (vertical ? best_offset : 0),
+            shifted.width, shifted.height, GUAC_COMP_OVER,
+            surface->layer, shifted.x, shifted.y);
+
+    __guac_common_surface_sync_shadow(surface, &shifted);
+
+    /* Lines before and after the shifted content remain dirty */
+    int before = best_start;
+    int after = lines - best_start - best_length;
+
+    guac_common_rect head, tail;
+    if (vertical) {
+        guac_common_rect_init(&head, rect->x, rect->y, rect->width, before);
+        guac_common_rect_init(&tail, rect->x, shifted.y + shifted.height,
+                rect->width, after);
+    }
+    else {
+        guac_common_rect_init(&head, rect->x, rect->y, before, rect->height);
+        guac_common_rect_init(&tail, shifted.x + shifted.width, rect->y,
+                after, rect->height);
+    }
+
+    if (after == 0)
+        *rect = head;
+
+    else if (before == 0)
+        *rect = tail;
+
+    /* Split into two rects if possible, otherwise leave rect untouched */
+    else if (surface->bitmap_queue_length < GUAC_COMMON_SURFACE_QUEUE_SIZE) {
+        guac_common_surface_bitmap_rect* queued =
+            &(surface->bitmap_queue[surface->bitmap_queue_length++]);
+        queued->rect = tail;
+        queued->flushed = 0;
+        *rect = head;
+    }
+
+    return 1;
+
+}
+
+/**
+ * Replaces scrolled content within all rects of the bitmap queue of the given
+ * surface with copies, such that only newly-exposed content is encoded. Rects
+ * which are left empty are marked as flushed.
+ *
+ * @param surface
+ *     The surface whose bitmap queue should be searched for scrolling.
+ */
+static void __guac_common_surface_flush_scroll(guac_common_surface* surface) {
+
+    int i;
+
+    /* Nothing to compare against if the client contents are unknown */
+    if (surface->shadow_buffer == NULL || !surface->shadow_valid)
+        return;
+
+    for (i=0; i < surface->bitmap_queue_length; i++) {
+
+        guac_common_surface_bitmap_rect* current = &surface->bitmap_queue[i];
+
+        __guac_common_bound_rect(surface, &current->rect, NULL, NULL);
+        if (current->rect.width <= 0 || current->rect.height <= 0)
+            continue;
+
+        /* Vertical scrolling is far more common, so check it first */
+        if (!__guac_common_surface_detect_scroll(surface, &current->rect, 1))
+            __guac_common_surface_detect_scroll(surface, &current->rect, 0);
+
+        if (current->rect.width <= 0 || current->rect.height <= 0)
+            current->flushed = 1;
+
+    }
+
+}
+
 static void __guac_common_surface_flush(guac_common_surface* surface) {
 
+    /* Encode all updates of this flush using the same quality settings */
+    guac_client_get_quality(surface->client, &surface->quality);
+
     /* Flush final dirty rectangle to queue. */
     __guac_common_surface_flush_to_queue(surface);
 
+    /* Send scrolled content as copies, leaving only exposed content queued */
+    __guac_common_surface_flush_scroll(surface);
+
     guac_common_surface_bitmap_rect* current = surface->bitmap_queue;
     int i, j;
     int original_queue_length;
     int flushed = 0;
 
+    /* Bounds of all content sent, for updating the shadow buffer */
+    guac_common_rect flushed_rect;
+    guac_common_rect_init(&flushed_rect, 0, 0, 0, 0);
+
     original_queue_length = surface->bitmap_queue_length;
 
     /* Sort updates to make combination less costly */
@@ -2089,24 +2608,17 @@ static void __guac_common_surface_flush(guac_common_surface* surface) {
             /* Flush as bitmap otherwise */
             else if (surface->dirty) {
 
-                flushed++;
+                if (flushed++)
+                    guac_common_rect_extend(&flushed_rect, &surface->dirty_rect);
+                else
+                    flushed_rect = surface->dirty_rect;
 
                 int opaque = __guac_common_surface_is_opaque(surface,
                             &surface->dirty_rect);
 
-                /* Prefer WebP when reasonable */
-                if (__guac_common_surface_should_use_webp(surface,
-                            &surface->dirty_rect))
-                    __guac_common_surface_flush_to_webp(surface, opaque);
-
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (opaque && __guac_common_surface_should_use_jpeg(
-                            surface, &surface->dirty_rect))
-                    __guac_common_surface_flush_to_jpeg(surface);
-
-                /* Use PNG if no lossy formats are appropriate */
-                else
-                    __guac_common_surface_flush_to_png(surface, opaque);
+                /* Copy previously-sent tiles, encoding only what remains */
+                if (!__guac_common_surface_flush_from_cache(surface, opaque))
+                    __guac_common_surface_flush_to_image(surface, opaque);
 
             }
 
@@ -2116,6 +2628,22 @@ static void __guac_common_surface_flush(guac_common_surface* surface) {
 
     }
 
+    /* Wait for background encoding, as the buffer may change once unlocked */
+    guac_client_flush_async_streams(surface->client);
+
+    /* Cache tiles sent losslessly, now that they exist on the client */
+    __guac_common_surface_flush_tile_cache(surface);
+
+    /* The client now matches the surface entirely, content outside the
+     * flushed rects having been unchanged */
+    if (!surface->shadow_valid) {
+        guac_common_rect_init(&flushed_rect, 0, 0,
+                surface->width, surface->height);
+        surface->shadow_valid = 1;
+    }
+
+    __guac_common_surface_sync_shadow(surface, &flushed_rect);
+
     /* Flush complete */
     surface->bitmap_queue_length = 0;
 
@@ -2177,6 +2705,11 @@ void guac_common_surface_dup(guac_common_surface* surface, guac_user* user,
     guac_protocol_send_size(socket, surface->layer,
             surface->width, surface->height);
 
+    /* The new user receives pending updates early, so its contents will
+     * differ from the shadow buffer until the next flush */
+    if (surface->dirty || surface->bitmap_queue_length > 0)
+        surface->shadow_valid = 0;
+
     /* Send contents of layer, if non-empty */
     if (surface->width > 0 && surface->height > 0) {
 
@@ -2185,9 +2718,18 @@ void guac_common_surface_dup(guac_common_surface* surface, guac_user* user,
                 surface->buffer, CAIRO_FORMAT_ARGB32,
                 surface->width, surface->height, surface->stride);
 
-        /* Send PNG for rect */
-        guac_user_stream_png(user, socket, GUAC_COMP_OVER, surface->layer,
-                0, 0, rect);
+        /* Send PNG for rect, streamed from the client if not synchronizing
+         * a specific user. Keyframes of recordings are rendered on the
+         * thread drawing the display, so are compressed quickly, finishing
+         * before the surface may change again */
+        if (user != NULL)
+            guac_user_stream_png(user, socket, GUAC_COMP_OVER, surface->layer,
+                    0, 0, rect);
+        else {
+            guac_client_stream_png_async(surface->client, socket,
+                    GUAC_COMP_OVER, surface->layer, 0, 0, rect, 1);
+            guac_client_flush_async_streams(surface->client);
+        }
         cairo_surface_destroy(rect);
 
     }
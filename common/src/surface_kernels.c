@@ -0,0 +1,664 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <common/surface_kernels.h>
+
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GUAC_COMMON_SURFACE_KERNELS_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+/*
+ * MSVC permits any intrinsic within any function, while GCC and Clang require
+ * functions using instructions beyond the baseline to be marked as such.
+ */
+#if defined(__GNUC__)
+#define GUAC_TARGET_SSE2 __attribute__((target("sse2")))
+#define GUAC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GUAC_TARGET_SSE2
+#define GUAC_TARGET_AVX2
+#endif
+
+/**
+ * Blends a single component using the same arithmetic as the remainder of
+ * guac_common_surface, saturating at 0xFF.
+ */
+static int __guac_common_blend_component(int dst, int src, int alpha) {
+
+    int blended = src + dst * (0xFF - alpha);
+
+    /* Do not exceed maximum component value */
+    if (blended > 0xFF)
+        return 0xFF;
+
+    return blended;
+
+}
+
+/**
+ * Applies the Porter-Duff "over" composite operator to a single pixel, as
+ * guac_common_surface_argb_blend() within surface.c.
+ */
+static uint32_t __guac_common_blend_pixel(uint32_t dst, uint32_t src) {
+
+    int dst_a = (dst >> 24) & 0xFF;
+    int src_a = (src >> 24) & 0xFF;
+
+    /* If source is fully opaque (or destination is fully transparent), the
+     * blended result is the source */
+    if (src_a == 0xFF || dst_a == 0x00)
+        return src;
+
+    /* If source is fully transparent, the blended result is the destination */
+    if (src_a == 0x00)
+        return dst;
+
+    int r = __guac_common_blend_component((dst >> 16) & 0xFF, (src >> 16) & 0xFF, src_a);
+    int g = __guac_common_blend_component((dst >>  8) & 0xFF, (src >>  8) & 0xFF, src_a);
+    int b = __guac_common_blend_component( dst        & 0xFF,  src        & 0xFF, src_a);
+    int a = __guac_common_blend_component(dst_a, src_a, src_a);
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+
+}
+
+/**
+ * Stores the given pixel if it differs from the current destination pixel,
+ * updating the changed range.
+ */
+static void __guac_common_put_pixel(uint32_t* dst, uint32_t color, int x,
+        int* first, int* last) {
+
+    if (*dst != color) {
+        if (*first < 0)
+            *first = x;
+        *last = x;
+        *dst = color;
+    }
+
+}
+
+/**
+ * Updates the changed range given a bitmask of changed pixels within a block
+ * of pixels starting at the given index.
+ */
+static void __guac_common_put_mask(int changed, int x, int* first, int* last) {
+
+    int i = 0;
+
+    if (!changed)
+        return;
+
+    /* Lowest changed pixel */
+    while (!(changed & (1 << i)))
+        i++;
+
+    if (*first < 0)
+        *first = x + i;
+
+    /* Highest changed pixel */
+    i = 31;
+    while (!(changed & (1 << i)))
+        i--;
+
+    *last = x + i;
+
+}
+
+static int __guac_common_put_opaque_scalar(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last) {
+
+    int x;
+
+    *first = -1;
+    for (x = 0; x < width; x++)
+        __guac_common_put_pixel(&dst[x], src[x] | 0xFF000000, x, first, last);
+
+    return *first >= 0;
+
+}
+
+static int __guac_common_put_blend_scalar(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last) {
+
+    int x;
+
+    *first = -1;
+    for (x = 0; x < width; x++)
+        __guac_common_put_pixel(&dst[x],
+                __guac_common_blend_pixel(dst[x], src[x]), x, first, last);
+
+    return *first >= 0;
+
+}
+
+static void __guac_common_fill_mask_scalar(uint32_t* dst,
+        const uint32_t* mask, int width, uint32_t color) {
+
+    int x;
+
+    for (x = 0; x < width; x++) {
+        if (mask[x] & 0xFF000000)
+            dst[x] = color;
+    }
+
+}
+
+static int __guac_common_count_same_scalar(const uint32_t* row, int width) {
+
+    int x;
+    int same = 0;
+
+    for (x = 1; x < width; x++) {
+        if ((row[x] | 0xFF000000) == (row[x - 1] | 0xFF000000))
+            same++;
+    }
+
+    return same;
+
+}
+
+const guac_common_surface_kernels guac_common_surface_scalar_kernels = {
+    "scalar",
+    __guac_common_put_opaque_scalar,
+    __guac_common_put_blend_scalar,
+    __guac_common_fill_mask_scalar,
+    __guac_common_count_same_scalar
+};
+
+#ifdef GUAC_COMMON_SURFACE_KERNELS_X86
+
+/**
+ * Counts the set bits of the given mask.
+ */
+static int __guac_common_popcount(int mask) {
+
+    int count = 0;
+
+    while (mask) {
+        mask &= mask - 1;
+        count++;
+    }
+
+    return count;
+
+}
+
+/**
+ * Blends four source pixels over four destination pixels, matching
+ * __guac_common_blend_pixel() exactly.
+ */
+GUAC_TARGET_SSE2
+static __m128i __guac_common_blend_sse2(__m128i d, __m128i s) {
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(0xFF);
+
+    /* Widen each component to 16 bits */
+    __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+    __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+    __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+    __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+    /* Broadcast source alpha across the components of each pixel */
+    __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+    __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+
+    /* src + dst * (0xFF - alpha), which cannot exceed 16 bits */
+    __m128i b_lo = _mm_add_epi16(s_lo,
+            _mm_mullo_epi16(d_lo, _mm_sub_epi16(max, a_lo)));
+    __m128i b_hi = _mm_add_epi16(s_hi,
+            _mm_mullo_epi16(d_hi, _mm_sub_epi16(max, a_hi)));
+
+    /* Unsigned minimum with 0xFF */
+    b_lo = _mm_sub_epi16(b_lo, _mm_subs_epu16(b_lo, max));
+    b_hi = _mm_sub_epi16(b_hi, _mm_subs_epu16(b_hi, max));
+
+    __m128i blended = _mm_packus_epi16(b_lo, b_hi);
+
+    /* Select source or destination wherever blending is skipped */
+    __m128i src_a = _mm_srli_epi32(s, 24);
+    __m128i dst_a = _mm_srli_epi32(d, 24);
+
+    __m128i use_src = _mm_or_si128(
+            _mm_cmpeq_epi32(src_a, _mm_set1_epi32(0xFF)),
+            _mm_cmpeq_epi32(dst_a, zero));
+    __m128i use_dst = _mm_andnot_si128(use_src, _mm_cmpeq_epi32(src_a, zero));
+    __m128i use_blend = _mm_andnot_si128(_mm_or_si128(use_src, use_dst),
+            _mm_set1_epi32(-1));
+
+    return _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(use_src, s), _mm_and_si128(use_dst, d)),
+            _mm_and_si128(use_blend, blended));
+
+}
+
+GUAC_TARGET_SSE2
+static int __guac_common_put_opaque_sse2(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last) {
+
+    const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+    int x = 0;
+
+    *first = -1;
+    for (; x + 4 <= width; x += 4) {
+
+        __m128i s = _mm_or_si128(_mm_loadu_si128((const __m128i*) &src[x]), alpha);
+        __m128i d = _mm_loadu_si128((const __m128i*) &dst[x]);
+
+        int changed = ~_mm_movemask_ps(_mm_castsi128_ps(
+                    _mm_cmpeq_epi32(s, d))) & 0xF;
+
+        if (changed) {
+            _mm_storeu_si128((__m128i*) &dst[x], s);
+            __guac_common_put_mask(changed, x, first, last);
+        }
+
+    }
+
+    for (; x < width; x++)
+        __guac_common_put_pixel(&dst[x], src[x] | 0xFF000000, x, first, last);
+
+    return *first >= 0;
+
+}
+
+GUAC_TARGET_SSE2
+static int __guac_common_put_blend_sse2(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last) {
+
+    int x = 0;
+
+    *first = -1;
+    for (; x + 4 <= width; x += 4) {
+
+        __m128i d = _mm_loadu_si128((const __m128i*) &dst[x]);
+        __m128i color = __guac_common_blend_sse2(d,
+                _mm_loadu_si128((const __m128i*) &src[x]));
+
+        int changed = ~_mm_movemask_ps(_mm_castsi128_ps(
+                    _mm_cmpeq_epi32(color, d))) & 0xF;
+
+        if (changed) {
+            _mm_storeu_si128((__m128i*) &dst[x], color);
+            __guac_common_put_mask(changed, x, first, last);
+        }
+
+    }
+
+    for (; x < width; x++)
+        __guac_common_put_pixel(&dst[x],
+                __guac_common_blend_pixel(dst[x], src[x]), x, first, last);
+
+    return *first >= 0;
+
+}
+
+GUAC_TARGET_SSE2
+static void __guac_common_fill_mask_sse2(uint32_t* dst,
+        const uint32_t* mask, int width, uint32_t color) {
+
+    const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+    const __m128i fill = _mm_set1_epi32((int) color);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+
+        __m128i m = _mm_loadu_si128((const __m128i*) &mask[x]);
+        __m128i d = _mm_loadu_si128((const __m128i*) &dst[x]);
+
+        /* Keep destination wherever the mask is fully transparent */
+        __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(m, alpha),
+                _mm_setzero_si128());
+
+        _mm_storeu_si128((__m128i*) &dst[x], _mm_or_si128(
+                    _mm_and_si128(keep, d), _mm_andnot_si128(keep, fill)));
+
+    }
+
+    for (; x < width; x++) {
+        if (mask[x] & 0xFF000000)
+            dst[x] = color;
+    }
+
+}
+
+GUAC_TARGET_SSE2
+static int __guac_common_count_same_sse2(const uint32_t* row, int width) {
+
+    const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+    int same = 0;
+    int x = 1;
+
+    for (; x + 4 <= width; x += 4) {
+
+        __m128i current = _mm_or_si128(
+                _mm_loadu_si128((const __m128i*) &row[x]), alpha);
+        __m128i previous = _mm_or_si128(
+                _mm_loadu_si128((const __m128i*) &row[x - 1]), alpha);
+
+        same += __guac_common_popcount(_mm_movemask_ps(_mm_castsi128_ps(
+                        _mm_cmpeq_epi32(current, previous))));
+
+    }
+
+    for (; x < width; x++) {
+        if ((row[x] | 0xFF000000) == (row[x - 1] | 0xFF000000))
+            same++;
+    }
+
+    return same;
+
+}
+
+static const guac_common_surface_kernels __guac_common_surface_sse2_kernels = {
+    "SSE2",
+    __guac_common_put_opaque_sse2,
+    __guac_common_put_blend_sse2,
+    __guac_common_fill_mask_sse2,
+    __guac_common_count_same_sse2
+};
+
+/**
+ * Blends eight source pixels over eight destination pixels, matching
+ * __guac_common_blend_pixel() exactly.
+ */
+GUAC_TARGET_AVX2
+static __m256i __guac_common_blend_avx2(__m256i d, __m256i s) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi16(0xFF);
+
+    /* Widen each component to 16 bits (within each 128-bit lane) */
+    __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+    __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+    __m256i d_lo = _mm256_unpacklo_epi8(d, zero);
+    __m256i d_hi = _mm256_unpackhi_epi8(d, zero);
+
+    /* Broadcast source alpha across the components of each pixel */
+    __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+    __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+
+    /* src + dst * (0xFF - alpha), which cannot exceed 16 bits */
+    __m256i b_lo = _mm256_add_epi16(s_lo,
+            _mm256_mullo_epi16(d_lo, _mm256_sub_epi16(max, a_lo)));
+    __m256i b_hi = _mm256_add_epi16(s_hi,
+            _mm256_mullo_epi16(d_hi, _mm256_sub_epi16(max, a_hi)));
+
+    /* Unsigned minimum with 0xFF */
+    b_lo = _mm256_min_epu16(b_lo, max);
+    b_hi = _mm256_min_epu16(b_hi, max);
+
+    __m256i blended = _mm256_packus_epi16(b_lo, b_hi);
+
+    /* Select source or destination wherever blending is skipped */
+    __m256i src_a = _mm256_srli_epi32(s, 24);
+    __m256i dst_a = _mm256_srli_epi32(d, 24);
+
+    __m256i use_src = _mm256_or_si256(
+            _mm256_cmpeq_epi32(src_a, _mm256_set1_epi32(0xFF)),
+            _mm256_cmpeq_epi32(dst_a, zero));
+    __m256i use_dst = _mm256_andnot_si256(use_src,
+            _mm256_cmpeq_epi32(src_a, zero));
+
+    __m256i result = _mm256_blendv_epi8(blended, s, use_src);
+    return _mm256_blendv_epi8(result, d, use_dst);
+
+}
+
+GUAC_TARGET_AVX2
+static int __guac_common_put_opaque_avx2(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last) {
+
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    int x = 0;
+
+    *first = -1;
+    for (; x + 8 <= width; x += 8) {
+
+        __m256i s = _mm256_or_si256(
+                _mm256_loadu_si256((const __m256i*) &src[x]), alpha);
+        __m256i d = _mm256_loadu_si256((const __m256i*) &dst[x]);
+
+        int changed = ~_mm256_movemask_ps(_mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(s, d))) & 0xFF;
+
+        if (changed) {
+            _mm256_storeu_si256((__m256i*) &dst[x], s);
+            __guac_common_put_mask(changed, x, first, last);
+        }
+
+    }
+
+    for (; x < width; x++)
+        __guac_common_put_pixel(&dst[x], src[x] | 0xFF000000, x, first, last);
+
+    return *first >= 0;
+
+}
+
+GUAC_TARGET_AVX2
+static int __guac_common_put_blend_avx2(uint32_t* dst, const uint32_t* src,
+        int width, int* first, int* last) {
+
+    int x = 0;
+
+    *first = -1;
+    for (; x + 8 <= width; x += 8) {
+
+        __m256i d = _mm256_loadu_si256((const __m256i*) &dst[x]);
+        __m256i color = __guac_common_blend_avx2(d,
+                _mm256_loadu_si256((const __m256i*) &src[x]));
+
+        int changed = ~_mm256_movemask_ps(_mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(color, d))) & 0xFF;
+
+        if (changed) {
+            _mm256_storeu_si256((__m256i*) &dst[x], color);
+            __guac_common_put_mask(changed, x, first, last);
+        }
+
+    }
+
+    for (; x < width; x++)
+        __guac_common_put_pixel(&dst[x],
+                __guac_common_blend_pixel(dst[x], src[x]), x, first, last);
+
+    return *first >= 0;
+
+}
+
+GUAC_TARGET_AVX2
+static void __guac_common_fill_mask_avx2(uint32_t* dst,
+        const uint32_t* mask, int width, uint32_t color) {
+
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    const __m256i fill = _mm256_set1_epi32((int) color);
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+
+        __m256i m = _mm256_loadu_si256((const __m256i*) &mask[x]);
+        __m256i d = _mm256_loadu_si256((const __m256i*) &dst[x]);
+
+        /* Keep destination wherever the mask is fully transparent */
+        __m256i keep = _mm256_cmpeq_epi32(_mm256_and_si256(m, alpha),
+                _mm256_setzero_si256());
+
+        _mm256_storeu_si256((__m256i*) &dst[x],
+                _mm256_blendv_epi8(fill, d, keep));
+
+    }
+
+    for (; x < width; x++) {
+        if (mask[x] & 0xFF000000)
+            dst[x] = color;
+    }
+
+}
+
+GUAC_TARGET_AVX2
+static int __guac_common_count_same_avx2(const uint32_t* row, int width) {
+
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    int same = 0;
+    int x = 1;
+
+    for (; x + 8 <= width; x += 8) {
+
+        __m256i current = _mm256_or_si256(
+                _mm256_loadu_si256((const __m256i*) &row[x]), alpha);
+        __m256i previous = _mm256_or_si256(
+                _mm256_loadu_si256((const __m256i*) &row[x - 1]), alpha);
+
+        same += __guac_common_popcount(_mm256_movemask_ps(
+                    _mm256_castsi256_ps(_mm256_cmpeq_epi32(current, previous))));
+
+    }
+
+    for (; x < width; x++) {
+        if ((row[x] | 0xFF000000) == (row[x - 1] | 0xFF000000))
+            same++;
+    }
+
+    return same;
+
+}
+
+static const guac_common_surface_kernels __guac_common_surface_avx2_kernels = {
+    "AVX2",
+    __guac_common_put_opaque_avx2,
+    __guac_common_put_blend_avx2,
+    __guac_common_fill_mask_avx2,
+    __guac_common_count_same_avx2
+};
+
+/**
+ * Returns whether the CPU and operating system both support SSE2.
+ */
+static int __guac_common_cpu_has_sse2() {
+
+#if defined(_M_X64) || defined(__x86_64__)
+    /* Part of the x86-64 baseline */
+    return 1;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (edx & (1 << 26)) != 0;
+#endif
+
+}
+
+/**
+ * Returns whether the CPU and operating system both support AVX2, the latter
+ * being required for the upper halves of the YMM registers to be preserved.
+ */
+static int __guac_common_cpu_has_avx2() {
+
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+
+    /* OSXSAVE and AVX */
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return 0;
+
+    /* XMM and YMM state enabled by the OS */
+    if ((_xgetbv(0) & 0x6) != 0x6)
+        return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+
+}
+
+#endif
+
+/**
+ * Selects the fastest kernels supported by the current CPU.
+ */
+static const guac_common_surface_kernels* __guac_common_surface_select_kernels() {
+
+#ifdef GUAC_COMMON_SURFACE_KERNELS_X86
+    if (__guac_common_cpu_has_avx2())
+        return &__guac_common_surface_avx2_kernels;
+
+    if (__guac_common_cpu_has_sse2())
+        return &__guac_common_surface_sse2_kernels;
+#endif
+
+    return &guac_common_surface_scalar_kernels;
+
+}
+
+const guac_common_surface_kernels* guac_common_surface_get_kernels() {
+
+    /* Initialization of function-local statics is thread-safe */
+    static const guac_common_surface_kernels* kernels =
+        __guac_common_surface_select_kernels();
+
+    return kernels;
+
+}
+
+const guac_common_surface_kernels* const* guac_common_surface_get_supported_kernels(
+        int* count) {
+
+    static const guac_common_surface_kernels* supported[3];
+    int supported_count = 0;
+
+    supported[supported_count++] = &guac_common_surface_scalar_kernels;
+
+#ifdef GUAC_COMMON_SURFACE_KERNELS_X86
+    if (__guac_common_cpu_has_sse2())
+        supported[supported_count++] = &__guac_common_surface_sse2_kernels;
+
+    if (__guac_common_cpu_has_avx2())
+        supported[supported_count++] = &__guac_common_surface_avx2_kernels;
+#endif
+
+    *count = supported_count;
+    return supported;
+
+}
+
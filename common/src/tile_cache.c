@@ -0,0 +1,440 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <common/tile_cache.h>
+
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/hash.h>
+#include <guacamole/layer.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Wraps the tile having its upper-left corner at the given location within a
+ * Cairo surface. The returned surface must be destroyed with
+ * cairo_surface_destroy().
+ *
+ * @param buffer
+ *     The upper-left pixel of the tile.
+ *
+ * @param stride
+ *     The number of bytes in each row of the given buffer.
+ *
+ * @return
+ *     A Cairo surface wrapping (not copying) the tile.
+ */
+static cairo_surface_t* __guac_common_tile_cache_wrap(
+        const unsigned char* buffer, int stride) {
+
+    return cairo_image_surface_create_for_data(
+            const_cast<unsigned char*>(buffer), CAIRO_FORMAT_ARGB32,
+            GUAC_COMMON_TILE_CACHE_TILE_SIZE, GUAC_COMMON_TILE_CACHE_TILE_SIZE,
+            stride);
+
+}
+
+/**
+ * Returns a pointer to the upper-left pixel of the given slot within the
+ * server-side copy of the off-screen buffer, storing the location of that slot
+ * within the off-screen buffer in the given coordinates.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot.
+ *
+ * @param x
+ *     Receives the X coordinate of the slot within the off-screen buffer.
+ *
+ * @param y
+ *     Receives the Y coordinate of the slot within the off-screen buffer.
+ *
+ * @return
+ *     A pointer to the upper-left pixel of the slot.
+ */
+static unsigned char* __guac_common_tile_cache_slot(
+        guac_common_tile_cache* cache, int slot, int* x, int* y) {
+
+    *x = (slot % GUAC_COMMON_TILE_CACHE_COLUMNS)
+        * GUAC_COMMON_TILE_CACHE_TILE_SIZE;
+    *y = (slot / GUAC_COMMON_TILE_CACHE_COLUMNS)
+        * GUAC_COMMON_TILE_CACHE_TILE_SIZE;
+
+    return cache->pixels + *y * cache->stride + *x * 4;
+
+}
+
+/**
+ * Removes the given slot from the LRU list.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot to remove.
+ */
+static void __guac_common_tile_cache_lru_remove(guac_common_tile_cache* cache,
+        int slot) {
+
+    guac_common_tile_cache_entry* entry = &cache->entries[slot];
+
+    if (entry->lru_prev != -1)
+        cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    if (entry->lru_next != -1)
+        cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+}
+
+/**
+ * Inserts the given slot at the head of the LRU list, marking it as most
+ * recently used.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot to insert.
+ */
+static void __guac_common_tile_cache_lru_push(guac_common_tile_cache* cache,
+        int slot) {
+
+    guac_common_tile_cache_entry* entry = &cache->entries[slot];
+
+    entry->lru_prev = -1;
+    entry->lru_next = cache->lru_head;
+
+    if (cache->lru_head != -1)
+        cache->entries[cache->lru_head].lru_prev = slot;
+    else
+        cache->lru_tail = slot;
+
+    cache->lru_head = slot;
+
+}
+
+/**
+ * Removes the given slot from its hash bucket.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot to remove.
+ */
+static void __guac_common_tile_cache_unlink(guac_common_tile_cache* cache,
+        int slot) {
+
+    int* current = &cache->buckets[
+        cache->entries[slot].hash & (cache->bucket_count - 1)];
+
+    while (*current != -1) {
+
+        if (*current == slot) {
+            *current = cache->entries[slot].next;
+            return;
+        }
+
+        current = &cache->entries[*current].next;
+
+    }
+
+}
+
+/**
+ * Searches the given cache for a tile identical to the given tile, having the
+ * given hash. The cache must already be locked.
+ *
+ * @param cache
+ *     The tile cache to search.
+ *
+ * @param tile
+ *     A Cairo surface wrapping the tile to search for.
+ *
+ * @param hash
+ *     The hash of the given tile.
+ *
+ * @return
+ *     The index of the matching slot, or -1 if no such slot exists.
+ */
+static int __guac_common_tile_cache_find(guac_common_tile_cache* cache,
+        cairo_surface_t* tile, unsigned int hash) {
+
+    int slot = cache->buckets[hash & (cache->bucket_count - 1)];
+
+    while (slot != -1) {
+
+        /* Hashes are only 24 bits, so verify every candidate */
+        if (cache->entries[slot].hash == hash) {
+
+            int x, y;
+            cairo_surface_t* cached = __guac_common_tile_cache_wrap(
+                    __guac_common_tile_cache_slot(cache, slot, &x, &y),
+                    cache->stride);
+
+            int cmp = guac_surface_cmp(tile, cached);
+            cairo_surface_destroy(cached);
+
+            if (cmp == 0)
+                return slot;
+
+        }
+
+        slot = cache->entries[slot].next;
+
+    }
+
+    return -1;
+
+}
+
+guac_common_tile_cache* guac_common_tile_cache_alloc(guac_client* client,
+        guac_socket* socket, int size) {
+
+    int rows = size / (GUAC_COMMON_TILE_CACHE_TILE_BYTES
+            * GUAC_COMMON_TILE_CACHE_COLUMNS);
+
+    /* Budget must allow at least one full row of tiles */
+    if (rows <= 0)
+        return NULL;
+
+    if (rows > GUAC_COMMON_TILE_CACHE_MAX_ROWS)
+        rows = GUAC_COMMON_TILE_CACHE_MAX_ROWS;
+
+    guac_common_tile_cache* cache = static_cast<guac_common_tile_cache*>(
+        calloc(1, sizeof(guac_common_tile_cache)));
+
+    cache->client = client;
+    cache->socket = socket;
+    cache->capacity = rows * GUAC_COMMON_TILE_CACHE_COLUMNS;
+    cache->used = 0;
+    cache->lru_head = -1;
+    cache->lru_tail = -1;
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_init(&cache->_lock, NULL);
+#endif
+
+    /* Server-side copy of the off-screen buffer */
+    cache->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32,
+            GUAC_COMMON_TILE_CACHE_COLUMNS * GUAC_COMMON_TILE_CACHE_TILE_SIZE);
+    cache->pixels = static_cast<unsigned char*>(
+        calloc(rows * GUAC_COMMON_TILE_CACHE_TILE_SIZE, cache->stride));
+
+    cache->entries = static_cast<guac_common_tile_cache_entry*>(
+        calloc(cache->capacity, sizeof(guac_common_tile_cache_entry)));
+
+    /* Size hash table to the next power of two above capacity */
+    cache->bucket_count = 1;
+    while (cache->bucket_count < cache->capacity)
+        cache->bucket_count <<= 1;
+
+    cache->buckets = static_cast<int*>(
+        malloc(cache->bucket_count * sizeof(int)));
+    for (int i = 0; i < cache->bucket_count; i++)
+        cache->buckets[i] = -1;
+
+    /* Allocate off-screen buffer on client */
+    cache->buffer = guac_client_alloc_buffer(client);
+    guac_protocol_send_size(socket, cache->buffer,
+            GUAC_COMMON_TILE_CACHE_COLUMNS * GUAC_COMMON_TILE_CACHE_TILE_SIZE,
+            rows * GUAC_COMMON_TILE_CACHE_TILE_SIZE);
+
+    return cache;
+
+}
+
+void guac_common_tile_cache_free(guac_common_tile_cache* cache) {
+
+    /* Destroy off-screen buffer within remotely-connected client */
+    guac_protocol_send_dispose(cache->socket, cache->buffer);
+    guac_client_free_buffer(cache->client, cache->buffer);
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_destroy(&cache->_lock);
+#endif
+
+    free(cache->buckets);
+    free(cache->entries);
+    free(cache->pixels);
+    free(cache);
+
+}
+
+int guac_common_tile_cache_lookup(guac_common_tile_cache* cache,
+        const unsigned char* buffer, int stride, int* sx, int* sy) {
+
+    cairo_surface_t* tile = __guac_common_tile_cache_wrap(buffer, stride);
+    unsigned int hash = guac_hash_surface(tile);
+
+#ifdef HAVE_BOOST
+	cache->_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&cache->_lock);
+#endif
+
+    int slot = __guac_common_tile_cache_find(cache, tile, hash);
+
+    /* Mark as most recently used */
+    if (slot != -1) {
+        __guac_common_tile_cache_lru_remove(cache, slot);
+        __guac_common_tile_cache_lru_push(cache, slot);
+        __guac_common_tile_cache_slot(cache, slot, sx, sy);
+    }
+
+#ifdef HAVE_BOOST
+	cache->_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&cache->_lock);
+#endif
+
+    cairo_surface_destroy(tile);
+    return slot != -1;
+
+}
+
+void guac_common_tile_cache_insert(guac_common_tile_cache* cache,
+        const guac_layer* layer, int x, int y, const unsigned char* buffer,
+        int stride) {
+
+    cairo_surface_t* tile = __guac_common_tile_cache_wrap(buffer, stride);
+    unsigned int hash = guac_hash_surface(tile);
+
+#ifdef HAVE_BOOST
+	cache->_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&cache->_lock);
+#endif
+
+    int slot = __guac_common_tile_cache_find(cache, tile, hash);
+
+    /* Tile already cached */
+    if (slot != -1)
+        __guac_common_tile_cache_lru_remove(cache, slot);
+
+    else {
+
+        /* Fill unused slots before evicting anything */
+        if (cache->used < cache->capacity)
+            slot = cache->used++;
+
+        /* Otherwise evict the least recently used tile */
+        else {
+            slot = cache->lru_tail;
+            __guac_common_tile_cache_lru_remove(cache, slot);
+            __guac_common_tile_cache_unlink(cache, slot);
+        }
+
+        int dx, dy;
+        unsigned char* dst = __guac_common_tile_cache_slot(cache, slot,
+                &dx, &dy);
+
+        /* Update server-side copy */
+        for (int row = 0; row < GUAC_COMMON_TILE_CACHE_TILE_SIZE; row++) {
+            memcpy(dst, buffer, GUAC_COMMON_TILE_CACHE_TILE_SIZE * 4);
+            dst += cache->stride;
+            buffer += stride;
+        }
+
+        /* Add to hash bucket */
+        guac_common_tile_cache_entry* entry = &cache->entries[slot];
+        int* bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+        entry->hash = hash;
+        entry->next = *bucket;
+        *bucket = slot;
+
+        /* Update client-side copy from the already-drawn tile */
+        guac_protocol_send_copy(cache->socket, layer, x, y,
+                GUAC_COMMON_TILE_CACHE_TILE_SIZE,
+                GUAC_COMMON_TILE_CACHE_TILE_SIZE,
+                GUAC_COMP_SRC, cache->buffer, dx, dy);
+
+    }
+
+    __guac_common_tile_cache_lru_push(cache, slot);
+
+#ifdef HAVE_BOOST
+	cache->_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&cache->_lock);
+#endif
+
+    cairo_surface_destroy(tile);
+
+}
+
+void guac_common_tile_cache_dup(guac_common_tile_cache* cache,
+        guac_user* user, guac_socket* socket) {
+
+#ifdef HAVE_BOOST
+	cache->_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&cache->_lock);
+#endif
+
+    int rows = cache->capacity / GUAC_COMMON_TILE_CACHE_COLUMNS;
+    int used_rows = (cache->used + GUAC_COMMON_TILE_CACHE_COLUMNS - 1)
+        / GUAC_COMMON_TILE_CACHE_COLUMNS;
+
+    guac_protocol_send_size(socket, cache->buffer,
+            GUAC_COMMON_TILE_CACHE_COLUMNS * GUAC_COMMON_TILE_CACHE_TILE_SIZE,
+            rows * GUAC_COMMON_TILE_CACHE_TILE_SIZE);
+
+    /* Send only the rows which have ever held tiles */
+    if (used_rows > 0) {
+
+        cairo_surface_t* rect = cairo_image_surface_create_for_data(
+                cache->pixels, CAIRO_FORMAT_ARGB32,
+                GUAC_COMMON_TILE_CACHE_COLUMNS * GUAC_COMMON_TILE_CACHE_TILE_SIZE,
+                used_rows * GUAC_COMMON_TILE_CACHE_TILE_SIZE, cache->stride);
+
+        /* Stream from the client if not synchronizing a specific user */
+        if (user != NULL)
+            guac_user_stream_png(user, socket, GUAC_COMP_SRC, cache->buffer,
+                    0, 0, rect);
+        else
+            guac_client_stream_png(cache->client, socket, GUAC_COMP_SRC,
+                    cache->buffer, 0, 0, rect);
+        cairo_surface_destroy(rect);
+
+    }
+
+#ifdef HAVE_BOOST
+	cache->_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&cache->_lock);
+#endif
+
+}
+
@@ -7,7 +7,9 @@
 
 #include <guacservice/GuacClientUser.h>
 #include <guacservice/GuacDefines.h>
+#include <guacservice/GuacControlChannel.h>
 #include <guacamole/error.h>
+#include <guacamole/metrics.h>
 #include <guacamole/user.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/process/environment.hpp>
@@ -18,6 +20,7 @@ private:
    std::vector<std::tuple<GuacClientUserPtr, boost::shared_ptr<boost::thread>>> m_ClientUsers;
    boost::mutex m_ClientUsersMutex;
    guac_socket * m_ShmSocket;
+   boost::shared_ptr<GuacControlChannel> m_ControlChannel;
    guac_client * m_Client;
    bool m_bIsProcessRunning;
 
@@ -35,33 +38,21 @@ private:
     */
    void RemoveUser(const std::string & stSharedMemoryTag);
    /**
-    * Reads the logger path from the parent shared memory and initialized the logger
+    * Stops all the users and frees the client, blocks until the plugin ended
+    * Freeing the client closes its socket, and with it any session recording, which writes out what it still buffers
     */
-   void InitLoggerFromParent();
+   void StopClient();
    /**
-    * Reads the logger path from the parent shared memory
-    * @return
-    */
-   std::string ReadLoggerPath();
-   /**
-    * Reads the protocol path from the parent shared memory
-    * @return
-    */
-   std::string ReadProtocolPath();
-   /**
-    * Reads the protocol from the parent shared memory
-    * @return
-    */
-   std::string ReadProtocol();
-   /**
-    * Reads the library path from the parent shared memory
-    * @return
+    * Initializes the logger to the log folder given by the parent
+    * @param stLoggerPath
     */
-   std::string ReadLibraryPath();
+   void InitLogger(const std::string & stLoggerPath);
    /**
-    * Reads the FPS from the parent shared memory
+    * Applies the params received from the parent, loads the protocol plugin and configures the client
+    * @param rParams
+    * @return false if the plugin could not be loaded
     */
-   short ReadFPS();
+   bool ApplyParams(const GuacClientParams & rParams);
    /**
     * Creates the actual full path to the plugin library from the given params
     * @param stLibraryFolder
@@ -72,18 +63,14 @@ private:
    /**
     * Loads the plugin given the path to the memory
     * @param stProtocolPath
-    */
-   void LoadPlugin(const std::string & stProtocolPath);
-   /**
-    * Waits for the command with default SHM timeout, returns the command or empty string if timeout
     * @return
     */
-   std::string WaitForCommand();
+   bool LoadPlugin(const std::string & stProtocolPath);
    /**
-    * Handles a given command and performs the associated operation
-    * @param stCommand
+    * Handles a given command, performs the associated operation and acknowledges it
+    * @param rCommand
     */
-   void HandleCommand(const std::string & stCommand);
+   void HandleCommand(const GuacControlMessage & rCommand);
 
 public:
    /**
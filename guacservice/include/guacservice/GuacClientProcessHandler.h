@@ -15,6 +15,8 @@
 #include <guacservice/GuacDefines.h>
 #include <guacservice/GuacLogger.h>
 #include <guacservice/GuacConfig.h>
+#include <guacservice/GuacControlChannel.h>
+#include <guacservice/GuacConnectionRelay.h>
 #include <regex>
 
 class GuacConnection;
@@ -32,6 +34,7 @@ private:
    std::vector<GuacConnectionPtr> m_vecConnections;
    guac_client * m_GuacClient;
    guac_socket * m_ShmSocket;
+   GuacControlChannel * m_ControlChannel;
 
 private:
    /**
@@ -40,30 +43,38 @@ private:
     */
    std::string GenerateSharedMemoryTag() const;
    /**
-    * The actual IOThread that runs, handles both read and write redirection on seperate threads and waits for them to finish
+    * Relays the user IO between its connection and the client process until the user leaves
+    * The client input is relayed asynchronously by the IO service, the process output by the calling thread
     * Cleans up everything at the end
     * @param pConnectionUser
     * @param bOwner
     */
-   void IOThread(const GuacConnectionPtr & pConnectionUser, bool bOwner);
+   void RelayUserIO(const GuacConnectionPtr & pConnectionUser, bool bOwner);
    /**
-    * Cleans up all the needed objects that are related to the user that was running the IOThreads
+    * Cleans up all the needed objects that are related to the user that was relayed
     * @param pConnectionUser
     * @param bOwner
-    * @param pUserShm
     * @param stSharedMemoryName
     */
-   void CleanupUserIO(const GuacConnectionPtr & pConnectionUser, bool bOwner, guac_socket * pUserShm,
-                      const std::string & stSharedMemoryName);
+   void CleanupUserIO(const GuacConnectionPtr & pConnectionUser, bool bOwner, const std::string & stSharedMemoryName);
    /**
     * Runs the process, does not block, only starts the process which will wait for new users to join
     * @return
     */
    bool RunProcess();
    /**
-    * Sends the client needed parameters to begin execution
+    * Sends the client needed parameters to begin execution, and waits for the client to load the protocol plugin
     */
    bool SendClientParams();
+   /**
+    * Sends a command to the client process and waits for its acknowledgement
+    * @param eType
+    * @param stPayload
+    * @param iTimeoutMS
+    * @return
+    */
+   bool SendClientCommand(GuacControlMessageType eType, const std::string & stPayload,
+                          int iTimeoutMS = CONTROL_COMMAND_TIMEOUT_MS);
 
 public:
    /**
@@ -81,7 +92,7 @@ public:
     */
    bool StartProcess(const std::string & stProtocolName);
    /**
-    * Adds a new connection user to the process, begins its associated IOThread
+    * Adds a new connection user to the process, relays its IO until it leaves
     * @param pConnectionUser
     * @return
     */
@@ -92,7 +103,12 @@ public:
     */
    bool IsProcessRunning() const;
    /**
-    * Stops the process and all the associated users and IOThreads
+    * Checks if the process was started and its child process has not exited since
+    * @return
+    */
+   bool IsProcessAlive() const;
+   /**
+    * Stops the process and all the associated users and their relays
     * @return
     */
    bool StopProcess();
@@ -111,6 +127,17 @@ public:
     * @param rConfig
     */
    void SetGuacConfig(const GuacConfig & rConfig);
+   /**
+    * Getter for the latency statistics of the commands sent to the client process
+    * @return
+    */
+   std::map<GuacControlMessageType, GuacControlCommandStats> GetControlCommandStats() const;
+   /**
+    * Asks the client process for its rendered metrics, see guacamole/metrics.h for the format
+    * @param rOutMetrics
+    * @return false if the process is not running or did not answer in time
+    */
+   bool CollectClientMetrics(std::string & rOutMetrics);
 };
 
 typedef GuacClientProcessHandler * GuacClientProcessHandlerPtr;
@@ -87,6 +87,13 @@ public:
     * @return
     */
    GuacClientProcessHandlerPtr CreateProcessHandler();
+   /**
+    * Adds an already created process handler to the linked list map
+    * Notifies the observers
+    * @param pProcess
+    * @return false if a process handler with the same ID already exists
+    */
+   bool AddProcessHandler(const GuacClientProcessHandlerPtr & pProcess);
    /**
     * Retrieves a process handler for a given ID from the linked list map
     * @param stID
@@ -0,0 +1,84 @@
+//
+// Pool of pre-started client processes
+//
+
+#ifndef GUACAMOLE_GUACCLIENTPROCESSPOOL_H
+#define GUACAMOLE_GUACCLIENTPROCESSPOOL_H
+
+#include <guacservice/GuacClientProcessHandler.h>
+#include <guacservice/GuacConfig.h>
+#include <guacservice/GuacLogger.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+
+#define PROCESS_POOL_RETRY_DELAY_MS 1000
+
+class GuacClientProcessPool
+{
+private:
+   std::deque<GuacClientProcessHandlerPtr> m_IdleProcesses;
+   boost::mutex m_PoolMutex;
+   boost::condition_variable m_PoolCondition;
+   boost::thread * m_ReplenishThread;
+   GuacConfig m_Config;
+   bool m_bIsPoolRunning;
+
+private:
+   /**
+    * Private constructor for singleton
+    */
+   GuacClientProcessPool();
+   /**
+    * Deleted for singleton
+    * @param other
+    */
+   GuacClientProcessPool(const GuacClientProcessPool & other) = delete;
+   /**
+    * Deleted for singleton
+    * @param other
+    * @return
+    */
+   GuacClientProcessPool operator=(const GuacClientProcessPool & other) = delete;
+   /**
+    * The replenish thread, starts a new client process whenever the pool is below its configured size
+    * Processes are started one at a time so the pool refills without competing with a login storm for the CPU
+    */
+   void ReplenishThread();
+   /**
+    * Starts a single client process for the pooled protocol, the process joins its shared memory,
+    * reads its parameters and loads the protocol plugin before it is returned
+    * @return The started process handler, or nullptr on failure
+    */
+   GuacClientProcessHandlerPtr StartIdleProcess();
+
+public:
+   /**
+    * Singleton getter
+    * @return
+    */
+   static boost::shared_ptr<GuacClientProcessPool> GetInstance();
+   /**
+    * Destructor, stops the pool
+    */
+   virtual ~GuacClientProcessPool();
+   /**
+    * Starts filling the pool in the background with the configured number of idle client processes
+    * Does nothing if the configured pool size is 0
+    * @param rConfig
+    */
+   void StartPool(const GuacConfig & rConfig);
+   /**
+    * Stops the replenish thread and stops all the idle processes
+    */
+   void StopPool();
+   /**
+    * Takes an idle process which is already running the given protocol out of the pool, and wakes the replenish
+    * thread to start its replacement. The returned handler is owned by the caller and is not yet on the handler map
+    * @param stProtocolName
+    * @return The running process handler, or nullptr if none is idle for the protocol
+    */
+   GuacClientProcessHandlerPtr AcquireProcessHandler(const std::string & stProtocolName);
+};
+
+#endif //GUACAMOLE_GUACCLIENTPROCESSPOOL_H
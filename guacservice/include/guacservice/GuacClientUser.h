@@ -13,6 +13,7 @@
 #include <guacamole/user.h>
 #include <guacamole/error.h>
 #include <guacservice/GuacLogger.h>
+#include <guacservice/GuacDefines.h>
 
 #define GUACD_TIMEOUT 15000
 #define GUACD_CLIENT_MAX_CONNECTIONS 65536
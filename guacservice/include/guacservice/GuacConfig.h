@@ -24,6 +24,20 @@ private:
    std::string m_stSSLCertFilePath;
    std::string m_stSSLDiffieHellmanPEMFilePath;
    short m_sFPS;
+   short m_sEncoderThreads;
+   short m_sTileCacheMB;
+   short m_sSendQueueMB;
+   std::string m_stSlowUserPolicy;
+   short m_sAudioAggregationMS;
+   short m_sProcessPoolSize;
+   std::string m_stProcessPoolProtocol;
+   short m_sIOThreads;
+   std::string m_stMetricsBindHost;
+   short m_sMetricsPort;
+   short m_sRecordingBufferMB;
+   std::string m_stRecordingOverflowPolicy;
+   bool m_bWithRecordingCompression;
+   short m_sRecordingKeyframeIntervalSec;
 
 public:
    /**
@@ -107,6 +121,76 @@ public:
     * @param sFPS
     */
    void SetFPS(short sFPS);
+   /**
+    * Setter for the number of threads encoding images on the client process, 0 to encode synchronously
+    * @param sEncoderThreads
+    */
+   void SetEncoderThreads(short sEncoderThreads);
+   /**
+    * Setter for the memory budget in MB of the client process tile cache, 0 to disable the cache
+    * @param sTileCacheMB
+    */
+   void SetTileCacheMB(short sTileCacheMB);
+   /**
+    * Setter for the size in MB of the send queue of each user, 0 to write to users directly
+    * @param sSendQueueMB
+    */
+   void SetSendQueueMB(short sSendQueueMB);
+   /**
+    * Setter for the policy applied to users whose send queue overflows, "resync" or "disconnect"
+    * @param stSlowUserPolicy
+    */
+   void SetSlowUserPolicy(const std::string & stSlowUserPolicy);
+   /**
+    * Setter for the milliseconds of audio aggregated into each audio blob, 0 to send each packet as it arrives
+    * @param sAudioAggregationMS
+    */
+   void SetAudioAggregationMS(short sAudioAggregationMS);
+   /**
+    * Setter for the number of idle client processes kept started ahead of new connections, 0 to disable the pool
+    * @param sProcessPoolSize
+    */
+   void SetProcessPoolSize(short sProcessPoolSize);
+   /**
+    * Setter for the protocol the pooled client processes are started for
+    * @param stProcessPoolProtocol
+    */
+   void SetProcessPoolProtocol(const std::string & stProcessPoolProtocol);
+   /**
+    * Setter for the number of threads running the asynchronous IO of all the connections, 0 for one per CPU
+    * @param sIOThreads
+    */
+   void SetIOThreads(short sIOThreads);
+   /**
+    * Setter for the host the metrics endpoint binds to
+    * @param stMetricsBindHost
+    */
+   void SetMetricsBindHost(const std::string & stMetricsBindHost);
+   /**
+    * Setter for the port of the metrics endpoint, 0 disables it
+    * @param sMetricsPort
+    */
+   void SetMetricsPort(short sMetricsPort);
+   /**
+    * Setter for the size in MB of the buffer each session recording is written through
+    * @param sRecordingBufferMB
+    */
+   void SetRecordingBufferMB(short sRecordingBufferMB);
+   /**
+    * Setter for the policy applied when storage falls behind a session recording, "block" or "stop"
+    * @param stRecordingOverflowPolicy
+    */
+   void SetRecordingOverflowPolicy(const std::string & stRecordingOverflowPolicy);
+   /**
+    * Setter for if session recordings are gzip compressed
+    * @param bWithRecordingCompression
+    */
+   void SetWithRecordingCompression(bool bWithRecordingCompression);
+   /**
+    * Setter for the interval in seconds between keyframes of indexed session recordings, 0 for no index
+    * @param sRecordingKeyframeIntervalSec
+    */
+   void SetRecordingKeyframeIntervalSec(short sRecordingKeyframeIntervalSec);
    /**
     * Getter for SSL
     * @return
@@ -172,6 +256,76 @@ public:
     * @return
     */
    short GetFPS() const;
+   /**
+    * Getter for the number of client process encoder threads
+    * @return
+    */
+   short GetEncoderThreads() const;
+   /**
+    * Getter for the tile cache memory budget in MB
+    * @return
+    */
+   short GetTileCacheMB() const;
+   /**
+    * Getter for the per user send queue size in MB
+    * @return
+    */
+   short GetSendQueueMB() const;
+   /**
+    * Getter for the slow user policy
+    * @return
+    */
+   const std::string & GetSlowUserPolicy() const;
+   /**
+    * Getter for the audio aggregation window in milliseconds
+    * @return
+    */
+   short GetAudioAggregationMS() const;
+   /**
+    * Getter for the number of pooled client processes
+    * @return
+    */
+   short GetProcessPoolSize() const;
+   /**
+    * Getter for the protocol of the pooled client processes
+    * @return
+    */
+   const std::string & GetProcessPoolProtocol() const;
+   /**
+    * Getter for the number of IO threads
+    * @return
+    */
+   short GetIOThreads() const;
+   /**
+    * Getter for the metrics endpoint bind host
+    * @return
+    */
+   const std::string & GetMetricsBindHost() const;
+   /**
+    * Getter for the metrics endpoint port
+    * @return
+    */
+   short GetMetricsPort() const;
+   /**
+    * Getter for the session recording buffer size in MB
+    * @return
+    */
+   short GetRecordingBufferMB() const;
+   /**
+    * Getter for the session recording overflow policy
+    * @return
+    */
+   const std::string & GetRecordingOverflowPolicy() const;
+   /**
+    * Getter for if session recordings are gzip compressed
+    * @return
+    */
+   bool IsWithRecordingCompression() const;
+   /**
+    * Getter for the session recording keyframe interval in seconds
+    * @return
+    */
+   short GetRecordingKeyframeIntervalSec() const;
 };
 
 #endif //GUACAMOLE_GUACCONFIG_H
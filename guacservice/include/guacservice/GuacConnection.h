@@ -8,6 +8,7 @@
 #include <guacservice/IGuacConnectionSocket.h>
 #include <guacservice/GuacClientProcessHandler.h>
 #include <guacservice/GuacClientProcessHandlerMap.h>
+#include <guacservice/GuacClientProcessPool.h>
 #include <guacservice/IGuacConnectionNotifier.h>
 #include <guacservice/GuacClientUser.h>
 #include <boost/shared_ptr.hpp>
@@ -0,0 +1,120 @@
+//
+// Asynchronous relay between a connection socket and its user shared memory
+//
+
+#ifndef GUACAMOLE_GUACCONNECTIONRELAY_H
+#define GUACAMOLE_GUACCONNECTIONRELAY_H
+
+#include <guacservice/IGuacConnectionSocket.h>
+#include <guacservice/GuacDefines.h>
+#include <guacservice/GuacLogger.h>
+#include <guacamole/socket.h>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
+
+// The longest time a stopped relay keeps waiting on the shared memory, which can not be woken by the IO service
+#define RELAY_STOP_CHECK_MS 250
+// The time a relay waits before retrying to write client input the user shared memory had no room for
+#define RELAY_WRITE_RETRY_MS 5
+
+class GuacConnectionRelay : public boost::enable_shared_from_this<GuacConnectionRelay>
+{
+private:
+   IGuacConnectionSocketPtr m_ConnectionSocket;
+   guac_socket * m_UserShm;
+   std::string m_stConnectionID;
+   char m_ClientReadBuffer[SOCKET_BUFFER_SIZE];
+   char m_SharedMemoryReadBuffer[SOCKET_BUFFER_SIZE];
+   boost::mutex m_RelayMutex;
+   boost::condition_variable m_RelayCondition;
+   boost::system::error_code m_WriteError;
+   bool m_bIsWritePending;
+   bool m_bIsRelayRunning;
+   size_t m_sPendingOffset;
+   size_t m_sPendingSize;
+   std::atomic<uint64_t> m_uBytesReceived;
+   std::atomic<uint64_t> m_uBytesSent;
+
+private:
+   /**
+    * Starts the next asynchronous read from the connection socket
+    */
+   void ReadFromClient();
+   /**
+    * Read handler, writes what the client sent to the user shared memory
+    * @param rErrorCode
+    * @param sSize
+    */
+   void OnClientRead(const boost::system::error_code & rErrorCode, size_t sSize);
+   /**
+    * Writes the pending client input to the user shared memory as far as it has room, never blocks the IO service
+    * Retries on a timer while input is left, and starts the next read once all of it was written
+    */
+   void WriteToSharedMemory();
+   /**
+    * Writes the given buffers to the connection socket on the IO service and waits for the write to complete
+    * @param vecBuffers
+    * @return false if the write failed
+    */
+   bool WriteToClient(const std::vector<boost::asio::const_buffer> & vecBuffers);
+
+public:
+   /**
+    * Constructor, the relay takes ownership of the user shared memory and frees it once its last operation ended
+    * @param pConnectionSocket
+    * @param pUserShm
+    * @param stConnectionID
+    */
+   GuacConnectionRelay(const IGuacConnectionSocketPtr & pConnectionSocket, guac_socket * pUserShm,
+                       const std::string & stConnectionID);
+   /**
+    * Destructor, frees the user shared memory
+    */
+   virtual ~GuacConnectionRelay();
+   /**
+    * Starts relaying the client input to the user shared memory on the IO service, does not block
+    */
+   void Start();
+   /**
+    * Relays the user shared memory to the client until the relay stops or the given predicate turns false, blocks
+    * The shared memory can not be waited on by the IO service, so the calling thread waits on it
+    * @param rIsRunning
+    */
+   void RunSharedMemoryToClient(const boost::function<bool()> & rIsRunning);
+   /**
+    * Stops the relay, the pending client read ends once the connection socket is closed
+    */
+   void Stop();
+   /**
+    * Getter for whether the relay is running
+    * @return
+    */
+   bool IsRelayRunning();
+   /**
+    * Getter for the connection ID the relay was created for
+    * @return
+    */
+   std::string GetConnectionID() const;
+   /**
+    * Getter for the number of bytes received from the client so far
+    * @return
+    */
+   uint64_t GetBytesReceived() const;
+   /**
+    * Getter for the number of bytes sent to the client so far
+    * @return
+    */
+   uint64_t GetBytesSent() const;
+   /**
+    * Getter for the number of bytes of process output waiting in the user shared memory to be sent to the client
+    * Only known for a ring buffer, 0 otherwise
+    * @return
+    */
+   size_t GetPendingOutputBytes() const;
+};
+
+typedef boost::shared_ptr<GuacConnectionRelay> GuacConnectionRelayPtr;
+
+#endif //GUACAMOLE_GUACCONNECTIONRELAY_H
@@ -17,7 +17,8 @@ class GuacConnectionSSLSocket : public IGuacConnectionSocket
 {
 private:
    std::string m_stPEMFile, m_stCertFile, m_stDHPEMFile;
-   boost::asio::io_service m_IOService;
+   boost::asio::io_service & m_IOService;
+   boost::asio::io_service::strand m_Strand;
    SSLSocketPtr m_Socket;
    guac_socket * m_GuacSocket;
    boost::asio::ssl::context * m_CurrentSSLContext;
@@ -32,25 +33,28 @@ private:
 public:
    /**
     * Constructor
-    * @param rContext
+    * @param rIOService The IO service running the asynchronous operations of the socket
+    * @param stPEMFile
+    * @param stCertFile
+    * @param stDHPEMFile
     */
-   GuacConnectionSSLSocket(const std::string & stPEMFile, const std::string & stCertFile,
-                           const std::string & stDHPEMFile);
+   GuacConnectionSSLSocket(boost::asio::io_service & rIOService, const std::string & stPEMFile,
+                           const std::string & stCertFile, const std::string & stDHPEMFile);
    /**
     * Destructor
     */
    virtual ~GuacConnectionSSLSocket();
    /**
-   * @see IGuacConnectionSocket::WaitForSocket
-   * @param pAcceptor
-   * @param rErrorCode
-   */
-   virtual void WaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor, boost::system::error_code & rErrorCode);
+    * @see IGuacConnectionSocket::AsyncWaitForSocket
+    * @param pAcceptor
+    * @param rHandler
+    */
+   virtual void AsyncWaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor, const GuacSocketHandler & rHandler);
    /**
-    * @see IGuacConnectionSocket::EstablishSocket
-    * @param rErrorCode
+    * @see IGuacConnectionSocket::AsyncEstablishSocket
+    * @param rHandler
     */
-   virtual void EstablishSocket(boost::system::error_code & rErrorCode);
+   virtual void AsyncEstablishSocket(const GuacSocketHandler & rHandler);
    /**
     * @see IGuacConnectionSocket::CloseSocket
     * @param rErrorCode
@@ -77,6 +81,13 @@ public:
    * @return
    */
    virtual size_t ReadSome(char * pBuffer, size_t sSize);
+   /**
+    * @see IGuacConnectionSocket::AsyncReadSome
+    * @param pBuffer
+    * @param sSize
+    * @param rHandler
+    */
+   virtual void AsyncReadSome(char * pBuffer, size_t sSize, const GuacSocketIOHandler & rHandler);
    /**
    * @see IGuacConnectionSocket::WriteSome
    * @param pBuffer
@@ -109,6 +120,27 @@ public:
    * @return
    */
    virtual size_t WriteAll(char * pBuffer, size_t sSize);
+   /**
+   * @see IGuacConnectionSocket::WriteAll
+   * @param vecBuffers
+   * @param rErrorCode
+   * @return
+   */
+   virtual size_t WriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                           boost::system::error_code & rErrorCode);
+   /**
+   * @see IGuacConnectionSocket::AsyncWriteAll
+   * @param vecBuffers
+   * @param rHandler
+   */
+   virtual void AsyncWriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                              const GuacSocketIOHandler & rHandler);
+   /**
+   * @see IGuacConnectionSocket::AsyncWait
+   * @param uMilliseconds
+   * @param rHandler
+   */
+   virtual void AsyncWait(unsigned int uMilliseconds, const GuacSocketHandler & rHandler);
    /**
     * @see IGuacConnectionSocket::IsSocketOpened
     * @return
@@ -16,30 +16,32 @@ typedef boost::shared_ptr<TCPSocket> TCPSocketPtr;
 class GuacConnectionTCPSocket : public IGuacConnectionSocket
 {
 private:
-   boost::asio::io_service m_IOService;
+   boost::asio::io_service & m_IOService;
+   boost::asio::io_service::strand m_Strand;
    TCPSocketPtr m_Socket;
    guac_socket * m_GuacSocket;
 
 public:
    /**
     * Constructor
+    * @param rIOService The IO service running the asynchronous operations of the socket
     */
-   GuacConnectionTCPSocket();
+   GuacConnectionTCPSocket(boost::asio::io_service & rIOService);
    /**
     * Destructor
     */
    virtual ~GuacConnectionTCPSocket();
    /**
-    * @see IGuacConnectionSocket::WaitForSocket
+    * @see IGuacConnectionSocket::AsyncWaitForSocket
     * @param pAcceptor
-    * @param rErrorCode
+    * @param rHandler
     */
-   virtual void WaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor, boost::system::error_code & rErrorCode);
+   virtual void AsyncWaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor, const GuacSocketHandler & rHandler);
    /**
-    * @see IGuacConnectionSocket::EstablishSocket
-    * @param rErrorCode
+    * @see IGuacConnectionSocket::AsyncEstablishSocket
+    * @param rHandler
     */
-   virtual void EstablishSocket(boost::system::error_code & rErrorCode);
+   virtual void AsyncEstablishSocket(const GuacSocketHandler & rHandler);
    /**
     * @see IGuacConnectionSocket::CloseSocket
     * @param rErrorCode
@@ -66,6 +68,13 @@ public:
    * @return
    */
    virtual size_t ReadSome(char * pBuffer, size_t sSize);
+   /**
+    * @see IGuacConnectionSocket::AsyncReadSome
+    * @param pBuffer
+    * @param sSize
+    * @param rHandler
+    */
+   virtual void AsyncReadSome(char * pBuffer, size_t sSize, const GuacSocketIOHandler & rHandler);
    /**
     * @see IGuacConnectionSocket::WriteSome
     * @param pBuffer
@@ -98,6 +107,27 @@ public:
    * @return
    */
    virtual size_t WriteAll(char * pBuffer, size_t sSize);
+   /**
+   * @see IGuacConnectionSocket::WriteAll
+   * @param vecBuffers
+   * @param rErrorCode
+   * @return
+   */
+   virtual size_t WriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                           boost::system::error_code & rErrorCode);
+   /**
+   * @see IGuacConnectionSocket::AsyncWriteAll
+   * @param vecBuffers
+   * @param rHandler
+   */
+   virtual void AsyncWriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                              const GuacSocketIOHandler & rHandler);
+   /**
+   * @see IGuacConnectionSocket::AsyncWait
+   * @param uMilliseconds
+   * @param rHandler
+   */
+   virtual void AsyncWait(unsigned int uMilliseconds, const GuacSocketHandler & rHandler);
    /**
     * @see IGuacConnectionSocket::IsSocketOpened
     * @return
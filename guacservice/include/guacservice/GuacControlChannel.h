@@ -0,0 +1,186 @@
+//
+// Framed request / response control protocol between guacservice and its client processes
+//
+
+#ifndef GUACAMOLE_GUACCONTROLCHANNEL_H
+#define GUACAMOLE_GUACCONTROLCHANNEL_H
+
+#include <boost/thread.hpp>
+#include <guacamole/socket.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Every frame starts with the magic, the type, the status, the sequence and the payload length, all little endian
+#define CONTROL_FRAME_MAGIC 0x4743
+#define CONTROL_FRAME_HEADER_SIZE 14
+#define CONTROL_FRAME_MAX_PAYLOAD 65536
+
+// The time given to a client process to join its shared memory, read its parameters and load the protocol plugin
+#define CONTROL_PARAMS_TIMEOUT_MS 30000
+// The time given to a client process to acknowledge any other command
+#define CONTROL_COMMAND_TIMEOUT_MS 15000
+// The time given to a client process to render its metrics, a scrape does not wait on a stuck process any longer
+#define CONTROL_METRICS_TIMEOUT_MS 1000
+
+/**
+ * The type of a control message, commands are sent by the parent and each is answered with an Ack by the child
+ */
+enum class GuacControlMessageType : uint16_t
+{
+   Params = 1,
+   AddUser = 2,
+   RemoveUser = 3,
+   Stop = 4,
+   Ack = 5,
+   Metrics = 6
+};
+
+/**
+ * The status carried by an Ack
+ */
+enum class GuacControlStatus : uint16_t
+{
+   Success = 0,
+   Failure = 1,
+   Unsupported = 2
+};
+
+/**
+ * A single control message, the payload of a command is its argument and the payload of an Ack is an error message,
+ * or the rendered metrics of the process for the Ack of a Metrics command
+ */
+struct GuacControlMessage
+{
+   GuacControlMessageType eType;
+   GuacControlStatus eStatus;
+   uint32_t uSequence;
+   std::string stPayload;
+};
+
+/**
+ * Latency and outcome statistics of a single command type, as seen by the parent
+ */
+struct GuacControlCommandStats
+{
+   uint64_t uCount;
+   uint64_t uFailures;
+   double dTotalMS;
+   double dMaxMS;
+   double dLastMS;
+};
+
+/**
+ * The parameters a client process needs to begin execution, carried by the Params command
+ */
+struct GuacClientParams
+{
+   std::string stLogFolder;
+   std::string stProtocol;
+   std::string stLibraryFolder;
+   short sFPS;
+   short sEncoderThreads;
+   short sTileCacheMB;
+   short sSendQueueMB;
+   std::string stSlowUserPolicy;
+   short sAudioAggregationMS;
+   short sRecordingBufferMB;
+   std::string stRecordingOverflowPolicy;
+   bool bWithRecordingCompression;
+   short sRecordingKeyframeIntervalSec;
+
+   /**
+    * Serializes the parameters to a Params payload
+    * @return
+    */
+   std::string Serialize() const;
+   /**
+    * Parses the parameters from a Params payload
+    * @param stPayload
+    * @return false if a parameter is missing or malformed
+    */
+   bool Deserialize(const std::string & stPayload);
+};
+
+class GuacControlChannel
+{
+private:
+   guac_socket * m_Socket;
+   std::string m_stReceiveBuffer;
+   uint32_t m_uNextSequence;
+   boost::mutex m_CommandMutex;
+   mutable boost::mutex m_StatsMutex;
+   std::map<GuacControlMessageType, GuacControlCommandStats> m_CommandStats;
+
+private:
+   /**
+    * Takes a complete frame out of the receive buffer if one has arrived
+    * @param rOutMessage
+    * @return 1 if a message was taken, 0 if the frame is incomplete, -1 if the buffer does not hold a valid frame
+    */
+   int TakeBufferedMessage(GuacControlMessage & rOutMessage);
+   /**
+    * Records the outcome and latency of a command
+    * @param eType
+    * @param bSuccess
+    * @param dLatencyMS
+    */
+   void RecordCommand(GuacControlMessageType eType, bool bSuccess, double dLatencyMS);
+
+public:
+   /**
+    * Constructor, the socket is not owned by the channel
+    * @param pSocket
+    */
+   GuacControlChannel(guac_socket * pSocket);
+   /**
+    * Default Destructor
+    */
+   virtual ~GuacControlChannel() = default;
+   /**
+    * Writes a single framed message
+    * @param rMessage
+    * @return
+    */
+   bool SendMessage(const GuacControlMessage & rMessage);
+   /**
+    * Blocks on the socket until a complete message arrives or the timeout elapses
+    * @param rOutMessage
+    * @param iTimeoutMS
+    * @return 1 if a message was received, 0 on timeout, -1 on a broken channel
+    */
+   int ReceiveMessage(GuacControlMessage & rOutMessage, int iTimeoutMS);
+   /**
+    * Sends a command and waits for its Ack, commands of concurrent callers are serialized
+    * The latency and outcome of the command are recorded and logged
+    * @param eType
+    * @param stPayload
+    * @param iTimeoutMS
+    * @param rOutAck The Ack received, its status is Failure if none arrived in time
+    * @return true if the command was acknowledged successfully
+    */
+   bool SendCommand(GuacControlMessageType eType, const std::string & stPayload, int iTimeoutMS,
+                    GuacControlMessage & rOutAck);
+   /**
+    * Answers a received command
+    * @param rCommand
+    * @param eStatus
+    * @param stMessage
+    * @return
+    */
+   bool SendAck(const GuacControlMessage & rCommand, GuacControlStatus eStatus, const std::string & stMessage = "");
+   /**
+    * Getter for the statistics of every command type sent so far
+    * @return
+    */
+   std::map<GuacControlMessageType, GuacControlCommandStats> GetCommandStats() const;
+   /**
+    * Getter for the printable name of a message type
+    * @param eType
+    * @return
+    */
+   static const char * GetMessageTypeName(GuacControlMessageType eType);
+};
+
+#endif //GUACAMOLE_GUACCONTROLCHANNEL_H
@@ -21,15 +21,15 @@
 #else
 #define LIB_EXTENSION "so"
 #endif
-#define PROTOCOL_BUFFER_MAX_LEN 32
-#define LIBRARY_FOLDER_BUFFER_MAX_LEN 512
-#define LOGGER_FOLDER_BUFFER_MAX_LEN 512
-#define FPS_BUFFER_MAX_LEN 4
-
 #define GUAC_SHARED_MEMORY_GLOBAL_QUEUE_SIZE 2
 #define GUAC_SHARED_MEMORY_GLOBAL_PACKET_SIZE 256
 
 #define GUAC_SHARED_MEMORY_USER_QUEUE_SIZE 1024
 #define GUAC_SHARED_MEMORY_USER_PACKET_SIZE 1024
+// The user shared memory is a byte ring buffer of QUEUE_SIZE * PACKET_SIZE bytes
+#define GUAC_SHARED_MEMORY_USER_RING_BUFFER true
+
+// The largest in-memory buffer of a session recording, larger configured sizes are clamped to it
+#define RECORDING_MAX_BUFFER_MB 1024
 
 #endif //GUACAMOLE_GUACDEFINES_H
\ No newline at end of file
@@ -0,0 +1,147 @@
+//
+// Aggregates the metrics of the service and all its client processes, and serves them over HTTP
+//
+
+#ifndef GUACAMOLE_GUACMETRICS_H
+#define GUACAMOLE_GUACMETRICS_H
+
+#include <guacservice/GuacConfig.h>
+#include <guacservice/GuacConnectionRelay.h>
+#include <guacservice/GuacLogger.h>
+#include <guacamole/timestamp.h>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <map>
+#include <sstream>
+
+class GuacClientProcessHandler;
+
+typedef GuacClientProcessHandler * GuacClientProcessHandlerPtr;
+
+class GuacMetrics
+{
+private:
+   /**
+    * The frame count of a client process at the previous scrape, for deriving its frame rate
+    */
+   struct GuacFramesSample
+   {
+      uint64_t uFrames;
+      guac_timestamp Timestamp;
+   };
+
+   /**
+    * The samples of a single metric family, rendered together under one TYPE line
+    */
+   struct GuacMetricFamily
+   {
+      std::string stType;
+      std::ostringstream Samples;
+   };
+
+   typedef std::map<std::string, GuacMetricFamily> GuacMetricFamilies;
+
+   boost::mutex m_ProcessHandlersMutex;
+   boost::condition_variable m_ProcessHandlersCondition;
+   std::map<std::string, GuacClientProcessHandlerPtr> m_ProcessHandlers;
+   GuacClientProcessHandlerPtr m_QueriedProcessHandler;
+   std::map<std::string, GuacFramesSample> m_FramesSamples;
+   boost::mutex m_RelaysMutex;
+   std::map<GuacConnectionRelayPtr, std::string> m_Relays;
+   uint64_t m_uEndedBytesReceived;
+   uint64_t m_uEndedBytesSent;
+   boost::asio::io_service m_IOService;
+   boost::asio::ip::tcp::acceptor * m_Acceptor;
+   boost::thread m_EndpointThread;
+
+private:
+   /**
+    * Private constructor for singleton
+    */
+   GuacMetrics();
+   /**
+    * Deleted for singleton
+    * @param other
+    */
+   GuacMetrics(const GuacMetrics & other) = delete;
+   /**
+    * Deleted for singleton
+    * @param other
+    * @return
+    */
+   GuacMetrics operator=(const GuacMetrics & other) = delete;
+   /**
+    * Adds the metrics rendered by a client process to the families, labeled with the process ID
+    * Also derives the frame rate of the process from its frame count
+    * @param stProcessID
+    * @param stMetrics
+    * @param rFamilies
+    */
+   void AddClientMetrics(const std::string & stProcessID, const std::string & stMetrics,
+                         GuacMetricFamilies & rFamilies);
+   /**
+    * Queries all the client processes and adds their metrics and control command statistics to the families
+    * The processes are queried one at a time without holding the lock, only the queried one can not be unregistered
+    * @param rFamilies
+    */
+   void CollectProcessHandlers(GuacMetricFamilies & rFamilies);
+   /**
+    * Adds the byte counters and pending output of all the relayed connections to the families
+    * @param rFamilies
+    */
+   void CollectRelays(GuacMetricFamilies & rFamilies);
+   /**
+    * Starts accepting the next scrape, does not block
+    */
+   void AcceptScrape();
+
+public:
+   /**
+    * Singleton getter
+    * @return
+    */
+   static boost::shared_ptr<GuacMetrics> GetInstance();
+   /**
+    * Destructor, stops the endpoint
+    */
+   virtual ~GuacMetrics();
+   /**
+    * Adds a running client process to the scraped processes
+    * @param pProcessHandler
+    */
+   void RegisterProcessHandler(const GuacClientProcessHandlerPtr & pProcessHandler);
+   /**
+    * Removes a client process from the scraped processes, waits for a scrape querying this very process to end
+    * @param pProcessHandler
+    */
+   void UnregisterProcessHandler(const GuacClientProcessHandlerPtr & pProcessHandler);
+   /**
+    * Adds a relayed connection of a client process to the scraped connections
+    * @param stProcessID
+    * @param pRelay
+    */
+   void RegisterRelay(const std::string & stProcessID, const GuacConnectionRelayPtr & pRelay);
+   /**
+    * Removes a relayed connection, its bytes are kept in the service totals
+    * @param pRelay
+    */
+   void UnregisterRelay(const GuacConnectionRelayPtr & pRelay);
+   /**
+    * Collects the metrics of the service and all its client processes
+    * @return The metrics in the Prometheus text exposition format
+    */
+   std::string Collect();
+   /**
+    * Starts serving the metrics over HTTP on the configured host and port, on a thread of its own
+    * Does nothing if the configured port is 0
+    * @param rConfig
+    * @return false if the endpoint could not be bound
+    */
+   bool StartEndpoint(const GuacConfig & rConfig);
+   /**
+    * Stops serving the metrics and waits for the endpoint thread to end
+    */
+   void StopEndpoint();
+};
+
+#endif //GUACAMOLE_GUACMETRICS_H
@@ -8,8 +8,10 @@
 #include <boost/asio.hpp>
 #include <boost/lexical_cast.hpp>
 #include <guacservice/GuacConnectionHandler.h>
+#include <guacservice/GuacClientProcessPool.h>
 #include <guacservice/GuacConfig.h>
 #include <guacservice/GuacLogger.h>
+#include <guacservice/GuacMetrics.h>
 #include <guacservice/GuacConnectionSSLSocket.h>
 #include <guacservice/GuacConnectionTCPSocket.h>
 
@@ -20,6 +22,10 @@ class GuacService
 private:
    boost::asio::ip::tcp::acceptor * m_Acceptor;
    boost::asio::io_service m_IOService;
+   boost::asio::io_service::work * m_IOServiceWork;
+   boost::thread_group m_IOThreads;
+   boost::mutex m_ServiceMutex;
+   boost::condition_variable m_ServiceCondition;
    GuacConnectionHandler * m_ConnectionsHandler;
    GuacConfig m_Config;
    bool m_IsServiceRunning;
@@ -35,7 +41,32 @@ private:
     */
    void CleanupService();
    /**
-    * Listens the new connection, each connection has its seperate IOService
+    * Starts the fixed pool of threads running the IO service, shared by the acceptor and all the connections
+    */
+   void StartIOThreads();
+   /**
+    * Stops the IO service and waits for its threads to end
+    */
+   void StopIOThreads();
+   /**
+    * Starts accepting the next connection, does not block
+    */
+   void AcceptNewConnection();
+   /**
+    * Accept handler, starts establishing the accepted connection and accepting the next one
+    * @param pConnection
+    * @param rErrorCode
+    */
+   void OnConnectionAccepted(const IGuacConnectionSocketPtr & pConnection, const boost::system::error_code & rErrorCode);
+   /**
+    * Establish handler, passes the established connection to the connections handler
+    * @param pConnection
+    * @param rErrorCode
+    */
+   void OnConnectionEstablished(const IGuacConnectionSocketPtr & pConnection,
+                                const boost::system::error_code & rErrorCode);
+   /**
+    * Listens to new connections, blocks until the service stops
     */
    void ListenAndAcceptNewConnections();
 
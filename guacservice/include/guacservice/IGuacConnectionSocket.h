@@ -9,6 +9,17 @@
 #include <boost/system/error_code.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <vector>
+
+/**
+ * Completion handler of an asynchronous socket operation
+ */
+typedef boost::function<void(const boost::system::error_code &)> GuacSocketHandler;
+/**
+ * Completion handler of an asynchronous read or write, given the amount of bytes transferred
+ */
+typedef boost::function<void(const boost::system::error_code &, size_t)> GuacSocketIOHandler;
 
 class IGuacConnectionSocket
 {
@@ -22,17 +33,19 @@ public:
     */
    virtual ~IGuacConnectionSocket() = default;
    /**
-    * Waits for a socket with a given acceptor
-    * On a new connection arrival from this acceptor, the connection will be accepted and saved on this socket
+    * Starts waiting for a socket with a given acceptor, does not block
+    * On a new connection arrival from this acceptor, the connection will be accepted, saved on this socket and the
+    * handler is called from the IO service
     * @param pAcceptor
-    * @param rErrorCode
+    * @param rHandler
     */
-   virtual void WaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor, boost::system::error_code & rErrorCode) = 0;
+   virtual void AsyncWaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor, const GuacSocketHandler & rHandler) = 0;
    /**
-    * Establishes a socket connection for this GuacConnectionSocket
-    * @param rErrorCode
+    * Starts establishing a socket connection for this GuacConnectionSocket, does not block
+    * The handler is called from the IO service once the connection is established or failed
+    * @param rHandler
     */
-   virtual void EstablishSocket(boost::system::error_code & rErrorCode) = 0;
+   virtual void AsyncEstablishSocket(const GuacSocketHandler & rHandler) = 0;
    /**
     * Closes the connection
     * @param rErrorCode
@@ -59,6 +72,14 @@ public:
    * @return
    */
    virtual size_t ReadSome(char * pBuffer, size_t sSize) = 0;
+   /**
+    * Starts reading some bytes from the socket into the buffer for the given max size, does not block
+    * The buffer must stay valid until the handler is called
+    * @param pBuffer
+    * @param sSize
+    * @param rHandler
+    */
+   virtual void AsyncReadSome(char * pBuffer, size_t sSize, const GuacSocketIOHandler & rHandler) = 0;
    /**
     * Writes the buffer with the given size to the socket
     * @param pBuffer
@@ -91,6 +112,29 @@ public:
    * @return
    */
    virtual size_t WriteAll(char * pBuffer, size_t sSize) = 0;
+   /**
+   * Writes all the given buffers, in order, to the socket as a single gathered write
+   * @param vecBuffers
+   * @param rErrorCode
+   * @return
+   */
+   virtual size_t WriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                           boost::system::error_code & rErrorCode) = 0;
+   /**
+   * Starts writing all the given buffers, in order, to the socket as a single gathered write, does not block
+   * The buffers must stay valid until the handler is called
+   * @param vecBuffers
+   * @param rHandler
+   */
+   virtual void AsyncWriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                              const GuacSocketIOHandler & rHandler) = 0;
+   /**
+   * Starts a timer on the strand of the socket, does not block
+   * The handler is called from the IO service once the given time passed
+   * @param uMilliseconds
+   * @param rHandler
+   */
+   virtual void AsyncWait(unsigned int uMilliseconds, const GuacSocketHandler & rHandler) = 0;
    /**
     * Getter for whether the socket is opened or not
     * @return
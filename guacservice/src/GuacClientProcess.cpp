@@ -3,9 +3,8 @@
 //
 
 #include <guacservice/GuacClientProcess.h>
-#include <chrono>
-#include <thread>
-using namespace std::chrono_literals;
+#include <algorithm>
+
 void GuacLogHandler(guac_client * client, guac_client_log_level level, const char * format, va_list args)
 {
    char message[2048];
@@ -32,8 +31,9 @@ GuacClientProcess::GuacClientProcess() : m_Client(nullptr), m_bIsProcessRunning(
 {
    // Joins the existing shared memory by the process id
    // Busy wait for 10 seconds to try and join the shared memory
-   static const std::size_t SHARED_MEMORY_WAIT_COUNT = 10;
-   static const std::size_t SHARED_MEMORY_WAIT_DELAY = 314;
+   // The parent creates it right after spawning us, so poll often to not add a full delay to every process start
+   static const std::size_t SHARED_MEMORY_WAIT_COUNT = 500;
+   static const std::size_t SHARED_MEMORY_WAIT_DELAY = 20;
 
    int count = SHARED_MEMORY_WAIT_COUNT;
    while (count > 0)
@@ -54,148 +54,13 @@ GuacClientProcess::GuacClientProcess() : m_Client(nullptr), m_bIsProcessRunning(
    }
 }
 
-std::string GuacClientProcess::ReadLoggerPath()
-{
-   GuacLogger::GetInstance()->Debug() << "Trying to read logger path [" << m_Client->connection_id << "]";
-
-   char buffer[LOGGER_FOLDER_BUFFER_MAX_LEN];
-   std::string loggerFolder;
-
-   // Select first to see if data is ready
-   if(guac_socket_select(m_ShmSocket, SHM_SELECT_MS))
-   {
-      GuacLogger::GetInstance()->Debug() << "Select Popped, Reading [" << m_Client->connection_id << "]";
-      // Read the next data
-      size_t size = guac_socket_read(m_ShmSocket, buffer, LOGGER_FOLDER_BUFFER_MAX_LEN);
-      if(size > 0)
-      {
-         loggerFolder = std::string(buffer, buffer + size);
-         GuacLogger::GetInstance()->Debug() << "Read Logger Path : " << loggerFolder << " [" << m_Client->connection_id
-                                            << "]";
-         return loggerFolder;
-      }
-   }
-   else
-   {
-      GuacLogger::GetInstance()->Error() << "Select Timeout on protocol read [" << m_Client->connection_id << "]";
-   }
-   return "";
-}
-
-std::string GuacClientProcess::ReadProtocol()
-{
-   GuacLogger::GetInstance()->Debug() << "Trying to read protocol type [" << m_Client->connection_id << "]";
-
-   char buffer[PROTOCOL_BUFFER_MAX_LEN];
-   std::string protocol;
-
-   // Select first to see if data is ready
-   if(guac_socket_select(m_ShmSocket, SHM_SELECT_MS))
-   {
-      GuacLogger::GetInstance()->Debug() << "Select Popped, Reading [" << m_Client->connection_id << "]";
-      // Read the next data
-      size_t size = guac_socket_read(m_ShmSocket, buffer, PROTOCOL_BUFFER_MAX_LEN);
-      if(size > 0)
-      {
-         protocol = std::string(buffer, buffer + size);
-         GuacLogger::GetInstance()->Debug() << "Read Protocol : " << protocol << " [" << m_Client->connection_id << "]";
-         return protocol;
-      }
-   }
-   else
-   {
-      GuacLogger::GetInstance()->Error() << "Select Timeout on protocol read [" << m_Client->connection_id << "]";
-   }
-   return "";
-}
-
-std::string GuacClientProcess::ReadLibraryPath()
-{
-   GuacLogger::GetInstance()->Debug() << "Trying to read libraries folder [" << m_Client->connection_id << "]";
-
-   char buffer[LIBRARY_FOLDER_BUFFER_MAX_LEN];
-   std::string lib;
-   // Select first to see if data is ready
-   if(guac_socket_select(m_ShmSocket, SHM_SELECT_MS))
-   {
-      GuacLogger::GetInstance()->Debug() << "Select Popped, Reading [" << m_Client->connection_id << "]";
-      // Read the next data
-      size_t size = guac_socket_read(m_ShmSocket, buffer, LIBRARY_FOLDER_BUFFER_MAX_LEN);
-      if(size > 0)
-      {
-         lib = std::string(buffer, buffer + size);
-         GuacLogger::GetInstance()->Debug() << "Read Lib Successfully" << " [" << m_Client->connection_id << "]";
-         return lib;
-      }
-   }
-   else
-   {
-      GuacLogger::GetInstance()->Error() << "Select Timeout on library path read [" << m_Client->connection_id << "]";
-   }
-   return "";
-}
-
-short GuacClientProcess::ReadFPS()
-{
-   GuacLogger::GetInstance()->Debug() << "Trying to read FPS [" << m_Client->connection_id << "]";
-
-   char buffer[FPS_BUFFER_MAX_LEN];
-   short fps;
-   // Select first to see if data is ready
-   if(guac_socket_select(m_ShmSocket, SHM_SELECT_MS))
-   {
-      GuacLogger::GetInstance()->Debug() << "Select Popped, Reading [" << m_Client->connection_id << "]";
-      // Read the next data
-      size_t size = guac_socket_read(m_ShmSocket, buffer, FPS_BUFFER_MAX_LEN);
-      if(size > 0)
-      {
-		 fps = boost::lexical_cast<short>(std::string(buffer, buffer + size));
-         GuacLogger::GetInstance()->Debug() << "Read FPS : " << fps << " [" << m_Client->connection_id << "]";
-         return fps;
-      }
-   }
-   else
-   {
-      GuacLogger::GetInstance()->Error() << "Select Timeout on FPS read [" << m_Client->connection_id << "]";
-   }
-   return -1;
-}
-
-std::string GuacClientProcess::ReadProtocolPath()
-{
-   // Wait for the protocol type to arrive from the parent process
-   std::string protocol = ReadProtocol();
-   if(protocol == "")
-   {
-      GuacLogger::GetInstance()->Error() << "Could not read protocol [" << m_Client->connection_id << "]";
-      guac_client_free(m_Client);
-      exit(1);
-   }
-
-   // Wait for library path to arrive from the parent process
-   std::string libraryPath = ReadLibraryPath();
-
-   if(libraryPath == "")
-   {
-      GuacLogger::GetInstance()->Error() << "Could not read library path [" << m_Client->connection_id << "]";
-
-      guac_client_free(m_Client);
-      exit(1);
-   }
-
-   GuacLogger::GetInstance()->Debug() << "Trying to load plugin " << protocol << " [" << m_Client->connection_id << "]";
-   std::string protocolPath = StitchProtocolPath(libraryPath, protocol);
-
-   return protocolPath;
-}
-
 std::string
 GuacClientProcess::StitchProtocolPath(const std::string & stLibraryFolder, const std::string & stProtocolName) const
 {
    return stLibraryFolder + "/" + stProtocolName + "." + std::string(LIB_EXTENSION);
 }
 
-void GuacClientProcess::LoadPlugin(const std::string & protocolPath)
+bool GuacClientProcess::LoadPlugin(const std::string & protocolPath)
 {
    int rc = guac_client_load_plugin(m_Client, protocolPath.c_str());
    if(rc < 0)
@@ -211,28 +76,69 @@ void GuacClientProcess::LoadPlugin(const std::string & protocolPath)
          GuacLogger::GetInstance()->Error() << "Unknown Plugin error [" << m_Client->connection_id << "]";
       }
       GuacLogger::GetInstance()->Error() << guac_error_message;
-      guac_client_free(m_Client);
-      exit(1);
-   }
-   else
-   {
-      GuacLogger::GetInstance()->Debug() << "Finished Loading Plugin [" << m_Client->connection_id << "]";
+      return false;
    }
+
+   GuacLogger::GetInstance()->Debug() << "Finished Loading Plugin [" << m_Client->connection_id << "]";
+   return true;
+}
+
+void GuacClientProcess::InitLogger(const std::string & stLoggerPath)
+{
+   GuacLogger::GetInstance()->InitializeLog(stLoggerPath,
+                                            "GuacServiceProcess_" + m_Client->connection_id,
+                                            boost::log::trivial::debug,
+                                            false, !(stLoggerPath == "NO_LOG"));
 }
 
-void GuacClientProcess::InitLoggerFromParent()
+bool GuacClientProcess::ApplyParams(const GuacClientParams & rParams)
 {
-   std::string loggerPath = ReadLoggerPath();
+   // Initialize the logger first so the rest of the startup is logged
+   InitLogger(rParams.stLogFolder);
 
-   if(loggerPath == "")
+   GuacLogger::GetInstance()->Debug() << "Initializing client process [" << m_Client->connection_id << "]";
+
+   // Load the given protocol plugin
+   GuacLogger::GetInstance()->Debug() << "Trying to load plugin " << rParams.stProtocol << " ["
+                                      << m_Client->connection_id << "]";
+   if(!LoadPlugin(StitchProtocolPath(rParams.stLibraryFolder, rParams.stProtocol)))
    {
-      guac_client_free(m_Client);
-      exit(1);
+      return false;
    }
-   GuacLogger::GetInstance()->InitializeLog(loggerPath,
-                                            "GuacServiceProcess_" + m_Client->connection_id,
-                                            boost::log::trivial::debug,
-                                            false, !(loggerPath == "NO_LOG"));
+
+   // Set the FPS on the client
+   m_Client->client_fps = rParams.sFPS;
+
+   // Start the encoder threads on the client
+   guac_client_set_encoder_threads(m_Client, rParams.sEncoderThreads);
+
+   // Set the tile cache budget, used by each display the plugin allocates
+   m_Client->tile_cache_size = rParams.sTileCacheMB * 1024 * 1024;
+
+   // Set the send queue settings, applied to each user as it joins
+   m_Client->send_queue_size = rParams.sSendQueueMB * 1024 * 1024;
+   m_Client->send_queue_policy = (rParams.stSlowUserPolicy == "disconnect")
+                                 ? GUAC_SEND_QUEUE_DISCONNECT : GUAC_SEND_QUEUE_RESYNC;
+
+   // Set the audio aggregation window, used by each audio stream the plugin allocates
+   m_Client->audio_aggregation_window = rParams.sAudioAggregationMS;
+
+   // Set the session recording settings, used if the plugin records the connection
+   // A size out of range is clamped, 0 picks the default size
+   short recording_buffer_mb = std::max<short>(0, std::min<short>(rParams.sRecordingBufferMB,
+                                                                  RECORDING_MAX_BUFFER_MB));
+   if(recording_buffer_mb != rParams.sRecordingBufferMB)
+   {
+      GuacLogger::GetInstance()->Error() << "RecordingBufferMB out of range, using " << recording_buffer_mb << " ["
+                                         << m_Client->connection_id << "]";
+   }
+   m_Client->recording_buffer_size = static_cast<size_t>(recording_buffer_mb) * 1024 * 1024;
+   m_Client->recording_overflow_policy = (rParams.stRecordingOverflowPolicy == "stop")
+                                         ? GUAC_RECORDING_OVERFLOW_STOP : GUAC_RECORDING_OVERFLOW_BLOCK;
+   m_Client->recording_compress = rParams.bWithRecordingCompression;
+   m_Client->recording_keyframe_interval = rParams.sRecordingKeyframeIntervalSec * 1000;
+
+   return true;
 }
 
 void GuacClientProcess::AddUser(const std::string & stSharedMemoryTag, bool bOwner)
@@ -297,65 +203,79 @@ void GuacClientProcess::RemoveUser(const std::string & stSharedMemoryTag)
    }
 }
 
-std::string GuacClientProcess::WaitForCommand()
+void GuacClientProcess::StopClient()
 {
-   // Select and read command
-   //if(guac_socket_select(m_ShmSocket, 3000))
+   // Copy the users, each user thread removes itself from the vector once done
+   std::vector<std::tuple<GuacClientUserPtr, boost::shared_ptr<boost::thread>>> users;
    {
-      char buffer[SOCKET_BUFFER_SIZE];
-      size_t size = guac_socket_read(m_ShmSocket, buffer, SOCKET_BUFFER_SIZE);
-
-      if(size > 0)
-      {
-         std::string command = std::string(buffer, buffer + size);
-         boost::trim(command);
-         return command;
-      }
+      boost::mutex::scoped_lock lock(m_ClientUsersMutex);
+      users = m_ClientUsers;
    }
-   return "";
-}
 
-void GuacClientProcess::HandleCommand(const std::string & stCommand)
-{
-   if(stCommand == "")
+   for(auto && user : users)
    {
-      return;
+      std::get<0>(user)->AbortUser();
+      std::get<1>(user)->join();
    }
 
-   GuacLogger::GetInstance()->Debug() << "Got New Command : " << stCommand << " [" << m_Client->connection_id << "]";
+   // The plugin thread ends once the client is stopped, the free handler waits for it before closing the recording
+   GuacLogger::GetInstance()->Debug() << "Stopping Client [" << m_Client->connection_id << "]";
+   guac_client_stop(m_Client);
+   GuacLogger::GetInstance()->Debug() << "Freeing Client [" << m_Client->connection_id << "]";
+   guac_client_free(m_Client);
+   m_Client = nullptr;
+}
 
-   std::vector<std::string> command_args;
-   boost::split(command_args, stCommand, boost::is_any_of(std::string(COMMAND_DELIMITER)));
+void GuacClientProcess::HandleCommand(const GuacControlMessage & rCommand)
+{
+   GuacLogger::GetInstance()->Debug() << "Got New Command : " << GuacControlChannel::GetMessageTypeName(rCommand.eType)
+                                      << " [" << m_Client->connection_id << "]";
 
-   if(command_args[0] == ADD_USER_COMMAND)
-   {
-      GuacLogger::GetInstance()->Debug() << "Adding New User - " << command_args[1] << " [" << m_Client->connection_id
-                                         << "]";
-      AddUser(command_args[1], m_ClientUsers.size() == 0);
-   }
-   else if(command_args[0] == REMOVE_USER_COMMAND)
-   {
-      GuacLogger::GetInstance()->Debug() << "Removing User - " << command_args[1] << " [" << m_Client->connection_id
-                                         << "]";
-      RemoveUser(command_args[1]);
-   }
-   else if(command_args[0] == STOP_PROCESS_COMMAND)
+   switch(rCommand.eType)
    {
+   case GuacControlMessageType::AddUser:
+      GuacLogger::GetInstance()->Debug() << "Adding New User - " << rCommand.stPayload << " ["
+                                         << m_Client->connection_id << "]";
+      AddUser(rCommand.stPayload, m_ClientUsers.size() == 0);
+      m_ControlChannel->SendAck(rCommand, GuacControlStatus::Success);
+      break;
+
+   case GuacControlMessageType::RemoveUser:
+      GuacLogger::GetInstance()->Debug() << "Removing User - " << rCommand.stPayload << " ["
+                                         << m_Client->connection_id << "]";
+      RemoveUser(rCommand.stPayload);
+      m_ControlChannel->SendAck(rCommand, GuacControlStatus::Success);
+      break;
+
+   case GuacControlMessageType::Stop:
       GuacLogger::GetInstance()->Debug() << "Stopping Process [" << m_Client->connection_id << "]";
 
-	  // TODO: Temporary patch, please fix me
-	  exit(1);
+      // Acknowledge before exiting, the parent waits for the process to end afterwards
+      m_ControlChannel->SendAck(rCommand, GuacControlStatus::Success);
 
-      // Stop all the users 
-      for(auto && user : m_ClientUsers)
-      {
-         std::get<0>(user)->AbortUser();
-         std::get<1>(user)->join();
-      }
-      GuacLogger::GetInstance()->Debug() << "All Users Stopped [" << m_Client->connection_id << "]";
+      // The recording is buffered in memory and written by its own thread, so it must be closed before exiting
+      StopClient();
 
-      // Stop the running main
-      m_bIsProcessRunning = false;
+      // TODO: Temporary patch, please fix me
+      exit(1);
+
+   case GuacControlMessageType::Metrics:
+   {
+      // The client state is sampled on request, the rest is recorded by libguac as it happens
+      guac_metrics_gauge_set("guac_client_users", m_Client->connected_users);
+      guac_metrics_gauge_set("guac_client_processing_lag_milliseconds", guac_client_get_processing_lag(m_Client));
+      guac_metrics_counter_set("guac_client_sent_bytes_total", m_Client->socket->bytes_written);
+
+      char * metrics = guac_metrics_render();
+      m_ControlChannel->SendAck(rCommand, GuacControlStatus::Success, metrics);
+      free(metrics);
+      break;
+   }
+
+   default:
+      GuacLogger::GetInstance()->Error() << "Unsupported command [" << m_Client->connection_id << "]";
+      m_ControlChannel->SendAck(rCommand, GuacControlStatus::Unsupported, "Unsupported command");
+      break;
    }
 }
 
@@ -365,57 +285,70 @@ void GuacClientProcess::StartClientProcess()
    m_Client = guac_client_alloc();
    m_Client->log_handler = GuacLogHandler;
 
+   m_ControlChannel.reset(new GuacControlChannel(m_ShmSocket));
+
    try
    {
-	   // Initialize the logger from parent
-	   InitLoggerFromParent();
-
-	   GuacLogger::GetInstance()->Debug() << "Initializing client process [" << m_Client->connection_id << "]";
-
-	   // Read the protocol full path from the parent process
-	   std::string protocolPath = ReadProtocolPath();
-
-	   // Load the given protocol plugin
-	   LoadPlugin(protocolPath);
-
-	   // Read the FPS from the parent process
-	   short fps = ReadFPS();
-
-	   // Failed reading FPS, aborting
-	   if (fps == -1)
-	   {
-		   guac_client_free(m_Client);
-		   exit(1);
-	   }
-
-	   // Set the FPS on the client
-	   m_Client->client_fps = fps;
-
-	   m_bIsProcessRunning = true;
-
-	   // This is the main thread, we will wait for new users notification from the parent process here
-	   // Each user will run on a different thread with the ID given from the parent as the shared memory tag
-	   GuacLogger::GetInstance()->Debug() << "Running Commands Loop [" << m_Client->connection_id << "]";
-	   // Start the waiting loop
-	   while (m_bIsProcessRunning)
-	   {
-		   std::string cmd = WaitForCommand();
-		   HandleCommand(cmd);
-		   std::this_thread::sleep_for(1000ms);
-	   }
+      // The first command is always the params, acknowledged once they are applied
+      GuacControlMessage command;
+      if(m_ControlChannel->ReceiveMessage(command, CONTROL_PARAMS_TIMEOUT_MS) <= 0 ||
+         command.eType != GuacControlMessageType::Params)
+      {
+         guac_client_free(m_Client);
+         exit(1);
+      }
+
+      GuacClientParams params;
+      if(!params.Deserialize(command.stPayload))
+      {
+         m_ControlChannel->SendAck(command, GuacControlStatus::Failure, "Malformed params");
+         guac_client_free(m_Client);
+         exit(1);
+      }
+
+      if(!ApplyParams(params))
+      {
+         m_ControlChannel->SendAck(command, GuacControlStatus::Failure, "Could not load plugin " + params.stProtocol);
+         guac_client_free(m_Client);
+         exit(1);
+      }
+
+      m_ControlChannel->SendAck(command, GuacControlStatus::Success);
+
+      m_bIsProcessRunning = true;
+
+      // This is the main thread, we will wait for new users notification from the parent process here
+      // Each user will run on a different thread with the ID given from the parent as the shared memory tag
+      GuacLogger::GetInstance()->Debug() << "Running Commands Loop [" << m_Client->connection_id << "]";
+
+      // Block on the control channel until the next command arrives
+      while(m_bIsProcessRunning)
+      {
+         int result = m_ControlChannel->ReceiveMessage(command, SHM_SELECT_MS);
+         if(result < 0)
+         {
+            GuacLogger::GetInstance()->Error() << "Control channel broken [" << m_Client->connection_id << "]";
+            break;
+         }
+
+         if(result > 0)
+         {
+            HandleCommand(command);
+         }
+      }
    }
    catch (...)
    {
-	   GuacLogger::GetInstance()->Error() << "Internal error occured.";
+      GuacLogger::GetInstance()->Error() << "Internal error occured.";
    }
    GuacLogger::GetInstance()->Debug() << "Command Loop Over, Finishing process [" << m_Client->connection_id << "]";
 
    // TODO: Temporary patch, please fix me
    exit(1);
 
-   // Stop the client and free it   
+   // Stop the client and free it
    GuacLogger::GetInstance()->Debug() << "Stopping Client [" << m_Client->connection_id << "]";
    guac_client_stop(m_Client);
    GuacLogger::GetInstance()->Debug() << "Freeing Client [" << m_Client->connection_id << "]";
    guac_client_free(m_Client);
-}
\ No newline at end of file
+}
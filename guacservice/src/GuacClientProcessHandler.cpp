@@ -5,9 +5,10 @@
 #include <guacservice/GuacClientProcessHandler.h>
 #include <guacservice/GuacConnection.h>
 #include <guacservice/GuacClientProcessHandlerMap.h>
+#include <guacservice/GuacMetrics.h>
 
 GuacClientProcessHandler::GuacClientProcessHandler()
-        : m_bIsProcessRunning(false), m_ClientChildProcess(nullptr), m_ShmSocket(nullptr)
+        : m_bIsProcessRunning(false), m_ClientChildProcess(nullptr), m_ShmSocket(nullptr), m_ControlChannel(nullptr)
 {
    m_GuacClient = guac_client_alloc();
 }
@@ -16,6 +17,8 @@ GuacClientProcessHandler::~GuacClientProcessHandler()
 {
    StopProcess();
 
+   delete m_ControlChannel;
+
    // Cleanup the shared memory if created
    if(m_ShmSocket)
    {
@@ -35,7 +38,7 @@ std::string GuacClientProcessHandler::GenerateSharedMemoryTag() const
    return shared_memory_name;
 }
 
-void GuacClientProcessHandler::IOThread(const GuacConnectionPtr & pConnectionUser, bool bOwner)
+void GuacClientProcessHandler::RelayUserIO(const GuacConnectionPtr & pConnectionUser, bool bOwner)
 {
    // Generate the random shared memory tag
    std::string shared_memory_name = GenerateSharedMemoryTag();
@@ -43,104 +46,61 @@ void GuacClientProcessHandler::IOThread(const GuacConnectionPtr & pConnectionUse
    // Create the shared memory
    guac_socket * user_shm = guac_socket_shared_memory_socket_create(shared_memory_name, true, true,
 	   GUAC_SHARED_MEMORY_USER_QUEUE_SIZE,
-	   GUAC_SHARED_MEMORY_USER_PACKET_SIZE);
-   guac_socket * tcp_socket = pConnectionUser->GetUnderlyingSocket()->GetGuacSocket();
+	   GUAC_SHARED_MEMORY_USER_PACKET_SIZE, GUAC_SHARED_MEMORY_USER_RING_BUFFER);
 
    // Failure to prepare the guac sockets
-   if(!user_shm || !tcp_socket)
+   if(!user_shm || !pConnectionUser->GetUnderlyingSocket()->GetGuacSocket())
    {
       GuacLogger::GetInstance()->Error() << "Could not create user shared memory, aborting user ["
                                          << GetProcessHandlerID() << "]";
 
+      if(user_shm)
+      {
+         guac_socket_free(user_shm);
+      }
+
       // WORKAROUND: kill the client process since Write Thread has exited
       // Cleanup all the user related IO objects
-      CleanupUserIO(pConnectionUser, bOwner, user_shm, shared_memory_name);
+      CleanupUserIO(pConnectionUser, bOwner, shared_memory_name);
 
       return;
    }
 
-   // Add the instruction that this is to add a user to the running process
-   std::string command = std::string(ADD_USER_COMMAND) + COMMAND_DELIMITER + shared_memory_name;
+   // The relay owns the user shared memory from here on, and releases it once its last IO operation ended
+   GuacConnectionRelayPtr relay(new GuacConnectionRelay(pConnectionUser->GetUnderlyingSocket(), user_shm,
+                                                        pConnectionUser->GetConnectionID()));
 
-   // Write the shared memory tag allocated for this user
+   // Send the shared memory tag allocated for this user
    // This will notify the child process that a new user has asked to join
-   guac_socket_write(m_ShmSocket, command.c_str(), command.size());
-
-   // Start Read thread and write asyncs
-   // Read thread will read from the stream and write to the connection
-   // Write thread will read from the connection and write to the stream
-   GuacLogger::GetInstance()->Debug() << "Starting IO Threads [" << GetProcessHandlerID() << "]";
-   GuacLogger::GetInstance()->Debug() << "Process Handler Started  [" << GetProcessHandlerID() << "]";
+   if(!SendClientCommand(GuacControlMessageType::AddUser, shared_memory_name))
+   {
+      GuacLogger::GetInstance()->Error() << "Client process could not add user, aborting user ["
+                                         << GetProcessHandlerID() << "]";
+      CleanupUserIO(pConnectionUser, bOwner, shared_memory_name);
+      return;
+   }
 
-   // Read thread
-   boost::thread read_thread([&]()
-                             {
-                                // Read part
-                                GuacLogger::GetInstance()->Debug() << "Read Thread Started [" << GetProcessHandlerID()
-                                                                   << "]";
-                                char buffer[SOCKET_BUFFER_SIZE];
-                                int size;
-
-                                // Keep reading from the shared memory socket and writing to the client connection socket
-                                // We select the user shared memory to not overload trying to read, CPU efficent
-                                while(m_bIsProcessRunning && m_ClientChildProcess->running() &&
-                                      !boost::this_thread::interruption_requested())
-                                {
-                                   if(guac_socket_select(user_shm, SHM_SELECT_MS))
-                                   {
-                                      size = guac_socket_read(user_shm, buffer, SOCKET_BUFFER_SIZE);
-									  // pConnectionUser->GetUnderlyingSocket()->WriteAll(buffer, size);
-                                      guac_socket_write(tcp_socket, buffer, size);
-                                      // If an error occured on writing to the socket, the guac_error is set
-                                      // Thus we stop the user completely
-                                      if(guac_error == GUAC_STATUS_SEE_ERRNO)
-                                      {
-                                         GuacLogger::GetInstance()->Error() << "Exception on Read Thread ";
-                                         guac_socket_reset(user_shm);
-                                         return;
-                                      }
-                                   }
-                                }
-
-                                return;
-                             });
-
-
-	// Write part
-	GuacLogger::GetInstance()->Debug() << "Write Started [" << GetProcessHandlerID() << "]";
-	char buffer[SOCKET_BUFFER_SIZE];
-	int size;
-	// Keep reading from the client connection socket and writing to the shared memory socket
-	while (m_bIsProcessRunning && m_ClientChildProcess->running() &&
-		pConnectionUser->IsGuacConnectionRunning())
-	{
-		//if (guac_socket_select(tcp_socket, SHM_SELECT_MS))
-		{
-			// size = pConnectionUser->GetUnderlyingSocket()->ReadSome(buffer, SOCKET_BUFFER_SIZE);
-			size = guac_socket_read(tcp_socket, buffer, SOCKET_BUFFER_SIZE);
-			// If an error occured on reading from the socket, the guac_error is set
-			// Thus we stop the user completely
-			if (guac_error == GUAC_STATUS_SEE_ERRNO)
-			{
-				GuacLogger::GetInstance()->Error() << "Exception on Write Thread ";
-				GuacLogger::GetInstance()->Error() << guac_error_message;
-				guac_socket_reset(user_shm);
-				break;
-			}
-			guac_socket_write(user_shm, buffer, size);
-		}
-	}
-
-    // WORKAROUND: kill the client process since Write Thread has exited
-	// Cleanup all the user related IO objects
-	CleanupUserIO(pConnectionUser, bOwner, user_shm, shared_memory_name);
-
-    // Wait for the read thread to finish
-    read_thread.join();
+   // The client input is relayed to the shared memory by the IO service threads,
+   // while this thread relays the shared memory output to the client
+   GuacLogger::GetInstance()->Debug() << "Starting User Relay [" << GetProcessHandlerID() << "]";
+   GuacMetrics::GetInstance()->RegisterRelay(GetProcessHandlerID(), relay);
+   relay->Start();
+   relay->RunSharedMemoryToClient([this, pConnectionUser]()
+                                  {
+                                     return m_bIsProcessRunning && m_ClientChildProcess &&
+                                            m_ClientChildProcess->running() &&
+                                            pConnectionUser->IsGuacConnectionRunning();
+                                  });
+   GuacMetrics::GetInstance()->UnregisterRelay(relay);
+   GuacLogger::GetInstance()->Debug() << "User Relay Ended [" << GetProcessHandlerID() << "]";
+
+   // WORKAROUND: kill the client process since the relay has ended
+   // Cleanup all the user related IO objects
+   CleanupUserIO(pConnectionUser, bOwner, shared_memory_name);
 }
 
 void
-GuacClientProcessHandler::CleanupUserIO(const GuacConnectionPtr & pConnectionUser, bool bOwner, guac_socket * pUserShm,
+GuacClientProcessHandler::CleanupUserIO(const GuacConnectionPtr & pConnectionUser, bool bOwner,
                                         const std::string & stSharedMemoryName)
 {
    // Check if the process is still running first, this means that the connection was closed
@@ -153,9 +113,6 @@ GuacClientProcessHandler::CleanupUserIO(const GuacConnectionPtr & pConnectionUse
       {
          GuacLogger::GetInstance()->Debug() << "Stopping Client Process [" << GetProcessHandlerID() << "]";
          StopProcess();
-
-         // Release the user shared memory  
-         guac_socket_free(pUserShm);
       }
       else
       {
@@ -163,14 +120,12 @@ GuacClientProcessHandler::CleanupUserIO(const GuacConnectionPtr & pConnectionUse
          // This is done on a different thread to avoid deadlocks of removal
          // It only needs the shared memory name to construct the command
          GuacLogger::GetInstance()->Debug() << "Removing Dead User [" << pConnectionUser->GetConnectionID() << "]";
-         boost::thread([this, stSharedMemoryName, pUserShm, pConnectionUser]()
+         boost::thread([this, stSharedMemoryName, pConnectionUser]()
                        {
                           boost::mutex::scoped_lock lock(m_ConnectionsMutex);
 
                           // Tell the child process to remove this connection
-                          std::string command =
-                                  std::string(REMOVE_USER_COMMAND) + COMMAND_DELIMITER + stSharedMemoryName;
-                          guac_socket_write(m_ShmSocket, command.c_str(), command.size());
+                          SendClientCommand(GuacControlMessageType::RemoveUser, stSharedMemoryName);
 
                           // Erase the connection from the vector
                           for(size_t i = 0; i < m_vecConnections.size(); i++)
@@ -181,9 +136,6 @@ GuacClientProcessHandler::CleanupUserIO(const GuacConnectionPtr & pConnectionUse
                                 break;
                              }
                           }
-
-                          // Release the user shared memory
-                          guac_socket_free(pUserShm);
                        });
       }
    }
@@ -191,44 +143,35 @@ GuacClientProcessHandler::CleanupUserIO(const GuacConnectionPtr & pConnectionUse
 
 bool GuacClientProcessHandler::SendClientParams()
 {
-   // Write the protocol needed params to the client process
-   // - Log Folder Path
-   // - Protocol Name
-   // - Libraries Folder Path
-   // - FPS
-   try
-   {
-      GuacLogger::GetInstance()->Debug() << "Child Process Started, Writing protocol to child ["
-                                         << GetProcessHandlerID() << "]";
-      GuacLogger::GetInstance()->Debug() << "Protocol is " << m_stProtocolName << " [" << GetProcessHandlerID() << "]";
-      GuacLogger::GetInstance()->Debug() << "Writing LogOutput Folder" << " [" << GetProcessHandlerID() << "]";
-      // If config says that there is no file log, then no log will happen on the child process
-      if(m_Config.IsWithFileLog())
-      {
-         guac_socket_write(m_ShmSocket, m_Config.GetGuacLogOutputFolder().c_str(),
-                           m_Config.GetGuacLogOutputFolder().size());
-      }
-      else
-      {
-         guac_socket_write(m_ShmSocket, std::string("NO_LOG").c_str(),
-                           m_Config.GetGuacLogOutputFolder().size());
-      }
-
-      GuacLogger::GetInstance()->Debug() << "Writing Protocol Name" << " [" << GetProcessHandlerID() << "]";
-      guac_socket_write(m_ShmSocket, m_stProtocolName.c_str(), m_stProtocolName.size());
-
-      GuacLogger::GetInstance()->Debug() << "Writing Libraries Folder" << " [" << GetProcessHandlerID() << "]";
-      guac_socket_write(m_ShmSocket, m_Config.GetGuacProtocolsLibrariesFolder().c_str(),
-                        m_Config.GetGuacProtocolsLibrariesFolder().size());
+   // The protocol needed params of the client process, sent as a single command
+   GuacClientParams params;
+
+   // If config says that there is no file log, then no log will happen on the child process
+   params.stLogFolder = m_Config.IsWithFileLog() ? m_Config.GetGuacLogOutputFolder() : "NO_LOG";
+   params.stProtocol = m_stProtocolName;
+   params.stLibraryFolder = m_Config.GetGuacProtocolsLibrariesFolder();
+   params.sFPS = m_Config.GetFPS();
+   params.sEncoderThreads = m_Config.GetEncoderThreads();
+   params.sTileCacheMB = m_Config.GetTileCacheMB();
+   params.sSendQueueMB = m_Config.GetSendQueueMB();
+   params.stSlowUserPolicy = m_Config.GetSlowUserPolicy();
+   params.sAudioAggregationMS = m_Config.GetAudioAggregationMS();
+   params.sRecordingBufferMB = m_Config.GetRecordingBufferMB();
+   params.stRecordingOverflowPolicy = m_Config.GetRecordingOverflowPolicy();
+   params.bWithRecordingCompression = m_Config.IsWithRecordingCompression();
+   params.sRecordingKeyframeIntervalSec = m_Config.GetRecordingKeyframeIntervalSec();
+
+   GuacLogger::GetInstance()->Debug() << "Child Process Started, Writing params to child ["
+                                      << GetProcessHandlerID() << "]";
+   GuacLogger::GetInstance()->Debug() << "Protocol is " << m_stProtocolName << " [" << GetProcessHandlerID() << "]";
 
-	  GuacLogger::GetInstance()->Debug() << "Writing FPS" << " [" << GetProcessHandlerID() << "]";
-	  guac_socket_write(m_ShmSocket, std::to_string(m_Config.GetFPS()).c_str(), std::to_string(m_Config.GetFPS()).size());
-   }
-   catch(...)
+   // The child acknowledges once it has applied the params and loaded the protocol plugin
+   if(!SendClientCommand(GuacControlMessageType::Params, params.Serialize(), CONTROL_PARAMS_TIMEOUT_MS))
    {
-      GuacLogger::GetInstance()->Error() << "Could not write to child process [" << GetProcessHandlerID() << "]";
-      m_ClientChildProcess->terminate();
-      m_ClientChildProcess->wait();
+      GuacLogger::GetInstance()->Error() << "Child process failed to start [" << GetProcessHandlerID() << "]";
+      std::error_code ec;
+      m_ClientChildProcess->terminate(ec);
+      m_ClientChildProcess->wait(ec);
       delete m_ClientChildProcess;
       m_ClientChildProcess = nullptr;
       return false;
@@ -237,6 +180,22 @@ bool GuacClientProcessHandler::SendClientParams()
    return true;
 }
 
+bool GuacClientProcessHandler::SendClientCommand(GuacControlMessageType eType, const std::string & stPayload,
+                                                 int iTimeoutMS)
+{
+   GuacControlMessage ack;
+   bool result = m_ControlChannel->SendCommand(eType, stPayload, iTimeoutMS, ack);
+
+   if(!result)
+   {
+      GuacLogger::GetInstance()->Error() << "Child process did not acknowledge "
+                                         << GuacControlChannel::GetMessageTypeName(eType) << " : " << ack.stPayload
+                                         << " [" << GetProcessHandlerID() << "]";
+   }
+
+   return result;
+}
+
 bool GuacClientProcessHandler::RunProcess()
 {
    GuacLogger::GetInstance()->Debug() << "Starting child process for protocol " << m_stProtocolName << " ["
@@ -264,6 +223,8 @@ bool GuacClientProcessHandler::RunProcess()
          m_ClientChildProcess->join();
          return false;
       }
+
+      m_ControlChannel = new GuacControlChannel(m_ShmSocket);
    }
    catch(boost::process::process_error & err)
    {
@@ -287,6 +248,9 @@ bool GuacClientProcessHandler::RunProcess()
 bool GuacClientProcessHandler::StartProcess(const std::string & stProtocolName)
 {
    // Close an existing socket just incase
+   delete m_ControlChannel;
+   m_ControlChannel = nullptr;
+
    if(m_ShmSocket)
    {
       guac_socket_free(m_ShmSocket);
@@ -304,6 +268,7 @@ bool GuacClientProcessHandler::StartProcess(const std::string & stProtocolName)
    if(result)
    {
       m_bIsProcessRunning = true;
+      GuacMetrics::GetInstance()->RegisterProcessHandler(this);
    }
 
    return result;
@@ -311,8 +276,8 @@ bool GuacClientProcessHandler::StartProcess(const std::string & stProtocolName)
 
 bool GuacClientProcessHandler::StartConnectionUser(const GuacConnectionPtr & pConnectionUser)
 {
-   // Start the IO Thread for this user
-   GuacLogger::GetInstance()->Debug() << "Starting IO Thread [" << GetProcessHandlerID() << "]["
+   // Start the IO relay for this user
+   GuacLogger::GetInstance()->Debug() << "Starting User IO [" << GetProcessHandlerID() << "]["
                                       << pConnectionUser->GetConnectionID() << "]";
 
    // The owner is the first actual connection of this process
@@ -325,8 +290,8 @@ bool GuacClientProcessHandler::StartConnectionUser(const GuacConnectionPtr & pCo
    owner = true;
    GuacLogger::GetInstance()->Debug() << "Forcing ownership";
 
-   // Start the user IO 
-   IOThread(pConnectionUser, owner);
+   // Start the user IO, blocks until the user leaves
+   RelayUserIO(pConnectionUser, owner);
 
    return true;
 }
@@ -336,8 +301,16 @@ bool GuacClientProcessHandler::IsProcessRunning() const
    return m_bIsProcessRunning;
 }
 
+bool GuacClientProcessHandler::IsProcessAlive() const
+{
+   return m_bIsProcessRunning && m_ClientChildProcess && m_ClientChildProcess->running();
+}
+
 bool GuacClientProcessHandler::StopProcess()
 {
+   // Waits for a scrape which is querying this process to end
+   GuacMetrics::GetInstance()->UnregisterProcessHandler(this);
+
    if(m_bIsProcessRunning)
    {
       GuacLogger::GetInstance()->Debug() << "Stopping Process  [" << GetProcessHandlerID() << "]";
@@ -347,10 +320,12 @@ bool GuacClientProcessHandler::StopProcess()
       if(m_ClientChildProcess && m_ClientChildProcess->running())
       {
          std::error_code ec;
-         // Send stop command and wait for process to end
+         // Send stop command and wait for process to end, a process which does not acknowledge it is killed
          GuacLogger::GetInstance()->Debug() << "Sending STOP to child process [" << GetProcessHandlerID() << "]";
-         std::string command = std::string(STOP_PROCESS_COMMAND) + COMMAND_DELIMITER;
-         guac_socket_write(m_ShmSocket, command.c_str(), command.size());
+         if(!SendClientCommand(GuacControlMessageType::Stop, ""))
+         {
+            m_ClientChildProcess->terminate(ec);
+         }
 
          // Wait for the child process to end after the stop command and clean it
          GuacLogger::GetInstance()->Debug() << "Waiting for child process to end [" << GetProcessHandlerID() << "]";
@@ -387,4 +362,31 @@ std::string GuacClientProcessHandler::GetProcessHandlerID() const
 void GuacClientProcessHandler::SetGuacConfig(const GuacConfig & rConfig)
 {
    m_Config = rConfig;
-}
\ No newline at end of file
+}
+
+std::map<GuacControlMessageType, GuacControlCommandStats> GuacClientProcessHandler::GetControlCommandStats() const
+{
+   if(!m_ControlChannel)
+   {
+      return std::map<GuacControlMessageType, GuacControlCommandStats>();
+   }
+
+   return m_ControlChannel->GetCommandStats();
+}
+
+bool GuacClientProcessHandler::CollectClientMetrics(std::string & rOutMetrics)
+{
+   if(!IsProcessAlive() || !m_ControlChannel)
+   {
+      return false;
+   }
+
+   GuacControlMessage ack;
+   if(!m_ControlChannel->SendCommand(GuacControlMessageType::Metrics, "", CONTROL_METRICS_TIMEOUT_MS, ack))
+   {
+      return false;
+   }
+
+   rOutMetrics = ack.stPayload;
+   return true;
+}
@@ -86,29 +86,40 @@ GuacClientProcessHandlerPtr GuacClientProcessHandlerMap::CreateProcessHandler()
 {
    GuacClientProcessHandlerPtr process(new GuacClientProcessHandler());
 
-   guac_common_list * bucket = GetBucket(process->GetProcessHandlerID());
+   if(AddProcessHandler(process))
+   {
+      return process;
+   }
+
+   delete process;
+   return GuacClientProcessHandlerPtr();
+}
+
+bool GuacClientProcessHandlerMap::AddProcessHandler(const GuacClientProcessHandlerPtr & pProcess)
+{
+   guac_common_list * bucket = GetBucket(pProcess->GetProcessHandlerID());
 
    guac_common_list_lock(bucket);
 
-   guac_common_list_element * found = GetBucketElement(bucket, process->GetProcessHandlerID());
+   guac_common_list_element * found = GetBucketElement(bucket, pProcess->GetProcessHandlerID());
 
    // If not found, that means the process can be added to the bucket
    if(!found)
    {
-      GuacLogger::GetInstance()->Debug() << "Creating new process with ID " << process->GetProcessHandlerID();
-      guac_common_list_add(bucket, process);
+      GuacLogger::GetInstance()->Debug() << "Adding process with ID " << pProcess->GetProcessHandlerID();
+      guac_common_list_add(bucket, pProcess);
       guac_common_list_unlock(bucket);
 
       // Notify observers
       for(auto && obs : m_Observers)
       {
-         obs->OnClientProcessCreated(process->GetProcessHandlerID());
+         obs->OnClientProcessCreated(pProcess->GetProcessHandlerID());
       }
 
-      return process;
+      return true;
    }
    guac_common_list_unlock(bucket);
-   return GuacClientProcessHandlerPtr();
+   return false;
 }
 
 GuacClientProcessHandlerPtr GuacClientProcessHandlerMap::RetrieveProcessHandler(const std::string & stID)
@@ -0,0 +1,174 @@
+//
+// Pool of pre-started client processes
+//
+
+#include <guacservice/GuacClientProcessPool.h>
+
+GuacClientProcessPool::GuacClientProcessPool() : m_ReplenishThread(nullptr), m_bIsPoolRunning(false)
+{
+}
+
+GuacClientProcessPool::~GuacClientProcessPool()
+{
+   StopPool();
+}
+
+boost::shared_ptr<GuacClientProcessPool> GuacClientProcessPool::GetInstance()
+{
+   static boost::shared_ptr<GuacClientProcessPool> pool(new GuacClientProcessPool());
+   return pool;
+}
+
+GuacClientProcessHandlerPtr GuacClientProcessPool::StartIdleProcess()
+{
+   GuacClientProcessHandlerPtr process(new GuacClientProcessHandler());
+   process->SetGuacConfig(m_Config);
+
+   GuacLogger::GetInstance()->Debug() << "Starting pooled process for protocol " << m_Config.GetProcessPoolProtocol()
+                                      << " [" << process->GetProcessHandlerID() << "]";
+
+   // Blocks until the child process has read all its parameters
+   if(!process->StartProcess(m_Config.GetProcessPoolProtocol()))
+   {
+      GuacLogger::GetInstance()->Error() << "Could not start pooled process [" << process->GetProcessHandlerID()
+                                         << "]";
+      delete process;
+      return nullptr;
+   }
+
+   return process;
+}
+
+void GuacClientProcessPool::ReplenishThread()
+{
+   boost::mutex::scoped_lock lock(m_PoolMutex);
+
+   while(m_bIsPoolRunning)
+   {
+      // Wait until a process was taken out of the pool
+      if(m_IdleProcesses.size() >= static_cast<size_t>(m_Config.GetProcessPoolSize()))
+      {
+         m_PoolCondition.wait(lock);
+         continue;
+      }
+
+      // Start the process without holding the lock, so connections can keep taking processes meanwhile
+      lock.unlock();
+      GuacClientProcessHandlerPtr process = StartIdleProcess();
+      lock.lock();
+
+      if(!process)
+      {
+         // Do not spin on a broken configuration, retry later
+         m_PoolCondition.timed_wait(lock, boost::posix_time::milliseconds(PROCESS_POOL_RETRY_DELAY_MS));
+         continue;
+      }
+
+      // The pool was stopped while the process was starting
+      if(!m_bIsPoolRunning)
+      {
+         lock.unlock();
+         delete process;
+         lock.lock();
+         break;
+      }
+
+      m_IdleProcesses.push_back(process);
+      GuacLogger::GetInstance()->Debug() << "Pooled process ready, " << m_IdleProcesses.size() << " idle ["
+                                         << process->GetProcessHandlerID() << "]";
+   }
+}
+
+void GuacClientProcessPool::StartPool(const GuacConfig & rConfig)
+{
+   boost::mutex::scoped_lock lock(m_PoolMutex);
+
+   if(m_bIsPoolRunning || rConfig.GetProcessPoolSize() <= 0)
+   {
+      return;
+   }
+
+   GuacLogger::GetInstance()->Debug() << "Starting process pool of " << rConfig.GetProcessPoolSize()
+                                      << " processes for protocol " << rConfig.GetProcessPoolProtocol();
+
+   m_Config = rConfig;
+   m_bIsPoolRunning = true;
+   m_ReplenishThread = new boost::thread(boost::bind(&GuacClientProcessPool::ReplenishThread, this));
+}
+
+void GuacClientProcessPool::StopPool()
+{
+   std::deque<GuacClientProcessHandlerPtr> idleProcesses;
+
+   {
+      boost::mutex::scoped_lock lock(m_PoolMutex);
+
+      if(!m_bIsPoolRunning)
+      {
+         return;
+      }
+
+      m_bIsPoolRunning = false;
+      idleProcesses.swap(m_IdleProcesses);
+      m_PoolCondition.notify_all();
+   }
+
+   // Wait for the replenish thread, which may be finishing the start of a process
+   m_ReplenishThread->join();
+   delete m_ReplenishThread;
+   m_ReplenishThread = nullptr;
+
+   // Deleting the handler stops its process
+   GuacLogger::GetInstance()->Debug() << "Stopping " << idleProcesses.size() << " pooled processes";
+   for(auto && process : idleProcesses)
+   {
+      delete process;
+   }
+}
+
+GuacClientProcessHandlerPtr GuacClientProcessPool::AcquireProcessHandler(const std::string & stProtocolName)
+{
+   std::deque<GuacClientProcessHandlerPtr> deadProcesses;
+   GuacClientProcessHandlerPtr process = nullptr;
+
+   {
+      boost::mutex::scoped_lock lock(m_PoolMutex);
+
+      if(!m_bIsPoolRunning || stProtocolName != m_Config.GetProcessPoolProtocol())
+      {
+         return nullptr;
+      }
+
+      // Take the oldest idle process, skipping any which died while waiting
+      while(!m_IdleProcesses.empty() && !process)
+      {
+         GuacClientProcessHandlerPtr idle = m_IdleProcesses.front();
+         m_IdleProcesses.pop_front();
+
+         if(idle->IsProcessAlive())
+         {
+            process = idle;
+         }
+         else
+         {
+            deadProcesses.push_back(idle);
+         }
+      }
+
+      // Wake the replenish thread to replace whatever was taken
+      m_PoolCondition.notify_all();
+   }
+
+   for(auto && dead : deadProcesses)
+   {
+      GuacLogger::GetInstance()->Error() << "Discarding dead pooled process [" << dead->GetProcessHandlerID() << "]";
+      delete dead;
+   }
+
+   if(process)
+   {
+      GuacLogger::GetInstance()->Debug() << "Acquired pooled process [" << process->GetProcessHandlerID() << "]";
+   }
+
+   return process;
+}
@@ -9,7 +9,8 @@ GuacClientUser::GuacClientUser(guac_user * pUser, const std::string & stShmName)
           m_ImageMimeTypes(nullptr), m_bIsRunning(false)
 {
    m_Parser = guac_parser_alloc();
-   m_User->socket = guac_socket_shared_memory_socket_join(m_stShmName, true, true);
+   m_User->socket = guac_socket_shared_memory_socket_join(m_stShmName, true, true,
+                                                                  GUAC_SHARED_MEMORY_USER_RING_BUFFER);
 }
 
 void GuacClientUser::IOThread()
@@ -24,6 +24,20 @@ void GuacConfig::ResetToDefault()
    m_stSSLCertFilePath = "./cert.crt";
    m_stSSLDiffieHellmanPEMFilePath = "./dh512.pem";
    m_sFPS = 30;
+   m_sEncoderThreads = 2;
+   m_sTileCacheMB = 16;
+   m_sSendQueueMB = 8;
+   m_stSlowUserPolicy = "resync";
+   m_sAudioAggregationMS = 60;
+   m_sProcessPoolSize = 2;
+   m_stProcessPoolProtocol = "rdp";
+   m_sIOThreads = 0;
+   m_stMetricsBindHost = "127.0.0.1";
+   m_sMetricsPort = 0;
+   m_sRecordingBufferMB = 16;
+   m_stRecordingOverflowPolicy = "block";
+   m_bWithRecordingCompression = false;
+   m_sRecordingKeyframeIntervalSec = 0;
 }
 
 void GuacConfig::SetWithSSL(bool bWithSSL)
@@ -120,6 +134,76 @@ void GuacConfig::SetFPS(short sFPS)
    m_sFPS = sFPS;
 }
 
+void GuacConfig::SetEncoderThreads(short sEncoderThreads)
+{
+   m_sEncoderThreads = sEncoderThreads;
+}
+
+void GuacConfig::SetTileCacheMB(short sTileCacheMB)
+{
+   m_sTileCacheMB = sTileCacheMB;
+}
+
+void GuacConfig::SetSendQueueMB(short sSendQueueMB)
+{
+   m_sSendQueueMB = sSendQueueMB;
+}
+
+void GuacConfig::SetSlowUserPolicy(const std::string & stSlowUserPolicy)
+{
+   m_stSlowUserPolicy = stSlowUserPolicy;
+}
+
+void GuacConfig::SetAudioAggregationMS(short sAudioAggregationMS)
+{
+   m_sAudioAggregationMS = sAudioAggregationMS;
+}
+
+void GuacConfig::SetProcessPoolSize(short sProcessPoolSize)
+{
+   m_sProcessPoolSize = sProcessPoolSize;
+}
+
+void GuacConfig::SetProcessPoolProtocol(const std::string & stProcessPoolProtocol)
+{
+   m_stProcessPoolProtocol = stProcessPoolProtocol;
+}
+
+void GuacConfig::SetIOThreads(short sIOThreads)
+{
+   m_sIOThreads = sIOThreads;
+}
+
+void GuacConfig::SetMetricsBindHost(const std::string & stMetricsBindHost)
+{
+   m_stMetricsBindHost = stMetricsBindHost;
+}
+
+void GuacConfig::SetMetricsPort(short sMetricsPort)
+{
+   m_sMetricsPort = sMetricsPort;
+}
+
+void GuacConfig::SetRecordingBufferMB(short sRecordingBufferMB)
+{
+   m_sRecordingBufferMB = sRecordingBufferMB;
+}
+
+void GuacConfig::SetRecordingOverflowPolicy(const std::string & stRecordingOverflowPolicy)
+{
+   m_stRecordingOverflowPolicy = stRecordingOverflowPolicy;
+}
+
+void GuacConfig::SetWithRecordingCompression(bool bWithRecordingCompression)
+{
+   m_bWithRecordingCompression = bWithRecordingCompression;
+}
+
+void GuacConfig::SetRecordingKeyframeIntervalSec(short sRecordingKeyframeIntervalSec)
+{
+   m_sRecordingKeyframeIntervalSec = sRecordingKeyframeIntervalSec;
+}
+
 bool GuacConfig::IsWithSSL() const
 {
    return m_bWithSSL;
@@ -184,3 +268,73 @@ short GuacConfig::GetFPS() const
 {
    return m_sFPS;
 }
+
+short GuacConfig::GetEncoderThreads() const
+{
+   return m_sEncoderThreads;
+}
+
+short GuacConfig::GetTileCacheMB() const
+{
+   return m_sTileCacheMB;
+}
+
+short GuacConfig::GetSendQueueMB() const
+{
+   return m_sSendQueueMB;
+}
+
+const std::string & GuacConfig::GetSlowUserPolicy() const
+{
+   return m_stSlowUserPolicy;
+}
+
+short GuacConfig::GetAudioAggregationMS() const
+{
+   return m_sAudioAggregationMS;
+}
+
+short GuacConfig::GetProcessPoolSize() const
+{
+   return m_sProcessPoolSize;
+}
+
+const std::string & GuacConfig::GetProcessPoolProtocol() const
+{
+   return m_stProcessPoolProtocol;
+}
+
+short GuacConfig::GetIOThreads() const
+{
+   return m_sIOThreads;
+}
+
+const std::string & GuacConfig::GetMetricsBindHost() const
+{
+   return m_stMetricsBindHost;
+}
+
+short GuacConfig::GetMetricsPort() const
+{
+   return m_sMetricsPort;
+}
+
+short GuacConfig::GetRecordingBufferMB() const
+{
+   return m_sRecordingBufferMB;
+}
+
+const std::string & GuacConfig::GetRecordingOverflowPolicy() const
+{
+   return m_stRecordingOverflowPolicy;
+}
+
+bool GuacConfig::IsWithRecordingCompression() const
+{
+   return m_bWithRecordingCompression;
+}
+
+short GuacConfig::GetRecordingKeyframeIntervalSec() const
+{
+   return m_sRecordingKeyframeIntervalSec;
+}
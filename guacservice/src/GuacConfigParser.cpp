@@ -17,6 +17,20 @@ bool GuacConfigParser::JSONTreeToConfig(const JSONTree & rTree, GuacConfig & rOu
    rOutConfig.SetSSLCertFilePath(rTree.get<std::string>("SSLCertFilePath", "./cert.crt"));
    rOutConfig.SetSSLDiffieHellmanPEMFilePath(rTree.get<std::string>("SSLDiffieHellmanPEMFilePath", "./dh512.pem"));
    rOutConfig.SetFPS(rTree.get<short>("FPS", 30));
+   rOutConfig.SetEncoderThreads(rTree.get<short>("EncoderThreads", 2));
+   rOutConfig.SetTileCacheMB(rTree.get<short>("TileCacheMB", 16));
+   rOutConfig.SetSendQueueMB(rTree.get<short>("SendQueueMB", 8));
+   rOutConfig.SetSlowUserPolicy(rTree.get<std::string>("SlowUserPolicy", "resync"));
+   rOutConfig.SetAudioAggregationMS(rTree.get<short>("AudioAggregationMS", 60));
+   rOutConfig.SetProcessPoolSize(rTree.get<short>("ProcessPoolSize", 2));
+   rOutConfig.SetProcessPoolProtocol(rTree.get<std::string>("ProcessPoolProtocol", "rdp"));
+   rOutConfig.SetIOThreads(rTree.get<short>("IOThreads", 0));
+   rOutConfig.SetMetricsBindHost(rTree.get<std::string>("MetricsBindHost", "127.0.0.1"));
+   rOutConfig.SetMetricsPort(rTree.get<short>("MetricsPort", 0));
+   rOutConfig.SetRecordingBufferMB(rTree.get<short>("RecordingBufferMB", 16));
+   rOutConfig.SetRecordingOverflowPolicy(rTree.get<std::string>("RecordingOverflowPolicy", "block"));
+   rOutConfig.SetWithRecordingCompression(rTree.get<bool>("WithRecordingCompression", false));
+   rOutConfig.SetRecordingKeyframeIntervalSec(rTree.get<short>("RecordingKeyframeIntervalSec", 0));
 
    return true;
 }
@@ -37,6 +51,20 @@ bool GuacConfigParser::ConfigToJSONTree(const GuacConfig & rConfig, JSONTree & r
    rOutTree.put("SSLCertFilePath", rConfig.GetSSLCertFilePath());
    rOutTree.put("SSLDiffieHellmanPEMFilePath", rConfig.GetSSLDiffieHellmanPEMFilePath());
    rOutTree.put("FPS", rConfig.GetFPS());
+   rOutTree.put("EncoderThreads", rConfig.GetEncoderThreads());
+   rOutTree.put("TileCacheMB", rConfig.GetTileCacheMB());
+   rOutTree.put("SendQueueMB", rConfig.GetSendQueueMB());
+   rOutTree.put("SlowUserPolicy", rConfig.GetSlowUserPolicy());
+   rOutTree.put("AudioAggregationMS", rConfig.GetAudioAggregationMS());
+   rOutTree.put("ProcessPoolSize", rConfig.GetProcessPoolSize());
+   rOutTree.put("ProcessPoolProtocol", rConfig.GetProcessPoolProtocol());
+   rOutTree.put("IOThreads", rConfig.GetIOThreads());
+   rOutTree.put("MetricsBindHost", rConfig.GetMetricsBindHost());
+   rOutTree.put("MetricsPort", rConfig.GetMetricsPort());
+   rOutTree.put("RecordingBufferMB", rConfig.GetRecordingBufferMB());
+   rOutTree.put("RecordingOverflowPolicy", rConfig.GetRecordingOverflowPolicy());
+   rOutTree.put("WithRecordingCompression", rConfig.IsWithRecordingCompression());
+   rOutTree.put("RecordingKeyframeIntervalSec", rConfig.GetRecordingKeyframeIntervalSec());
 
    return true;
 }
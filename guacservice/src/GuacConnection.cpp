@@ -40,10 +40,26 @@ GuacClientProcessHandlerPtr GuacConnection::GetClientProcess(bool & bNewProcess)
    else
    {
       bNewProcess = true;
-      // Process will be created
-      GuacLogger::GetInstance()->Debug() << "Creating new process for protocol " << id << " [" << GetConnectionID()
-                                         << "]";
-      process = GuacClientProcessHandlerMap::GetInstance()->CreateProcessHandler();
+
+      // Prefer a pooled process, which has already started and loaded the protocol plugin
+      process = GuacClientProcessPool::GetInstance()->AcquireProcessHandler(id);
+      if(process)
+      {
+         GuacLogger::GetInstance()->Debug() << "Using pooled process for protocol " << id << " [" << GetConnectionID()
+                                            << "]";
+         if(!GuacClientProcessHandlerMap::GetInstance()->AddProcessHandler(process))
+         {
+            delete process;
+            process = GuacClientProcessHandlerPtr();
+         }
+      }
+      else
+      {
+         // Process will be created
+         GuacLogger::GetInstance()->Debug() << "Creating new process for protocol " << id << " [" << GetConnectionID()
+                                            << "]";
+         process = GuacClientProcessHandlerMap::GetInstance()->CreateProcessHandler();
+      }
    }
 
    return process;
@@ -116,8 +132,8 @@ void GuacConnection::ConnectionThread()
       GuacLogger::GetInstance()->Debug() << "Starting new process for protocol " << protocolName << " ["
                                          << GetConnectionID() << "]";
 
-      // Start the process
-	  if (m_ClientProcessHandler->StartProcess(m_GuacParser->argv[0]))
+      // Start the process, unless it was already started by the pool
+	  if (m_ClientProcessHandler->IsProcessRunning() || m_ClientProcessHandler->StartProcess(m_GuacParser->argv[0]))
 	  {
 		  m_ClientProcessHandler->StartConnectionUser(GuacConnectionPtr(this));
 
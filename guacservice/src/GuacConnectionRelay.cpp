@@ -0,0 +1,227 @@
+//
+// Asynchronous relay between a connection socket and its user shared memory
+//
+
+#include <guacservice/GuacConnectionRelay.h>
+
+GuacConnectionRelay::GuacConnectionRelay(const IGuacConnectionSocketPtr & pConnectionSocket, guac_socket * pUserShm,
+                                         const std::string & stConnectionID)
+        : m_ConnectionSocket(pConnectionSocket), m_UserShm(pUserShm), m_stConnectionID(stConnectionID),
+          m_bIsWritePending(false), m_bIsRelayRunning(false), m_sPendingOffset(0), m_sPendingSize(0),
+          m_uBytesReceived(0), m_uBytesSent(0)
+{
+}
+
+GuacConnectionRelay::~GuacConnectionRelay()
+{
+   guac_socket_free(m_UserShm);
+}
+
+void GuacConnectionRelay::Start()
+{
+   {
+      boost::mutex::scoped_lock lock(m_RelayMutex);
+      m_bIsRelayRunning = true;
+   }
+
+   ReadFromClient();
+}
+
+void GuacConnectionRelay::ReadFromClient()
+{
+   // The handler keeps the relay, and with it the shared memory, alive until the read ends
+   GuacConnectionRelayPtr self = shared_from_this();
+   m_ConnectionSocket->AsyncReadSome(m_ClientReadBuffer, SOCKET_BUFFER_SIZE,
+                                     [self](const boost::system::error_code & rErrorCode, size_t sSize)
+                                     {
+                                        self->OnClientRead(rErrorCode, sSize);
+                                     });
+}
+
+void GuacConnectionRelay::OnClientRead(const boost::system::error_code & rErrorCode, size_t sSize)
+{
+   if(rErrorCode)
+   {
+      if(IsRelayRunning())
+      {
+         GuacLogger::GetInstance()->Error() << "Exception on client read - " << rErrorCode.message() << " ["
+                                            << m_stConnectionID << "]";
+      }
+      Stop();
+      return;
+   }
+
+   if(!IsRelayRunning())
+   {
+      return;
+   }
+
+   m_sPendingOffset = 0;
+   m_sPendingSize = sSize;
+   WriteToSharedMemory();
+}
+
+void GuacConnectionRelay::WriteToSharedMemory()
+{
+   // Waiting for the client process to make room would hold an IO thread, so only what fits is written
+   while(m_sPendingOffset < m_sPendingSize)
+   {
+      size_t size = guac_socket_shared_memory_socket_try_write(m_UserShm, m_ClientReadBuffer + m_sPendingOffset,
+                                                               m_sPendingSize - m_sPendingOffset);
+      if(size == static_cast<size_t>(-1))
+      {
+         GuacLogger::GetInstance()->Error() << "Exception on shared memory write [" << m_stConnectionID << "]";
+         Stop();
+         return;
+      }
+
+      if(size == 0)
+      {
+         break;
+      }
+
+      m_sPendingOffset += size;
+   }
+
+   // The shared memory is full, retry once the client process had time to read, the next read waits until then
+   if(m_sPendingOffset < m_sPendingSize)
+   {
+      GuacConnectionRelayPtr self = shared_from_this();
+      m_ConnectionSocket->AsyncWait(RELAY_WRITE_RETRY_MS, [self](const boost::system::error_code & rErrorCode)
+      {
+         if(rErrorCode || !self->IsRelayRunning())
+         {
+            self->Stop();
+            return;
+         }
+
+         self->WriteToSharedMemory();
+      });
+      return;
+   }
+
+   m_uBytesReceived += m_sPendingSize;
+   ReadFromClient();
+}
+
+bool GuacConnectionRelay::WriteToClient(const std::vector<boost::asio::const_buffer> & vecBuffers)
+{
+   {
+      boost::mutex::scoped_lock lock(m_RelayMutex);
+      m_bIsWritePending = true;
+   }
+
+   GuacConnectionRelayPtr self = shared_from_this();
+   m_ConnectionSocket->AsyncWriteAll(vecBuffers, [self](const boost::system::error_code & rErrorCode, size_t sSize)
+   {
+      boost::mutex::scoped_lock lock(self->m_RelayMutex);
+      self->m_WriteError = rErrorCode;
+      self->m_bIsWritePending = false;
+      self->m_RelayCondition.notify_all();
+   });
+
+   // The buffers point into the shared memory, which may only be released once they were sent
+   boost::mutex::scoped_lock lock(m_RelayMutex);
+   while(m_bIsWritePending)
+   {
+      m_RelayCondition.wait(lock);
+   }
+
+   if(m_WriteError)
+   {
+      return false;
+   }
+
+   m_uBytesSent += boost::asio::buffer_size(vecBuffers);
+   return true;
+}
+
+void GuacConnectionRelay::RunSharedMemoryToClient(const boost::function<bool()> & rIsRunning)
+{
+   // Keep reading from the shared memory socket and writing to the client connection socket
+   // We select the user shared memory to not overload trying to read, CPU efficent
+   while(IsRelayRunning() && rIsRunning())
+   {
+      if(guac_socket_select(m_UserShm, RELAY_STOP_CHECK_MS) <= 0)
+      {
+         continue;
+      }
+
+      // On a ring buffer the readable data is passed in place to the connection as a gathered write,
+      // and only released to the writer once it was sent
+      const char * first;
+      const char * second;
+      size_t first_size;
+      size_t second_size;
+      size_t spans_size = guac_socket_shared_memory_socket_peek_spans(m_UserShm, &first, &first_size,
+                                                                      &second, &second_size);
+      std::vector<boost::asio::const_buffer> vecBuffers;
+      if(spans_size > 0)
+      {
+         vecBuffers.emplace_back(first, first_size);
+         if(second_size > 0)
+         {
+            vecBuffers.emplace_back(second, second_size);
+         }
+      }
+      else
+      {
+         size_t size = guac_socket_read(m_UserShm, m_SharedMemoryReadBuffer, SOCKET_BUFFER_SIZE);
+         if(size == 0 || size == static_cast<size_t>(-1))
+         {
+            continue;
+         }
+         vecBuffers.emplace_back(m_SharedMemoryReadBuffer, size);
+      }
+
+      if(!WriteToClient(vecBuffers))
+      {
+         GuacLogger::GetInstance()->Error() << "Exception on client write [" << m_stConnectionID << "]";
+         break;
+      }
+
+      if(spans_size > 0)
+      {
+         guac_socket_shared_memory_socket_commit_read(m_UserShm, spans_size);
+      }
+   }
+
+   Stop();
+}
+
+void GuacConnectionRelay::Stop()
+{
+   boost::mutex::scoped_lock lock(m_RelayMutex);
+   m_bIsRelayRunning = false;
+}
+
+bool GuacConnectionRelay::IsRelayRunning()
+{
+   boost::mutex::scoped_lock lock(m_RelayMutex);
+   return m_bIsRelayRunning;
+}
+
+std::string GuacConnectionRelay::GetConnectionID() const
+{
+   return m_stConnectionID;
+}
+
+uint64_t GuacConnectionRelay::GetBytesReceived() const
+{
+   return m_uBytesReceived;
+}
+
+uint64_t GuacConnectionRelay::GetBytesSent() const
+{
+   return m_uBytesSent;
+}
+
+size_t GuacConnectionRelay::GetPendingOutputBytes() const
+{
+   // Peeking does not consume anything, so it is safe next to the relaying thread
+   const char * first;
+   const char * second;
+   size_t first_size;
+   size_t second_size;
+   return guac_socket_shared_memory_socket_peek_spans(m_UserShm, &first, &first_size, &second, &second_size);
+}
@@ -1,10 +1,10 @@
 #include <guacservice/GuacConnectionSSLSocket.h>
 #include "guacservice/GuacConnectionTCPSocket.h"
 
-GuacConnectionSSLSocket::GuacConnectionSSLSocket(const std::string & stPEMFile, const std::string & stCertFile,
-                                                 const std::string & stDHPEMFile)
-        : m_GuacSocket(nullptr), m_stPEMFile(stPEMFile), m_stCertFile(stCertFile), m_stDHPEMFile(stDHPEMFile),
-          m_CurrentSSLContext(nullptr)
+GuacConnectionSSLSocket::GuacConnectionSSLSocket(boost::asio::io_service & rIOService, const std::string & stPEMFile,
+                                                 const std::string & stCertFile, const std::string & stDHPEMFile)
+        : m_stPEMFile(stPEMFile), m_stCertFile(stCertFile), m_stDHPEMFile(stDHPEMFile), m_IOService(rIOService),
+          m_Strand(rIOService), m_GuacSocket(nullptr), m_CurrentSSLContext(nullptr)
 {
 
 }
@@ -24,7 +24,7 @@ void GuacConnectionSSLSocket::CreateSSLContext(boost::system::error_code & rOutE
    }
 
    // Create the context and fill it
-   m_CurrentSSLContext = new boost::asio::ssl::context(m_IOService, boost::asio::ssl::context::sslv23_server);
+   m_CurrentSSLContext = new boost::asio::ssl::context(boost::asio::ssl::context::sslv23_server);
    m_CurrentSSLContext->set_options(boost::asio::ssl::context::default_workarounds
                                     | boost::asio::ssl::context::no_sslv2
                                     | boost::asio::ssl::context::single_dh_use, rOutErrorCode);
@@ -47,56 +47,57 @@ void GuacConnectionSSLSocket::CreateSSLContext(boost::system::error_code & rOutE
    }
 }
 
-void GuacConnectionSSLSocket::WaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor,
-                                            boost::system::error_code & rErrorCode)
+void GuacConnectionSSLSocket::AsyncWaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor,
+                                                 const GuacSocketHandler & rHandler)
 {
+   boost::system::error_code ec;
+
    // Create the socket and close the old one if open
    if(IsSocketOpened())
    {
-      CloseSocket(rErrorCode);
+      CloseSocket(ec);
    }
 
-   CreateSSLContext(rErrorCode);
+   CreateSSLContext(ec);
 
-   if(!rErrorCode)
+   if(ec)
    {
-      m_Socket.reset(new SSLSocket(m_IOService, *m_CurrentSSLContext));
+      m_IOService.post(boost::bind(rHandler, ec));
+      return;
+   }
 
-      // Wait for new connection
-      pAcceptor->accept(m_Socket->lowest_layer(), rErrorCode);
+   m_Socket.reset(new SSLSocket(m_IOService, *m_CurrentSSLContext));
 
-      if(!rErrorCode)
-      {
-         // Clear the error just incase
-         rErrorCode.clear();
-      }
-   }
+   // Wait for new connection
+   pAcceptor->async_accept(m_Socket->lowest_layer(), rHandler);
 }
 
-void GuacConnectionSSLSocket::EstablishSocket(boost::system::error_code & rErrorCode)
-{
-   // Handle SSL handshake
-   m_Socket->handshake(boost::asio::ssl::stream_base::server, rErrorCode);
-
-   if(!rErrorCode)
-   {
-      // Open the guac socket
-      m_GuacSocket = guac_socket_boost_tcp_socket(m_Socket);
-      if(m_GuacSocket)
-      {
-         // Clear the error just incase
-         rErrorCode.clear();
-      }
-      else
-      {
-         m_Socket->lowest_layer().close();
-         rErrorCode.assign(boost::system::errc::no_buffer_space, boost::system::system_category());
-      }
-   }
-   else
-   {
-      m_Socket->lowest_layer().close();
-   }
+void GuacConnectionSSLSocket::AsyncEstablishSocket(const GuacSocketHandler & rHandler)
+{
+   // Handle SSL handshake, a slow client only holds its socket and not a thread while it negotiates
+   SSLSocketPtr socket = m_Socket;
+   m_Socket->async_handshake(boost::asio::ssl::stream_base::server,
+                             m_Strand.wrap([this, socket, rHandler](const boost::system::error_code & rHandshakeError)
+                                           {
+                                              boost::system::error_code ec = rHandshakeError;
+                                              if(!ec)
+                                              {
+                                                 // Open the guac socket
+                                                 m_GuacSocket = guac_socket_boost_tcp_socket(socket);
+                                                 if(!m_GuacSocket)
+                                                 {
+                                                    socket->lowest_layer().close();
+                                                    ec.assign(boost::system::errc::no_buffer_space,
+                                                              boost::system::system_category());
+                                                 }
+                                              }
+                                              else
+                                              {
+                                                 socket->lowest_layer().close();
+                                              }
+
+                                              rHandler(ec);
+                                           }));
 }
 
 void GuacConnectionSSLSocket::CloseSocket(boost::system::error_code & rErrorCode)
@@ -132,6 +133,16 @@ size_t GuacConnectionSSLSocket::ReadSome(char * pBuffer, size_t sSize)
    return m_Socket->read_some(boost::asio::buffer(pBuffer, sSize));
 }
 
+void GuacConnectionSSLSocket::AsyncReadSome(char * pBuffer, size_t sSize, const GuacSocketIOHandler & rHandler)
+{
+   // The SSL stream is not thread safe, all its operations run on its strand
+   SSLSocketPtr socket = m_Socket;
+   m_Strand.dispatch([this, socket, pBuffer, sSize, rHandler]()
+                     {
+                        socket->async_read_some(boost::asio::buffer(pBuffer, sSize), m_Strand.wrap(rHandler));
+                     });
+}
+
 size_t GuacConnectionSSLSocket::WriteSome(char * pBuffer, size_t sSize, boost::system::error_code & rErrorCode)
 {
    return m_Socket->write_some(boost::asio::buffer(pBuffer, sSize), rErrorCode);
@@ -152,6 +163,33 @@ size_t GuacConnectionSSLSocket::WriteAll(char * pBuffer, size_t sSize)
    return boost::asio::write(*m_Socket, boost::asio::buffer(pBuffer, sSize));
 }
 
+size_t GuacConnectionSSLSocket::WriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                                   boost::system::error_code & rErrorCode)
+{
+   return boost::asio::write(*m_Socket, vecBuffers, rErrorCode);
+}
+
+void GuacConnectionSSLSocket::AsyncWriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                                            const GuacSocketIOHandler & rHandler)
+{
+   SSLSocketPtr socket = m_Socket;
+   m_Strand.dispatch([this, socket, vecBuffers, rHandler]()
+                     {
+                        boost::asio::async_write(*socket, vecBuffers, m_Strand.wrap(rHandler));
+                     });
+}
+
+void GuacConnectionSSLSocket::AsyncWait(unsigned int uMilliseconds, const GuacSocketHandler & rHandler)
+{
+   // The handler keeps the timer alive until it expired
+   boost::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(m_IOService));
+   timer->expires_from_now(boost::posix_time::milliseconds(uMilliseconds));
+   timer->async_wait(m_Strand.wrap([timer, rHandler](const boost::system::error_code & rErrorCode)
+                                   {
+                                      rHandler(rErrorCode);
+                                   }));
+}
+
 bool GuacConnectionSSLSocket::IsSocketOpened() const
 {
    return m_Socket && m_Socket->lowest_layer().is_open();
@@ -1,7 +1,7 @@
 #include <guacservice/GuacConnectionTCPSocket.h>
 
-GuacConnectionTCPSocket::GuacConnectionTCPSocket()
-        : m_GuacSocket(nullptr)
+GuacConnectionTCPSocket::GuacConnectionTCPSocket(boost::asio::io_service & rIOService)
+        : m_IOService(rIOService), m_Strand(rIOService), m_GuacSocket(nullptr)
 {
 
 }
@@ -12,40 +12,35 @@ GuacConnectionTCPSocket::~GuacConnectionTCPSocket()
    CloseSocket(ec);
 }
 
-void GuacConnectionTCPSocket::WaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor,
-                                            boost::system::error_code & rErrorCode)
+void GuacConnectionTCPSocket::AsyncWaitForSocket(boost::asio::ip::tcp::acceptor * pAcceptor,
+                                                 const GuacSocketHandler & rHandler)
 {
    // Create the socket and close the old one if open
    if(IsSocketOpened())
    {
-      CloseSocket(rErrorCode);
+      boost::system::error_code ec;
+      CloseSocket(ec);
    }
    m_Socket.reset(new TCPSocket(m_IOService));
 
    // Wait for new connection
-   pAcceptor->accept(*m_Socket, rErrorCode);
-
-   if(!rErrorCode)
-   {
-      // Clear the error just incase
-      rErrorCode.clear();
-   }
+   pAcceptor->async_accept(*m_Socket, rHandler);
 }
 
-void GuacConnectionTCPSocket::EstablishSocket(boost::system::error_code & rErrorCode)
+void GuacConnectionTCPSocket::AsyncEstablishSocket(const GuacSocketHandler & rHandler)
 {
+   boost::system::error_code ec;
+
    // Open the guac socket
    m_GuacSocket = guac_socket_boost_tcp_socket(m_Socket);
-   if(m_GuacSocket)
-   {
-      // Clear the error just incase
-      rErrorCode.clear();
-   }
-   else
+   if(!m_GuacSocket)
    {
       m_Socket->close();
-      rErrorCode.assign(boost::system::errc::no_buffer_space, boost::system::system_category());
+      ec.assign(boost::system::errc::no_buffer_space, boost::system::system_category());
    }
+
+   // Nothing to negotiate on plain TCP, complete from the IO service like any other asynchronous operation
+   m_IOService.post(boost::bind(rHandler, ec));
 }
 
 void GuacConnectionTCPSocket::CloseSocket(boost::system::error_code & rErrorCode)
@@ -75,6 +70,16 @@ size_t GuacConnectionTCPSocket::ReadSome(char * pBuffer, size_t sSize)
    return m_Socket->read_some(boost::asio::buffer(pBuffer, sSize));
 }
 
+void GuacConnectionTCPSocket::AsyncReadSome(char * pBuffer, size_t sSize, const GuacSocketIOHandler & rHandler)
+{
+   // All the operations of the socket run on its strand, so a read and a write never run concurrently
+   TCPSocketPtr socket = m_Socket;
+   m_Strand.dispatch([this, socket, pBuffer, sSize, rHandler]()
+                     {
+                        socket->async_read_some(boost::asio::buffer(pBuffer, sSize), m_Strand.wrap(rHandler));
+                     });
+}
+
 size_t GuacConnectionTCPSocket::WriteSome(char * pBuffer, size_t sSize, boost::system::error_code & rErrorCode)
 {
    return m_Socket->write_some(boost::asio::buffer(pBuffer, sSize), rErrorCode);
@@ -95,6 +100,33 @@ size_t GuacConnectionTCPSocket::WriteAll(char * pBuffer, size_t sSize)
    return boost::asio::write(*m_Socket, boost::asio::buffer(pBuffer, sSize));
 }
 
+size_t GuacConnectionTCPSocket::WriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                                   boost::system::error_code & rErrorCode)
+{
+   return boost::asio::write(*m_Socket, vecBuffers, rErrorCode);
+}
+
+void GuacConnectionTCPSocket::AsyncWriteAll(const std::vector<boost::asio::const_buffer> & vecBuffers,
+                                            const GuacSocketIOHandler & rHandler)
+{
+   TCPSocketPtr socket = m_Socket;
+   m_Strand.dispatch([this, socket, vecBuffers, rHandler]()
+                     {
+                        boost::asio::async_write(*socket, vecBuffers, m_Strand.wrap(rHandler));
+                     });
+}
+
+void GuacConnectionTCPSocket::AsyncWait(unsigned int uMilliseconds, const GuacSocketHandler & rHandler)
+{
+   // The handler keeps the timer alive until it expired
+   boost::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(m_IOService));
+   timer->expires_from_now(boost::posix_time::milliseconds(uMilliseconds));
+   timer->async_wait(m_Strand.wrap([timer, rHandler](const boost::system::error_code & rErrorCode)
+                                   {
+                                      rHandler(rErrorCode);
+                                   }));
+}
+
 bool GuacConnectionTCPSocket::IsSocketOpened() const
 {
    return m_Socket && m_Socket->is_open();
@@ -0,0 +1,282 @@
+//
+// Framed request / response control protocol between guacservice and its client processes
+//
+
+#include <guacservice/GuacControlChannel.h>
+#include <guacservice/GuacDefines.h>
+#include <guacservice/GuacLogger.h>
+#include <guacamole/timestamp.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+   void WriteUInt16(std::string & rOut, uint16_t uValue)
+   {
+      rOut.push_back(static_cast<char>(uValue & 0xFF));
+      rOut.push_back(static_cast<char>((uValue >> 8) & 0xFF));
+   }
+
+   void WriteUInt32(std::string & rOut, uint32_t uValue)
+   {
+      WriteUInt16(rOut, static_cast<uint16_t>(uValue & 0xFFFF));
+      WriteUInt16(rOut, static_cast<uint16_t>(uValue >> 16));
+   }
+
+   uint16_t ReadUInt16(const std::string & stIn, size_t offset)
+   {
+      return static_cast<uint16_t>(static_cast<unsigned char>(stIn[offset]) |
+                                   (static_cast<unsigned char>(stIn[offset + 1]) << 8));
+   }
+
+   uint32_t ReadUInt32(const std::string & stIn, size_t offset)
+   {
+      return ReadUInt16(stIn, offset) | (static_cast<uint32_t>(ReadUInt16(stIn, offset + 2)) << 16);
+   }
+}
+
+std::string GuacClientParams::Serialize() const
+{
+   std::ostringstream payload;
+   payload << "LogFolder=" << stLogFolder << "\n"
+           << "Protocol=" << stProtocol << "\n"
+           << "LibraryFolder=" << stLibraryFolder << "\n"
+           << "FPS=" << sFPS << "\n"
+           << "EncoderThreads=" << sEncoderThreads << "\n"
+           << "TileCacheMB=" << sTileCacheMB << "\n"
+           << "SendQueueMB=" << sSendQueueMB << "\n"
+           << "SlowUserPolicy=" << stSlowUserPolicy << "\n"
+           << "AudioAggregationMS=" << sAudioAggregationMS << "\n"
+           << "RecordingBufferMB=" << sRecordingBufferMB << "\n"
+           << "RecordingOverflowPolicy=" << stRecordingOverflowPolicy << "\n"
+           << "WithRecordingCompression=" << bWithRecordingCompression << "\n"
+           << "RecordingKeyframeIntervalSec=" << sRecordingKeyframeIntervalSec << "\n";
+   return payload.str();
+}
+
+bool GuacClientParams::Deserialize(const std::string & stPayload)
+{
+   std::map<std::string, std::string> values;
+   std::vector<std::string> lines;
+   boost::split(lines, stPayload, boost::is_any_of("\n"));
+
+   for(auto && line : lines)
+   {
+      size_t separator = line.find('=');
+      if(separator != std::string::npos)
+      {
+         values[line.substr(0, separator)] = line.substr(separator + 1);
+      }
+   }
+
+   try
+   {
+      stLogFolder = values.at("LogFolder");
+      stProtocol = values.at("Protocol");
+      stLibraryFolder = values.at("LibraryFolder");
+      sFPS = boost::lexical_cast<short>(values.at("FPS"));
+      sEncoderThreads = boost::lexical_cast<short>(values.at("EncoderThreads"));
+      sTileCacheMB = boost::lexical_cast<short>(values.at("TileCacheMB"));
+      sSendQueueMB = boost::lexical_cast<short>(values.at("SendQueueMB"));
+      stSlowUserPolicy = values.at("SlowUserPolicy");
+      sAudioAggregationMS = boost::lexical_cast<short>(values.at("AudioAggregationMS"));
+      sRecordingBufferMB = boost::lexical_cast<short>(values.at("RecordingBufferMB"));
+      stRecordingOverflowPolicy = values.at("RecordingOverflowPolicy");
+      bWithRecordingCompression = boost::lexical_cast<bool>(values.at("WithRecordingCompression"));
+      sRecordingKeyframeIntervalSec = boost::lexical_cast<short>(values.at("RecordingKeyframeIntervalSec"));
+   }
+   catch(...)
+   {
+      return false;
+   }
+
+   return !stLogFolder.empty() && !stProtocol.empty() && !stLibraryFolder.empty() && !stSlowUserPolicy.empty() &&
+          !stRecordingOverflowPolicy.empty();
+}
+
+GuacControlChannel::GuacControlChannel(guac_socket * pSocket) : m_Socket(pSocket), m_uNextSequence(1)
+{
+}
+
+bool GuacControlChannel::SendMessage(const GuacControlMessage & rMessage)
+{
+   if(rMessage.stPayload.size() > CONTROL_FRAME_MAX_PAYLOAD)
+   {
+      return false;
+   }
+
+   // The frame is written at once so the queue packets never interleave it with another frame
+   std::string frame;
+   frame.reserve(CONTROL_FRAME_HEADER_SIZE + rMessage.stPayload.size());
+   WriteUInt16(frame, CONTROL_FRAME_MAGIC);
+   WriteUInt16(frame, static_cast<uint16_t>(rMessage.eType));
+   WriteUInt16(frame, static_cast<uint16_t>(rMessage.eStatus));
+   WriteUInt32(frame, rMessage.uSequence);
+   WriteUInt32(frame, static_cast<uint32_t>(rMessage.stPayload.size()));
+   frame += rMessage.stPayload;
+
+   return guac_socket_write(m_Socket, frame.data(), frame.size()) == 0;
+}
+
+int GuacControlChannel::TakeBufferedMessage(GuacControlMessage & rOutMessage)
+{
+   if(m_stReceiveBuffer.size() < CONTROL_FRAME_HEADER_SIZE)
+   {
+      return 0;
+   }
+
+   uint32_t payloadSize = ReadUInt32(m_stReceiveBuffer, 10);
+   if(ReadUInt16(m_stReceiveBuffer, 0) != CONTROL_FRAME_MAGIC || payloadSize > CONTROL_FRAME_MAX_PAYLOAD)
+   {
+      m_stReceiveBuffer.clear();
+      return -1;
+   }
+
+   if(m_stReceiveBuffer.size() < CONTROL_FRAME_HEADER_SIZE + payloadSize)
+   {
+      return 0;
+   }
+
+   rOutMessage.eType = static_cast<GuacControlMessageType>(ReadUInt16(m_stReceiveBuffer, 2));
+   rOutMessage.eStatus = static_cast<GuacControlStatus>(ReadUInt16(m_stReceiveBuffer, 4));
+   rOutMessage.uSequence = ReadUInt32(m_stReceiveBuffer, 6);
+   rOutMessage.stPayload = m_stReceiveBuffer.substr(CONTROL_FRAME_HEADER_SIZE, payloadSize);
+   m_stReceiveBuffer.erase(0, CONTROL_FRAME_HEADER_SIZE + payloadSize);
+
+   return 1;
+}
+
+int GuacControlChannel::ReceiveMessage(GuacControlMessage & rOutMessage, int iTimeoutMS)
+{
+   guac_timestamp deadline = guac_timestamp_current() + iTimeoutMS;
+
+   while(true)
+   {
+      // A frame may span several queue packets, keep reading until it is complete
+      int result = TakeBufferedMessage(rOutMessage);
+      if(result != 0)
+      {
+         return result;
+      }
+
+      int remaining = static_cast<int>(deadline - guac_timestamp_current());
+      if(remaining <= 0 || guac_socket_select(m_Socket, remaining) <= 0)
+      {
+         return 0;
+      }
+
+      char buffer[SOCKET_BUFFER_SIZE];
+      size_t size = guac_socket_read(m_Socket, buffer, SOCKET_BUFFER_SIZE);
+      if(size == static_cast<size_t>(-1))
+      {
+         return -1;
+      }
+
+      m_stReceiveBuffer.append(buffer, size);
+   }
+}
+
+bool GuacControlChannel::SendCommand(GuacControlMessageType eType, const std::string & stPayload, int iTimeoutMS,
+                                     GuacControlMessage & rOutAck)
+{
+   boost::mutex::scoped_lock lock(m_CommandMutex);
+
+   GuacControlMessage command = {eType, GuacControlStatus::Success, m_uNextSequence++, stPayload};
+   guac_timestamp start = guac_timestamp_current();
+
+   rOutAck = {GuacControlMessageType::Ack, GuacControlStatus::Failure, command.uSequence, "No acknowledgement"};
+
+   bool acknowledged = false;
+   if(SendMessage(command))
+   {
+      // Wait for the Ack of this command, skipping Acks of earlier commands which timed out
+      guac_timestamp deadline = start + iTimeoutMS;
+      GuacControlMessage message;
+      int remaining;
+      while((remaining = static_cast<int>(deadline - guac_timestamp_current())) > 0 &&
+            ReceiveMessage(message, remaining) > 0)
+      {
+         if(message.eType == GuacControlMessageType::Ack && message.uSequence == command.uSequence)
+         {
+            rOutAck = message;
+            acknowledged = true;
+            break;
+         }
+      }
+   }
+   else
+   {
+      rOutAck.stPayload = "Could not write command";
+   }
+
+   bool success = acknowledged && rOutAck.eStatus == GuacControlStatus::Success;
+   double latency = static_cast<double>(guac_timestamp_current() - start);
+   RecordCommand(eType, success, latency);
+
+   if(success)
+   {
+      GuacLogger::GetInstance()->Debug() << "Control command " << GetMessageTypeName(eType) << " acknowledged in "
+                                         << latency << "ms";
+   }
+   else
+   {
+      GuacLogger::GetInstance()->Error() << "Control command " << GetMessageTypeName(eType) << " failed after "
+                                         << latency << "ms : " << rOutAck.stPayload;
+   }
+
+   return success;
+}
+
+bool GuacControlChannel::SendAck(const GuacControlMessage & rCommand, GuacControlStatus eStatus,
+                                 const std::string & stMessage)
+{
+   GuacControlMessage ack = {GuacControlMessageType::Ack, eStatus, rCommand.uSequence, stMessage};
+   return SendMessage(ack);
+}
+
+void GuacControlChannel::RecordCommand(GuacControlMessageType eType, bool bSuccess, double dLatencyMS)
+{
+   boost::mutex::scoped_lock lock(m_StatsMutex);
+
+   // Value initialized on first use
+   GuacControlCommandStats & stats = m_CommandStats[eType];
+   stats.uCount++;
+   if(!bSuccess)
+   {
+      stats.uFailures++;
+   }
+   stats.dTotalMS += dLatencyMS;
+   stats.dLastMS = dLatencyMS;
+   if(dLatencyMS > stats.dMaxMS)
+   {
+      stats.dMaxMS = dLatencyMS;
+   }
+}
+
+std::map<GuacControlMessageType, GuacControlCommandStats> GuacControlChannel::GetCommandStats() const
+{
+   boost::mutex::scoped_lock lock(m_StatsMutex);
+   return m_CommandStats;
+}
+
+const char * GuacControlChannel::GetMessageTypeName(GuacControlMessageType eType)
+{
+   switch(eType)
+   {
+   case GuacControlMessageType::Params:
+      return "Params";
+   case GuacControlMessageType::AddUser:
+      return "AddUser";
+   case GuacControlMessageType::RemoveUser:
+      return "RemoveUser";
+   case GuacControlMessageType::Stop:
+      return "Stop";
+   case GuacControlMessageType::Ack:
+      return "Ack";
+   case GuacControlMessageType::Metrics:
+      return "Metrics";
+   }
+   return "Unknown";
+}
@@ -0,0 +1,472 @@
+//
+// Aggregates the metrics of the service and all its client processes, and serves them over HTTP
+//
+
+#include <guacservice/GuacMetrics.h>
+#include <guacservice/GuacClientProcessHandler.h>
+#include <guacamole/metrics.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <vector>
+
+// The largest scrape request read, anything longer is dropped
+#define METRICS_MAX_REQUEST_SIZE 8192
+
+namespace
+{
+   /**
+    * A single scrape of the endpoint, kept alive by its pending operations
+    */
+   struct GuacMetricsScrape
+   {
+      boost::asio::ip::tcp::socket Socket;
+      boost::asio::streambuf Request;
+      std::string stResponse;
+
+      explicit GuacMetricsScrape(boost::asio::io_service & rIOService)
+              : Socket(rIOService), Request(METRICS_MAX_REQUEST_SIZE)
+      {
+      }
+   };
+
+   typedef boost::shared_ptr<GuacMetricsScrape> GuacMetricsScrapePtr;
+
+   /**
+    * Splits a metric name of the form name{labels} to its name and labels, the labels are empty if there are none
+    */
+   void SplitMetricName(const std::string & stMetric, std::string & rOutName, std::string & rOutLabels)
+   {
+      size_t brace = stMetric.find('{');
+      if(brace == std::string::npos || stMetric.back() != '}')
+      {
+         rOutName = stMetric;
+         rOutLabels.clear();
+         return;
+      }
+
+      rOutName = stMetric.substr(0, brace);
+      rOutLabels = stMetric.substr(brace + 1, stMetric.size() - brace - 2);
+   }
+
+   /**
+    * Joins a metric name and its labels, followed by a single extra label if given
+    */
+   std::string FormatMetricName(const std::string & stName, const std::string & stLabels,
+                                const std::string & stExtraLabel = "")
+   {
+      std::string labels = stLabels;
+      if(!stExtraLabel.empty())
+      {
+         labels += (labels.empty() ? "" : ",") + stExtraLabel;
+      }
+
+      return labels.empty() ? stName : stName + "{" + labels + "}";
+   }
+
+   std::string FormatLabel(const std::string & stLabel, const std::string & stValue)
+   {
+      return stLabel + "=\"" + stValue + "\"";
+   }
+}
+
+GuacMetrics::GuacMetrics() : m_QueriedProcessHandler(nullptr), m_uEndedBytesReceived(0), m_uEndedBytesSent(0),
+                             m_Acceptor(nullptr)
+{
+}
+
+GuacMetrics::~GuacMetrics()
+{
+   StopEndpoint();
+}
+
+boost::shared_ptr<GuacMetrics> GuacMetrics::GetInstance()
+{
+   static boost::shared_ptr<GuacMetrics> metrics(new GuacMetrics());
+   return metrics;
+}
+
+void GuacMetrics::RegisterProcessHandler(const GuacClientProcessHandlerPtr & pProcessHandler)
+{
+   boost::mutex::scoped_lock lock(m_ProcessHandlersMutex);
+   m_ProcessHandlers[pProcessHandler->GetProcessHandlerID()] = pProcessHandler;
+}
+
+void GuacMetrics::UnregisterProcessHandler(const GuacClientProcessHandlerPtr & pProcessHandler)
+{
+   boost::mutex::scoped_lock lock(m_ProcessHandlersMutex);
+   m_ProcessHandlers.erase(pProcessHandler->GetProcessHandlerID());
+   m_FramesSamples.erase(pProcessHandler->GetProcessHandlerID());
+
+   // A scrape only uses a process handler while querying it, so the process handler is not used past this point
+   while(m_QueriedProcessHandler == pProcessHandler)
+   {
+      m_ProcessHandlersCondition.wait(lock);
+   }
+}
+
+void GuacMetrics::RegisterRelay(const std::string & stProcessID, const GuacConnectionRelayPtr & pRelay)
+{
+   boost::mutex::scoped_lock lock(m_RelaysMutex);
+   m_Relays[pRelay] = stProcessID;
+}
+
+void GuacMetrics::UnregisterRelay(const GuacConnectionRelayPtr & pRelay)
+{
+   boost::mutex::scoped_lock lock(m_RelaysMutex);
+   if(m_Relays.erase(pRelay))
+   {
+      m_uEndedBytesReceived += pRelay->GetBytesReceived();
+      m_uEndedBytesSent += pRelay->GetBytesSent();
+   }
+}
+
+void GuacMetrics::AddClientMetrics(const std::string & stProcessID, const std::string & stMetrics,
+                                   GuacMetricFamilies & rFamilies)
+{
+   const std::string process_label = FormatLabel("process", stProcessID);
+
+   std::vector<std::string> lines;
+   boost::split(lines, stMetrics, boost::is_any_of("\n"), boost::token_compress_on);
+
+   for(auto && line : lines)
+   {
+      std::vector<std::string> fields;
+      boost::split(fields, line, boost::is_any_of(" "), boost::token_compress_on);
+      if(fields.size() < 3)
+      {
+         continue;
+      }
+
+      std::string name;
+      std::string labels;
+      SplitMetricName(fields[1], name, labels);
+
+      if(fields[0] == "counter" || fields[0] == "gauge")
+      {
+         GuacMetricFamily & family = rFamilies[name];
+         family.stType = fields[0];
+         family.Samples << FormatMetricName(name, labels, process_label) << " " << fields[2] << "\n";
+
+         // The frame rate is derived from the frame count between two scrapes
+         if(name == "guac_frames_total")
+         {
+            uint64_t frames = boost::lexical_cast<uint64_t>(fields[2]);
+            guac_timestamp now = guac_timestamp_current();
+            double frames_per_second = 0;
+
+            auto previous = m_FramesSamples.find(stProcessID);
+            if(previous != m_FramesSamples.end() && now > previous->second.Timestamp &&
+               frames >= previous->second.uFrames)
+            {
+               frames_per_second = (frames - previous->second.uFrames) * 1000.0 /
+                                   (now - previous->second.Timestamp);
+            }
+            m_FramesSamples[stProcessID] = {frames, now};
+
+            GuacMetricFamily & fps_family = rFamilies["guac_frames_per_second"];
+            fps_family.stType = "gauge";
+            fps_family.Samples << FormatMetricName("guac_frames_per_second", "", process_label) << " "
+                               << frames_per_second << "\n";
+         }
+      }
+      else if(fields[0] == "histogram" && fields.size() == 4 + GUAC_METRICS_HISTOGRAM_BUCKETS)
+      {
+         GuacMetricFamily & family = rFamilies[name];
+         family.stType = "histogram";
+
+         // The client process counts each bucket on its own, buckets are cumulative here
+         std::string sample_labels = FormatMetricName("", labels, process_label);
+         uint64_t cumulative = 0;
+         for(int i = 0; i < GUAC_METRICS_HISTOGRAM_BUCKETS; i++)
+         {
+            cumulative += boost::lexical_cast<uint64_t>(fields[4 + i]);
+            std::string bound = i < GUAC_METRICS_HISTOGRAM_BUCKETS - 1 ?
+                                boost::lexical_cast<std::string>(guac_metrics_histogram_bound(i)) : "+Inf";
+            family.Samples << FormatMetricName(name + "_bucket", labels,
+                                               process_label + "," + FormatLabel("le", bound))
+                           << " " << cumulative << "\n";
+         }
+         family.Samples << name << "_sum" << sample_labels << " " << fields[3] << "\n";
+         family.Samples << name << "_count" << sample_labels << " " << fields[2] << "\n";
+      }
+   }
+}
+
+void GuacMetrics::CollectProcessHandlers(GuacMetricFamilies & rFamilies)
+{
+   // Each process is queried with a timeout, so the lock is not held across the queries to not block teardown
+   std::vector<std::string> process_ids;
+   {
+      boost::mutex::scoped_lock lock(m_ProcessHandlersMutex);
+      for(auto && handler : m_ProcessHandlers)
+      {
+         process_ids.push_back(handler.first);
+      }
+   }
+
+   GuacMetricFamily & processes = rFamilies["guac_client_processes"];
+   processes.stType = "gauge";
+   processes.Samples << "guac_client_processes " << process_ids.size() << "\n";
+
+   GuacMetricFamily & commands = rFamilies["guac_control_commands_total"];
+   GuacMetricFamily & failures = rFamilies["guac_control_command_failures_total"];
+   GuacMetricFamily & total_ms = rFamilies["guac_control_command_milliseconds_total"];
+   GuacMetricFamily & max_ms = rFamilies["guac_control_command_max_milliseconds"];
+   commands.stType = "counter";
+   failures.stType = "counter";
+   total_ms.stType = "counter";
+   max_ms.stType = "gauge";
+
+   for(auto && process_id : process_ids)
+   {
+      const std::string process_label = FormatLabel("process", process_id);
+
+      // Mark the process handler as queried, a process unregistered meanwhile is skipped
+      GuacClientProcessHandlerPtr handler;
+      {
+         boost::mutex::scoped_lock lock(m_ProcessHandlersMutex);
+         auto found = m_ProcessHandlers.find(process_id);
+         if(found == m_ProcessHandlers.end())
+         {
+            continue;
+         }
+
+         handler = found->second;
+         m_QueriedProcessHandler = handler;
+      }
+
+      // A process which did not answer in time is only missing from this scrape
+      std::string client_metrics;
+      bool collected = handler->CollectClientMetrics(client_metrics);
+      std::map<GuacControlMessageType, GuacControlCommandStats> command_stats = handler->GetControlCommandStats();
+
+      {
+         boost::mutex::scoped_lock lock(m_ProcessHandlersMutex);
+         m_QueriedProcessHandler = nullptr;
+         m_ProcessHandlersCondition.notify_all();
+
+         // The frame samples of an unregistered process are not kept
+         if(collected && m_ProcessHandlers.count(process_id))
+         {
+            try
+            {
+               AddClientMetrics(process_id, client_metrics, rFamilies);
+            }
+            catch(boost::bad_lexical_cast & err)
+            {
+               GuacLogger::GetInstance()->Error() << "Invalid metrics from client process - " << err.what() << " ["
+                                                  << process_id << "]";
+            }
+         }
+      }
+
+      for(auto && stats : command_stats)
+      {
+         std::string labels = process_label + "," +
+                              FormatLabel("command", GuacControlChannel::GetMessageTypeName(stats.first));
+         commands.Samples << FormatMetricName("guac_control_commands_total", labels) << " "
+                          << stats.second.uCount << "\n";
+         failures.Samples << FormatMetricName("guac_control_command_failures_total", labels) << " "
+                          << stats.second.uFailures << "\n";
+         total_ms.Samples << FormatMetricName("guac_control_command_milliseconds_total", labels) << " "
+                          << stats.second.dTotalMS << "\n";
+         max_ms.Samples << FormatMetricName("guac_control_command_max_milliseconds", labels) << " "
+                        << stats.second.dMaxMS << "\n";
+      }
+   }
+}
+
+void GuacMetrics::CollectRelays(GuacMetricFamilies & rFamilies)
+{
+   boost::mutex::scoped_lock lock(m_RelaysMutex);
+
+   GuacMetricFamily & connections = rFamilies["guac_connections"];
+   GuacMetricFamily & received = rFamilies["guac_connection_received_bytes_total"];
+   GuacMetricFamily & sent = rFamilies["guac_connection_sent_bytes_total"];
+   GuacMetricFamily & pending = rFamilies["guac_connection_pending_bytes"];
+   GuacMetricFamily & service_received = rFamilies["guac_service_received_bytes_total"];
+   GuacMetricFamily & service_sent = rFamilies["guac_service_sent_bytes_total"];
+   connections.stType = "gauge";
+   received.stType = "counter";
+   sent.stType = "counter";
+   pending.stType = "gauge";
+   service_received.stType = "counter";
+   service_sent.stType = "counter";
+
+   uint64_t total_received = m_uEndedBytesReceived;
+   uint64_t total_sent = m_uEndedBytesSent;
+
+   for(auto && relay : m_Relays)
+   {
+      std::string labels = FormatLabel("process", relay.second) + "," +
+                           FormatLabel("connection", relay.first->GetConnectionID());
+      uint64_t relay_received = relay.first->GetBytesReceived();
+      uint64_t relay_sent = relay.first->GetBytesSent();
+      total_received += relay_received;
+      total_sent += relay_sent;
+
+      received.Samples << FormatMetricName("guac_connection_received_bytes_total", labels) << " " << relay_received
+                       << "\n";
+      sent.Samples << FormatMetricName("guac_connection_sent_bytes_total", labels) << " " << relay_sent << "\n";
+      pending.Samples << FormatMetricName("guac_connection_pending_bytes", labels) << " "
+                      << relay.first->GetPendingOutputBytes() << "\n";
+   }
+
+   connections.Samples << "guac_connections " << m_Relays.size() << "\n";
+   service_received.Samples << "guac_service_received_bytes_total " << total_received << "\n";
+   service_sent.Samples << "guac_service_sent_bytes_total " << total_sent << "\n";
+}
+
+std::string GuacMetrics::Collect()
+{
+   GuacMetricFamilies families;
+   CollectProcessHandlers(families);
+   CollectRelays(families);
+
+   std::ostringstream exposition;
+   for(auto && family : families)
+   {
+      std::string samples = family.second.Samples.str();
+      if(!samples.empty())
+      {
+         exposition << "# TYPE " << family.first << " " << family.second.stType << "\n" << samples;
+      }
+   }
+
+   return exposition.str();
+}
+
+void GuacMetrics::AcceptScrape()
+{
+   GuacMetricsScrapePtr scrape(new GuacMetricsScrape(m_IOService));
+   m_Acceptor->async_accept(scrape->Socket, [this, scrape](const boost::system::error_code & rErrorCode)
+   {
+      if(rErrorCode)
+      {
+         if(rErrorCode != boost::asio::error::operation_aborted)
+         {
+            GuacLogger::GetInstance()->Error() << "Could not accept metrics scrape - " << rErrorCode.message();
+            AcceptScrape();
+         }
+         return;
+      }
+
+      AcceptScrape();
+
+      boost::asio::async_read_until(scrape->Socket, scrape->Request, "\r\n\r\n",
+                                    [this, scrape](const boost::system::error_code & rReadError, size_t sSize)
+      {
+         if(rReadError)
+         {
+            return;
+         }
+
+         std::istream request(&scrape->Request);
+         std::string method;
+         std::string path;
+         request >> method >> path;
+
+         // Scrapes are served one at a time by the endpoint thread, a slow client process never holds the IO threads
+         std::string status = "404 Not Found";
+         std::string body;
+         if(method == "GET" && (path == "/metrics" || path == "/"))
+         {
+            status = "200 OK";
+            body = Collect();
+         }
+
+         std::ostringstream response;
+         response << "HTTP/1.0 " << status << "\r\n"
+                  << "Content-Type: text/plain; version=0.0.4\r\n"
+                  << "Content-Length: " << body.size() << "\r\n"
+                  << "Connection: close\r\n\r\n"
+                  << body;
+         scrape->stResponse = response.str();
+
+         boost::asio::async_write(scrape->Socket, boost::asio::buffer(scrape->stResponse),
+                                  [scrape](const boost::system::error_code & rWriteError, size_t sWritten)
+                                  {
+                                     boost::system::error_code ec;
+                                     scrape->Socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+                                     scrape->Socket.close(ec);
+                                  });
+      });
+   });
+}
+
+bool GuacMetrics::StartEndpoint(const GuacConfig & rConfig)
+{
+   if(rConfig.GetMetricsPort() == 0 || m_Acceptor)
+   {
+      return true;
+   }
+
+   boost::system::error_code ec;
+   boost::asio::ip::tcp::resolver resolver(m_IOService);
+   boost::asio::ip::tcp::resolver::iterator endpoint_iter =
+           resolver.resolve(boost::asio::ip::tcp::resolver::query(
+                   rConfig.GetMetricsBindHost(), boost::lexical_cast<std::string>(rConfig.GetMetricsPort())), ec);
+
+   if(ec)
+   {
+      GuacLogger::GetInstance()->Error() << "Could not resolve metrics endpoint " << rConfig.GetMetricsBindHost();
+      return false;
+   }
+
+   // Bind to the first resolved host which accepts it
+   m_Acceptor = new boost::asio::ip::tcp::acceptor(m_IOService);
+   boost::asio::ip::tcp::resolver::iterator end;
+   ec = boost::asio::error::host_not_found;
+   while(ec && endpoint_iter != end)
+   {
+      boost::asio::ip::tcp::endpoint endpoint = *endpoint_iter++;
+      m_Acceptor->close(ec);
+      m_Acceptor->open(endpoint.protocol(), ec);
+      if(!ec)
+      {
+         m_Acceptor->bind(endpoint, ec);
+      }
+   }
+
+   if(!ec)
+   {
+      m_Acceptor->listen(boost::asio::socket_base::max_connections, ec);
+   }
+
+   if(ec)
+   {
+      GuacLogger::GetInstance()->Error() << "Could not listen for metrics scrapes - " << ec.message();
+      delete m_Acceptor;
+      m_Acceptor = nullptr;
+      return false;
+   }
+
+   GuacLogger::GetInstance()->Debug() << "Metrics endpoint is : "
+                                      << m_Acceptor->local_endpoint().address().to_string() << ":"
+                                      << m_Acceptor->local_endpoint().port();
+
+   AcceptScrape();
+   m_IOService.reset();
+   m_EndpointThread = boost::thread([this]()
+                                    {
+                                       m_IOService.run();
+                                    });
+
+   return true;
+}
+
+void GuacMetrics::StopEndpoint()
+{
+   if(!m_Acceptor)
+   {
+      return;
+   }
+
+   m_IOService.stop();
+   m_EndpointThread.join();
+
+   boost::system::error_code ec;
+   m_Acceptor->close(ec);
+   delete m_Acceptor;
+   m_Acceptor = nullptr;
+}
@@ -4,7 +4,7 @@
 
 #include <guacservice/GuacService.h>
 
-GuacService::GuacService() : m_IsServiceRunning(false), m_ConnectionsHandler(nullptr)
+GuacService::GuacService() : m_IsServiceRunning(false), m_ConnectionsHandler(nullptr), m_IOServiceWork(nullptr)
 {
    m_Acceptor = new boost::asio::ip::tcp::acceptor(m_IOService);
 }
@@ -77,72 +77,165 @@ bool GuacService::BindAcceptor()
 
 void GuacService::CleanupService()
 {
+   // Stop serving scrapes before the processes go away
+   GuacMetrics::GetInstance()->StopEndpoint();
+
+   // Stop the idle pooled processes
+   GuacClientProcessPool::GetInstance()->StopPool();
+
+   // Stop accepting
+   boost::system::error_code ec;
+   m_Acceptor->close(ec);
+
    // Close all the handler connections
-   m_ConnectionsHandler->CloseConnections();
+   if(m_ConnectionsHandler)
+   {
+      m_ConnectionsHandler->CloseConnections();
+   }
+
+   // Stop the IO threads once no connection uses them anymore
+   StopIOThreads();
 
    // Close the service
    m_IsServiceRunning = false;
 }
 
-void GuacService::ListenAndAcceptNewConnections()
+void GuacService::StartIOThreads()
 {
-   GuacLogger::GetInstance()->Debug() << "Starting to listen to connections";
-   if(m_Config.IsWithSSL())
+   // A fixed amount of threads runs the IO of all the connections, regardless of how many are connected
+   int threads = m_Config.GetIOThreads() > 0 ? m_Config.GetIOThreads() : boost::thread::hardware_concurrency();
+   if(threads <= 0)
    {
-      GuacLogger::GetInstance()->Debug() << "Using SSL";
+      threads = 1;
    }
 
-   while(m_IsServiceRunning)
+   GuacLogger::GetInstance()->Debug() << "Starting " << threads << " IO threads";
+
+   // Keep the IO service running while it has no pending operation
+   m_IOService.reset();
+   m_IOServiceWork = new boost::asio::io_service::work(m_IOService);
+
+   for(int i = 0; i < threads; i++)
    {
-      boost::system::error_code ec;
+      m_IOThreads.create_thread([this]()
+                                {
+                                   // Handlers of the connections are not expected to throw, but a throwing one
+                                   // must not take down the whole thread pool
+                                   while(true)
+                                   {
+                                      try
+                                      {
+                                         m_IOService.run();
+                                         break;
+                                      }
+                                      catch(std::exception & err)
+                                      {
+                                         GuacLogger::GetInstance()->Error() << "IO handler failed - " << err.what();
+                                      }
+                                   }
+                                });
+   }
+}
+
+void GuacService::StopIOThreads()
+{
+   if(!m_IOServiceWork)
+   {
+      return;
+   }
 
-      // Get the connection depending on the type
-      auto newConnectionSocket =
-              m_Config.IsWithSSL() ?
-              IGuacConnectionSocketPtr(
-                      new GuacConnectionSSLSocket(m_Config.GetSSLPEMFilePath(), m_Config.GetSSLCertFilePath(),
-                                                  m_Config.GetSSLDiffieHellmanPEMFilePath()))
-                                   :
-              IGuacConnectionSocketPtr(new GuacConnectionTCPSocket());
+   delete m_IOServiceWork;
+   m_IOServiceWork = nullptr;
 
-      // Start waiting for a connection, this will block 
-      newConnectionSocket->WaitForSocket(m_Acceptor, ec);
+   m_IOService.stop();
+   m_IOThreads.join_all();
+}
 
-      GuacLogger::GetInstance()->Debug() << "New connection accepted";
+void GuacService::AcceptNewConnection()
+{
+   // Get the connection depending on the type
+   auto newConnectionSocket =
+           m_Config.IsWithSSL() ?
+           IGuacConnectionSocketPtr(
+                   new GuacConnectionSSLSocket(m_IOService, m_Config.GetSSLPEMFilePath(),
+                                               m_Config.GetSSLCertFilePath(),
+                                               m_Config.GetSSLDiffieHellmanPEMFilePath()))
+                                :
+           IGuacConnectionSocketPtr(new GuacConnectionTCPSocket(m_IOService));
+
+   // Pass the connection to the handler, since it is the only reference to it until it is accepted
+   newConnectionSocket->AsyncWaitForSocket(m_Acceptor,
+                                           boost::bind(&GuacService::OnConnectionAccepted, this, newConnectionSocket,
+                                                       boost::asio::placeholders::error));
+}
 
-      // Send this to another thread to be added to the connections handler and start his connection thread
-      // Pass the connection as a param due to the loop releasing the reference to it
-      if(!ec)
-      {
-         boost::thread([this](const IGuacConnectionSocketPtr & connection)
-                       {
-                          boost::system::error_code establishEc;
-
-                          GuacLogger::GetInstance()->Debug() << "Trying to establish connection";
-                          // Establish the connection, this will establish needed objects to begin the connection
-                          // Notice that this might block if this is SSL with the handshake
-                          connection->EstablishSocket(establishEc);
-
-                          if(!establishEc)
-                          {
-                             GuacLogger::GetInstance()->Debug() << "Connection finished establishing.";
-
-                             // Add new connection to the guac handler
-                             m_ConnectionsHandler->HandleNewConnection(connection);
-                          }
-                          else
-                          {
-                             GuacLogger::GetInstance()->Error() << "Establish socket failed - "
-                                                                << establishEc.message();
-                          }
-
-                       }, newConnectionSocket);
-      }
-      else
+void GuacService::OnConnectionAccepted(const IGuacConnectionSocketPtr & pConnection,
+                                       const boost::system::error_code & rErrorCode)
+{
+   if(rErrorCode)
+   {
+      // The acceptor is closed when the service is cleaned up
+      if(rErrorCode != boost::asio::error::operation_aborted)
       {
-         GuacLogger::GetInstance()->Error() << "Connection could not be accepted, server issue, aborting";
-         break;
+         GuacLogger::GetInstance()->Error() << "Connection could not be accepted, server issue, aborting - "
+                                            << rErrorCode.message();
       }
+
+      boost::mutex::scoped_lock lock(m_ServiceMutex);
+      m_IsServiceRunning = false;
+      m_ServiceCondition.notify_all();
+      return;
+   }
+
+   GuacLogger::GetInstance()->Debug() << "New connection accepted";
+
+   // Establish the connection, this will establish needed objects to begin the connection
+   // On SSL this performs the handshake, without holding a thread while the client negotiates
+   GuacLogger::GetInstance()->Debug() << "Trying to establish connection";
+   pConnection->AsyncEstablishSocket(boost::bind(&GuacService::OnConnectionEstablished, this, pConnection,
+                                                 boost::asio::placeholders::error));
+
+   // Keep accepting
+   AcceptNewConnection();
+}
+
+void GuacService::OnConnectionEstablished(const IGuacConnectionSocketPtr & pConnection,
+                                          const boost::system::error_code & rErrorCode)
+{
+   if(rErrorCode)
+   {
+      GuacLogger::GetInstance()->Error() << "Establish socket failed - " << rErrorCode.message();
+      return;
+   }
+
+   GuacLogger::GetInstance()->Debug() << "Connection finished establishing.";
+
+   // Add new connection to the guac handler
+   // This runs the connection session which blocks on the client process, so it is not run on the IO threads
+   boost::thread([this](const IGuacConnectionSocketPtr & connection)
+                 {
+                    m_ConnectionsHandler->HandleNewConnection(connection);
+                 }, pConnection).detach();
+}
+
+void GuacService::ListenAndAcceptNewConnections()
+{
+   GuacLogger::GetInstance()->Debug() << "Starting to listen to connections";
+   if(m_Config.IsWithSSL())
+   {
+      GuacLogger::GetInstance()->Debug() << "Using SSL";
+   }
+
+   StartIOThreads();
+
+   // Start the accepting cycle, it keeps itself going on the IO threads
+   m_IOService.post(boost::bind(&GuacService::AcceptNewConnection, this));
+
+   // Wait until the acceptor fails
+   boost::mutex::scoped_lock lock(m_ServiceMutex);
+   while(m_IsServiceRunning)
+   {
+      m_ServiceCondition.wait(lock);
    }
 }
 
@@ -197,7 +290,13 @@ bool GuacService::StartGuacamoleService(const GuacConfig & rConfig)
       return false;
    }
 
-   // Start the accepting cycle, sync
+   // Start filling the process pool in the background, ahead of the first connections
+   GuacClientProcessPool::GetInstance()->StartPool(m_Config);
+
+   // The service keeps running without metrics if the endpoint could not be bound
+   GuacMetrics::GetInstance()->StartEndpoint(m_Config);
+
+   // Start the accepting cycle, blocks until the service ends
    m_IsServiceRunning = true;
    ListenAndAcceptNewConnections();
 
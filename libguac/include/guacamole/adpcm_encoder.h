@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_ADPCM_ENCODER_H
+#define GUAC_ADPCM_ENCODER_H
+
+#include <guacamole/config.h>
+
+#include <guacamole/audio.h>
+
+#include <stdint.h>
+
+/**
+ * The base mimetype of audio encoded by the IMA ADPCM encoder, as defined for
+ * the DVI4 payload format of RFC 3551. Each blob is an independently-decodable
+ * block beginning with a four-byte header for each channel: the predicted
+ * sample value (signed 16-bit, big-endian), the step index (8-bit) and a
+ * reserved zero byte. The header is followed by one 4-bit code per sample,
+ * with samples of multiple channels interleaved as with raw PCM and the first
+ * sample of each byte stored within its most significant nibble.
+ */
+#define GUAC_ADPCM_ENCODER_MIMETYPE "audio/DVI4"
+
+/**
+ * The maximum number of bytes to send in each audio blob, including the
+ * per-channel block headers.
+ */
+#define GUAC_ADPCM_ENCODER_BLOB_SIZE 6048
+
+/**
+ * The size of the IMA ADPCM encoder input buffer, in milliseconds. The
+ * equivalent number of samples will vary by PCM rate and number of channels.
+ */
+#define GUAC_ADPCM_ENCODER_BUFFER_SIZE 250
+
+/**
+ * The maximum number of audio channels supported by the IMA ADPCM encoder.
+ */
+#define GUAC_ADPCM_ENCODER_MAX_CHANNELS 2
+
+/**
+ * The state of the IMA ADPCM predictor for a single channel.
+ */
+typedef struct adpcm_encoder_channel {
+
+    /**
+     * The sample value predicted from all previously-encoded samples.
+     */
+    int predictor;
+
+    /**
+     * Index into the IMA ADPCM step size table for the next sample.
+     */
+    int step_index;
+
+} adpcm_encoder_channel;
+
+/**
+ * The current state of the IMA ADPCM encoder. PCM data is buffered until
+ * flushed, at which point it is encoded as blocks of 4-bit codes, a quarter
+ * of the size of the original 16-bit audio.
+ */
+typedef struct adpcm_encoder_state {
+
+    /**
+     * Buffer of not-yet-encoded PCM samples.
+     */
+    int16_t* buffer;
+
+    /**
+     * Size of the PCM buffer, in samples.
+     */
+    int length;
+
+    /**
+     * The current number of samples stored within the PCM buffer.
+     */
+    int written;
+
+    /**
+     * The predictor state of each channel, carried from block to block.
+     */
+    adpcm_encoder_channel channels[GUAC_ADPCM_ENCODER_MAX_CHANNELS];
+
+} adpcm_encoder_state;
+
+/**
+ * Audio encoder which writes IMA ADPCM (four bits per sample).
+ */
+extern guac_audio_encoder* adpcm_encoder;
+
+#endif
+
@@ -27,10 +27,19 @@
  * @file audio.h
  */
 
+#include <guacamole/config.h>
+
 #include <guacamole/audio-fntypes.h>
 #include <guacamole/audio-types.h>
 #include <guacamole/client-types.h>
 #include <guacamole/stream-types.h>
+#include <guacamole/timestamp-types.h>
+
+#ifdef HAVE_BOOST
+#include <boost/thread.hpp>
+#elif defined HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 struct guac_audio_encoder {
 
@@ -108,6 +117,42 @@ struct guac_audio_stream {
      */
     void* data;
 
+    /**
+     * The number of milliseconds of audio which may be aggregated before
+     * being sent, when written via guac_audio_stream_end_packet(). If zero,
+     * each packet is sent as soon as it is complete.
+     */
+    int aggregation_window;
+
+    /**
+     * The time the oldest audio not yet flushed was written, or zero if no
+     * audio is awaiting a flush.
+     */
+    guac_timestamp __pending_since;
+
+    /**
+     * The number of bytes of PCM data written since the last flush.
+     */
+    int __pending_bytes;
+
+#ifdef HAVE_BOOST
+    /**
+     * Lock which is acquired while writing or flushing the stream, as packets
+     * may be written and aggregated audio flushed from different threads.
+     * This lock is recursive, as encoders flush the stream from within their
+     * write handlers once their buffers are full.
+     */
+    boost::recursive_mutex __lock;
+#elif defined HAVE_LIBPTHREAD
+    /**
+     * Lock which is acquired while writing or flushing the stream, as packets
+     * may be written and aggregated audio flushed from different threads.
+     * This lock is recursive, as encoders flush the stream from within their
+     * write handlers once their buffers are full.
+     */
+    pthread_mutex_t __lock;
+#endif
+
 };
 
 /**
@@ -231,5 +276,33 @@ void guac_audio_stream_write_pcm(guac_audio_stream* stream,
  */
 void guac_audio_stream_flush(guac_audio_stream* stream);
 
+/**
+ * Marks the end of a packet of PCM data written via
+ * guac_audio_stream_write_pcm(), flushing the stream only once the audio
+ * written since the last flush spans the aggregation window of the stream.
+ * Smaller packets are thus combined into fewer, larger blobs. Any audio left
+ * pending must later be sent with guac_audio_stream_flush_pending().
+ *
+ * @param stream
+ *     The guac_audio_stream to which a complete packet has been written.
+ */
+void guac_audio_stream_end_packet(guac_audio_stream* stream);
+
+/**
+ * Flushes the given audio stream if the oldest audio not yet flushed has
+ * waited for the full aggregation window of the stream. This should be
+ * invoked periodically, such as at the end of each frame, by any caller of
+ * guac_audio_stream_end_packet(), such that aggregated audio is not held
+ * indefinitely once packets stop arriving.
+ *
+ * @param stream
+ *     The guac_audio_stream to flush, if due.
+ *
+ * @return
+ *     The number of milliseconds until pending audio will be due for a flush,
+ *     or -1 if no audio is pending.
+ */
+int guac_audio_stream_flush_pending(guac_audio_stream* stream);
+
 #endif
 
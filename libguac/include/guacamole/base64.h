@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_BASE64_H
+#define GUAC_BASE64_H
+
+/**
+ * Bulk base64 encoding of complete three-byte groups, using SSSE3 or AVX2
+ * where supported by the CPU.
+ *
+ * @file base64.h
+ */
+
+#include <guacamole/config.h>
+
+#include <stddef.h>
+
+/**
+ * The number of base64 characters encoded into a temporary buffer before
+ * being written to a socket at once. This must be a multiple of 4.
+ */
+#define GUAC_BASE64_CHUNK_SIZE 8192
+
+/**
+ * Encodes as many complete three-byte groups of the given data as possible
+ * as base64, without padding. Any trailing one or two bytes which do not form
+ * a complete group are left unencoded.
+ *
+ * @param output
+ *     The buffer to store the base64 characters in, which must have space for
+ *     at least (count / 3) * 4 characters. No null terminator is written.
+ *
+ * @param input
+ *     The data to encode.
+ *
+ * @param count
+ *     The number of bytes of data available.
+ *
+ * @return
+ *     The number of bytes of input encoded, which is always a multiple of 3.
+ */
+size_t guac_base64_encode(char* output, const unsigned char* input,
+        size_t count);
+
+#endif
+
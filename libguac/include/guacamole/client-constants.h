@@ -32,6 +32,14 @@
  */
 #define GUAC_CLIENT_MAX_STREAMS 64
 
+/**
+ * The number of bytes queued on the client socket which are assumed to take
+ * one millisecond to drain. Data which has been written but not yet consumed
+ * is accounted for in the processing lag at this rate, such that frame
+ * production is throttled while the outbound queues are backed up.
+ */
+#define GUAC_CLIENT_QUEUE_DEPTH_BYTES_PER_MS 1024
+
 /**
  * The index of a closed stream.
  */
@@ -83,5 +91,12 @@
  */
 #define GUAC_BUFFER_POOL_INITIAL_SIZE 1024
 
+/**
+ * The number of recently-sent sync instructions remembered by each
+ * guac_client, such that the amount of data acknowledged by a user can be
+ * determined when that user responds to a sync.
+ */
+#define GUAC_CLIENT_SYNC_HISTORY 64
+
 #endif
 
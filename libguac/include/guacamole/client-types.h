@@ -84,5 +84,47 @@ typedef enum guac_client_log_level {
 
 } guac_client_log_level;
 
+/**
+ * The action taken when a user falls so far behind that their send queue
+ * cannot hold the data broadcast to them.
+ */
+typedef enum guac_send_queue_policy {
+
+    /**
+     * Discard everything queued for the user and bring the user back up to
+     * date with the current state of the connection, using the resync
+     * handler of the guac_client. Instructions opening, acknowledging or
+     * closing streams are kept, while the data of the streams is discarded.
+     * If no resync handler is defined, the user is disconnected instead.
+     */
+    GUAC_SEND_QUEUE_RESYNC,
+
+    /**
+     * Disconnect the user.
+     */
+    GUAC_SEND_QUEUE_DISCONNECT
+
+} guac_send_queue_policy;
+
+/**
+ * The action taken when session recording falls so far behind the storage
+ * that its buffer cannot hold the data written to the recording.
+ */
+typedef enum guac_recording_overflow_policy {
+
+    /**
+     * Block the thread writing to the recording until the storage catches
+     * up, such that no recorded data is ever lost.
+     */
+    GUAC_RECORDING_OVERFLOW_BLOCK,
+
+    /**
+     * Stop recording, keeping everything recorded so far, such that the
+     * connection itself is never slowed by its recording.
+     */
+    GUAC_RECORDING_OVERFLOW_STOP
+
+} guac_recording_overflow_policy;
+
 #endif
 
@@ -33,6 +33,7 @@
 #include <guacamole/layer-types.h>
 #include <guacamole/object-types.h>
 #include <guacamole/pool-types.h>
+#include <guacamole/quality.h>
 #include <guacamole/socket-types.h>
 #include <guacamole/stream-types.h>
 #include <guacamole/timestamp-types.h>
@@ -45,6 +46,8 @@
 #ifdef HAVE_BOOST
 #include <boost/thread.hpp>
 #include <boost/dll.hpp>
+
+#include <atomic>
 #elif defined HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -85,6 +88,43 @@ struct guac_client {
      */
     guac_timestamp last_sent_timestamp;
 
+    /**
+     * The image quality, lossy compression threshold and frame scale suited
+     * to the slowest of all connected users. This is updated each time any
+     * user responds to a sync, and must only be accessed while holding
+     * __quality_lock. Use guac_client_get_quality() to read a consistent
+     * copy.
+     */
+    guac_quality quality;
+
+    /**
+     * The timestamps of the most recently sent sync instructions, in a ring
+     * of GUAC_CLIENT_SYNC_HISTORY entries.
+     */
+    guac_timestamp __sync_timestamps[GUAC_CLIENT_SYNC_HISTORY];
+
+    /**
+     * The number of bytes written to the broadcast socket as of each of the
+     * sync instructions in __sync_timestamps.
+     */
+    int64_t __sync_bytes[GUAC_CLIENT_SYNC_HISTORY];
+
+    /**
+     * The index within __sync_timestamps of the next sync to be recorded.
+     */
+    int __sync_index;
+
+    /**
+     * Lock which is acquired when quality, __sync_timestamps, __sync_bytes or
+     * __sync_index are read or modified, as syncs are recorded by the thread
+     * ending each frame while users acknowledge them from their own threads.
+     */
+#ifdef HAVE_BOOST
+	boost::mutex __quality_lock;
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_t __quality_lock;
+#endif
+
     /**
      * Handler for freeing data when the client is being unloaded.
      *
@@ -159,7 +199,9 @@ struct guac_client {
 
     /**
      * Lock which is acquired when the users list is being manipulated, or when
-     * the users list is being iterated.
+     * the users list is being iterated. When built with Boost, the list is
+     * iterated through __user_snapshot instead, and this lock is only acquired
+     * to manipulate the list.
      */
 #ifdef HAVE_BOOST
 	rwlock::RWLock<rwlock::SLEEP> __users_lock;
@@ -274,6 +316,76 @@ struct guac_client {
 	* Added by CA
 	*/
 	int client_fps;
+	/**
+	* Pool of worker threads encoding images submitted through the
+	* guac_client_stream_*_async() functions, NULL if encoding is synchronous
+	*/
+	struct guac_encode_pool* __encode_pool;
+	/**
+	* The memory budget in bytes of the tile cache of each display of this client, 0 to disable tile caching
+	* Added by CA
+	*/
+	int tile_cache_size;
+	/**
+	* The maximum number of bytes queued for each user before send_queue_policy applies, 0 to write
+	* broadcast data to each user synchronously
+	* Added by CA
+	*/
+	int send_queue_size;
+	/**
+	* The action taken when a user falls further behind than send_queue_size allows
+	* Added by CA
+	*/
+	guac_send_queue_policy send_queue_policy;
+	/**
+	* Handler bringing a user whose queued data was discarded back up to date, see
+	* guac_user_resync_handler. If NULL, such users are disconnected instead.
+	*/
+	guac_user_resync_handler* resync_handler;
+	/**
+	* The number of milliseconds of audio aggregated into each audio blob by protocols batching
+	* their audio packets, 0 to send each packet as it arrives
+	* Added by CA
+	*/
+	int audio_aggregation_window;
+	/**
+	* The maximum number of bytes of session recording buffered in memory while they are written
+	* to storage by the recording writer thread, 0 for the default
+	* Added by CA
+	*/
+	size_t recording_buffer_size;
+	/**
+	* The action taken when the storage falls further behind than recording_buffer_size allows
+	* Added by CA
+	*/
+	guac_recording_overflow_policy recording_overflow_policy;
+	/**
+	* Non-zero if session recordings should be gzip compressed as they are written
+	* Added by CA
+	*/
+	int recording_compress;
+	/**
+	* The number of milliseconds between the keyframes written to session recordings, each of which
+	* is listed in an index written alongside the recording, or 0 if recordings are not indexed
+	* Added by CA
+	*/
+	int recording_keyframe_interval;
+	/**
+	* Array of the users connected as of the most recent join or leave, iterated without locking by
+	* guac_client_foreach_user() and friends. Each join or leave publishes a new snapshot rather than
+	* modifying the current one.
+	*/
+	std::atomic<struct guac_user_snapshot*> __user_snapshot;
+	/**
+	* The number of threads currently iterating a snapshot, counted separately for threads which
+	* began while __user_snapshot_epoch was even and odd, such that replaced snapshots can be freed
+	* once both counts have drained without waiting for a moment with no readers at all
+	*/
+	std::atomic<int> __user_snapshot_readers[2];
+	/**
+	* Advanced twice by each join or leave while waiting for the readers of the replaced snapshot
+	*/
+	std::atomic<unsigned int> __user_snapshot_epoch;
 #elif defined HAVE_LIBPTHREAD
     void* __plugin_handle;
 #endif
@@ -435,7 +547,9 @@ int guac_client_add_user(guac_client* client, guac_user* user, int argc, char**
 
 /**
  * Removes the given user, removing the user from the internally-tracked list
- * of connected users, and calling any appropriate leave handler.
+ * of connected users, and calling any appropriate leave handler. Any
+ * iteration of the users which may still reach the given user is allowed to
+ * complete before the leave handler is called.
  *
  * @param client The proxy client to return the buffer to.
  * @param user The user to remove.
@@ -453,6 +567,9 @@ void guac_client_remove_user(guac_client* client, guac_user* user);
  * MAY invoke guac_client_foreach_user(), doing so should not be necessary, and
  * may indicate poor design choices.
  *
+ * When built with Boost, this function acquires no lock, iterating the users
+ * connected as of the most recent join or leave.
+ *
  * @param client
  *     The client whose users should be iterated.
  *
@@ -557,7 +674,9 @@ int guac_client_load_plugin(guac_client* client, const char* protocol);
 /**
  * Calculates and returns the approximate processing lag experienced by the
  * pool of users. The processing lag is the difference in time between server
- * and client due purely to data processing and excluding network delays.
+ * and client due purely to data processing and excluding network delays. Data
+ * still queued on the client socket is included, estimated as the time
+ * needed to drain it (see GUAC_CLIENT_QUEUE_DEPTH_BYTES_PER_MS).
  *
  * @param client
  *     The guac_client to calculate the processing lag of.
@@ -568,6 +687,78 @@ int guac_client_load_plugin(guac_client* client, const char* protocol);
  */
 int guac_client_get_processing_lag(guac_client* client);
 
+/**
+ * Returns the approximate number of bytes written to the given client which
+ * have not yet been consumed by the most backed-up user. Users with send
+ * queues (see send_queue_size) are only considered through the least
+ * backed-up of those users, as users who fall too far behind are handled by
+ * send_queue_policy rather than pacing all other users.
+ *
+ * @param client
+ *     The guac_client to query.
+ *
+ * @return
+ *     The approximate number of bytes queued for the slowest user of the
+ *     given guac_client.
+ */
+int guac_client_get_queue_depth(guac_client* client);
+
+/**
+ * Returns the number of bytes which had been written to all users of the
+ * given client as of the sync instruction having the given timestamp.
+ *
+ * @param client
+ *     The guac_client to query.
+ *
+ * @param timestamp
+ *     The timestamp of a sync instruction sent by guac_client_end_frame().
+ *
+ * @return
+ *     The number of bytes written prior to the given sync instruction, or -1
+ *     if the sync is too old or unknown.
+ */
+int64_t guac_client_get_sync_bytes(guac_client* client,
+        guac_timestamp timestamp);
+
+/**
+ * Recalculates the aggregate quality settings of the given client from the
+ * quality controllers of all connected users, such that the settings suit
+ * the slowest user.
+ *
+ * @param client
+ *     The guac_client whose quality settings should be updated.
+ */
+void guac_client_update_quality(guac_client* client);
+
+/**
+ * Copies the current aggregate quality settings of the given client, as
+ * last calculated by guac_client_update_quality(). Callers making several
+ * encoding decisions should read the settings once and use the copy
+ * throughout, such that all decisions agree.
+ *
+ * @param client
+ *     The guac_client to query.
+ *
+ * @param quality
+ *     Storage for the copy of the quality settings.
+ */
+void guac_client_get_quality(guac_client* client, guac_quality* quality);
+
+/**
+ * Returns the duration to use for the current frame, stretching the given
+ * nominal duration as required by the slowest connected user.
+ *
+ * @param client
+ *     The guac_client to query.
+ *
+ * @param duration
+ *     The nominal duration of each frame, in milliseconds.
+ *
+ * @return
+ *     The duration to use for the current frame, in milliseconds.
+ */
+int guac_client_get_frame_duration(guac_client* client, int duration);
+
 /**
  * Streams the image data of the given surface over an image stream ("img"
  * instruction) as PNG-encoded data. The image stream will be automatically
@@ -684,6 +875,153 @@ void guac_client_stream_webp(guac_client* client, guac_socket* socket,
         guac_composite_mode mode, const guac_layer* layer, int x, int y,
         cairo_surface_t* surface, int quality, int lossless);
 
+#ifdef HAVE_BOOST
+/**
+ * Sets the number of worker threads used to encode images streamed via
+ * guac_client_stream_png_async(), guac_client_stream_jpeg_async() and
+ * guac_client_stream_webp_async(). Any images already submitted are emitted
+ * before the previous worker threads are stopped.
+ *
+ * @param client
+ *     The Guacamole client whose encoder threads should be set.
+ *
+ * @param threads
+ *     The number of encoder threads to use, or zero to encode synchronously
+ *     within the calling thread.
+ */
+void guac_client_set_encoder_threads(guac_client* client, int threads);
+#endif
+
+/**
+ * Behaves as guac_client_stream_png(), except that, if the client has encoder
+ * threads, the image is encoded in the background. The resulting img, blob
+ * and end instructions are sent in submission order relative to other
+ * asynchronously-streamed images, but only as encoding completes, thus
+ * guac_client_flush_async_streams() must be invoked before sending any other
+ * instruction which depends on the image, and before modifying the contents
+ * of the given surface. Builds without Boost have no encoder threads, and
+ * always encode within the calling thread.
+ *
+ * @param client
+ *     The Guacamole client for which the image stream should be allocated.
+ *
+ * @param socket
+ *     The socket over which instructions associated with the image stream
+ *     should be sent.
+ *
+ * @param mode
+ *     The composite mode to use when rendering the image over the given layer.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param surface
+ *     A Cairo surface containing the image data to be streamed.
+ *
+ * @param fast
+ *     Non-zero to compress the image quickly at the expense of its size, as
+ *     suits realtime updates, zero to compress as guac_client_stream_png()
+ *     does.
+ */
+void guac_client_stream_png_async(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, int fast);
+
+/**
+ * Behaves as guac_client_stream_jpeg(), except that the image may be encoded
+ * in the background. See guac_client_stream_png_async().
+ *
+ * @param client
+ *     The Guacamole client for which the image stream should be allocated.
+ *
+ * @param socket
+ *     The socket over which instructions associated with the image stream
+ *     should be sent.
+ *
+ * @param mode
+ *     The composite mode to use when rendering the image over the given layer.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param surface
+ *     A Cairo surface containing the image data to be streamed.
+ *
+ * @param quality
+ *     The JPEG image quality, which must be an integer value between 0 and 100
+ *     inclusive.
+ */
+void guac_client_stream_jpeg_async(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, int quality);
+
+/**
+ * Behaves as guac_client_stream_webp(), except that the image may be encoded
+ * in the background. See guac_client_stream_png_async().
+ *
+ * @param client
+ *     The Guacamole client for whom the image stream should be allocated.
+ *
+ * @param socket
+ *     The socket over which instructions associated with the image stream
+ *     should be sent.
+ *
+ * @param mode
+ *     The composite mode to use when rendering the image over the given layer.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param surface
+ *     A Cairo surface containing the image data to be streamed.
+ *
+ * @param quality
+ *     The WebP image quality, which must be an integer value between 0 and 100
+ *     inclusive.
+ *
+ * @param lossless
+ *     Zero to encode a lossy image, non-zero to encode losslessly.
+ */
+void guac_client_stream_webp_async(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, int quality, int lossless);
+
+/**
+ * Waits for all images submitted through the guac_client_stream_*_async()
+ * functions to finish encoding, sending their instructions in order. Once
+ * this function returns, the surfaces of those images are no longer
+ * referenced.
+ *
+ * @param client
+ *     The Guacamole client whose asynchronous image streams should be
+ *     flushed.
+ */
+void guac_client_flush_async_streams(guac_client* client);
+
 /**
  * Returns whether all users of the given client support WebP. If any user does
  * not support WebP, or the server cannot encode WebP images, zero is returned.
@@ -29,6 +29,12 @@ struct guac_stream;
  * Encodes the given surface as a JPEG, and sends the resulting data over the
  * given stream and socket as blobs.
  *
+ * The time taken and the bytes written are recorded within the metrics of
+ * the process, labeled with the image format.
+ *
+ * When built with Boost, each thread reuses a single libjpeg compressor for
+ * all images it encodes.
+ *
  * @param socket
  *     The socket to send JPEG blobs over.
  *
@@ -27,10 +27,37 @@
 
 #include <cairo/cairo.h>
 
+/**
+ * The tradeoffs between encoding time and size which may be requested of the
+ * PNG encoder.
+ */
+typedef enum guac_png_profile {
+
+    /**
+     * The compression level and row filtering chosen by libpng, or by Cairo
+     * for images with more than 256 colors.
+     */
+    GUAC_PNG_PROFILE_DEFAULT,
+
+    /**
+     * Low compression level and a single fixed row filter, for realtime
+     * updates where the time taken to encode matters more than the size.
+     */
+    GUAC_PNG_PROFILE_FAST
+
+} guac_png_profile;
+
 /**
  * Encodes the given surface as a PNG, and sends the resulting data over the
  * given stream and socket as blobs.
  *
+ * The time taken and the bytes written are recorded within the metrics of
+ * the process, labeled with the image format.
+ *
+ * When built with Boost, each thread keeps the palette, row buffers and the
+ * memory allocated by libpng and zlib from one image to the next, as setting
+ * these up otherwise costs as much as compressing a small image.
+ *
  * @param socket
  *     The socket to send PNG blobs over.
  *
@@ -40,11 +67,14 @@
  * @param surface
  *     The Cairo surface to write to the given stream and socket as PNG blobs.
  *
+ * @param profile
+ *     The tradeoff between encoding time and size to make.
+ *
  * @return
  *     Zero if the encoding operation is successful, non-zero otherwise.
  */
 int guac_png_write(guac_socket* socket, guac_stream* stream,
-        cairo_surface_t* surface);
+        cairo_surface_t* surface, guac_png_profile profile);
 
 #endif
 
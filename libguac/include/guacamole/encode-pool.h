@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_ENCODE_POOL_H
+#define GUAC_ENCODE_POOL_H
+
+/**
+ * A pool of worker threads which encode images into in-memory buffers
+ * concurrently, while the resulting instructions are emitted strictly in the
+ * order the images were submitted.
+ *
+ * @file encode-pool.h
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/client-types.h>
+#include <guacamole/layer-types.h>
+#include <guacamole/protocol-types.h>
+#include <guacamole/socket-types.h>
+
+#include <cairo/cairo.h>
+
+/**
+ * The maximum number of images which may be in flight within an encoder pool
+ * at any one time. Each in-flight image holds an output stream, thus this
+ * must remain well below GUAC_CLIENT_MAX_STREAMS.
+ */
+#define GUAC_ENCODE_POOL_MAX_JOBS 16
+
+/**
+ * The image formats which may be encoded by an encoder pool.
+ */
+typedef enum guac_encode_format {
+
+    /**
+     * Lossless PNG.
+     */
+    GUAC_ENCODE_PNG,
+
+    /**
+     * Lossless PNG, using the fast PNG profile.
+     */
+    GUAC_ENCODE_PNG_FAST,
+
+    /**
+     * Lossy JPEG.
+     */
+    GUAC_ENCODE_JPEG,
+
+    /**
+     * Lossy or lossless WebP.
+     */
+    GUAC_ENCODE_WEBP
+
+} guac_encode_format;
+
+/**
+ * A pool of image encoding worker threads. The internals of this structure
+ * are private to encode-pool.c.
+ */
+typedef struct guac_encode_pool guac_encode_pool;
+
+/**
+ * Allocates a new encoder pool which will run the given number of worker
+ * threads on behalf of the given client.
+ *
+ * @param client
+ *     The client whose streams will be used by images encoded by this pool.
+ *
+ * @param threads
+ *     The number of worker threads to start. This must be greater than zero.
+ *
+ * @return
+ *     A newly-allocated encoder pool, or NULL if the pool could not be
+ *     allocated.
+ */
+guac_encode_pool* guac_encode_pool_alloc(guac_client* client, int threads);
+
+/**
+ * Emits any images still pending within the given pool, stops all worker
+ * threads, and frees the pool.
+ *
+ * @param pool
+ *     The encoder pool to free.
+ */
+void guac_encode_pool_free(guac_encode_pool* pool);
+
+/**
+ * Submits the given surface for encoding. The surface is referenced, not
+ * copied, thus its contents must not change until guac_encode_pool_flush()
+ * has been invoked. Completed images at the head of the pool are emitted
+ * before returning, and if the pool is full this function blocks until the
+ * oldest image has been emitted.
+ *
+ * @param pool
+ *     The encoder pool to submit the image to.
+ *
+ * @param socket
+ *     The socket over which the img, blob and end instructions of the
+ *     encoded image should eventually be sent.
+ *
+ * @param format
+ *     The format to encode the image as.
+ *
+ * @param mode
+ *     The composite mode to use when rendering the image over the given layer.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle.
+ *
+ * @param surface
+ *     A Cairo surface containing the image data to be encoded.
+ *
+ * @param quality
+ *     The image quality, ignored for PNG.
+ *
+ * @param lossless
+ *     Non-zero to encode losslessly, ignored for anything other than WebP.
+ */
+void guac_encode_pool_submit(guac_encode_pool* pool, guac_socket* socket,
+        guac_encode_format format, guac_composite_mode mode,
+        const guac_layer* layer, int x, int y, cairo_surface_t* surface,
+        int quality, int lossless);
+
+/**
+ * Waits for every image submitted to the given pool to finish encoding,
+ * emitting each over its socket in submission order.
+ *
+ * @param pool
+ *     The encoder pool to flush.
+ */
+void guac_encode_pool_flush(guac_encode_pool* pool);
+
+#endif
+
@@ -31,6 +31,12 @@
  * Encodes the given surface as a WebP, and sends the resulting data over the
  * given stream and socket as blobs.
  *
+ * The time taken and the bytes written are recorded within the metrics of
+ * the process, labeled with the image format.
+ *
+ * When built with Boost, each thread reuses its pixel buffer and, while the
+ * quality and losslessness are unchanged, its encoder configuration.
+ *
  * @param socket
  *     The socket to send WebP blobs over.
  *
@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_METRICS_H
+#define GUAC_METRICS_H
+
+/**
+ * A process-wide registry of counters, gauges and histograms describing the
+ * work done by the process, such as frames sent and time spent encoding
+ * images. The registry is rendered as text for collection by a parent
+ * process, which aggregates it with the registries of its other children.
+ *
+ * Metrics are identified by their name, which may carry labels in the form
+ * name{label="value"}. Each rendered line describes a single metric:
+ *
+ *     counter NAME VALUE
+ *     gauge NAME VALUE
+ *     histogram NAME COUNT SUM BUCKET_0 ... BUCKET_N
+ *
+ * where the bucket values are the number of observations falling within each
+ * bucket, not cumulative, the last bucket being unbounded.
+ *
+ * @file metrics.h
+ */
+
+#include <guacamole/config.h>
+
+#include <stdint.h>
+
+/**
+ * The number of buckets of every histogram, including the final unbounded
+ * bucket.
+ */
+#define GUAC_METRICS_HISTOGRAM_BUCKETS 12
+
+/**
+ * Returns the inclusive upper bound of the given histogram bucket, in the unit
+ * of the observed values. Every histogram shares the same buckets, which are
+ * suited to durations in milliseconds.
+ *
+ * @param bucket
+ *     The index of the bucket, which must be less than
+ *     GUAC_METRICS_HISTOGRAM_BUCKETS - 1, as the last bucket is unbounded.
+ *
+ * @return
+ *     The upper bound of the given bucket.
+ */
+double guac_metrics_histogram_bound(int bucket);
+
+/**
+ * Adds the given value to the counter having the given name, creating the
+ * counter if it does not yet exist.
+ *
+ * @param name
+ *     The name of the counter, optionally including labels.
+ *
+ * @param value
+ *     The value to add.
+ */
+void guac_metrics_counter_add(const char* name, uint64_t value);
+
+/**
+ * Sets the counter having the given name to the given value, creating the
+ * counter if it does not yet exist. This is intended for values which are
+ * already counted elsewhere, and which must only ever increase.
+ *
+ * @param name
+ *     The name of the counter, optionally including labels.
+ *
+ * @param value
+ *     The new value of the counter.
+ */
+void guac_metrics_counter_set(const char* name, uint64_t value);
+
+/**
+ * Sets the gauge having the given name to the given value, creating the gauge
+ * if it does not yet exist.
+ *
+ * @param name
+ *     The name of the gauge, optionally including labels.
+ *
+ * @param value
+ *     The new value of the gauge.
+ */
+void guac_metrics_gauge_set(const char* name, double value);
+
+/**
+ * Records an observation within the histogram having the given name, creating
+ * the histogram if it does not yet exist.
+ *
+ * @param name
+ *     The name of the histogram, optionally including labels.
+ *
+ * @param value
+ *     The observed value.
+ */
+void guac_metrics_histogram_observe(const char* name, double value);
+
+/**
+ * Returns the current value of a monotonic clock, in microseconds, for timing
+ * the durations recorded within histograms. The value of a single call has no
+ * defined meaning.
+ *
+ * @return
+ *     An arbitrary microsecond timestamp.
+ */
+int64_t guac_metrics_time_usec();
+
+/**
+ * Renders every metric registered so far as text, one metric per line, in the
+ * format described above.
+ *
+ * @return
+ *     A newly-allocated, null-terminated string which must be freed with
+ *     free().
+ */
+char* guac_metrics_render();
+
+#endif
+
@@ -0,0 +1,198 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_QUALITY_H
+#define GUAC_QUALITY_H
+
+/**
+ * Adaptive controller which trades image quality and frame rate for latency,
+ * based on the round trip and throughput measured from sync acknowledgements.
+ *
+ * @file quality.h
+ */
+
+#include <guacamole/config.h>
+#include <guacamole/timestamp-types.h>
+
+#include <stdint.h>
+
+/**
+ * The latency, in milliseconds, which the controller attempts to stay within.
+ * Once exceeded, quality and frame rate are reduced. Once latency falls below
+ * half of this value, they are gradually restored.
+ */
+#define GUAC_QUALITY_TARGET_LATENCY 150
+
+/**
+ * The highest lossy image quality used, and the quality used until the first
+ * measurements are available. Range 0-100 where 100 is the highest
+ * quality/largest file size.
+ */
+#define GUAC_QUALITY_MAX_IMAGE_QUALITY 90
+
+/**
+ * The lowest lossy image quality the controller will fall back to.
+ */
+#define GUAC_QUALITY_MIN_IMAGE_QUALITY 30
+
+/**
+ * The amount image quality is reduced by each time the target latency is
+ * exceeded.
+ */
+#define GUAC_QUALITY_IMAGE_QUALITY_DECREASE 10
+
+/**
+ * The amount image quality is restored by each time latency is comfortably
+ * within the target.
+ */
+#define GUAC_QUALITY_IMAGE_QUALITY_INCREASE 2
+
+/**
+ * The highest PNG optimality below which lossy compression is chosen. PNG
+ * optimality is positive where PNG is likely to compress better, thus raising
+ * the threshold above zero favors lossy compression for more content.
+ */
+#define GUAC_QUALITY_MAX_LOSSY_THRESHOLD 0x300
+
+/**
+ * The amount the lossy threshold is raised or lowered by with each
+ * adjustment.
+ */
+#define GUAC_QUALITY_LOSSY_THRESHOLD_STEP 0x80
+
+/**
+ * The largest factor, as a percentage, by which frame durations may be
+ * stretched.
+ */
+#define GUAC_QUALITY_MAX_FRAME_SCALE 400
+
+/**
+ * The minimum amount of time, in milliseconds, between adjustments, allowing
+ * the effect of each adjustment to be measured before the next.
+ */
+#define GUAC_QUALITY_ADJUST_INTERVAL 250
+
+/**
+ * The minimum amount of time, in milliseconds, between acknowledgements for
+ * a throughput sample to be taken.
+ */
+#define GUAC_QUALITY_MIN_SAMPLE_INTERVAL 20
+
+/**
+ * The state of the quality controller of a single user, or the aggregate
+ * settings of all users of a client.
+ */
+typedef struct guac_quality {
+
+    /**
+     * The smoothed time between sending a sync and receiving its
+     * acknowledgement, in milliseconds, or zero if not yet measured.
+     */
+    int round_trip;
+
+    /**
+     * The smoothed rate at which sent data is acknowledged, in bytes per
+     * millisecond, or zero if not yet measured.
+     */
+    int bandwidth;
+
+    /**
+     * The time the last acknowledgement used for a throughput sample was
+     * received, or zero if none has been received.
+     */
+    guac_timestamp last_ack_timestamp;
+
+    /**
+     * The number of bytes which had been sent at the time of the sync
+     * acknowledged by the last throughput sample.
+     */
+    int64_t last_ack_bytes;
+
+    /**
+     * The time settings were last adjusted, or zero if never adjusted.
+     */
+    guac_timestamp last_adjust_timestamp;
+
+    /**
+     * The JPEG/WebP quality to use, from GUAC_QUALITY_MIN_IMAGE_QUALITY to
+     * GUAC_QUALITY_MAX_IMAGE_QUALITY.
+     */
+    int image_quality;
+
+    /**
+     * The PNG optimality below which lossy compression should be preferred,
+     * from zero to GUAC_QUALITY_MAX_LOSSY_THRESHOLD.
+     */
+    int lossy_threshold;
+
+    /**
+     * The factor, as a percentage, by which frame durations should be
+     * stretched, from 100 to GUAC_QUALITY_MAX_FRAME_SCALE.
+     */
+    int frame_scale;
+
+} guac_quality;
+
+/**
+ * Resets the given controller to full quality with no measurements.
+ *
+ * @param quality
+ *     The controller to reset.
+ */
+void guac_quality_init(guac_quality* quality);
+
+/**
+ * Updates the given controller with the measurements from a single sync
+ * acknowledgement, adjusting its settings toward the target latency.
+ *
+ * @param quality
+ *     The controller to update.
+ *
+ * @param now
+ *     The time the acknowledgement was received.
+ *
+ * @param round_trip
+ *     The time between sending the acknowledged sync and receiving its
+ *     acknowledgement, in milliseconds.
+ *
+ * @param acked_bytes
+ *     The total number of bytes sent prior to the acknowledged sync, or -1 if
+ *     unknown.
+ *
+ * @param sent_bytes
+ *     The total number of bytes sent so far.
+ */
+void guac_quality_update(guac_quality* quality, guac_timestamp now,
+        int round_trip, int64_t acked_bytes, int64_t sent_bytes);
+
+/**
+ * Merges the settings of the given controller into the given aggregate, such
+ * that the aggregate suits the worst-performing of all merged controllers.
+ * The aggregate should first be reset with guac_quality_init().
+ *
+ * @param aggregate
+ *     The aggregate settings to update.
+ *
+ * @param quality
+ *     The controller to merge.
+ */
+void guac_quality_merge(guac_quality* aggregate, const guac_quality* quality);
+
+#endif
+
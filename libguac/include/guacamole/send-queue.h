@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_SEND_QUEUE_H
+#define GUAC_SEND_QUEUE_H
+
+/**
+ * Bounded per-user queues of broadcast instructions, each drained to the
+ * user's socket by a dedicated writer thread, such that a user on a slow link
+ * cannot stall the thread producing instructions for all users.
+ *
+ * @file send-queue.h
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/client-types.h>
+#include <guacamole/user-types.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+/**
+ * A complete, immutable instruction shared by the send queues of all users it
+ * is broadcast to. The buffer is freed once every queue has written it.
+ */
+typedef boost::shared_ptr<const std::vector<char> > guac_send_chunk;
+
+typedef struct guac_send_queue guac_send_queue;
+
+/**
+ * Allocates a new send queue for the given user, starting its writer thread.
+ * The size and overflow policy of the queue are taken from the user's
+ * guac_client.
+ *
+ * @param user
+ *     The user whose socket the queue should be drained to.
+ *
+ * @return
+ *     A newly-allocated send queue.
+ */
+guac_send_queue* guac_send_queue_alloc(guac_user* user);
+
+/**
+ * Stops the writer thread of the given send queue, discarding anything not
+ * yet written, and frees the queue. This must be invoked only after the user
+ * has been removed from the user list of its client.
+ *
+ * @param queue
+ *     The send queue to free.
+ */
+void guac_send_queue_free(guac_send_queue* queue);
+
+/**
+ * Appends the given instruction to the given send queue. This never blocks.
+ * If the queue would grow beyond its maximum size, the overflow policy of the
+ * client is applied instead.
+ *
+ * @param queue
+ *     The send queue to append to.
+ *
+ * @param chunk
+ *     The complete instruction to append.
+ */
+void guac_send_queue_push(guac_send_queue* queue, const guac_send_chunk& chunk);
+
+/**
+ * Requests that the user's socket be flushed once everything currently
+ * queued has been written. This never blocks.
+ *
+ * @param queue
+ *     The send queue to flush.
+ */
+void guac_send_queue_flush(guac_send_queue* queue);
+
+/**
+ * Returns the number of bytes which have been queued but not yet written to
+ * the user's socket, including any data still queued within that socket.
+ *
+ * @param queue
+ *     The send queue to query.
+ *
+ * @return
+ *     The number of bytes queued for the user.
+ */
+int guac_send_queue_depth(guac_send_queue* queue);
+
+#endif
+
@@ -111,5 +111,19 @@ typedef void guac_socket_unlock_handler(guac_socket* socket);
 typedef int guac_socket_free_handler(guac_socket* socket);
 typedef void guac_socket_reset_handler(guac_socket* socket);
 
+/**
+ * When set within a guac_socket, a handler of this type will be called
+ * whenever guac_socket_queue_depth() is invoked, to report how much data
+ * written to the socket has not yet been consumed by the other side.
+ *
+ * @param socket
+ *     The guac_socket whose queue depth is requested.
+ *
+ * @return
+ *     The approximate number of bytes written to the socket which are still
+ *     waiting to be consumed.
+ */
+typedef int guac_socket_queue_depth_handler(guac_socket* socket);
+
 #endif
 
@@ -37,6 +37,8 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+
+#include <atomic>
 #elif defined HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -88,6 +90,12 @@ struct guac_socket {
     guac_socket_free_handler* free_handler;
     guac_socket_reset_handler* reset_handler;
 
+    /**
+     * Handler which will be called whenever guac_socket_queue_depth() is
+     * invoked on this socket.
+     */
+    guac_socket_queue_depth_handler* queue_depth_handler;
+
     /**
      * The current state of this guac_socket.
      */
@@ -99,6 +107,17 @@ struct guac_socket {
      */
     guac_timestamp last_write_timestamp;
 
+    /**
+     * The total number of bytes written to this guac_socket since it was
+     * allocated. This may be read by any thread, such as when users
+     * acknowledge syncs, while the socket is being written.
+     */
+#ifdef HAVE_BOOST
+	std::atomic<int64_t> bytes_written;
+#elif defined HAVE_LIBPTHREAD
+    int64_t bytes_written;
+#endif
+
     /**
      * The number of bytes present in the base64 "ready" buffer.
      */
@@ -357,6 +376,20 @@ size_t guac_socket_flush_base64(guac_socket* socket);
  */
 size_t guac_socket_flush(guac_socket* socket);
 
+/**
+ * Returns the approximate number of bytes written to the given socket which
+ * have not yet been consumed by the other side. Sockets which do not queue
+ * data, or cannot tell, always report zero. A growing depth means the
+ * receiving side is not keeping up, and writes will eventually block.
+ *
+ * @param socket
+ *     The guac_socket to query.
+ *
+ * @return
+ *     The approximate number of bytes queued on the given socket.
+ */
+int guac_socket_queue_depth(guac_socket* socket);
+
 /**
  * Waits for input to be available on the given guac_socket object until the
  * specified timeout elapses.
@@ -381,13 +414,97 @@ int guac_socket_select(guac_socket* socket, int usec_timeout);
 void guac_socket_reset(guac_socket* socket);
 
 guac_socket* guac_socket_boost_file(const char * file);
+/**
+ * Creates a new write-only guac_socket which writes to the given file through
+ * a bounded in-memory ring buffer, drained by a dedicated writer thread in
+ * large sequential writes. Writing to the returned socket only copies data
+ * into the buffer, unless the buffer is full and the overflow policy blocks.
+ * Flushing the socket never blocks, but requests that everything written so
+ * far reach the file once the writer is idle.
+ *
+ * If the file cannot be created, NULL is returned, and guac_error is set
+ * appropriately.
+ *
+ * @param file
+ *     The path of the file to create. Any existing file is replaced.
+ *
+ * @param buffer_size
+ *     The size of the ring buffer, in bytes.
+ *
+ * @param policy
+ *     The action taken when the ring buffer cannot hold the data written.
+ *     If recording stops, the file ends with the last instruction which was
+ *     written to the socket in full.
+ *
+ * @param compress
+ *     Non-zero if the data should be gzip compressed by the writer thread.
+ *
+ * @return
+ *     A newly allocated guac_socket writing to the given file, or NULL if
+ *     the file cannot be created.
+ */
+guac_socket* guac_socket_async_file(const char* file, size_t buffer_size,
+        guac_recording_overflow_policy policy, int compress);
+
+/**
+ * Returns whether the given socket, created with guac_socket_async_file(),
+ * has stopped recording, either because the file could not be written or
+ * because the ring buffer overflowed under the stop policy. Data written to a
+ * stopped socket is discarded, though still counted within bytes_written.
+ *
+ * @param socket
+ *     The socket to check, as created with guac_socket_async_file().
+ *
+ * @return
+ *     Non-zero if the socket has stopped recording, zero otherwise.
+ */
+int guac_socket_async_file_stopped(guac_socket* socket);
+/**
+ * Wraps the given connected boost socket, which may be SSL, in a guac_socket.
+ * The io_service of the socket must be run by the caller, as selecting on the
+ * returned guac_socket waits for an asynchronous operation to complete.
+ */
 guac_socket* guac_socket_boost_tcp_socket(const boost::shared_ptr<boost::asio::ip::tcp::socket> & tcp_socket);
 guac_socket* guac_socket_boost_tcp_socket(const boost::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> & tcp_ssl_socket);
 guac_socket* guac_socket_iostream_socket();
 guac_socket* guac_socket_named_pipe_socket_create(const std::string & pipe_name);
 guac_socket* guac_socket_named_pipe_socket_join(const std::string & pipe_name);
-guac_socket* guac_socket_shared_memory_socket_create(const std::string & shname, bool multi_read, bool streamlined, int queue_size, int packet_size);
-guac_socket* guac_socket_shared_memory_socket_join(const std::string & shname, bool multi_read, bool streamlined);
+guac_socket* guac_socket_shared_memory_socket_create(const std::string & shname, bool multi_read, bool streamlined, int queue_size, int packet_size, bool ring_buffer = false);
+guac_socket* guac_socket_shared_memory_socket_join(const std::string & shname, bool multi_read, bool streamlined, bool ring_buffer = false);
+/**
+ * Exposes the data currently readable from a ring buffer shared memory socket
+ * in place, without copying it out. The readable bytes are contiguous in the
+ * mapped region unless they wrap around its end, in which case they are split
+ * in two spans. The spans stay valid until guac_socket_shared_memory_socket_commit_read()
+ * is called, and only the single reader of the socket may use this.
+ *
+ * @param socket The ring buffer shared memory socket to read from.
+ * @param first Receives the start of the first span.
+ * @param first_size Receives the size of the first span.
+ * @param second Receives the start of the second span.
+ * @param second_size Receives the size of the second span, zero if the data does not wrap.
+ * @return The total number of readable bytes, zero if none or if the socket is not a ring buffer.
+ */
+size_t guac_socket_shared_memory_socket_peek_spans(guac_socket* socket, const char** first, size_t* first_size, const char** second, size_t* second_size);
+/**
+ * Releases the given number of bytes, previously exposed by
+ * guac_socket_shared_memory_socket_peek_spans(), back to the writer.
+ *
+ * @param socket The ring buffer shared memory socket which was read from.
+ * @param count The number of bytes consumed from the start of the spans.
+ */
+void guac_socket_shared_memory_socket_commit_read(guac_socket* socket, size_t count);
+/**
+ * Writes as much of the given data to a shared memory socket as fits without
+ * waiting for the reader, for callers which must not block, such as handlers
+ * running on an IO service thread.
+ *
+ * @param socket The shared memory socket to write to.
+ * @param buf The data to write.
+ * @param count The number of bytes of data to write.
+ * @return The number of bytes written, zero if the socket is full, or -1 if an error occurred.
+ */
+size_t guac_socket_shared_memory_socket_try_write(guac_socket* socket, const void* buf, size_t count);
 
 #endif
 
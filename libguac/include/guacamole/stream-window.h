@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_STREAM_WINDOW_H
+#define GUAC_STREAM_WINDOW_H
+
+/**
+ * Sliding-window flow control for outbound streams, allowing several blobs to
+ * be in flight at once rather than waiting for each blob to be acknowledged
+ * before sending the next. The size of the window follows the rate at which
+ * blobs are acknowledged, such that transfers fill the available bandwidth
+ * without queueing more data than the connection can carry.
+ *
+ * The Guacamole client acknowledges the stream itself and then each blob, in
+ * order, thus acknowledgements are matched to blobs purely by position.
+ *
+ * @file stream-window.h
+ */
+
+#include <guacamole/config.h>
+#include <guacamole/protocol-types.h>
+
+/**
+ * The number of blobs which may be in flight before the first blob has been
+ * acknowledged.
+ */
+#define GUAC_STREAM_WINDOW_INITIAL_BLOBS 4
+
+/**
+ * The smallest number of blobs the window will shrink to.
+ */
+#define GUAC_STREAM_WINDOW_MIN_BLOBS 2
+
+/**
+ * The default upper bound on the number of blobs in flight.
+ */
+#define GUAC_STREAM_WINDOW_DEFAULT_MAX_BLOBS 64
+
+/**
+ * The flow control state of a single outbound stream.
+ */
+typedef struct guac_stream_window guac_stream_window;
+
+/**
+ * Allocates the flow control state for a new outbound stream. The stream is
+ * not considered open, and no blobs may be sent, until the stream itself has
+ * been acknowledged. This should thus be invoked immediately before the
+ * instruction opening the stream is sent.
+ *
+ * @param max_blobs
+ *     The maximum number of blobs which may be in flight at once, regardless
+ *     of the observed acknowledgement rate.
+ *
+ * @return
+ *     A newly-allocated guac_stream_window.
+ */
+guac_stream_window* guac_stream_window_alloc(int max_blobs);
+
+/**
+ * Frees the given guac_stream_window. No thread may be waiting within
+ * guac_stream_window_wait() on the given window.
+ *
+ * @param window
+ *     The guac_stream_window to free.
+ */
+void guac_stream_window_free(guac_stream_window* window);
+
+/**
+ * Returns the number of blobs which may be sent immediately.
+ *
+ * @param window
+ *     The guac_stream_window to query.
+ *
+ * @return
+ *     The number of blobs which may be sent, or zero if the stream is not yet
+ *     open, has been closed, or the window is full.
+ */
+int guac_stream_window_available(guac_stream_window* window);
+
+/**
+ * Returns the number of blobs which have been sent but not yet acknowledged.
+ *
+ * @param window
+ *     The guac_stream_window to query.
+ *
+ * @return
+ *     The number of unacknowledged blobs.
+ */
+int guac_stream_window_pending(guac_stream_window* window);
+
+/**
+ * Records that a blob has been sent along the stream. The caller must have
+ * determined that room was available with guac_stream_window_available() or
+ * guac_stream_window_wait().
+ *
+ * @param window
+ *     The guac_stream_window of the stream the blob was sent along.
+ */
+void guac_stream_window_sent(guac_stream_window* window);
+
+/**
+ * Records an acknowledgement received for the stream, opening the stream if
+ * this is the first acknowledgement, or releasing the oldest in-flight blob
+ * otherwise. The size of the window is adjusted using the time the
+ * acknowledged blob spent in flight. Any thread waiting within
+ * guac_stream_window_wait() is woken.
+ *
+ * @param window
+ *     The guac_stream_window of the acknowledged stream.
+ *
+ * @param status
+ *     The status code of the received acknowledgement. Any status other than
+ *     GUAC_PROTOCOL_STATUS_SUCCESS closes the window.
+ *
+ * @return
+ *     Zero if the acknowledgement was successful, non-zero if the window has
+ *     been closed.
+ */
+int guac_stream_window_ack(guac_stream_window* window,
+        guac_protocol_status status);
+
+/**
+ * Suspends the current thread until at least one blob may be sent, or until
+ * the window is closed.
+ *
+ * @param window
+ *     The guac_stream_window to wait for.
+ *
+ * @return
+ *     Non-zero if a blob may now be sent, zero if the window has been closed.
+ */
+int guac_stream_window_wait(guac_stream_window* window);
+
+/**
+ * Suspends the current thread until every blob sent has been acknowledged, or
+ * until the window is closed. This allows a stream to be ended without any
+ * acknowledgements arriving after its index has been released for reuse.
+ *
+ * @param window
+ *     The guac_stream_window to wait for.
+ *
+ * @return
+ *     Non-zero if all blobs have been acknowledged, zero if the window has
+ *     been closed.
+ */
+int guac_stream_window_drain(guac_stream_window* window);
+
+/**
+ * Closes the given window, such that no further blobs may be sent and any
+ * thread waiting within guac_stream_window_wait() returns.
+ *
+ * @param window
+ *     The guac_stream_window to close.
+ */
+void guac_stream_window_close(guac_stream_window* window);
+
+#endif
+
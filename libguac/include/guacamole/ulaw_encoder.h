@@ -0,0 +1,76 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_ULAW_ENCODER_H
+#define GUAC_ULAW_ENCODER_H
+
+#include <guacamole/config.h>
+
+#include <guacamole/audio.h>
+
+/**
+ * The base mimetype of audio encoded by the µ-law encoder, as defined for
+ * the PCMU payload format of RFC 3551. Each sample is a single byte, with
+ * samples of multiple channels interleaved as with raw PCM.
+ */
+#define GUAC_ULAW_ENCODER_MIMETYPE "audio/PCMU"
+
+/**
+ * The maximum number of bytes to send in each audio blob.
+ */
+#define GUAC_ULAW_ENCODER_BLOB_SIZE 6048
+
+/**
+ * The size of the µ-law encoder output buffer, in milliseconds. The
+ * equivalent size in bytes will vary by PCM rate and number of channels.
+ */
+#define GUAC_ULAW_ENCODER_BUFFER_SIZE 250
+
+/**
+ * The current state of the µ-law encoder. PCM data is encoded as it is
+ * written, halving the size of 16-bit audio, and buffered only as necessary
+ * to ensure audio packet sizes are reasonable.
+ */
+typedef struct ulaw_encoder_state {
+
+    /**
+     * Buffer of not-yet-written µ-law data.
+     */
+    unsigned char* buffer;
+
+    /**
+     * Size of the µ-law buffer, in bytes.
+     */
+    int length;
+
+    /**
+     * The current number of bytes stored within the µ-law buffer.
+     */
+    int written;
+
+} ulaw_encoder_state;
+
+/**
+ * Audio encoder which writes G.711 µ-law (one byte per sample).
+ */
+extern guac_audio_encoder* ulaw_encoder;
+
+#endif
+
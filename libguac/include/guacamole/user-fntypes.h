@@ -28,6 +28,7 @@
 
 #include <guacamole/object-types.h>
 #include <guacamole/protocol-types.h>
+#include <guacamole/socket-types.h>
 #include <guacamole/stream-types.h>
 #include <guacamole/timestamp-types.h>
 #include <guacamole/user-types.h>
@@ -354,6 +355,31 @@ typedef int guac_user_join_handler(guac_user* user, int argc, char** argv);
  */
 typedef int guac_user_leave_handler(guac_user* user);
 
+/**
+ * Handler for resync events. A resync event is fired by the guac_client
+ * whenever data broadcast to a guac_user had to be discarded because that
+ * user fell too far behind. The handler must send the complete current state
+ * of the connection over the given socket, as would be done for a newly-
+ * joined user. Instructions opening, acknowledging or closing streams are
+ * never discarded, so streams such as audio need not be announced again.
+ *
+ * Implementations of the resync handler MUST NOT use the client-level
+ * broadcast socket, nor invoke guac_client_foreach_user() or
+ * guac_client_for_owner().
+ *
+ * @param user
+ *     The user that must be brought back up to date.
+ *
+ * @param socket
+ *     The socket over which the current state must be sent. This socket
+ *     delivers data in order with all data subsequently broadcast to the
+ *     user.
+ *
+ * @return
+ *     Zero if the user has been brought up to date, non-zero otherwise.
+ */
+typedef int guac_user_resync_handler(guac_user* user, guac_socket* socket);
+
 /**
  * Handler for Guacamole sync events. A sync event is fired by the
  * guac_client whenever a guac_user responds to a "sync" instruction. Sync
@@ -37,8 +37,8 @@
 /**
  * Internal handler for Guacamole instructions. Instruction handlers will be
  * invoked when their corresponding instructions are received. The mapping
- * of instruction opcode to handler is defined by the
- * __guac_instruction_handler_map array.
+ * of instruction opcode to handler is defined by
+ * __guac_get_instruction_handler().
  *
  * @param user
  *     The user that sent the instruction.
@@ -54,23 +54,6 @@
  */
 typedef int __guac_instruction_handler(guac_user* user, int argc, char** argv);
 
-/**
- * Structure mapping an instruction opcode to an instruction handler.
- */
-typedef struct __guac_instruction_handler_mapping {
-
-    /**
-     * The instruction opcode which maps to a specific handler.
-     */
-    char* opcode;
-
-    /**
-     * The handler which maps to a specific opcode.
-     */
-    __guac_instruction_handler* handler;
-
-} __guac_instruction_handler_mapping;
-
 /**
  * Internal initial handler for the sync instruction. When a sync instruction
  * is received, this handler will be called. Sync instructions are automatically
@@ -171,12 +154,18 @@ __guac_instruction_handler __guac_handle_size;
 __guac_instruction_handler __guac_handle_disconnect;
 
 /**
- * Instruction handler mapping table. This is a NULL-terminated array of
- * __guac_instruction_handler_mapping structures, each mapping an opcode
- * to a __guac_instruction_handler. The end of the array must be marked
- * with a __guac_instruction_handler_mapping with the opcode set to
- * NULL (the NULL terminator).
+ * Returns the handler of the given instruction opcode. This is the only
+ * mapping of opcodes to handlers, so a new handler must be added here to be
+ * dispatched. Opcodes are told apart by a switch on their leading characters,
+ * such that at most one opcode is compared in full.
+ *
+ * @param opcode
+ *     The opcode of the instruction to handle.
+ *
+ * @return
+ *     The handler of the given opcode, or NULL if the opcode is not
+ *     recognized.
  */
-extern __guac_instruction_handler_mapping __guac_instruction_handler_map[];
+__guac_instruction_handler* __guac_get_instruction_handler(const char* opcode);
 
 #endif
@@ -32,6 +32,7 @@
 #include <guacamole/client-types.h>
 #include <guacamole/layer-types.h>
 #include <guacamole/pool-types.h>
+#include <guacamole/quality.h>
 #include <guacamole/socket-types.h>
 #include <guacamole/stream-types.h>
 #include <guacamole/timestamp-types.h>
@@ -109,6 +110,14 @@ struct guac_user {
      */
     guac_socket* socket;
 
+#ifdef HAVE_BOOST
+    /**
+     * The queue through which data broadcast to all users is delivered to
+     * this user, or NULL if broadcast data is written to socket directly.
+     */
+    struct guac_send_queue* __send_queue;
+#endif
+
     /**
      * The unique identifier allocated for this user, which may be used within
      * the Guacamole protocol to refer to this user.  This identifier is
@@ -170,6 +179,14 @@ struct guac_user {
      */
     int processing_lag;
 
+    /**
+     * The quality controller of this user, updated from the round trip and
+     * throughput measured each time the user responds to a sync. This must
+     * only be accessed while holding the __quality_lock of the client, as it
+     * is merged with the controllers of all other users.
+     */
+    guac_quality quality;
+
     /**
      * Information structure containing properties exposed by the remote
      * user during the initial handshake process.
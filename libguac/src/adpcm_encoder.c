@@ -0,0 +1,338 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <guacamole/config.h>
+
+#include <guacamole/adpcm_encoder.h>
+#include <guacamole/audio.h>
+
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_BOOST
+#include <sstream>
+#endif
+
+/**
+ * The IMA ADPCM quantizer step sizes, indexed by step index.
+ */
+static const int adpcm_step_sizes[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/**
+ * The adjustment to the step index following each code, indexed by the
+ * magnitude bits of the code.
+ */
+static const int adpcm_index_adjust[8] = {
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/**
+ * Encodes a single 16-bit sample as a 4-bit IMA ADPCM code, updating the
+ * predictor state of its channel exactly as the decoder will.
+ *
+ * @param channel
+ *     The predictor state of the channel the sample belongs to.
+ *
+ * @param sample
+ *     The sample to encode.
+ *
+ * @return
+ *     The 4-bit code representing the given sample.
+ */
+static int adpcm_encode_sample(adpcm_encoder_channel* channel, int sample) {
+
+    int step = adpcm_step_sizes[channel->step_index];
+    int diff = sample - channel->predictor;
+    int code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+
+    /* Quantize difference, accumulating the difference the decoder will
+     * reconstruct from the code */
+    int delta = step >> 3;
+
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    /* Update predictor */
+    if (code & 8)
+        channel->predictor -= delta;
+    else
+        channel->predictor += delta;
+
+    if (channel->predictor > 32767)
+        channel->predictor = 32767;
+    else if (channel->predictor < -32768)
+        channel->predictor = -32768;
+
+    /* Update step size */
+    channel->step_index += adpcm_index_adjust[code & 7];
+
+    if (channel->step_index < 0)
+        channel->step_index = 0;
+    else if (channel->step_index > 88)
+        channel->step_index = 88;
+
+    return code;
+
+}
+
+/**
+ * Encodes the given interleaved samples as a single block, writing the
+ * per-channel block headers followed by the 4-bit codes.
+ *
+ * @param state
+ *     The encoder state holding the predictor state of each channel.
+ *
+ * @param channels
+ *     The number of interleaved channels.
+ *
+ * @param samples
+ *     The samples to encode.
+ *
+ * @param count
+ *     The number of samples to encode, across all channels. This must be a
+ *     multiple of both the number of channels and two.
+ *
+ * @param output
+ *     The buffer to write the encoded block to, which must be large enough
+ *     to contain the block headers and count / 2 bytes of codes.
+ *
+ * @return
+ *     The number of bytes written to the output buffer.
+ */
+static int adpcm_encode_block(adpcm_encoder_state* state, int channels,
+        const int16_t* samples, int count, unsigned char* output) {
+
+    unsigned char* current = output;
+    int i;
+
+    /* Block header, allowing decoding to start at this block */
+    for (i = 0; i < channels; i++) {
+        adpcm_encoder_channel* channel = &state->channels[i];
+        *(current++) = (unsigned char) ((channel->predictor >> 8) & 0xFF);
+        *(current++) = (unsigned char) (channel->predictor & 0xFF);
+        *(current++) = (unsigned char) channel->step_index;
+        *(current++) = 0;
+    }
+
+    /* Two samples per byte, first sample in high nibble */
+    for (i = 0; i < count; i += 2) {
+        int high = adpcm_encode_sample(&state->channels[i % channels],
+                samples[i]);
+        int low = adpcm_encode_sample(&state->channels[(i + 1) % channels],
+                samples[i + 1]);
+        *(current++) = (unsigned char) ((high << 4) | low);
+    }
+
+    return (int) (current - output);
+
+}
+
+static void adpcm_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+#ifdef HAVE_BOOST
+    std::stringstream ss;
+    ss << GUAC_ADPCM_ENCODER_MIMETYPE << ";rate=" << audio->rate << ",channels=" << audio->channels;
+    guac_protocol_send_audio(socket, audio->stream, ss.str().c_str());
+#elif defined HAVE_LIBPTHREAD
+    char mimetype[256];
+
+    /* Produce mimetype string from format info */
+    snprintf(mimetype, sizeof(mimetype), GUAC_ADPCM_ENCODER_MIMETYPE
+            ";rate=%i,channels=%i", audio->rate, audio->channels);
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, mimetype);
+#endif
+}
+
+static void adpcm_encoder_begin_handler(guac_audio_stream* audio) {
+
+    adpcm_encoder_state* state;
+
+    /* Broadcast existence of stream */
+    adpcm_encoder_send_audio(audio, audio->client->socket);
+
+    /* Allocate and init encoder state */
+    audio->data = state = static_cast<adpcm_encoder_state*>(
+            calloc(1, sizeof(adpcm_encoder_state)));
+    state->written = 0;
+    state->length = GUAC_ADPCM_ENCODER_BUFFER_SIZE
+                    * audio->rate * audio->channels / 1000;
+
+    /* Samples are encoded in pairs of whole frames */
+    if (state->length < 2 * audio->channels)
+        state->length = 2 * audio->channels;
+
+    state->buffer = (int16_t*) malloc(state->length * sizeof(int16_t));
+
+}
+
+static void adpcm_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    adpcm_encoder_send_audio(audio, user->socket);
+
+}
+
+static void adpcm_encoder_end_handler(guac_audio_stream* audio) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    /* Free state information */
+    free(state->buffer);
+    free(state);
+
+}
+
+static void adpcm_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+    int bytes_per_sample = audio->bps / 8;
+
+    while (length >= bytes_per_sample) {
+
+        /* If no space remains, flush and retry */
+        if (state->written == state->length) {
+            guac_audio_stream_flush(audio);
+            continue;
+        }
+
+        /* Read little-endian 16-bit or signed 8-bit sample */
+        int16_t sample;
+        if (bytes_per_sample == 2)
+            sample = (int16_t) (pcm_data[0] | (pcm_data[1] << 8));
+        else
+            sample = (int16_t) (((int8_t) pcm_data[0]) * 256);
+
+        state->buffer[state->written++] = sample;
+
+        pcm_data += bytes_per_sample;
+        length -= bytes_per_sample;
+
+    }
+
+}
+
+static void adpcm_encoder_flush_handler(guac_audio_stream* audio) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+    guac_socket* socket = audio->client->socket;
+    guac_stream* stream = audio->stream;
+
+    unsigned char block[GUAC_ADPCM_ENCODER_BLOB_SIZE];
+    int channels = audio->channels;
+
+    /* Largest number of samples per block, a multiple of both the number of
+     * channels and two */
+    int block_samples = (GUAC_ADPCM_ENCODER_BLOB_SIZE - 4 * channels) * 2;
+    block_samples -= block_samples % (2 * channels);
+
+    /* Only whole pairs of whole frames can be encoded */
+    int remaining = state->written - state->written % (2 * channels);
+    const int16_t* current = state->buffer;
+
+    /* Encode and send buffered samples as blobs */
+    while (remaining > 0) {
+
+        int count = remaining;
+        if (count > block_samples)
+            count = block_samples;
+
+        int size = adpcm_encode_block(state, channels, current, count, block);
+        guac_protocol_send_blob(socket, stream, block, size);
+
+        current += count;
+        remaining -= count;
+
+    }
+
+    /* Retain any samples which could not yet be encoded */
+    state->written -= (int) (current - state->buffer);
+    memmove(state->buffer, current, state->written * sizeof(int16_t));
+
+}
+
+#ifdef HAVE_BOOST
+guac_audio_encoder _adpcm_encoder = {GUAC_ADPCM_ENCODER_MIMETYPE,
+	adpcm_encoder_begin_handler,
+	adpcm_encoder_write_handler,
+	adpcm_encoder_flush_handler,
+	adpcm_encoder_end_handler,
+	adpcm_encoder_join_handler
+};
+#elif defined HAVE_LIBPTHREAD
+/* IMA ADPCM encoder handlers */
+guac_audio_encoder _adpcm_encoder = {
+    .mimetype      = GUAC_ADPCM_ENCODER_MIMETYPE,
+    .begin_handler = adpcm_encoder_begin_handler,
+    .write_handler = adpcm_encoder_write_handler,
+    .flush_handler = adpcm_encoder_flush_handler,
+    .join_handler  = adpcm_encoder_join_handler,
+    .end_handler   = adpcm_encoder_end_handler
+};
+#endif
+
+/* Actual encoder definition */
+guac_audio_encoder* adpcm_encoder = &_adpcm_encoder;
+
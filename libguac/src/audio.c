@@ -19,17 +19,49 @@
 
 #include <guacamole/config.h>
 
+#include <guacamole/adpcm_encoder.h>
 #include <guacamole/raw_encoder.h>
+#include <guacamole/ulaw_encoder.h>
 
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Acquires the lock of the given audio stream. The lock is recursive, and may
+ * be acquired again by the thread already holding it.
+ *
+ * @param audio
+ *     The guac_audio_stream to lock.
+ */
+static void guac_audio_stream_lock(guac_audio_stream* audio) {
+#ifdef HAVE_BOOST
+    audio->__lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&audio->__lock);
+#endif
+}
+
+/**
+ * Releases the lock of the given audio stream.
+ *
+ * @param audio
+ *     The guac_audio_stream to unlock.
+ */
+static void guac_audio_stream_unlock(guac_audio_stream* audio) {
+#ifdef HAVE_BOOST
+    audio->__lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&audio->__lock);
+#endif
+}
+
 /**
  * Sets the encoder associated with the given guac_audio_stream, automatically
  * invoking its begin_handler. The guac_audio_stream MUST NOT already be
@@ -53,10 +85,37 @@ static void guac_audio_stream_set_encoder(guac_audio_stream* audio,
 
 }
 
+/**
+ * Returns whether the given user has declared support for the given audio
+ * mimetype.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @param mimetype
+ *     The base audio mimetype to look for, without any parameters.
+ *
+ * @return
+ *     Non-zero if the user supports the given mimetype, zero otherwise.
+ */
+static int guac_audio_user_supports(guac_user* user, const char* mimetype) {
+
+    int i;
+
+    for (i=0; user->info.audio_mimetypes[i] != NULL; i++) {
+        if (strcmp(user->info.audio_mimetypes[i], mimetype) == 0)
+            return 1;
+    }
+
+    return 0;
+
+}
+
 /**
  * Assigns a new audio encoder to the given guac_audio_stream based on the
- * audio mimetypes declared as supported by the given user. If no audio encoder
- * can be found, no new audio encoder is assigned, and the existing encoder is
+ * audio mimetypes declared as supported by the given user. Compressed
+ * encodings are preferred for 16-bit audio, falling back to raw PCM. If no
+ * audio encoder can be found, no new audio encoder is assigned, and the existing encoder is
  * left untouched (if any).
  *
  * @param user
@@ -84,7 +143,19 @@ static void* guac_audio_assign_encoder(guac_user* user, void* data) {
     if (user == NULL || audio->encoder != NULL)
         return audio->encoder;
 
-    /* For each supported mimetype, check for an associated encoder */
+    /* Prefer IMA ADPCM, a quarter of the size of 16-bit PCM */
+    if (bps == 16 && guac_audio_user_supports(user, adpcm_encoder->mimetype)) {
+        guac_audio_stream_set_encoder(audio, adpcm_encoder);
+        return audio->encoder;
+    }
+
+    /* Otherwise prefer µ-law, half the size of 16-bit PCM */
+    if (bps == 16 && guac_audio_user_supports(user, ulaw_encoder->mimetype)) {
+        guac_audio_stream_set_encoder(audio, ulaw_encoder);
+        return audio->encoder;
+    }
+
+    /* For each supported mimetype, check for an associated raw encoder */
     for (i=0; user->info.audio_mimetypes[i] != NULL; i++) {
 
         const char* mimetype = user->info.audio_mimetypes[i];
@@ -114,10 +185,25 @@ guac_audio_stream* guac_audio_stream_alloc(guac_client* client,
     guac_audio_stream* audio;
 
     /* Allocate stream */
+#ifdef HAVE_BOOST
+    audio = new guac_audio_stream();
+#elif defined HAVE_LIBPTHREAD
     audio = (guac_audio_stream*) calloc(1, sizeof(guac_audio_stream));
+
+    pthread_mutexattr_t lock_attributes;
+    pthread_mutexattr_init(&lock_attributes);
+    pthread_mutexattr_settype(&lock_attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&audio->__lock, &lock_attributes);
+    pthread_mutexattr_destroy(&lock_attributes);
+#endif
     audio->client = client;
     audio->stream = guac_client_alloc_stream(client);
 
+    /* Aggregate packets as configured for the client */
+#ifdef HAVE_BOOST
+    audio->aggregation_window = client->audio_aggregation_window;
+#endif
+
     /* Load PCM properties */
     audio->rate = rate;
     audio->channels = channels;
@@ -142,6 +228,8 @@ guac_audio_stream* guac_audio_stream_alloc(guac_client* client,
 void guac_audio_stream_reset(guac_audio_stream* audio,
         guac_audio_encoder* encoder, int rate, int channels, int bps) {
 
+    guac_audio_stream_lock(audio);
+
     /* Pull assigned encoder if no other encoder is requested */
     if (encoder == NULL)
         encoder = audio->encoder;
@@ -151,9 +239,13 @@ void guac_audio_stream_reset(guac_audio_stream* audio,
             && rate     == audio->rate
             && channels == audio->channels
             && bps      == audio->bps) {
+        guac_audio_stream_unlock(audio);
         return;
     }
 
+    /* Send any aggregated audio in the old format */
+    guac_audio_stream_flush(audio);
+
     /* Free old encoder data */
     if (audio->encoder != NULL && audio->encoder->end_handler)
         audio->encoder->end_handler(audio);
@@ -166,10 +258,14 @@ void guac_audio_stream_reset(guac_audio_stream* audio,
     /* Re-init encoder */
     guac_audio_stream_set_encoder(audio, encoder);
 
+    guac_audio_stream_unlock(audio);
+
 }
 
 void guac_audio_stream_add_user(guac_audio_stream* audio, guac_user* user) {
 
+    guac_audio_stream_lock(audio);
+
     /* Attempt to assign encoder if no encoder has yet been assigned */
     if (audio->encoder == NULL)
         guac_audio_assign_encoder(user, audio);
@@ -178,6 +274,8 @@ void guac_audio_stream_add_user(guac_audio_stream* audio, guac_user* user) {
     if (audio->encoder != NULL && audio->encoder->join_handler)
         audio->encoder->join_handler(audio, user);
 
+    guac_audio_stream_unlock(audio);
+
 }
 
 void guac_audio_stream_free(guac_audio_stream* audio) {
@@ -190,24 +288,90 @@ void guac_audio_stream_free(guac_audio_stream* audio) {
         audio->encoder->end_handler(audio);
 
     /* Free associated data */
+#ifdef HAVE_BOOST
+    delete audio;
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_destroy(&audio->__lock);
     free(audio);
+#endif
 
 }
 
 void guac_audio_stream_write_pcm(guac_audio_stream* audio, 
         const unsigned char* data, int length) {
 
+    guac_audio_stream_lock(audio);
+
+    /* Note arrival of the oldest unflushed audio */
+    if (audio->__pending_since == 0)
+        audio->__pending_since = guac_timestamp_current();
+
     /* Write data */
     if (audio->encoder != NULL && audio->encoder->write_handler)
         audio->encoder->write_handler(audio, data, length);
 
+    audio->__pending_bytes += length;
+
+    guac_audio_stream_unlock(audio);
+
 }
 
 void guac_audio_stream_flush(guac_audio_stream* audio) {
 
+    guac_audio_stream_lock(audio);
+
     /* Flush any buffered data */
     if (audio->encoder != NULL && audio->encoder->flush_handler)
         audio->encoder->flush_handler(audio);
 
+    /* Nothing remains pending */
+    audio->__pending_since = 0;
+    audio->__pending_bytes = 0;
+
+    guac_audio_stream_unlock(audio);
+
+}
+
+void guac_audio_stream_end_packet(guac_audio_stream* audio) {
+
+    guac_audio_stream_lock(audio);
+
+    /* Bytes of PCM data spanning the aggregation window */
+    int window_bytes = audio->rate * audio->channels * (audio->bps / 8)
+                     / 1000 * audio->aggregation_window;
+
+    /* Flush once the window is filled or the oldest audio has waited long
+     * enough, whichever comes first */
+    if (audio->__pending_bytes >= window_bytes
+            || guac_timestamp_current() - audio->__pending_since
+                >= audio->aggregation_window)
+        guac_audio_stream_flush(audio);
+
+    guac_audio_stream_unlock(audio);
+
+}
+
+int guac_audio_stream_flush_pending(guac_audio_stream* audio) {
+
+    guac_audio_stream_lock(audio);
+
+    /* Nothing to do if no audio is pending */
+    if (audio->__pending_since == 0) {
+        guac_audio_stream_unlock(audio);
+        return -1;
+    }
+
+    /* Flush if the oldest audio has waited for the full window */
+    int remaining = (int) (audio->__pending_since + audio->aggregation_window
+                         - guac_timestamp_current());
+
+    if (remaining <= 0) {
+        guac_audio_stream_flush(audio);
+        remaining = -1;
+    }
+
+    guac_audio_stream_unlock(audio);
+    return remaining;
+
 }
 
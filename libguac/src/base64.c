@@ -0,0 +1,318 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/base64.h>
+
+#include <stddef.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GUAC_BASE64_X86
+#include <immintrin.h>
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define GUAC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define GUAC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GUAC_TARGET_SSSE3
+#define GUAC_TARGET_AVX2
+#endif
+
+/**
+ * The base64 alphabet, indexed by 6-bit value.
+ */
+static const char __guac_base64_characters[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
+    'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's',
+    't', 'u', 'v', 'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', '+', '/'
+};
+
+/**
+ * Signature shared by all encoder implementations. Each encodes complete
+ * three-byte groups only, returning the number of input bytes consumed.
+ */
+typedef size_t guac_base64_encoder(char* output, const unsigned char* input,
+        size_t count);
+
+static size_t __guac_base64_encode_scalar(char* output,
+        const unsigned char* input, size_t count) {
+
+    size_t groups = count / 3;
+    size_t i;
+
+    for (i = 0; i < groups; i++) {
+
+        unsigned int a = input[0];
+        unsigned int b = input[1];
+        unsigned int c = input[2];
+
+        output[0] = __guac_base64_characters[a >> 2];
+        output[1] = __guac_base64_characters[((a & 0x03) << 4) | (b >> 4)];
+        output[2] = __guac_base64_characters[((b & 0x0F) << 2) | (c >> 6)];
+        output[3] = __guac_base64_characters[c & 0x3F];
+
+        input += 3;
+        output += 4;
+
+    }
+
+    return groups * 3;
+
+}
+
+#ifdef GUAC_BASE64_X86
+
+/*
+ * The vectorized encoders below follow the approach described by Wojciech
+ * Muła: each 3-byte group is first spread across a 32-bit lane, the four
+ * 6-bit values are isolated with a pair of 16-bit multiplies, and the values
+ * are then mapped to ASCII by adding a per-range offset selected with a
+ * byte shuffle.
+ */
+
+/**
+ * Spreads the first twelve bytes of the given vector into sixteen 6-bit
+ * values, one per byte, in output order.
+ */
+GUAC_TARGET_SSSE3
+static __m128i __guac_base64_reshuffle_ssse3(__m128i in) {
+
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(
+                10, 11,  9, 10,
+                 7,  8,  6,  7,
+                 4,  5,  3,  4,
+                 1,  2,  0,  1));
+
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+    return _mm_or_si128(t1, t3);
+
+}
+
+/**
+ * Maps sixteen 6-bit values to their base64 characters.
+ */
+GUAC_TARGET_SSSE3
+static __m128i __guac_base64_translate_ssse3(__m128i in) {
+
+    /* Offsets for 'A'-'Z', 'a'-'z', '0'-'9', '+' and '/' respectively */
+    const __m128i lut = _mm_setr_epi8(
+            65, 71, -4, -4, -4, -4, -4, -4,
+            -4, -4, -4, -4, -19, -16, 0, 0);
+
+    /* Values 0-25 select offset 0, 26-51 offset 1, 52-63 offsets 2-13 */
+    __m128i index = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    __m128i above = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+    index = _mm_sub_epi8(index, above);
+
+    return _mm_add_epi8(_mm_shuffle_epi8(lut, index), in);
+
+}
+
+GUAC_TARGET_SSSE3
+static size_t __guac_base64_encode_ssse3(char* output,
+        const unsigned char* input, size_t count) {
+
+    size_t consumed = 0;
+
+    /* Each iteration encodes 12 bytes, but reads 16 */
+    while (count - consumed >= 16) {
+
+        __m128i in = _mm_loadu_si128((const __m128i*) (input + consumed));
+        __m128i out = __guac_base64_translate_ssse3(
+                __guac_base64_reshuffle_ssse3(in));
+
+        _mm_storeu_si128((__m128i*) output, out);
+
+        consumed += 12;
+        output += 16;
+
+    }
+
+    return consumed + __guac_base64_encode_scalar(output, input + consumed,
+            count - consumed);
+
+}
+
+/**
+ * Spreads the first twelve bytes of each 128-bit lane of the given vector
+ * into sixteen 6-bit values, one per byte, in output order.
+ */
+GUAC_TARGET_AVX2
+static __m256i __guac_base64_reshuffle_avx2(__m256i in) {
+
+    in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+                10, 11,  9, 10,
+                 7,  8,  6,  7,
+                 4,  5,  3,  4,
+                 1,  2,  0,  1,
+                10, 11,  9, 10,
+                 7,  8,  6,  7,
+                 4,  5,  3,  4,
+                 1,  2,  0,  1));
+
+    __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+
+    return _mm256_or_si256(t1, t3);
+
+}
+
+/**
+ * Maps thirty-two 6-bit values to their base64 characters.
+ */
+GUAC_TARGET_AVX2
+static __m256i __guac_base64_translate_avx2(__m256i in) {
+
+    /* Offsets for 'A'-'Z', 'a'-'z', '0'-'9', '+' and '/' respectively */
+    const __m256i lut = _mm256_setr_epi8(
+            65, 71, -4, -4, -4, -4, -4, -4,
+            -4, -4, -4, -4, -19, -16, 0, 0,
+            65, 71, -4, -4, -4, -4, -4, -4,
+            -4, -4, -4, -4, -19, -16, 0, 0);
+
+    /* Values 0-25 select offset 0, 26-51 offset 1, 52-63 offsets 2-13 */
+    __m256i index = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+    __m256i above = _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25));
+    index = _mm256_sub_epi8(index, above);
+
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lut, index), in);
+
+}
+
+GUAC_TARGET_AVX2
+static size_t __guac_base64_encode_avx2(char* output,
+        const unsigned char* input, size_t count) {
+
+    size_t consumed = 0;
+
+    /* Each iteration encodes 24 bytes, 12 per lane, but reads 28 */
+    while (count - consumed >= 28) {
+
+        const unsigned char* current = input + consumed;
+
+        __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) current)),
+                _mm_loadu_si128((const __m128i*) (current + 12)), 1);
+
+        __m256i out = __guac_base64_translate_avx2(
+                __guac_base64_reshuffle_avx2(in));
+
+        _mm256_storeu_si256((__m256i*) output, out);
+
+        consumed += 24;
+        output += 32;
+
+    }
+
+    return consumed + __guac_base64_encode_scalar(output, input + consumed,
+            count - consumed);
+
+}
+
+/**
+ * Returns whether the CPU supports SSSE3.
+ */
+static int __guac_base64_cpu_has_ssse3() {
+
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+
+}
+
+/**
+ * Returns whether the CPU and operating system both support AVX2.
+ */
+static int __guac_base64_cpu_has_avx2() {
+
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+
+    /* OSXSAVE and AVX */
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return 0;
+
+    /* XMM and YMM state enabled by the OS */
+    if ((_xgetbv(0) & 0x6) != 0x6)
+        return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+
+}
+
+#endif
+
+/**
+ * Selects the fastest encoder supported by the current CPU.
+ */
+static guac_base64_encoder* __guac_base64_select_encoder() {
+
+#ifdef GUAC_BASE64_X86
+    if (__guac_base64_cpu_has_avx2())
+        return __guac_base64_encode_avx2;
+
+    if (__guac_base64_cpu_has_ssse3())
+        return __guac_base64_encode_ssse3;
+#endif
+
+    return __guac_base64_encode_scalar;
+
+}
+
+size_t guac_base64_encode(char* output, const unsigned char* input,
+        size_t count) {
+
+    /* Initialization of function-local statics is thread-safe */
+    static guac_base64_encoder* encoder = __guac_base64_select_encoder();
+
+    return encoder(output, input, count);
+
+}
+
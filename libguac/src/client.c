@@ -23,13 +23,17 @@
 #include <guacamole/client.h>
 #include <guacamole/encode-jpeg.h>
 #include <guacamole/encode-png.h>
+#include <guacamole/encode-pool.h>
 #include <guacamole/encode-webp.h>
 #include <guacamole/error.h>
 #include <guacamole/id.h>
 #include <guacamole/layer.h>
+#include <guacamole/metrics.h>
 #include <guacamole/pool.h>
 #include <guacamole/plugin.h>
 #include <guacamole/protocol.h>
+#include <guacamole/quality.h>
+#include <guacamole/send-queue.h>
 #include <guacamole/socket.h>
 #include <guacamole/stream.h>
 #include <guacamole/timestamp.h>
@@ -134,6 +138,162 @@ void guac_client_free_stream(guac_client* client, guac_stream* stream) {
 
 }
 
+#ifdef HAVE_BOOST
+/**
+ * The number of times a join or leave yields while waiting for the readers of
+ * a replaced snapshot, before sleeping between checks instead. Readers are
+ * normally done within a few yields, but a reader writing directly to a
+ * stalled user may hold its snapshot for as long as that write blocks.
+ */
+#define GUAC_CLIENT_SNAPSHOT_SPINS 64
+
+/**
+ * The time a join or leave sleeps between checks of the readers of a replaced
+ * snapshot once done yielding, in milliseconds.
+ */
+#define GUAC_CLIENT_SNAPSHOT_SLEEP 1
+
+/**
+ * Immutable array of the users connected to a guac_client at some point in
+ * time. Snapshots are never modified once published; each join or leave
+ * publishes a new snapshot, freeing the replaced snapshot only once no thread
+ * can still be iterating it.
+ */
+typedef struct guac_user_snapshot {
+
+    /**
+     * The number of users within the users array.
+     */
+    int count;
+
+    /**
+     * The owner of the connection, or NULL if the owner has left.
+     */
+    guac_user* owner;
+
+    /**
+     * All connected users, in the order they were iterated by
+     * guac_client_foreach_user() before snapshots were introduced: the most
+     * recently joined user first.
+     */
+    guac_user** users;
+
+} guac_user_snapshot;
+
+/**
+ * Allocates a snapshot of the current users of the given client, as listed
+ * by __users. The __users_lock of the client must be held for writing.
+ *
+ * @param client
+ *     The client whose users should be captured.
+ *
+ * @return
+ *     A new snapshot, to be freed with free().
+ */
+static guac_user_snapshot* guac_client_snapshot_users(guac_client* client) {
+
+    /* Allocate the snapshot and its array as one block */
+    guac_user_snapshot* snapshot = static_cast<guac_user_snapshot*>(
+            malloc(sizeof(guac_user_snapshot)
+                + sizeof(guac_user*) * client->connected_users));
+
+    snapshot->count = 0;
+    snapshot->owner = client->__owner;
+    snapshot->users = (guac_user**) (snapshot + 1);
+
+    guac_user* current = client->__users;
+    while (current != NULL) {
+        snapshot->users[snapshot->count++] = current;
+        current = current->__next;
+    }
+
+    return snapshot;
+
+}
+
+/**
+ * Acquires the current snapshot of the users of the given client, which will
+ * not be freed until released with guac_client_release_users(). This never
+ * blocks, and may be nested.
+ *
+ * @param client
+ *     The client whose users should be acquired.
+ *
+ * @param epoch
+ *     Storage for the parity of the epoch under which the snapshot was
+ *     acquired, to be passed to guac_client_release_users().
+ *
+ * @return
+ *     The current snapshot of the users of the given client.
+ */
+static guac_user_snapshot* guac_client_acquire_users(guac_client* client,
+        int* epoch) {
+
+    /* Count this thread as a reader before loading the snapshot, such that
+     * a replaced snapshot is never freed once loaded */
+    *epoch = client->__user_snapshot_epoch.load() & 1;
+    client->__user_snapshot_readers[*epoch]++;
+
+    return client->__user_snapshot.load();
+
+}
+
+/**
+ * Releases a snapshot acquired with guac_client_acquire_users(). The snapshot
+ * and the users within it must not be used after this.
+ *
+ * @param client
+ *     The client whose users were acquired.
+ *
+ * @param epoch
+ *     The epoch parity stored by guac_client_acquire_users().
+ */
+static void guac_client_release_users(guac_client* client, int epoch) {
+    client->__user_snapshot_readers[epoch]--;
+}
+
+/**
+ * Publishes a new snapshot of the current users of the given client, waiting
+ * for all threads which may still be iterating the replaced snapshot before
+ * freeing it. Once this returns, no thread can reach a user which is no
+ * longer listed. The __users_lock of the client must be held for writing, and
+ * the calling thread must not itself hold a snapshot.
+ *
+ * @param client
+ *     The client whose users have changed.
+ */
+static void guac_client_publish_users(guac_client* client) {
+
+    guac_user_snapshot* replaced =
+        client->__user_snapshot.exchange(guac_client_snapshot_users(client));
+
+    /* Readers counted under either parity may hold the replaced snapshot.
+     * Switching parity before waiting on each count lets new readers proceed
+     * under the other count, so that each count is certain to drain. */
+    for (int i = 0; i < 2; i++) {
+
+        int previous = client->__user_snapshot_epoch.fetch_add(1) & 1;
+        for (int spins = 0;
+                client->__user_snapshot_readers[previous].load() != 0;
+                spins++) {
+
+            /* Back off to sleeping, rather than keeping a core busy for as
+             * long as a reader is stalled */
+            if (spins < GUAC_CLIENT_SNAPSHOT_SPINS)
+                boost::this_thread::yield();
+            else
+                boost::this_thread::sleep_for(boost::chrono::milliseconds(
+                            GUAC_CLIENT_SNAPSHOT_SLEEP));
+
+        }
+
+    }
+
+    free(replaced);
+
+}
+#endif
+
 guac_client* guac_client_alloc() {
 
     int i;
@@ -155,8 +315,25 @@ guac_client* guac_client_alloc() {
     client->args = __GUAC_CLIENT_NO_ARGS;
     client->state = GUAC_CLIENT_RUNNING;
     client->last_sent_timestamp = guac_timestamp_current();
+    guac_quality_init(&client->quality);
 #ifdef HAVE_BOOST
 	client->client_fps = 0;
+	client->__encode_pool = nullptr;
+	client->tile_cache_size = 0;
+	client->send_queue_size = 0;
+	client->send_queue_policy = GUAC_SEND_QUEUE_RESYNC;
+	client->resync_handler = nullptr;
+	client->audio_aggregation_window = 0;
+	client->recording_buffer_size = 0;
+	client->recording_overflow_policy = GUAC_RECORDING_OVERFLOW_BLOCK;
+	client->recording_compress = 0;
+	client->recording_keyframe_interval = 0;
+
+	/* Start with an empty snapshot, such that one is always present */
+	client->__user_snapshot.store(guac_client_snapshot_users(client));
+	client->__user_snapshot_readers[0].store(0);
+	client->__user_snapshot_readers[1].store(0);
+	client->__user_snapshot_epoch.store(0);
 #endif
     /* Generate ID */
     client->connection_id = guac_generate_id(GUAC_CLIENT_ID_PREFIX);
@@ -187,6 +364,7 @@ guac_client* guac_client_alloc() {
     pthread_rwlockattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
 
     pthread_rwlock_init(&(client->__users_lock), &lock_attributes);
+    pthread_mutex_init(&(client->__quality_lock), NULL);
 #endif
     /* Set up socket to broadcast to all users */
     client->socket = guac_socket_broadcast(client);
@@ -208,6 +386,11 @@ void guac_client_free(guac_client* client) {
 
     }
 
+#ifdef HAVE_BOOST
+    /* Emit any pending images and stop encoder threads */
+    guac_client_set_encoder_threads(client, 0);
+#endif
+
     /* Free socket */
     guac_socket_free(client->socket);
 
@@ -234,8 +417,11 @@ void guac_client_free(guac_client* client) {
             guac_client_log(client, GUAC_LOG_ERROR, "Unable to close plugin: %s", dlerror());
     }
 #endif
-#ifdef HAVE_LIBPTHREAD
+#ifdef HAVE_BOOST
+    free(client->__user_snapshot.load());
+#elif defined HAVE_LIBPTHREAD
     pthread_rwlock_destroy(&(client->__users_lock));
+    pthread_mutex_destroy(&(client->__quality_lock));
     free(client->connection_id);
 #endif
     free(client);
@@ -306,6 +492,12 @@ int guac_client_add_user(guac_client* client, guac_user* user, int argc, char**
     if (client->join_handler)
         retval = client->join_handler(user, argc, argv);
 
+#ifdef HAVE_BOOST
+    /* Deliver broadcast data to the user from a dedicated writer thread */
+    if (retval == 0 && client->send_queue_size > 0)
+        user->__send_queue = guac_send_queue_alloc(user);
+#endif
+
 #ifdef HAVE_BOOST
 	client->__users_lock.LockWrite();
 #elif defined HAVE_LIBPTHREAD
@@ -328,6 +520,11 @@ int guac_client_add_user(guac_client* client, guac_user* user, int argc, char**
         if (user->owner)
             client->__owner = user;
 
+#ifdef HAVE_BOOST
+        /* Include the user in future iterations */
+        guac_client_publish_users(client);
+#endif
+
     }
 
 #ifdef HAVE_BOOST
@@ -364,12 +561,25 @@ void guac_client_remove_user(guac_client* client, guac_user* user) {
 		if (user->owner)
 			client->__owner = NULL;
 
+#ifdef HAVE_BOOST
+		/* Wait for any iterations which may still reach the user */
+		guac_client_publish_users(client);
+#endif
+
 #ifdef HAVE_BOOST
 		client->__users_lock.UnLockWrite();
 #elif defined HAVE_LIBPTHREAD
 		pthread_rwlock_unlock(&(client->__users_lock));
 #endif
 	}
+
+#ifdef HAVE_BOOST
+    /* Nothing further can be broadcast to the user */
+    if (user->__send_queue != NULL) {
+        guac_send_queue_free(user->__send_queue);
+        user->__send_queue = NULL;
+    }
+#endif
     /* Call handler, if defined */
     if (user->leave_handler)
         user->leave_handler(user);
@@ -380,13 +590,19 @@ void guac_client_remove_user(guac_client* client, guac_user* user) {
 
 void guac_client_foreach_user(guac_client* client, guac_user_callback* callback, void* data) {
 
-    guac_user* current;
-	
 #ifdef HAVE_BOOST
-	client->__users_lock.LockRead();
+    int epoch;
+    guac_user_snapshot* snapshot = guac_client_acquire_users(client, &epoch);
+
+    /* Call function on each user */
+    for (int i = 0; i < snapshot->count; i++)
+        callback(snapshot->users[i], data);
+
+    guac_client_release_users(client, epoch);
 #elif defined HAVE_LIBPTHREAD
-	pthread_rwlock_wrlock(&(client->__users_lock));
-#endif
+    guac_user* current;
+
+	pthread_rwlock_rdlock(&(client->__users_lock));
 
     /* Call function on each user */
     current = client->__users;
@@ -394,9 +610,7 @@ void guac_client_foreach_user(guac_client* client, guac_user_callback* callback,
         callback(current, data);
         current = current->__next;
     }
-#ifdef HAVE_BOOST
-	client->__users_lock.UnLockRead();
-#elif defined HAVE_LIBPTHREAD
+
 	pthread_rwlock_unlock(&(client->__users_lock));
 #endif
 }
@@ -407,17 +621,19 @@ void* guac_client_for_owner(guac_client* client, guac_user_callback* callback,
     void* retval;
 
 #ifdef HAVE_BOOST
-	client->__users_lock.LockRead();
+    int epoch;
+    guac_user_snapshot* snapshot = guac_client_acquire_users(client, &epoch);
+
+    /* Invoke callback with current owner */
+    retval = callback(snapshot->owner, data);
+
+    guac_client_release_users(client, epoch);
 #elif defined HAVE_LIBPTHREAD
-	pthread_rwlock_wrlock(&(client->__users_lock));
-#endif
+	pthread_rwlock_rdlock(&(client->__users_lock));
 
     /* Invoke callback with current owner */
     retval = callback(client->__owner, data);
 
-#ifdef HAVE_BOOST
-	client->__users_lock.UnLockRead();
-#elif defined HAVE_LIBPTHREAD
 	pthread_rwlock_unlock(&(client->__users_lock));
 #endif
 
@@ -429,16 +645,27 @@ void* guac_client_for_owner(guac_client* client, guac_user_callback* callback,
 void* guac_client_for_user(guac_client* client, guac_user* user,
         guac_user_callback* callback, void* data) {
 
-    guac_user* current;
-
     int user_valid = 0;
     void* retval;
 
 #ifdef HAVE_BOOST
-	client->__users_lock.LockRead();
+    int epoch;
+    guac_user_snapshot* snapshot = guac_client_acquire_users(client, &epoch);
+
+    /* Search the snapshot for a pointer to the given user */
+    for (int i = 0; i < snapshot->count; i++) {
+
+        /* If the user's pointer exists in the list, they are indeed valid */
+        if (snapshot->users[i] == user) {
+            user_valid = 1;
+            break;
+        }
+
+    }
 #elif defined HAVE_LIBPTHREAD
-	pthread_rwlock_wrlock(&(client->__users_lock));
-#endif
+    guac_user* current;
+
+	pthread_rwlock_rdlock(&(client->__users_lock));
 
     /* Loop through all users, searching for a pointer to the given user */
     current = client->__users;
@@ -452,6 +679,7 @@ void* guac_client_for_user(guac_client* client, guac_user* user,
 
         current = current->__next;
     }
+#endif
 
     /* Use NULL if user does not actually exist */
     if (!user_valid)
@@ -461,7 +689,7 @@ void* guac_client_for_user(guac_client* client, guac_user* user,
     retval = callback(user, data);
 
 #ifdef HAVE_BOOST
-	client->__users_lock.UnLockRead();
+    guac_client_release_users(client, epoch);
 #elif defined HAVE_LIBPTHREAD
 	pthread_rwlock_unlock(&(client->__users_lock));
 #endif
@@ -475,6 +703,25 @@ int guac_client_end_frame(guac_client* client) {
 
     /* Update and send timestamp */
     client->last_sent_timestamp = guac_timestamp_current();
+
+    /* Remember how much data will have been received once acknowledged */
+#ifdef HAVE_BOOST
+	client->__quality_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&(client->__quality_lock));
+#endif
+    int index = client->__sync_index;
+    client->__sync_timestamps[index] = client->last_sent_timestamp;
+    client->__sync_bytes[index] = client->socket->bytes_written;
+    client->__sync_index = (index + 1) % GUAC_CLIENT_SYNC_HISTORY;
+#ifdef HAVE_BOOST
+	client->__quality_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&(client->__quality_lock));
+#endif
+
+    guac_metrics_counter_add("guac_frames_total", 1);
+
     return guac_protocol_send_sync(client->socket, client->last_sent_timestamp);
 
 }
@@ -606,13 +853,131 @@ int guac_client_get_processing_lag(guac_client* client) {
     /* Approximate the processing lag of all users */
     guac_client_foreach_user(client, __calculate_lag, &processing_lag);
 
+    /* Account for data which is still queued and has yet to be drained */
+    int queue_lag = guac_client_get_queue_depth(client)
+                  / GUAC_CLIENT_QUEUE_DEPTH_BYTES_PER_MS;
+
+    if (queue_lag > processing_lag)
+        processing_lag = queue_lag;
+
     return processing_lag;
 
 }
 
-void guac_client_stream_png(guac_client* client, guac_socket* socket,
+int guac_client_get_queue_depth(guac_client* client) {
+    return guac_socket_queue_depth(client->socket);
+}
+
+int64_t guac_client_get_sync_bytes(guac_client* client,
+        guac_timestamp timestamp) {
+
+    int i;
+    int64_t bytes = -1;
+
+#ifdef HAVE_BOOST
+	client->__quality_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&(client->__quality_lock));
+#endif
+
+    /* Search from most recent, as users generally lag by only a few frames */
+    for (i = 1; i <= GUAC_CLIENT_SYNC_HISTORY; i++) {
+
+        int index = (client->__sync_index - i + GUAC_CLIENT_SYNC_HISTORY)
+                  % GUAC_CLIENT_SYNC_HISTORY;
+
+        if (client->__sync_timestamps[index] == timestamp) {
+            bytes = client->__sync_bytes[index];
+            break;
+        }
+
+    }
+
+#ifdef HAVE_BOOST
+	client->__quality_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&(client->__quality_lock));
+#endif
+
+    return bytes;
+
+}
+
+/**
+ * Merges the quality settings of the given user into the provided aggregate.
+ * The __quality_lock of the client must be held.
+ *
+ * @param user
+ *     The guac_user whose quality controller should be merged.
+ *
+ * @param data
+ *     Pointer to the guac_quality aggregate being calculated.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __merge_quality(guac_user* user, void* data) {
+
+    guac_quality* quality = (guac_quality*) data;
+    guac_quality_merge(quality, &user->quality);
+
+    return NULL;
+
+}
+
+void guac_client_update_quality(guac_client* client) {
+
+    guac_quality quality;
+    guac_quality_init(&quality);
+
+    /* Settle on the settings of the slowest user */
+#ifdef HAVE_BOOST
+	client->__quality_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&(client->__quality_lock));
+#endif
+    guac_client_foreach_user(client, __merge_quality, &quality);
+    client->quality = quality;
+#ifdef HAVE_BOOST
+	client->__quality_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&(client->__quality_lock));
+#endif
+
+}
+
+void guac_client_get_quality(guac_client* client, guac_quality* quality) {
+
+#ifdef HAVE_BOOST
+	client->__quality_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&(client->__quality_lock));
+#endif
+    *quality = client->quality;
+#ifdef HAVE_BOOST
+	client->__quality_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&(client->__quality_lock));
+#endif
+
+}
+
+int guac_client_get_frame_duration(guac_client* client, int duration) {
+
+    guac_quality quality;
+    guac_client_get_quality(client, &quality);
+
+    return duration * quality.frame_scale / 100;
+
+}
+
+/**
+ * Streams the given surface as a PNG, as described by
+ * guac_client_stream_png(), compressing with the given PNG profile.
+ */
+static void __guac_client_stream_png(guac_client* client, guac_socket* socket,
         guac_composite_mode mode, const guac_layer* layer, int x, int y,
-        cairo_surface_t* surface) {
+        cairo_surface_t* surface, guac_png_profile profile) {
 
     /* Allocate new stream for image */
     guac_stream* stream = guac_client_alloc_stream(client);
@@ -621,7 +986,7 @@ void guac_client_stream_png(guac_client* client, guac_socket* socket,
     guac_protocol_send_img(socket, stream, mode, layer, "image/png", x, y);
 
     /* Write PNG data */
-    guac_png_write(socket, stream, surface);
+    guac_png_write(socket, stream, surface, profile);
 
     /* Terminate stream */
     guac_protocol_send_end(socket, stream);
@@ -631,6 +996,13 @@ void guac_client_stream_png(guac_client* client, guac_socket* socket,
 
 }
 
+void guac_client_stream_png(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface) {
+    __guac_client_stream_png(client, socket, mode, layer, x, y, surface,
+            GUAC_PNG_PROFILE_DEFAULT);
+}
+
 void guac_client_stream_jpeg(guac_client* client, guac_socket* socket,
         guac_composite_mode mode, const guac_layer* layer, int x, int y,
         cairo_surface_t* surface, int quality) {
@@ -707,6 +1079,84 @@ static void* __webp_support_callback(guac_user* user, void* data) {
 }
 #endif
 
+#ifdef HAVE_BOOST
+void guac_client_set_encoder_threads(guac_client* client, int threads) {
+
+    /* Stop existing pool, emitting anything still in flight */
+    if (client->__encode_pool != NULL) {
+        guac_encode_pool_free(client->__encode_pool);
+        client->__encode_pool = NULL;
+    }
+
+    if (threads > 0)
+        client->__encode_pool = guac_encode_pool_alloc(client, threads);
+
+}
+#endif
+
+void guac_client_stream_png_async(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, int fast) {
+
+#ifdef HAVE_BOOST
+    /* Encode in the background if encoder threads are available */
+    if (client->__encode_pool != NULL) {
+        guac_encode_pool_submit(client->__encode_pool, socket,
+                fast ? GUAC_ENCODE_PNG_FAST : GUAC_ENCODE_PNG,
+                mode, layer, x, y, surface, 0, 0);
+        return;
+    }
+#endif
+
+    __guac_client_stream_png(client, socket, mode, layer, x, y, surface,
+            fast ? GUAC_PNG_PROFILE_FAST : GUAC_PNG_PROFILE_DEFAULT);
+
+}
+
+void guac_client_stream_jpeg_async(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, int quality) {
+
+#ifdef HAVE_BOOST
+    /* Encode in the background if encoder threads are available */
+    if (client->__encode_pool != NULL) {
+        guac_encode_pool_submit(client->__encode_pool, socket,
+                GUAC_ENCODE_JPEG, mode, layer, x, y, surface, quality, 0);
+        return;
+    }
+#endif
+
+    guac_client_stream_jpeg(client, socket, mode, layer, x, y, surface,
+            quality);
+
+}
+
+void guac_client_stream_webp_async(guac_client* client, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, int quality, int lossless) {
+
+#if defined HAVE_BOOST && defined ENABLE_WEBP
+    /* Encode in the background if encoder threads are available */
+    if (client->__encode_pool != NULL) {
+        guac_encode_pool_submit(client->__encode_pool, socket,
+                GUAC_ENCODE_WEBP, mode, layer, x, y, surface, quality,
+                lossless);
+        return;
+    }
+#endif
+
+    guac_client_stream_webp(client, socket, mode, layer, x, y, surface,
+            quality, lossless);
+
+}
+
+void guac_client_flush_async_streams(guac_client* client) {
+#ifdef HAVE_BOOST
+    if (client->__encode_pool != NULL)
+        guac_encode_pool_flush(client->__encode_pool);
+#endif
+}
+
 int guac_client_supports_webp(guac_client* client) {
 
 #ifdef ENABLE_WEBP
@@ -20,8 +20,10 @@
 
 #include <guacamole/encode-jpeg.h>
 #include <guacamole/error.h>
+#include <guacamole/metrics.h>
 #include <guacamole/palette.h>
 #include <guacamole/protocol.h>
+#include <guacamole/socket.h>
 
 #include <cairo/cairo.h>
 extern "C"
@@ -30,6 +32,10 @@ extern "C"
 }
 #include <guacamole/stream.h>
 
+#ifdef HAVE_BOOST
+#include <boost/thread/tss.hpp>
+#endif
+
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -167,7 +173,121 @@ static void jpeg_guac_dest(j_compress_ptr cinfo, guac_socket* socket,
 
 }
 
-int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
+/**
+ * A libjpeg compressor kept between the images encoded by a single thread.
+ * libjpeg returns a compressor to its idle state once each image is finished,
+ * thus only the parameters of each image need be set again.
+ */
+typedef struct guac_jpeg_context {
+
+    /**
+     * The libjpeg compressor.
+     */
+    struct jpeg_compress_struct cinfo;
+
+    /**
+     * The error manager of the compressor.
+     */
+    struct jpeg_error_mgr jerr;
+
+    /**
+     * Buffer receiving each scanline converted from BGRx to RGB, where the
+     * library cannot read BGRx itself.
+     */
+    unsigned char* scanline;
+
+    /**
+     * The size of the scanline buffer, in bytes.
+     */
+    int scanline_size;
+
+} guac_jpeg_context;
+
+/**
+ * Allocates a new JPEG encoder context, creating its compressor.
+ *
+ * @return
+ *     The new context.
+ */
+static guac_jpeg_context* guac_jpeg_context_alloc() {
+
+    guac_jpeg_context* context =
+        (guac_jpeg_context*) malloc(sizeof(guac_jpeg_context));
+
+    context->cinfo.err = jpeg_std_error(&context->jerr);
+    jpeg_create_compress(&context->cinfo);
+
+    context->scanline = NULL;
+    context->scanline_size = 0;
+
+    return context;
+
+}
+
+/**
+ * Frees the given JPEG encoder context, destroying its compressor.
+ *
+ * @param context
+ *     The context to free.
+ */
+static void guac_jpeg_context_free(guac_jpeg_context* context) {
+    jpeg_destroy_compress(&context->cinfo);
+    free(context->scanline);
+    free(context);
+}
+
+#ifdef HAVE_BOOST
+/**
+ * The JPEG encoder context of each thread, allocated on first use and freed
+ * when the thread exits.
+ */
+static boost::thread_specific_ptr<guac_jpeg_context> __guac_jpeg_context(
+        guac_jpeg_context_free);
+#endif
+
+/**
+ * Returns the JPEG encoder context of the current thread, which must be
+ * released with guac_jpeg_context_release() once the image is written.
+ * Without Boost, a new context is allocated for each image.
+ *
+ * @return
+ *     The JPEG encoder context of the current thread.
+ */
+static guac_jpeg_context* guac_jpeg_context_acquire() {
+
+#ifdef HAVE_BOOST
+    guac_jpeg_context* context = __guac_jpeg_context.get();
+    if (context == NULL) {
+        context = guac_jpeg_context_alloc();
+        __guac_jpeg_context.reset(context);
+    }
+    return context;
+#else
+    return guac_jpeg_context_alloc();
+#endif
+
+}
+
+/**
+ * Releases the given context, acquired with guac_jpeg_context_acquire().
+ *
+ * @param context
+ *     The context to release.
+ */
+static void guac_jpeg_context_release(guac_jpeg_context* context) {
+#ifndef HAVE_BOOST
+    guac_jpeg_context_free(context);
+#endif
+}
+
+/**
+ * Writes the given surface as JPEG blobs, as described by guac_jpeg_write(),
+ * without recording metrics.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+static int __guac_jpeg_write(guac_socket* socket, guac_stream* stream,
         cairo_surface_t* surface, int quality) {
 
     /* Get image surface properties and data */
@@ -188,11 +308,9 @@ int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
     /* Flush pending operations to surface */
     cairo_surface_flush(surface);
 
-    /* Prepare JPEG bits */
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
+    /* Prepare JPEG bits, reusing the compressor of this thread */
+    guac_jpeg_context* context = guac_jpeg_context_acquire();
+    struct jpeg_compress_struct& cinfo = context->cinfo;
 
     /* Write JPEG directly to given stream */
     jpeg_guac_dest(&cinfo, socket, stream);
@@ -212,11 +330,15 @@ int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
     cinfo.input_components = 3;
     cinfo.in_color_space = JCS_RGB;
 
-    /* Create a buffer for the write scan line which is where we will
+    /* Grow the buffer for the write scan line which is where we will
      * put the converted pixels (BGRx -> RGB) */
     int write_stride = cinfo.image_width * cinfo.input_components;
-    unsigned char *scanline_data = static_cast<unsigned char*>(malloc(write_stride));
-    memset(scanline_data, 0, write_stride);
+    if (write_stride > context->scanline_size) {
+        free(context->scanline);
+        context->scanline = static_cast<unsigned char*>(malloc(write_stride));
+        context->scanline_size = write_stride;
+    }
+    unsigned char *scanline_data = context->scanline;
 #endif
 
     /* Initialize the JPEG compressor */
@@ -256,16 +378,32 @@ int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
         jpeg_write_scanlines(&cinfo, row_pointer, 1);
     }
 
-#ifndef JCS_EXTENSIONS
-    free(scanline_data);
-#endif
-
-    /* Finalize compression */
+    /* Finalize compression, leaving the compressor ready for the next
+     * image */
     jpeg_finish_compress(&cinfo);
 
-    /* Clean up */
-    jpeg_destroy_compress(&cinfo);
+    guac_jpeg_context_release(context);
     return 0;
 
 }
 
+int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
+        cairo_surface_t* surface, int quality) {
+
+    int64_t started = guac_metrics_time_usec();
+    int64_t written = socket->bytes_written;
+
+    int result = __guac_jpeg_write(socket, stream, surface, quality);
+
+    /* Bytes are counted as written to the socket, thus include the blob
+     * instructions around the encoded data */
+    guac_metrics_histogram_observe("guac_encode_milliseconds{format=\"jpeg\"}",
+            (guac_metrics_time_usec() - started) / 1000.0);
+    guac_metrics_counter_add("guac_encode_bytes_total{format=\"jpeg\"}",
+            socket->bytes_written - written);
+    guac_metrics_counter_add("guac_encode_images_total{format=\"jpeg\"}", 1);
+
+    return result;
+
+}
+
@@ -21,6 +21,7 @@
 
 #include <guacamole/encode-png.h>
 #include <guacamole/error.h>
+#include <guacamole/metrics.h>
 #include <guacamole/palette.h>
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
@@ -35,12 +36,93 @@ extern "C"
 #include <pngstruct.h>
 #endif
 
+#ifdef HAVE_BOOST
+#include <boost/thread/tss.hpp>
+#endif
+
 #include <inttypes.h>
 #include <setjmp.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * The largest total size, in bytes, of the memory blocks kept for reuse by the
+ * PNG encoder context of each thread.
+ */
+#define GUAC_PNG_CONTEXT_MAX_CACHED 4194304
+
+/**
+ * The zlib compression level of the fast PNG profile.
+ */
+#define GUAC_PNG_FAST_COMPRESSION_LEVEL 1
+
+/**
+ * The zlib memory level of the fast PNG profile. This sizes the hash table
+ * zlib clears before each image, thus is kept well below the default of 8.
+ */
+#define GUAC_PNG_FAST_MEMORY_LEVEL 5
+
+/**
+ * Header preceding each memory block allocated through a PNG encoder
+ * context.
+ */
+typedef struct guac_png_block {
+
+    /**
+     * The next unused block held by the context, if this block is unused.
+     */
+    struct guac_png_block* next;
+
+    /**
+     * The number of bytes which follow this header.
+     */
+    size_t size;
+
+} guac_png_block;
+
+/**
+ * State kept between the images encoded by a single thread.
+ */
+typedef struct guac_png_context {
+
+    /**
+     * Memory blocks freed by libpng or zlib, kept for their next allocation.
+     */
+    guac_png_block* unused;
+
+    /**
+     * The total size of all blocks within unused, in bytes.
+     */
+    size_t unused_size;
+
+    /**
+     * The palette of the image being encoded, cleared after each image.
+     */
+    guac_palette palette;
+
+    /**
+     * The palette index of each pixel of the image being encoded.
+     */
+    png_byte* indices;
+
+    /**
+     * The size of the indices buffer, in bytes.
+     */
+    size_t indices_size;
+
+    /**
+     * Pointers to each row of the image being encoded.
+     */
+    png_byte** rows;
+
+    /**
+     * The number of pointers the rows buffer can hold.
+     */
+    int rows_size;
+
+} guac_png_context;
+
 /**
  * Data describing the current write state of PNG data.
  */
@@ -268,49 +350,257 @@ static void guac_png_flush_handler(png_structp png) {
 
 }
 
-int guac_png_write(guac_socket* socket, guac_stream* stream,
-        cairo_surface_t* surface) {
+/**
+ * Allocates a new, empty PNG encoder context.
+ *
+ * @return
+ *     The new context.
+ */
+static guac_png_context* guac_png_context_alloc() {
+
+    guac_png_context* context =
+        (guac_png_context*) malloc(sizeof(guac_png_context));
+    memset(context, 0, sizeof(guac_png_context));
+
+    return context;
+
+}
+
+/**
+ * Frees the given PNG encoder context, along with all memory it holds.
+ *
+ * @param context
+ *     The context to free.
+ */
+static void guac_png_context_free(guac_png_context* context) {
+
+    /* Free all unused blocks */
+    guac_png_block* current = context->unused;
+    while (current != NULL) {
+        guac_png_block* next = current->next;
+        free(current);
+        current = next;
+    }
+
+    free(context->indices);
+    free(context->rows);
+    free(context);
+
+}
+
+#ifdef HAVE_BOOST
+/**
+ * The PNG encoder context of each thread, allocated on first use and freed
+ * when the thread exits.
+ */
+static boost::thread_specific_ptr<guac_png_context> __guac_png_context(
+        guac_png_context_free);
+#endif
+
+/**
+ * Returns the PNG encoder context of the current thread, which must be
+ * released with guac_png_context_release() once the image is written.
+ * Without Boost, a new context is allocated for each image.
+ *
+ * @return
+ *     The PNG encoder context of the current thread.
+ */
+static guac_png_context* guac_png_context_acquire() {
+
+#ifdef HAVE_BOOST
+    guac_png_context* context = __guac_png_context.get();
+    if (context == NULL) {
+        context = guac_png_context_alloc();
+        __guac_png_context.reset(context);
+    }
+    return context;
+#else
+    return guac_png_context_alloc();
+#endif
+
+}
+
+/**
+ * Releases the given context, acquired with guac_png_context_acquire().
+ *
+ * @param context
+ *     The context to release.
+ */
+static void guac_png_context_release(guac_png_context* context) {
+#ifndef HAVE_BOOST
+    guac_png_context_free(context);
+#endif
+}
+
+/**
+ * Allocation handler given to libpng, and through libpng to zlib, which
+ * reuses the smallest sufficiently large block freed by an earlier image.
+ *
+ * @param png
+ *     The PNG compression state structure, whose memory pointer is the
+ *     guac_png_context.
+ *
+ * @param size
+ *     The number of bytes to allocate.
+ *
+ * @return
+ *     The allocated memory, or NULL if allocation fails.
+ */
+static png_voidp guac_png_context_malloc(png_structp png,
+        png_alloc_size_t size) {
+
+    guac_png_context* context = (guac_png_context*) png_get_mem_ptr(png);
+
+    /* Find the smallest unused block that fits, without wasting more than
+     * the requested size */
+    guac_png_block** best = NULL;
+    for (guac_png_block** current = &context->unused; *current != NULL;
+            current = &(*current)->next) {
+
+        size_t available = (*current)->size;
+        if (available >= size && available <= size * 2
+                && (best == NULL || available < (*best)->size))
+            best = current;
+
+    }
+
+    /* Reuse block if found */
+    if (best != NULL) {
+        guac_png_block* block = *best;
+        *best = block->next;
+        context->unused_size -= block->size;
+        return block + 1;
+    }
+
+    /* Otherwise allocate a new block */
+    guac_png_block* block =
+        (guac_png_block*) malloc(sizeof(guac_png_block) + size);
+    if (block == NULL)
+        return NULL;
+
+    block->size = size;
+    return block + 1;
+
+}
+
+/**
+ * Free handler given to libpng, and through libpng to zlib, which keeps the
+ * freed block for reuse unless the context already holds
+ * GUAC_PNG_CONTEXT_MAX_CACHED bytes.
+ *
+ * @param png
+ *     The PNG compression state structure, whose memory pointer is the
+ *     guac_png_context.
+ *
+ * @param ptr
+ *     Memory allocated by guac_png_context_malloc(), or NULL.
+ */
+static void guac_png_context_free_block(png_structp png, png_voidp ptr) {
+
+    guac_png_context* context = (guac_png_context*) png_get_mem_ptr(png);
+
+    if (ptr == NULL)
+        return;
+
+    guac_png_block* block = ((guac_png_block*) ptr) - 1;
+
+    /* Release block entirely if cache is full */
+    if (context->unused_size + block->size > GUAC_PNG_CONTEXT_MAX_CACHED) {
+        free(block);
+        return;
+    }
+
+    block->next = context->unused;
+    context->unused = block;
+    context->unused_size += block->size;
+
+}
+
+/**
+ * Ensures the row buffers of the given context are large enough for an image
+ * of the given dimensions.
+ *
+ * @param context
+ *     The context whose buffers should be grown.
+ *
+ * @param width
+ *     The width of the image, in pixels.
+ *
+ * @param height
+ *     The height of the image, in pixels.
+ */
+static void guac_png_context_reserve(guac_png_context* context, int width,
+        int height) {
+
+    size_t indices_size = (size_t) width * height;
+    if (indices_size > context->indices_size) {
+        free(context->indices);
+        context->indices = (png_byte*) malloc(indices_size);
+        context->indices_size = indices_size;
+    }
+
+    if (height > context->rows_size) {
+        free(context->rows);
+        context->rows = (png_byte**) malloc(sizeof(png_byte*) * height);
+        context->rows_size = height;
+    }
+
+}
+
+/**
+ * Writes the given RGB24 surface as PNG blobs using libpng, either as an
+ * indexed image using the palette held by the given context, or as a
+ * truecolor image read directly from the surface.
+ *
+ * @param context
+ *     The PNG encoder context of the current thread.
+ *
+ * @param socket
+ *     The socket to send PNG blobs over.
+ *
+ * @param stream
+ *     The stream to associate with each blob.
+ *
+ * @param surface
+ *     The Cairo surface to write to the given stream and socket as PNG blobs.
+ *
+ * @param indexed
+ *     Non-zero to write an indexed image using the palette of the context,
+ *     which must already have been built from the surface, zero to write a
+ *     truecolor image.
+ *
+ * @param profile
+ *     The tradeoff between encoding time and size to make.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+static int guac_png_libpng_write(guac_png_context* context,
+        guac_socket* socket, guac_stream* stream, cairo_surface_t* surface,
+        int indexed, guac_png_profile profile) {
 
     png_structp png;
     png_infop png_info;
-    png_byte** png_rows;
-    int bpp;
+    int transforms;
 
     int x, y;
 
     guac_png_write_state write_state;
+    guac_palette* palette = &context->palette;
 
     /* Get image surface properties and data */
-    cairo_format_t format = cairo_image_surface_get_format(surface);
     int width = cairo_image_surface_get_width(surface);
     int height = cairo_image_surface_get_height(surface);
     int stride = cairo_image_surface_get_stride(surface);
     unsigned char* data = cairo_image_surface_get_data(surface);
 
-    /* If not RGB24, use Cairo PNG writer */
-    if (format != CAIRO_FORMAT_RGB24 || data == NULL)
-        return guac_png_cairo_write(socket, stream, surface);
-
-    /* Flush pending operations to surface */
-    cairo_surface_flush(surface);
+    guac_png_context_reserve(context, width, height);
+    png_byte** png_rows = context->rows;
 
-    /* Attempt to build palette */
-    guac_palette* palette = guac_palette_alloc(surface);
-
-    /* If not possible, resort to Cairo PNG writer */
-    if (palette == NULL)
-        return guac_png_cairo_write(socket, stream, surface);
-
-    /* Calculate BPP from palette size */
-    if      (palette->size <= 2)  bpp = 1;
-    else if (palette->size <= 4)  bpp = 2;
-    else if (palette->size <= 16) bpp = 4;
-    else                          bpp = 8;
-
-    /* Set up PNG writer */
-    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    /* Set up PNG writer, allocating through the context */
+    png = png_create_write_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL,
+            context, guac_png_context_malloc, guac_png_context_free_block);
     if (!png) {
-        guac_palette_free(palette);
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "libpng failed to create write structure";
         return -1;
@@ -319,7 +609,6 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
     png_info = png_create_info_struct(png);
     if (!png_info) {
         png_destroy_write_struct(&png, NULL);
-        guac_palette_free(palette);
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "libpng failed to create info structure";
         return -1;
@@ -328,7 +617,6 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
     /* Set error handler */
     if (setjmp(png_jmpbuf(png))) {
         png_destroy_write_struct(&png, &png_info);
-        guac_palette_free(palette);
         guac_error = GUAC_STATUS_IO_ERROR;
         guac_error_message = "libpng output error";
         return -1;
@@ -344,64 +632,180 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
             guac_png_write_handler,
             guac_png_flush_handler);
 
-    /* Copy data from surface into PNG data */
-    png_rows = (png_byte**) malloc(sizeof(png_byte*) * height);
-    for (y=0; y<height; y++) {
+    /* Trade size for speed if requested */
+    if (profile == GUAC_PNG_PROFILE_FAST) {
+        png_set_compression_level(png, GUAC_PNG_FAST_COMPRESSION_LEVEL);
+        png_set_compression_mem_level(png, GUAC_PNG_FAST_MEMORY_LEVEL);
+    }
+
+    if (indexed) {
+
+        int bpp;
+
+        /* Calculate BPP from palette size */
+        if      (palette->size <= 2)  bpp = 1;
+        else if (palette->size <= 4)  bpp = 2;
+        else if (palette->size <= 16) bpp = 4;
+        else                          bpp = 8;
+
+        /* Copy data from surface into PNG data */
+        png_byte* row = context->indices;
+        for (y=0; y<height; y++) {
+
+            png_rows[y] = row;
+
+            /* Runs of the same color need only be looked up once */
+            int last_color = -1;
+            int last_index = 0;
+
+            /* Copy data from surface into current row */
+            for (x=0; x<width; x++) {
 
-        /* Allocate new PNG row */
-        png_byte* row = (png_byte*) malloc(sizeof(png_byte) * width);
-        png_rows[y] = row;
+                /* Get pixel color */
+                int color = ((uint32_t*) data)[x] & 0xFFFFFF;
 
-        /* Copy data from surface into current row */
-        for (x=0; x<width; x++) {
+                /* Set index in row */
+                if (color != last_color) {
+                    last_color = color;
+                    last_index = guac_palette_find(palette, color);
+                }
 
-            /* Get pixel color */
-            int color = ((uint32_t*) data)[x] & 0xFFFFFF;
+                row[x] = last_index;
 
-            /* Set index in row */
-            row[x] = guac_palette_find(palette, color);
+            }
+
+            /* Advance to next data row */
+            data += stride;
+            row += width;
 
         }
 
-        /* Advance to next data row */
-        data += stride;
+        /* Write image info */
+        png_set_IHDR(
+            png,
+            png_info,
+            width,
+            height,
+            bpp,
+            PNG_COLOR_TYPE_PALETTE,
+            PNG_INTERLACE_NONE,
+            PNG_COMPRESSION_TYPE_DEFAULT,
+            PNG_FILTER_TYPE_DEFAULT
+        );
+
+        /* Write palette */
+        png_set_PLTE(png, png_info, palette->colors, palette->size);
+
+        /* Indexed rows are never filtered */
+        if (profile == GUAC_PNG_PROFILE_FAST)
+            png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+
+        transforms = PNG_TRANSFORM_PACKING;
 
     }
 
-    /* Write image info */
-    png_set_IHDR(
-        png,
-        png_info,
-        width,
-        height,
-        bpp,
-        PNG_COLOR_TYPE_PALETTE,
-        PNG_INTERLACE_NONE,
-        PNG_COMPRESSION_TYPE_DEFAULT,
-        PNG_FILTER_TYPE_DEFAULT
-    );
-
-    /* Write palette */
-    png_set_PLTE(png, png_info, palette->colors, palette->size);
+    else {
+
+        /* Rows are read from the surface as is */
+        for (y=0; y<height; y++)
+            png_rows[y] = data + y * stride;
+
+        /* Write image info */
+        png_set_IHDR(
+            png,
+            png_info,
+            width,
+            height,
+            8,
+            PNG_COLOR_TYPE_RGB,
+            PNG_INTERLACE_NONE,
+            PNG_COMPRESSION_TYPE_DEFAULT,
+            PNG_FILTER_TYPE_DEFAULT
+        );
+
+        /* Filter every row the same way, rather than trying each filter */
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+
+        /* Pixels are BGRx in memory */
+        transforms = PNG_TRANSFORM_BGR | PNG_TRANSFORM_STRIP_FILLER_AFTER;
+
+    }
 
     /* Write image */
     png_set_rows(png, png_info, png_rows);
-    png_write_png(png, png_info, PNG_TRANSFORM_PACKING, NULL);
+    png_write_png(png, png_info, transforms, NULL);
 
     /* Finish write */
     png_destroy_write_struct(&png, &png_info);
 
-    /* Free palette */
-    guac_palette_free(palette);
-
-    /* Free PNG data */
-    for (y=0; y<height; y++)
-        free(png_rows[y]);
-    free(png_rows);
-
     /* Ensure all data is written */
     guac_png_flush_data(&write_state);
     return 0;
 
 }
 
+/**
+ * Writes the given surface as PNG blobs, as described by guac_png_write(),
+ * without recording metrics.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+static int __guac_png_write(guac_socket* socket, guac_stream* stream,
+        cairo_surface_t* surface, guac_png_profile profile) {
+
+    int result;
+
+    /* Get image surface properties and data */
+    cairo_format_t format = cairo_image_surface_get_format(surface);
+    unsigned char* data = cairo_image_surface_get_data(surface);
+
+    /* If not RGB24, use Cairo PNG writer */
+    if (format != CAIRO_FORMAT_RGB24 || data == NULL)
+        return guac_png_cairo_write(socket, stream, surface);
+
+    /* Flush pending operations to surface */
+    cairo_surface_flush(surface);
+
+    guac_png_context* context = guac_png_context_acquire();
+
+    /* Attempt to build palette */
+    if (guac_palette_build(&context->palette, surface) == 0) {
+        result = guac_png_libpng_write(context, socket, stream, surface, 1,
+                profile);
+        guac_palette_clear(&context->palette);
+    }
+
+    /* If not possible, write truecolor when fast, otherwise resort to Cairo
+     * PNG writer */
+    else if (profile == GUAC_PNG_PROFILE_FAST)
+        result = guac_png_libpng_write(context, socket, stream, surface, 0,
+                profile);
+    else
+        result = guac_png_cairo_write(socket, stream, surface);
+
+    guac_png_context_release(context);
+    return result;
+
+}
+
+int guac_png_write(guac_socket* socket, guac_stream* stream,
+        cairo_surface_t* surface, guac_png_profile profile) {
+
+    int64_t started = guac_metrics_time_usec();
+    int64_t written = socket->bytes_written;
+
+    int result = __guac_png_write(socket, stream, surface, profile);
+
+    /* Bytes are counted as written to the socket, thus include the blob
+     * instructions around the encoded data */
+    guac_metrics_histogram_observe("guac_encode_milliseconds{format=\"png\"}",
+            (guac_metrics_time_usec() - started) / 1000.0);
+    guac_metrics_counter_add("guac_encode_bytes_total{format=\"png\"}",
+            socket->bytes_written - written);
+    guac_metrics_counter_add("guac_encode_images_total{format=\"png\"}", 1);
+
+    return result;
+
+}
+
@@ -0,0 +1,406 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/client.h>
+#include <guacamole/encode-jpeg.h>
+#include <guacamole/encode-png.h>
+#include <guacamole/encode-pool.h>
+#include <guacamole/encode-webp.h>
+#include <guacamole/error.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+
+#include <cairo/cairo.h>
+
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <vector>
+
+/**
+ * A single image submitted to an encoder pool, along with the buffer
+ * receiving its encoded blob instructions.
+ */
+typedef struct guac_encode_job {
+
+    /**
+     * The socket over which the encoded image will be emitted.
+     */
+    guac_socket* socket;
+
+    /**
+     * The stream allocated for this image at submission time.
+     */
+    guac_stream* stream;
+
+    /**
+     * The format to encode the image as.
+     */
+    guac_encode_format format;
+
+    /**
+     * The composite mode to send within the img instruction.
+     */
+    guac_composite_mode mode;
+
+    /**
+     * The destination layer of the image.
+     */
+    const guac_layer* layer;
+
+    /**
+     * The destination X coordinate of the image.
+     */
+    int x;
+
+    /**
+     * The destination Y coordinate of the image.
+     */
+    int y;
+
+    /**
+     * The image data to encode. A reference is held until the job is emitted.
+     */
+    cairo_surface_t* surface;
+
+    /**
+     * The image quality, ignored for PNG.
+     */
+    int quality;
+
+    /**
+     * Non-zero for lossless WebP.
+     */
+    int lossless;
+
+    /**
+     * The blob instructions produced by the encoder, in wire format.
+     */
+    std::vector<char> output;
+
+    /**
+     * Whether a worker has finished encoding this job.
+     */
+    bool done;
+
+} guac_encode_job;
+
+struct guac_encode_pool {
+
+    /**
+     * The client owning the streams used by submitted images.
+     */
+    guac_client* client;
+
+    /**
+     * All worker threads of this pool.
+     */
+    boost::thread_group workers;
+
+    /**
+     * Lock guarding both job queues and the stopping flag.
+     */
+    boost::mutex lock;
+
+    /**
+     * Signalled whenever a job is queued or the pool is stopping.
+     */
+    boost::condition_variable job_queued;
+
+    /**
+     * Signalled whenever a worker finishes encoding a job.
+     */
+    boost::condition_variable job_done;
+
+    /**
+     * Jobs which have not yet been picked up by a worker.
+     */
+    std::deque<guac_encode_job*> queued;
+
+    /**
+     * All jobs which have not yet been emitted, in submission order.
+     */
+    std::deque<guac_encode_job*> pending;
+
+    /**
+     * Whether the workers should exit.
+     */
+    bool stopping;
+
+};
+
+/**
+ * Write handler of the in-memory socket used by workers, appending all data
+ * to the output buffer of the job being encoded.
+ *
+ * @param socket
+ *     The in-memory socket being written to.
+ *
+ * @param buf
+ *     The data to append.
+ *
+ * @param count
+ *     The number of bytes to append.
+ *
+ * @return
+ *     The number of bytes written, which is always count.
+ */
+static size_t __guac_encode_pool_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_encode_job* job = static_cast<guac_encode_job*>(socket->data);
+    const char* data = static_cast<const char*>(buf);
+
+    job->output.insert(job->output.end(), data, data + count);
+    return count;
+
+}
+
+/**
+ * Encodes the given job into its output buffer. This function is invoked on
+ * worker threads and touches nothing but the job itself.
+ *
+ * @param job
+ *     The job to encode.
+ */
+static void __guac_encode_pool_encode(guac_encode_job* job) {
+
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL)
+        return;
+
+    socket->data = job;
+    socket->write_handler = __guac_encode_pool_write_handler;
+
+    switch (job->format) {
+
+        case GUAC_ENCODE_PNG:
+            guac_png_write(socket, job->stream, job->surface,
+                    GUAC_PNG_PROFILE_DEFAULT);
+            break;
+
+        case GUAC_ENCODE_PNG_FAST:
+            guac_png_write(socket, job->stream, job->surface,
+                    GUAC_PNG_PROFILE_FAST);
+            break;
+
+        case GUAC_ENCODE_JPEG:
+            guac_jpeg_write(socket, job->stream, job->surface, job->quality);
+            break;
+
+#ifdef ENABLE_WEBP
+        case GUAC_ENCODE_WEBP:
+            guac_webp_write(socket, job->stream, job->surface, job->quality,
+                    job->lossless);
+            break;
+#endif
+
+        default:
+            break;
+
+    }
+
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Main loop of each worker thread, encoding queued jobs until the pool is
+ * stopped.
+ *
+ * @param pool
+ *     The pool this worker belongs to.
+ */
+static void __guac_encode_pool_worker(guac_encode_pool* pool) {
+
+    boost::unique_lock<boost::mutex> lock(pool->lock);
+
+    for (;;) {
+
+        while (pool->queued.empty() && !pool->stopping)
+            pool->job_queued.wait(lock);
+
+        if (pool->queued.empty())
+            break;
+
+        guac_encode_job* job = pool->queued.front();
+        pool->queued.pop_front();
+
+        /* Encode without holding the pool lock */
+        lock.unlock();
+        __guac_encode_pool_encode(job);
+        lock.lock();
+
+        job->done = true;
+        pool->job_done.notify_all();
+
+    }
+
+}
+
+/**
+ * Sends the img, blob and end instructions of the given encoded job, then
+ * releases the job and its stream.
+ *
+ * @param pool
+ *     The pool the job was submitted to.
+ *
+ * @param job
+ *     The completed job to emit.
+ */
+static void __guac_encode_pool_emit(guac_encode_pool* pool,
+        guac_encode_job* job) {
+
+    const char* mimetype = "image/png";
+    if (job->format == GUAC_ENCODE_JPEG)
+        mimetype = "image/jpeg";
+    else if (job->format == GUAC_ENCODE_WEBP)
+        mimetype = "image/webp";
+
+    guac_protocol_send_img(job->socket, job->stream, job->mode, job->layer,
+            mimetype, job->x, job->y);
+
+    /* Blob instructions were fully formed by the worker */
+    if (!job->output.empty()) {
+        guac_socket_instruction_begin(job->socket);
+        guac_socket_write(job->socket, job->output.data(), job->output.size());
+        guac_socket_instruction_end(job->socket);
+    }
+
+    guac_protocol_send_end(job->socket, job->stream);
+
+    guac_client_free_stream(pool->client, job->stream);
+    cairo_surface_destroy(job->surface);
+    delete job;
+
+}
+
+/**
+ * Emits completed jobs from the head of the pending queue. If max_pending is
+ * not negative, this continues until the pending queue holds no more than the
+ * given number of jobs, blocking on unfinished jobs as necessary.
+ *
+ * @param pool
+ *     The pool whose completed jobs should be emitted.
+ *
+ * @param max_pending
+ *     The number of jobs which may remain pending once this function returns,
+ *     or -1 to emit only those jobs which have already completed.
+ */
+static void __guac_encode_pool_drain(guac_encode_pool* pool,
+        int max_pending) {
+
+    boost::unique_lock<boost::mutex> lock(pool->lock);
+
+    while (!pool->pending.empty()) {
+
+        guac_encode_job* job = pool->pending.front();
+
+        if (!job->done) {
+
+            /* Stop at the first unfinished job unless required to wait */
+            if (max_pending < 0
+                    || (int) pool->pending.size() <= max_pending)
+                break;
+
+            pool->job_done.wait(lock);
+            continue;
+
+        }
+
+        pool->pending.pop_front();
+
+        /* Emit outside the lock so workers may continue */
+        lock.unlock();
+        __guac_encode_pool_emit(pool, job);
+        lock.lock();
+
+    }
+
+}
+
+guac_encode_pool* guac_encode_pool_alloc(guac_client* client, int threads) {
+
+    guac_encode_pool* pool = new guac_encode_pool();
+    pool->client = client;
+    pool->stopping = false;
+
+    for (int i = 0; i < threads; i++)
+        pool->workers.create_thread(
+                boost::bind(__guac_encode_pool_worker, pool));
+
+    return pool;
+
+}
+
+void guac_encode_pool_free(guac_encode_pool* pool) {
+
+    /* Emit everything still in flight */
+    guac_encode_pool_flush(pool);
+
+    {
+        boost::lock_guard<boost::mutex> lock(pool->lock);
+        pool->stopping = true;
+        pool->job_queued.notify_all();
+    }
+
+    pool->workers.join_all();
+    delete pool;
+
+}
+
+void guac_encode_pool_submit(guac_encode_pool* pool, guac_socket* socket,
+        guac_encode_format format, guac_composite_mode mode,
+        const guac_layer* layer, int x, int y, cairo_surface_t* surface,
+        int quality, int lossless) {
+
+    /* Make room for the new job, emitting whatever is already complete */
+    __guac_encode_pool_drain(pool, GUAC_ENCODE_POOL_MAX_JOBS - 1);
+
+    guac_stream* stream = guac_client_alloc_stream(pool->client);
+    if (stream == NULL)
+        return;
+
+    guac_encode_job* job = new guac_encode_job();
+    job->socket = socket;
+    job->stream = stream;
+    job->format = format;
+    job->mode = mode;
+    job->layer = layer;
+    job->x = x;
+    job->y = y;
+    job->surface = cairo_surface_reference(surface);
+    job->quality = quality;
+    job->lossless = lossless;
+    job->done = false;
+
+    boost::lock_guard<boost::mutex> lock(pool->lock);
+    pool->pending.push_back(job);
+    pool->queued.push_back(job);
+    pool->job_queued.notify_one();
+
+}
+
+void guac_encode_pool_flush(guac_encode_pool* pool) {
+    __guac_encode_pool_drain(pool, 0);
+}
+
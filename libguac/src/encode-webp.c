@@ -21,6 +21,7 @@
 
 #include <guacamole/encode-webp.h>
 #include <guacamole/error.h>
+#include <guacamole/metrics.h>
 #include <guacamole/palette.h>
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
@@ -28,6 +29,10 @@
 #include <cairo/cairo.h>
 #include <webp/encode.h>
 
+#ifdef HAVE_BOOST
+#include <boost/thread/tss.hpp>
+#endif
+
 #include <assert.h>
 #include <inttypes.h>
 #include <stdint.h>
@@ -162,7 +167,124 @@ static int guac_webp_stream_write(const uint8_t* data, size_t data_size,
     return 1;
 }
 
-int guac_webp_write(guac_socket* socket, guac_stream* stream,
+/**
+ * State kept between the images encoded by a single thread.
+ */
+typedef struct guac_webp_context {
+
+    /**
+     * The configuration of the most recent image, which is reused while the
+     * requested quality and losslessness are unchanged.
+     */
+    WebPConfig config;
+
+    /**
+     * Non-zero if config has been initialized.
+     */
+    int config_valid;
+
+    /**
+     * The quality with which config was initialized.
+     */
+    int config_quality;
+
+    /**
+     * The losslessness with which config was initialized.
+     */
+    int config_lossless;
+
+    /**
+     * The ARGB pixels of the image being encoded, given to libwebp in place
+     * of a buffer allocated for each picture.
+     */
+    uint32_t* argb;
+
+    /**
+     * The number of pixels the argb buffer can hold.
+     */
+    size_t argb_size;
+
+} guac_webp_context;
+
+/**
+ * Allocates a new, empty WebP encoder context.
+ *
+ * @return
+ *     The new context.
+ */
+static guac_webp_context* guac_webp_context_alloc() {
+
+    guac_webp_context* context =
+        (guac_webp_context*) malloc(sizeof(guac_webp_context));
+    memset(context, 0, sizeof(guac_webp_context));
+
+    return context;
+
+}
+
+/**
+ * Frees the given WebP encoder context.
+ *
+ * @param context
+ *     The context to free.
+ */
+static void guac_webp_context_free(guac_webp_context* context) {
+    free(context->argb);
+    free(context);
+}
+
+#ifdef HAVE_BOOST
+/**
+ * The WebP encoder context of each thread, allocated on first use and freed
+ * when the thread exits.
+ */
+static boost::thread_specific_ptr<guac_webp_context> __guac_webp_context(
+        guac_webp_context_free);
+#endif
+
+/**
+ * Returns the WebP encoder context of the current thread, which must be
+ * released with guac_webp_context_release() once the image is written.
+ * Without Boost, a new context is allocated for each image.
+ *
+ * @return
+ *     The WebP encoder context of the current thread.
+ */
+static guac_webp_context* guac_webp_context_acquire() {
+
+#ifdef HAVE_BOOST
+    guac_webp_context* context = __guac_webp_context.get();
+    if (context == NULL) {
+        context = guac_webp_context_alloc();
+        __guac_webp_context.reset(context);
+    }
+    return context;
+#else
+    return guac_webp_context_alloc();
+#endif
+
+}
+
+/**
+ * Releases the given context, acquired with guac_webp_context_acquire().
+ *
+ * @param context
+ *     The context to release.
+ */
+static void guac_webp_context_release(guac_webp_context* context) {
+#ifndef HAVE_BOOST
+    guac_webp_context_free(context);
+#endif
+}
+
+/**
+ * Writes the given surface as WebP blobs, as described by guac_webp_write(),
+ * without recording metrics.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+static int __guac_webp_write(guac_socket* socket, guac_stream* stream,
         cairo_surface_t* surface, int quality, int lossless) {
 
     guac_webp_stream_writer writer;
@@ -186,28 +308,51 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
     /* Flush pending operations to surface */
     cairo_surface_flush(surface);
 
-    /* Configure WebP compression bits */
-    WebPConfig config;
-    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, quality))
-        return -1;
+    guac_webp_context* context = guac_webp_context_acquire();
+    WebPConfig* config = &context->config;
+
+    /* Configure WebP compression bits, unless unchanged since last image */
+    if (!context->config_valid || context->config_quality != quality
+            || context->config_lossless != lossless) {
+
+        if (!WebPConfigPreset(config, WEBP_PRESET_DEFAULT, quality)) {
+            context->config_valid = 0;
+            guac_webp_context_release(context);
+            return -1;
+        }
 
-    /* Add additional tuning */
-    config.lossless = lossless;
-    config.quality = quality;
-    config.thread_level = 1; /* Multi threaded */
-    config.method = 2; /* Compression method (0=fast/larger, 6=slow/smaller) */
+        /* Add additional tuning */
+        config->lossless = lossless;
+        config->quality = quality;
+        config->thread_level = 1; /* Multi threaded */
+        config->method = 2; /* Compression method (0=fast/larger, 6=slow/smaller) */
 
-    /* Validate configuration */
-    WebPValidateConfig(&config);
+        /* Validate configuration */
+        WebPValidateConfig(config);
+
+        context->config_valid = 1;
+        context->config_quality = quality;
+        context->config_lossless = lossless;
+
+    }
+
+    /* Grow pixel buffer if needed */
+    size_t argb_size = (size_t) width * height;
+    if (argb_size > context->argb_size) {
+        free(context->argb);
+        context->argb = (uint32_t*) malloc(sizeof(uint32_t) * argb_size);
+        context->argb_size = argb_size;
+    }
 
-    /* Set up WebP picture */
+    /* Set up WebP picture over the pixel buffer of the context */
     WebPPictureInit(&picture);
     picture.use_argb = 1;
     picture.width = width;
     picture.height = height;
+    picture.argb = context->argb;
+    picture.argb_stride = width;
 
-    /* Allocate and init writer */
-    WebPPictureAlloc(&picture);
+    /* Init writer */
     picture.writer = guac_webp_stream_write;
     picture.custom_ptr = &writer;
     guac_webp_stream_writer_init(&writer, socket, stream);
@@ -244,15 +389,38 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
     }
 
     /* Encode image */
-    WebPEncode(&config, &picture);
+    WebPEncode(config, &picture);
 
-    /* Free picture */
+    /* Free anything allocated by the encoder. The pixel buffer belongs to the
+     * context and is left alone. */
     WebPPictureFree(&picture);
 
     /* Ensure all data is written */
     guac_webp_flush_data(&writer);
 
+    guac_webp_context_release(context);
     return 0;
 
 }
 
+int guac_webp_write(guac_socket* socket, guac_stream* stream,
+        cairo_surface_t* surface, int quality, int lossless) {
+
+    int64_t started = guac_metrics_time_usec();
+    int64_t written = socket->bytes_written;
+
+    int result = __guac_webp_write(socket, stream, surface, quality,
+            lossless);
+
+    /* Bytes are counted as written to the socket, thus include the blob
+     * instructions around the encoded data */
+    guac_metrics_histogram_observe("guac_encode_milliseconds{format=\"webp\"}",
+            (guac_metrics_time_usec() - started) / 1000.0);
+    guac_metrics_counter_add("guac_encode_bytes_total{format=\"webp\"}",
+            socket->bytes_written - written);
+    guac_metrics_counter_add("guac_encode_images_total{format=\"webp\"}", 1);
+
+    return result;
+
+}
+
@@ -0,0 +1,255 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/metrics.h>
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_BOOST
+#include <boost/thread.hpp>
+#elif defined HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+/**
+ * The upper bounds of all histogram buckets but the last, in milliseconds.
+ */
+static const double __guac_metrics_bounds[GUAC_METRICS_HISTOGRAM_BUCKETS - 1] = {
+    0.5, 1, 2, 5, 10, 25, 50, 100, 250, 500, 1000
+};
+
+/**
+ * The type of a registered metric.
+ */
+typedef enum guac_metric_type {
+    GUAC_METRIC_COUNTER,
+    GUAC_METRIC_GAUGE,
+    GUAC_METRIC_HISTOGRAM
+} guac_metric_type;
+
+/**
+ * The current state of a single registered metric.
+ */
+typedef struct guac_metric {
+
+    /**
+     * The type of this metric, fixed when it is first registered.
+     */
+    guac_metric_type type;
+
+    /**
+     * The value of a counter or gauge, or the sum of the observations of a
+     * histogram.
+     */
+    double value;
+
+    /**
+     * The number of observations of a histogram.
+     */
+    uint64_t count;
+
+    /**
+     * The number of observations within each bucket of a histogram.
+     */
+    uint64_t buckets[GUAC_METRICS_HISTOGRAM_BUCKETS];
+
+} guac_metric;
+
+/**
+ * All metrics registered within this process, by name.
+ */
+static std::map<std::string, guac_metric>* __guac_metrics = NULL;
+
+#ifdef HAVE_BOOST
+/**
+ * Lock which is acquired prior to accessing the registered metrics.
+ */
+static boost::mutex __guac_metrics_lock;
+#elif defined HAVE_LIBPTHREAD
+/**
+ * Lock which is acquired prior to accessing the registered metrics.
+ */
+static pthread_mutex_t __guac_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * Acquires the lock of the metrics registry.
+ */
+static void __guac_metrics_acquire() {
+#ifdef HAVE_BOOST
+    __guac_metrics_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&__guac_metrics_lock);
+#endif
+}
+
+/**
+ * Releases the lock of the metrics registry.
+ */
+static void __guac_metrics_release() {
+#ifdef HAVE_BOOST
+    __guac_metrics_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&__guac_metrics_lock);
+#endif
+}
+
+/**
+ * Returns the metric having the given name, registering it with the given
+ * type if it does not yet exist. The registry lock must be held.
+ *
+ * @param name
+ *     The name of the metric.
+ *
+ * @param type
+ *     The type of the metric.
+ *
+ * @return
+ *     The metric having the given name.
+ */
+static guac_metric* __guac_metrics_get(const char* name,
+        guac_metric_type type) {
+
+    /* Allocate the registry on first use */
+    if (__guac_metrics == NULL)
+        __guac_metrics = new std::map<std::string, guac_metric>();
+
+    std::map<std::string, guac_metric>::iterator found =
+        __guac_metrics->find(name);
+
+    if (found != __guac_metrics->end())
+        return &found->second;
+
+    guac_metric* metric = &(*__guac_metrics)[name];
+    memset(metric, 0, sizeof(guac_metric));
+    metric->type = type;
+
+    return metric;
+
+}
+
+double guac_metrics_histogram_bound(int bucket) {
+    return __guac_metrics_bounds[bucket];
+}
+
+void guac_metrics_counter_add(const char* name, uint64_t value) {
+
+    __guac_metrics_acquire();
+    __guac_metrics_get(name, GUAC_METRIC_COUNTER)->value += value;
+    __guac_metrics_release();
+
+}
+
+void guac_metrics_counter_set(const char* name, uint64_t value) {
+
+    __guac_metrics_acquire();
+    __guac_metrics_get(name, GUAC_METRIC_COUNTER)->value = (double) value;
+    __guac_metrics_release();
+
+}
+
+void guac_metrics_gauge_set(const char* name, double value) {
+
+    __guac_metrics_acquire();
+    __guac_metrics_get(name, GUAC_METRIC_GAUGE)->value = value;
+    __guac_metrics_release();
+
+}
+
+void guac_metrics_histogram_observe(const char* name, double value) {
+
+    /* Find the first bucket which can hold the value, if any */
+    int bucket = 0;
+    while (bucket < GUAC_METRICS_HISTOGRAM_BUCKETS - 1
+            && value > __guac_metrics_bounds[bucket])
+        bucket++;
+
+    __guac_metrics_acquire();
+
+    guac_metric* metric = __guac_metrics_get(name, GUAC_METRIC_HISTOGRAM);
+    metric->value += value;
+    metric->count++;
+    metric->buckets[bucket]++;
+
+    __guac_metrics_release();
+
+}
+
+int64_t guac_metrics_time_usec() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+char* guac_metrics_render() {
+
+    std::ostringstream rendered;
+
+    __guac_metrics_acquire();
+
+    if (__guac_metrics != NULL) {
+
+        std::map<std::string, guac_metric>::const_iterator current;
+        for (current = __guac_metrics->begin();
+                current != __guac_metrics->end(); current++) {
+
+            const guac_metric& metric = current->second;
+            switch (metric.type) {
+
+                case GUAC_METRIC_COUNTER:
+                    rendered << "counter " << current->first << " "
+                             << (uint64_t) metric.value << "\n";
+                    break;
+
+                case GUAC_METRIC_GAUGE:
+                    rendered << "gauge " << current->first << " "
+                             << metric.value << "\n";
+                    break;
+
+                case GUAC_METRIC_HISTOGRAM:
+                    rendered << "histogram " << current->first << " "
+                             << metric.count << " " << metric.value;
+                    for (int i = 0; i < GUAC_METRICS_HISTOGRAM_BUCKETS; i++)
+                        rendered << " " << metric.buckets[i];
+                    rendered << "\n";
+                    break;
+
+            }
+
+        }
+
+    }
+
+    __guac_metrics_release();
+
+    std::string text = rendered.str();
+    char* result = static_cast<char*>(malloc(text.size() + 1));
+    memcpy(result, text.c_str(), text.size() + 1);
+
+    return result;
+
+}
+
@@ -30,6 +30,21 @@
 
 guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
 
+    /* Allocate palette */
+    guac_palette* palette = (guac_palette*) malloc(sizeof(guac_palette));
+    memset(palette, 0, sizeof(guac_palette));
+
+    if (guac_palette_build(palette, surface)) {
+        guac_palette_free(palette);
+        return NULL;
+    }
+
+    return palette;
+
+}
+
+int guac_palette_build(guac_palette* palette, cairo_surface_t* surface) {
+
     int x, y;
 
     int width = cairo_image_surface_get_width(surface);
@@ -37,9 +52,8 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
     int stride = cairo_image_surface_get_stride(surface);
     unsigned char* data = cairo_image_surface_get_data(surface);
 
-    /* Allocate palette */
-    guac_palette* palette = (guac_palette*) malloc(sizeof(guac_palette));
-    memset(palette, 0, sizeof(guac_palette));
+    /* The most recently stored color, which runs of pixels tend to repeat */
+    int last_color = -1;
 
     for (y=0; y<height; y++) {
         for (x=0; x<width; x++) {
@@ -47,6 +61,12 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
             /* Get pixel color */
             int color = ((uint32_t*) data)[x] & 0xFFFFFF;
 
+            /* Skip lookup if same as previous pixel */
+            if (color == last_color)
+                continue;
+
+            last_color = color;
+
             /* Calculate hash code */
             int hash = ((color & 0xFFF000) >> 12) ^ (color & 0xFFF);
 
@@ -64,8 +84,8 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
 
                     /* Stop if already at capacity */
                     if (palette->size == 256) {
-                        guac_palette_free(palette);
-                        return NULL;
+                        guac_palette_clear(palette);
+                        return -1;
                     }
 
                     /* Store in palette */
@@ -74,6 +94,9 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
                     c->green = (color >> 8 ) & 0xFF;
                     c->red   = (color >> 16) & 0xFF;
 
+                    /* Remember slot for clearing */
+                    palette->slots[palette->size] = hash;
+
                     /* Add color to map */
                     entry->index = ++palette->size;
                     entry->color = color;
@@ -97,7 +120,19 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
 
     }
 
-    return palette;
+    return 0;
+
+}
+
+void guac_palette_clear(guac_palette* palette) {
+
+    int i;
+
+    /* Clear only the entries in use, rather than the entire map */
+    for (i=0; i<palette->size; i++)
+        palette->entries[palette->slots[i]].index = 0;
+
+    palette->size = 0;
 
 }
 
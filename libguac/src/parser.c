@@ -25,6 +25,7 @@
 #include <guacamole/unicode.h>
 #include <guacamole/parser.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -59,107 +60,133 @@ guac_parser* guac_parser_alloc() {
 int guac_parser_append(guac_parser* parser, void* buffer, int length) {
 
     char* char_buffer = (char*) buffer;
-    int bytes_parsed = 0;
+    char* buffer_end = char_buffer + length;
 
-    /* Do not exceed maximum number of elements */
-    if (parser->__elementc == GUAC_INSTRUCTION_MAX_ELEMENTS
-            && parser->state != GUAC_PARSE_COMPLETE) {
-        parser->state = GUAC_PARSE_ERROR;
-        return 0;
-    }
+    /* Parse as many elements as are available, up to the end of the
+     * instruction */
+    while (char_buffer < buffer_end && parser->state != GUAC_PARSE_COMPLETE) {
 
-    /* Parse element length */
-    if (parser->state == GUAC_PARSE_LENGTH) {
+        /* Parse element length */
+        if (parser->state == GUAC_PARSE_LENGTH) {
 
-        int parsed_length = parser->__element_length;
-        while (bytes_parsed < length) {
+            int parsed_length = parser->__element_length;
+            while (char_buffer < buffer_end) {
 
-            /* Pull next character */
-            char c = *(char_buffer++);
-            bytes_parsed++;
+                /* Pull next character */
+                char c = *(char_buffer++);
 
-            /* If digit, add to length */
-            if (c >= '0' && c <= '9')
-                parsed_length = parsed_length*10 + c - '0';
+                /* If digit, add to length, failing if too long */
+                if (c >= '0' && c <= '9') {
+                    parsed_length = parsed_length*10 + c - '0';
+                    if (parsed_length > GUAC_INSTRUCTION_MAX_LENGTH) {
+                        parser->state = GUAC_PARSE_ERROR;
+                        return 0;
+                    }
+                }
 
-            /* If period, switch to parsing content */
-            else if (c == '.') {
-                parser->__elementv[parser->__elementc++] = char_buffer;
-                parser->state = GUAC_PARSE_CONTENT;
-                break;
-            }
+                /* If period, switch to parsing content */
+                else if (c == '.') {
 
-            /* If not digit, parse error */
-            else {
-                parser->state = GUAC_PARSE_ERROR;
-                return 0;
-            }
+                    /* Do not exceed maximum number of elements */
+                    if (parser->__elementc == GUAC_INSTRUCTION_MAX_ELEMENTS) {
+                        parser->state = GUAC_PARSE_ERROR;
+                        return 0;
+                    }
 
-        }
+                    parser->__elementv[parser->__elementc++] = char_buffer;
+                    parser->state = GUAC_PARSE_CONTENT;
+                    break;
 
-        /* If too long, parse error */
-        if (parsed_length > GUAC_INSTRUCTION_MAX_LENGTH) {
-            parser->state = GUAC_PARSE_ERROR;
-            return 0;
-        }
+                }
 
-        /* Save length */
-        parser->__element_length = parsed_length;
+                /* If not digit, parse error */
+                else {
+                    parser->state = GUAC_PARSE_ERROR;
+                    return 0;
+                }
 
-    } /* end parse length */
+            }
 
-    /* Parse element content */
-    if (parser->state == GUAC_PARSE_CONTENT) {
+            /* Save length */
+            parser->__element_length = parsed_length;
 
-        while (bytes_parsed < length && parser->__element_length >= 0) {
+        } /* end parse length */
 
-            /* Get length of current character */
-            char c = *char_buffer;
-            int char_length = guac_utf8_charsize((unsigned char) c);
+        /* Parse element content */
+        if (parser->state == GUAC_PARSE_CONTENT) {
 
-            /* If full character not present in buffer, stop now */
-            if (char_length + bytes_parsed > length)
-                break;
+            /* The element length is in characters, so content can only be
+             * skipped in bulk while it is ASCII */
+            int remaining = parser->__element_length;
+            while (remaining > 0 && char_buffer < buffer_end) {
 
-            /* Record character as parsed */
-            bytes_parsed += char_length;
+                int available = buffer_end - char_buffer;
+                unsigned char c = (unsigned char) *char_buffer;
 
-            /* If end of element, handle terminator */
-            if (parser->__element_length == 0) {
+                /* Skip multibyte character, stopping if the full character is
+                 * not yet present in the buffer */
+                if (c >= 0x80) {
 
-                *char_buffer = '\0';
+                    int char_length = guac_utf8_charsize(c);
+                    if (char_length > available)
+                        break;
 
-                /* If semicolon, store end-of-instruction */
-                if (c == ';') {
-                    parser->state = GUAC_PARSE_COMPLETE;
-                    parser->opcode = parser->__elementv[0];
-                    parser->argv = &(parser->__elementv[1]);
-                    parser->argc = parser->__elementc - 1;
-                    break;
-                }
+                    char_buffer += char_length;
+                    remaining--;
+                    continue;
 
-                /* If comma, move on to next element */
-                else if (c == ',') {
-                    parser->state = GUAC_PARSE_LENGTH;
-                    break;
                 }
 
-                /* Otherwise, parse error */
-                else {
-                    parser->state = GUAC_PARSE_ERROR;
-                    return 0;
+                /* Skip single-byte character, or eight at once if the next
+                 * eight bytes are all ASCII and within the element */
+                int ascii_length = 1;
+                if (remaining >= 8 && available >= 8) {
+
+                    uint64_t word;
+                    memcpy(&word, char_buffer, sizeof(word));
+                    if (!(word & UINT64_C(0x8080808080808080)))
+                        ascii_length = 8;
+
                 }
 
-            } /* end if end of element */
+                char_buffer += ascii_length;
+                remaining -= ascii_length;
 
-            /* Advance to next character */
-            parser->__element_length--;
-            char_buffer += char_length;
+            }
 
-        }
+            parser->__element_length = remaining;
+
+            /* Wait for the rest of the element and its terminator */
+            if (remaining > 0 || char_buffer == buffer_end)
+                break;
+
+            /* Handle terminator */
+            char c = *char_buffer;
+            *(char_buffer++) = '\0';
+
+            /* If semicolon, store end-of-instruction */
+            if (c == ';') {
+                parser->state = GUAC_PARSE_COMPLETE;
+                parser->opcode = parser->__elementv[0];
+                parser->argv = &(parser->__elementv[1]);
+                parser->argc = parser->__elementc - 1;
+            }
+
+            /* If comma, move on to next element */
+            else if (c == ',')
+                parser->state = GUAC_PARSE_LENGTH;
+
+            /* Otherwise, parse error */
+            else {
+                parser->state = GUAC_PARSE_ERROR;
+                return 0;
+            }
+
+        } /* end parse content */
+
+    }
 
-    } /* end parse content */
-    return bytes_parsed;
+    return char_buffer - (char*) buffer;
 
 }
 
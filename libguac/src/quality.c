@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/quality.h>
+
+#include <stdint.h>
+
+void guac_quality_init(guac_quality* quality) {
+
+    quality->round_trip = 0;
+    quality->bandwidth = 0;
+    quality->last_ack_timestamp = 0;
+    quality->last_ack_bytes = 0;
+    quality->last_adjust_timestamp = 0;
+
+    quality->image_quality = GUAC_QUALITY_MAX_IMAGE_QUALITY;
+    quality->lossy_threshold = 0;
+    quality->frame_scale = 100;
+
+}
+
+/**
+ * Updates the smoothed bandwidth of the given controller using the number of
+ * bytes acknowledged since the previous sample.
+ *
+ * @param quality
+ *     The controller to update.
+ *
+ * @param now
+ *     The time the acknowledgement was received.
+ *
+ * @param acked_bytes
+ *     The total number of bytes sent prior to the acknowledged sync.
+ */
+static void __guac_quality_sample_bandwidth(guac_quality* quality,
+        guac_timestamp now, int64_t acked_bytes) {
+
+    /* Use the first acknowledgement only as a baseline */
+    if (quality->last_ack_timestamp == 0) {
+        quality->last_ack_timestamp = now;
+        quality->last_ack_bytes = acked_bytes;
+        return;
+    }
+
+    /* Wait for enough time to pass for a meaningful sample */
+    int elapsed = (int) (now - quality->last_ack_timestamp);
+    if (elapsed < GUAC_QUALITY_MIN_SAMPLE_INTERVAL
+            || acked_bytes < quality->last_ack_bytes)
+        return;
+
+    int sample = (int) ((acked_bytes - quality->last_ack_bytes) / elapsed);
+
+    /* Ignore idle periods, which say nothing about the available bandwidth */
+    if (sample > 0) {
+        if (quality->bandwidth == 0)
+            quality->bandwidth = sample;
+        else
+            quality->bandwidth = (quality->bandwidth * 3 + sample) / 4;
+    }
+
+    quality->last_ack_timestamp = now;
+    quality->last_ack_bytes = acked_bytes;
+
+}
+
+void guac_quality_update(guac_quality* quality, guac_timestamp now,
+        int round_trip, int64_t acked_bytes, int64_t sent_bytes) {
+
+    if (round_trip < 0)
+        round_trip = 0;
+
+    /* Smooth round trip, reacting more quickly to increases */
+    if (quality->round_trip == 0 || round_trip > quality->round_trip)
+        quality->round_trip = (quality->round_trip + round_trip * 3) / 4;
+    else
+        quality->round_trip = (quality->round_trip * 7 + round_trip) / 8;
+
+    int latency = quality->round_trip;
+
+    if (acked_bytes >= 0) {
+
+        __guac_quality_sample_bandwidth(quality, now, acked_bytes);
+
+        /* Data sent but not yet acknowledged will take at least this long
+         * to arrive, even if the round trip itself is short */
+        if (quality->bandwidth > 0 && sent_bytes > acked_bytes) {
+            int queue_delay = (int) ((sent_bytes - acked_bytes)
+                    / quality->bandwidth);
+            if (queue_delay > latency)
+                latency = queue_delay;
+        }
+
+    }
+
+    /* Allow the previous adjustment to take effect */
+    if (now - quality->last_adjust_timestamp < GUAC_QUALITY_ADJUST_INTERVAL)
+        return;
+
+    quality->last_adjust_timestamp = now;
+
+    /* Degrade quickly when over the target latency */
+    if (latency > GUAC_QUALITY_TARGET_LATENCY) {
+
+        quality->image_quality -= GUAC_QUALITY_IMAGE_QUALITY_DECREASE;
+        if (quality->image_quality < GUAC_QUALITY_MIN_IMAGE_QUALITY)
+            quality->image_quality = GUAC_QUALITY_MIN_IMAGE_QUALITY;
+
+        quality->lossy_threshold += GUAC_QUALITY_LOSSY_THRESHOLD_STEP;
+        if (quality->lossy_threshold > GUAC_QUALITY_MAX_LOSSY_THRESHOLD)
+            quality->lossy_threshold = GUAC_QUALITY_MAX_LOSSY_THRESHOLD;
+
+        quality->frame_scale = quality->frame_scale * 5 / 4;
+        if (quality->frame_scale > GUAC_QUALITY_MAX_FRAME_SCALE)
+            quality->frame_scale = GUAC_QUALITY_MAX_FRAME_SCALE;
+
+    }
+
+    /* Recover slowly once comfortably within the target */
+    else if (latency < GUAC_QUALITY_TARGET_LATENCY / 2) {
+
+        quality->image_quality += GUAC_QUALITY_IMAGE_QUALITY_INCREASE;
+        if (quality->image_quality > GUAC_QUALITY_MAX_IMAGE_QUALITY)
+            quality->image_quality = GUAC_QUALITY_MAX_IMAGE_QUALITY;
+
+        quality->lossy_threshold -= GUAC_QUALITY_LOSSY_THRESHOLD_STEP / 8;
+        if (quality->lossy_threshold < 0)
+            quality->lossy_threshold = 0;
+
+        quality->frame_scale -= 5;
+        if (quality->frame_scale < 100)
+            quality->frame_scale = 100;
+
+    }
+
+}
+
+void guac_quality_merge(guac_quality* aggregate, const guac_quality* quality) {
+
+    if (quality->round_trip > aggregate->round_trip)
+        aggregate->round_trip = quality->round_trip;
+
+    if (aggregate->bandwidth == 0 || (quality->bandwidth != 0
+                && quality->bandwidth < aggregate->bandwidth))
+        aggregate->bandwidth = quality->bandwidth;
+
+    if (quality->image_quality < aggregate->image_quality)
+        aggregate->image_quality = quality->image_quality;
+
+    if (quality->lossy_threshold > aggregate->lossy_threshold)
+        aggregate->lossy_threshold = quality->lossy_threshold;
+
+    if (quality->frame_scale > aggregate->frame_scale)
+        aggregate->frame_scale = quality->frame_scale;
+
+}
+
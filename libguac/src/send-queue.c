@@ -0,0 +1,494 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/client.h>
+#include <guacamole/send-queue.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * The opcodes of the instructions which open, acknowledge or close a stream,
+ * which are kept even when the rest of the queue is discarded for a resync.
+ * The resync handler only resends the display, so the client would otherwise
+ * never learn of a stream opened meanwhile, such as a new audio stream, or
+ * keep a stream open which was closed meanwhile.
+ */
+static const char* __guac_send_queue_stream_opcodes[] = {
+    "audio", "clipboard", "file", "pipe", "argv", "body", "ack", "end", NULL
+};
+
+struct guac_send_queue {
+
+    /**
+     * The user receiving everything written by this queue.
+     */
+    guac_user* user;
+
+    /**
+     * The maximum number of bytes which may be queued before the overflow
+     * policy applies.
+     */
+    size_t max_bytes;
+
+    /**
+     * The action taken when the queue overflows.
+     */
+    guac_send_queue_policy policy;
+
+    /**
+     * Lock guarding all queue state below.
+     */
+    boost::mutex lock;
+
+    /**
+     * Signalled whenever the writer thread has something to do.
+     */
+    boost::condition_variable changed;
+
+    /**
+     * All instructions not yet picked up by the writer thread, in order.
+     */
+    std::deque<guac_send_chunk> chunks;
+
+    /**
+     * The total size of all queued instructions, including the instruction
+     * currently being written.
+     */
+    size_t queued_bytes;
+
+    /**
+     * Whether the user's socket should be flushed once the queue is empty.
+     */
+    bool flush_requested;
+
+    /**
+     * Whether queued data was discarded and the user must be resynchronized.
+     * Broadcast data is discarded until the resync begins, as it will be
+     * covered by the resync.
+     */
+    bool resync_requested;
+
+    /**
+     * Whether the user has been disconnected, in which case all further data
+     * is discarded.
+     */
+    bool failed;
+
+    /**
+     * Whether the writer thread should exit.
+     */
+    bool stopping;
+
+    /**
+     * Socket given to the resync handler, which appends complete instructions
+     * to this queue. It is only ever used by the writer thread.
+     */
+    guac_socket* resync_socket;
+
+    /**
+     * The instruction currently being written to resync_socket.
+     */
+    std::vector<char> resync_instruction;
+
+    /**
+     * The thread writing queued instructions to the user's socket.
+     */
+    boost::thread writer;
+
+};
+
+/**
+ * Appends the given instruction regardless of the size of the queue. The
+ * queue lock must be held.
+ *
+ * @param queue
+ *     The send queue to append to.
+ *
+ * @param chunk
+ *     The complete instruction to append.
+ */
+static void __guac_send_queue_append(guac_send_queue* queue,
+        const guac_send_chunk& chunk) {
+
+    queue->chunks.push_back(chunk);
+    queue->queued_bytes += chunk->size();
+    queue->changed.notify_one();
+
+}
+
+/**
+ * Discards everything queued. The queue lock must be held.
+ *
+ * @param queue
+ *     The send queue to clear.
+ */
+static void __guac_send_queue_discard(guac_send_queue* queue) {
+
+    while (!queue->chunks.empty()) {
+        queue->queued_bytes -= queue->chunks.front()->size();
+        queue->chunks.pop_front();
+    }
+
+}
+
+/**
+ * Returns whether the given instruction opens, acknowledges or closes a
+ * stream, as listed within __guac_send_queue_stream_opcodes.
+ *
+ * @param chunk
+ *     The complete instruction to test.
+ *
+ * @return
+ *     true if the instruction must survive a resync, false otherwise.
+ */
+static bool __guac_send_queue_is_stream_control(const guac_send_chunk& chunk) {
+
+    const char* data = chunk->data();
+    const char* end = data + chunk->size();
+
+    /* Parse the length of the opcode, always the first element */
+    size_t length = 0;
+    while (data < end && *data >= '0' && *data <= '9')
+        length = length * 10 + (*(data++) - '0');
+
+    if (data == end || *(data++) != '.' || (size_t) (end - data) < length)
+        return false;
+
+    for (const char** opcode = __guac_send_queue_stream_opcodes;
+            *opcode != NULL; opcode++) {
+        if (strlen(*opcode) == length && memcmp(*opcode, data, length) == 0)
+            return true;
+    }
+
+    return false;
+
+}
+
+/**
+ * Discards everything queued except the instructions controlling streams,
+ * which the resync cannot resend. The queue lock must be held.
+ *
+ * @param queue
+ *     The send queue to clear for a resync.
+ */
+static void __guac_send_queue_discard_for_resync(guac_send_queue* queue) {
+
+    std::deque<guac_send_chunk> kept;
+
+    while (!queue->chunks.empty()) {
+
+        guac_send_chunk chunk = queue->chunks.front();
+        queue->chunks.pop_front();
+
+        if (__guac_send_queue_is_stream_control(chunk))
+            kept.push_back(chunk);
+        else
+            queue->queued_bytes -= chunk->size();
+
+    }
+
+    queue->chunks.swap(kept);
+
+}
+
+/**
+ * Marks the user as failed and signals the user to stop. The queue lock must
+ * be held.
+ *
+ * @param queue
+ *     The send queue whose user failed.
+ */
+static void __guac_send_queue_fail(guac_send_queue* queue) {
+
+    queue->failed = true;
+    __guac_send_queue_discard(queue);
+    guac_user_stop(queue->user);
+
+}
+
+/**
+ * Pushes the instruction built within resync_socket onto the queue.
+ *
+ * @param queue
+ *     The send queue owning resync_socket.
+ */
+static void __guac_send_queue_push_resync(guac_send_queue* queue) {
+
+    if (queue->resync_instruction.empty())
+        return;
+
+    guac_send_chunk chunk(new std::vector<char>(queue->resync_instruction));
+    queue->resync_instruction.clear();
+
+    /* The state sent during a resync is never discarded */
+    boost::lock_guard<boost::mutex> lock(queue->lock);
+    if (!queue->failed)
+        __guac_send_queue_append(queue, chunk);
+
+}
+
+/**
+ * Write handler of resync_socket, accumulating data until the end of the
+ * current instruction.
+ */
+static size_t __guac_send_queue_resync_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_send_queue* queue = (guac_send_queue*) socket->data;
+    const char* data = (const char*) buf;
+
+    queue->resync_instruction.insert(queue->resync_instruction.end(),
+            data, data + count);
+
+    return count;
+
+}
+
+/**
+ * Unlock handler of resync_socket, pushing each instruction as it completes.
+ */
+static void __guac_send_queue_resync_unlock_handler(guac_socket* socket) {
+    __guac_send_queue_push_resync((guac_send_queue*) socket->data);
+}
+
+/**
+ * Flush handler of resync_socket, pushing any data written outside of an
+ * instruction and requesting a flush of the user's socket.
+ */
+static size_t __guac_send_queue_resync_flush_handler(guac_socket* socket) {
+
+    guac_send_queue* queue = (guac_send_queue*) socket->data;
+    __guac_send_queue_push_resync(queue);
+    guac_send_queue_flush(queue);
+
+    return 0;
+
+}
+
+/**
+ * Brings the user up to date after queued data was discarded, invoking the
+ * resync handler of the client with resync_socket. This runs on the writer
+ * thread, and must be invoked without the queue lock held.
+ *
+ * @param queue
+ *     The send queue whose user must be resynchronized.
+ */
+static void __guac_send_queue_resync(guac_send_queue* queue) {
+
+    guac_user* user = queue->user;
+
+    guac_user_log(user, GUAC_LOG_INFO, "User fell too far behind. "
+            "Resynchronizing display.");
+
+    if (user->client->resync_handler(user, queue->resync_socket)) {
+        boost::lock_guard<boost::mutex> lock(queue->lock);
+        __guac_send_queue_fail(queue);
+        return;
+    }
+
+    guac_socket_flush(queue->resync_socket);
+
+}
+
+/**
+ * Main loop of the writer thread, writing queued instructions to the user's
+ * socket until the queue is stopped.
+ *
+ * @param queue
+ *     The send queue to drain.
+ */
+static void __guac_send_queue_writer(guac_send_queue* queue) {
+
+    guac_socket* socket = queue->user->socket;
+    boost::unique_lock<boost::mutex> lock(queue->lock);
+
+    while (!queue->stopping) {
+
+        /* Resynchronize the user before anything further is queued */
+        if (queue->resync_requested) {
+            queue->resync_requested = false;
+            lock.unlock();
+            __guac_send_queue_resync(queue);
+            lock.lock();
+            continue;
+        }
+
+        /* Write next instruction, if any */
+        if (!queue->chunks.empty()) {
+
+            guac_send_chunk chunk = queue->chunks.front();
+            queue->chunks.pop_front();
+
+            /* Write without holding the lock, such that pushes never block */
+            lock.unlock();
+            guac_socket_instruction_begin(socket);
+            int error = guac_socket_write(socket, chunk->data(), chunk->size());
+            guac_socket_instruction_end(socket);
+            lock.lock();
+
+            queue->queued_bytes -= chunk->size();
+
+            if (error)
+                __guac_send_queue_fail(queue);
+
+            continue;
+
+        }
+
+        /* Flush once everything requested has been written */
+        if (queue->flush_requested) {
+
+            queue->flush_requested = false;
+
+            lock.unlock();
+            int error = guac_socket_flush(socket);
+            lock.lock();
+
+            if (error)
+                __guac_send_queue_fail(queue);
+
+            continue;
+
+        }
+
+        queue->changed.wait(lock);
+
+    }
+
+}
+
+guac_send_queue* guac_send_queue_alloc(guac_user* user) {
+
+    guac_send_queue* queue = new guac_send_queue();
+    queue->user = user;
+    queue->max_bytes = user->client->send_queue_size;
+    queue->policy = user->client->send_queue_policy;
+    queue->queued_bytes = 0;
+    queue->flush_requested = false;
+    queue->resync_requested = false;
+    queue->failed = false;
+    queue->stopping = false;
+
+    /* Socket used by the resync handler to queue the current state */
+    queue->resync_socket = guac_socket_alloc();
+    queue->resync_socket->data = queue;
+    queue->resync_socket->write_handler = __guac_send_queue_resync_write_handler;
+    queue->resync_socket->unlock_handler = __guac_send_queue_resync_unlock_handler;
+    queue->resync_socket->flush_handler = __guac_send_queue_resync_flush_handler;
+
+    queue->writer = boost::thread(boost::bind(__guac_send_queue_writer, queue));
+
+    return queue;
+
+}
+
+void guac_send_queue_free(guac_send_queue* queue) {
+
+    {
+        boost::lock_guard<boost::mutex> lock(queue->lock);
+        queue->stopping = true;
+        __guac_send_queue_discard(queue);
+        queue->changed.notify_one();
+    }
+
+    /* At most a single blocked write remains, which will time out */
+    queue->writer.join();
+
+    /* The resync socket has nothing further to push */
+    queue->resync_socket->flush_handler = NULL;
+    guac_socket_free(queue->resync_socket);
+
+    delete queue;
+
+}
+
+void guac_send_queue_push(guac_send_queue* queue, const guac_send_chunk& chunk) {
+
+    boost::lock_guard<boost::mutex> lock(queue->lock);
+
+    /* Drop data for users which are gone */
+    if (queue->failed || queue->stopping)
+        return;
+
+    /* Drop data for users about to be resynchronized, other than stream
+     * control, which the resync does not cover */
+    if (queue->resync_requested) {
+        if (__guac_send_queue_is_stream_control(chunk))
+            __guac_send_queue_append(queue, chunk);
+        return;
+    }
+
+    /* Apply policy if the user has fallen too far behind */
+    if (queue->queued_bytes + chunk->size() > queue->max_bytes
+            && queue->queued_bytes > 0) {
+
+        if (queue->policy == GUAC_SEND_QUEUE_RESYNC
+                && queue->user->client->resync_handler != NULL) {
+            __guac_send_queue_discard_for_resync(queue);
+            if (__guac_send_queue_is_stream_control(chunk))
+                __guac_send_queue_append(queue, chunk);
+            queue->resync_requested = true;
+            queue->changed.notify_one();
+        }
+
+        else {
+            guac_user_log(queue->user, GUAC_LOG_WARNING, "User fell too far "
+                    "behind. Disconnecting.");
+            __guac_send_queue_fail(queue);
+        }
+
+        return;
+
+    }
+
+    __guac_send_queue_append(queue, chunk);
+
+}
+
+void guac_send_queue_flush(guac_send_queue* queue) {
+
+    boost::lock_guard<boost::mutex> lock(queue->lock);
+
+    queue->flush_requested = true;
+    queue->changed.notify_one();
+
+}
+
+int guac_send_queue_depth(guac_send_queue* queue) {
+
+    int queued_bytes;
+
+    {
+        boost::lock_guard<boost::mutex> lock(queue->lock);
+        queued_bytes = (int) queue->queued_bytes;
+    }
+
+    return queued_bytes + guac_socket_queue_depth(queue->user->socket);
+
+}
+
@@ -0,0 +1,619 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#ifdef HAVE_BOOST
+#include <guacamole/error.h>
+#include <guacamole/metrics.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/thread.hpp>
+
+/* The zlib bundled with libpng */
+#include <png/zlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * The largest single write made by the writer thread, in bytes.
+ */
+#define GUAC_SOCKET_ASYNC_FILE_WRITE_SIZE 262144
+
+/**
+ * The minimum number of milliseconds between two flushes of the compressed
+ * stream, each of which costs some compression ratio.
+ */
+#define GUAC_SOCKET_ASYNC_FILE_SYNC_INTERVAL 1000
+
+/**
+ * The gzip compression level used, favoring speed as the writer thread must
+ * keep up with the connection.
+ */
+#define GUAC_SOCKET_ASYNC_FILE_COMPRESSION_LEVEL 1
+
+/**
+ * The part of a Guacamole instruction being read while looking for the end of
+ * each instruction written.
+ */
+typedef enum guac_socket_async_file_parse_state {
+
+    /**
+     * The decimal length prefix of an element, up to its period.
+     */
+    GUAC_SOCKET_ASYNC_FILE_PARSE_LENGTH,
+
+    /**
+     * The value of an element, followed by its terminator.
+     */
+    GUAC_SOCKET_ASYNC_FILE_PARSE_VALUE
+
+} guac_socket_async_file_parse_state;
+
+typedef struct guac_socket_async_file_data {
+
+    /**
+     * The file receiving everything written by the writer thread.
+     */
+    boost::filesystem::ofstream file;
+
+    /**
+     * The action taken when the ring buffer cannot hold the data written.
+     */
+    guac_recording_overflow_policy policy;
+
+    /**
+     * Whether the data is gzip compressed before it is written.
+     */
+    bool compress;
+
+    /**
+     * The state of the gzip compression, if compressing.
+     */
+    z_stream deflater;
+
+    /**
+     * The output buffer of the gzip compression.
+     */
+    std::vector<char> deflated;
+
+    /**
+     * The time the compressed stream was last flushed.
+     */
+    guac_timestamp last_sync;
+
+    /**
+     * Lock guarding all ring buffer state below.
+     */
+    boost::mutex lock;
+
+    /**
+     * Signalled whenever the writer thread has something to do.
+     */
+    boost::condition_variable changed;
+
+    /**
+     * Signalled whenever the writer thread released space within the ring.
+     */
+    boost::condition_variable released;
+
+    /**
+     * The ring buffer holding data not yet written to the file.
+     */
+    std::vector<char> ring;
+
+    /**
+     * The offset of the oldest byte not yet written within the ring.
+     */
+    size_t head;
+
+    /**
+     * The number of bytes within the ring not yet written, including those
+     * currently being written by the writer thread.
+     */
+    size_t size;
+
+    /**
+     * The number of bytes at the start of the ring which form complete
+     * instructions. Only these are written, such that a recording stopped by
+     * the stop policy never ends in the middle of an instruction.
+     */
+    size_t complete;
+
+    /**
+     * The number of bytes currently being written by the writer thread.
+     */
+    size_t writing;
+
+    /**
+     * The part of the instruction being read at the end of the ring.
+     */
+    guac_socket_async_file_parse_state parse_state;
+
+    /**
+     * The length of the element being read at the end of the ring, while
+     * reading its length, or the number of its characters not yet read,
+     * while reading its value.
+     */
+    size_t parse_length;
+
+    /**
+     * Whether the file should be flushed once the ring is empty.
+     */
+    bool flush_requested;
+
+    /**
+     * Whether the file could not be written, in which case all further data
+     * is discarded.
+     */
+    bool failed;
+
+    /**
+     * Whether the ring overflowed under the stop policy, in which case all
+     * further data is discarded, while the data recorded so far is still
+     * written and the file properly completed.
+     */
+    bool overflowed;
+
+    /**
+     * Whether the writer thread should exit once the ring is empty.
+     */
+    bool stopping;
+
+    /**
+     * The thread writing the ring buffer to the file.
+     */
+    boost::thread writer;
+
+} guac_socket_async_file_data;
+
+/**
+ * Writes the given data to the file, compressing it first if required. This
+ * is only ever invoked by the writer thread, without the lock held.
+ *
+ * @param data
+ *     The data of the async file socket.
+ *
+ * @param buf
+ *     The data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @param flush
+ *     The zlib flush mode to apply once the data is compressed, ignored if
+ *     not compressing.
+ *
+ * @return
+ *     Zero if the data was written, non-zero otherwise.
+ */
+static int __guac_socket_async_file_write(guac_socket_async_file_data* data,
+        const char* buf, size_t count, int flush) {
+
+    if (!data->compress) {
+        data->file.write(buf, count);
+        return data->file.fail();
+    }
+
+    data->deflater.next_in = (Bytef*) buf;
+    data->deflater.avail_in = (uInt) count;
+
+    /* Keep writing out compressed data until all input is consumed and the
+     * requested flush is complete */
+    do {
+
+        data->deflater.next_out = (Bytef*) &data->deflated[0];
+        data->deflater.avail_out = (uInt) data->deflated.size();
+
+        if (deflate(&data->deflater, flush) == Z_STREAM_ERROR)
+            return 1;
+
+        size_t deflated = data->deflated.size() - data->deflater.avail_out;
+        data->file.write(&data->deflated[0], deflated);
+        if (data->file.fail())
+            return 1;
+
+    } while (data->deflater.avail_out == 0);
+
+    return 0;
+
+}
+
+/**
+ * Pushes everything written so far to the file. This is only ever invoked by
+ * the writer thread, without the lock held.
+ *
+ * @param data
+ *     The data of the async file socket.
+ *
+ * @return
+ *     Zero if the file was flushed, non-zero otherwise.
+ */
+static int __guac_socket_async_file_sync(guac_socket_async_file_data* data) {
+
+    /* Flushing the compressed stream ends the current block, which is only
+     * worth it every now and then */
+    if (data->compress) {
+
+        guac_timestamp now = guac_timestamp_current();
+        if (now - data->last_sync < GUAC_SOCKET_ASYNC_FILE_SYNC_INTERVAL)
+            return 0;
+
+        data->last_sync = now;
+        if (__guac_socket_async_file_write(data, NULL, 0, Z_SYNC_FLUSH))
+            return 1;
+
+    }
+
+    data->file.flush();
+    return data->file.fail();
+
+}
+
+/**
+ * Returns the number of bytes at the start of the ring which the writer
+ * thread may write. The lock must be held.
+ *
+ * @param data
+ *     The data of the async file socket.
+ *
+ * @return
+ *     The number of bytes which may be written.
+ */
+static size_t __guac_socket_async_file_writable(
+        guac_socket_async_file_data* data) {
+
+    /* Everything left is written once stopping, and an instruction larger
+     * than the whole ring cannot be held back */
+    if (data->stopping
+            || (data->complete == 0 && data->size == data->ring.size()))
+        return data->size;
+
+    return data->complete;
+
+}
+
+/**
+ * Advances the search for the end of each instruction over the given data,
+ * just copied to the end of the ring, marking each instruction found as
+ * complete. The lock must be held.
+ *
+ * @param data
+ *     The data of the async file socket.
+ *
+ * @param buf
+ *     The data copied to the end of the ring.
+ *
+ * @param count
+ *     The number of bytes copied, already counted within the size of the
+ *     ring.
+ */
+static void __guac_socket_async_file_parse(guac_socket_async_file_data* data,
+        const char* buf, size_t count) {
+
+    for (size_t i = 0; i < count; i++) {
+
+        unsigned char c = (unsigned char) buf[i];
+
+        if (data->parse_state == GUAC_SOCKET_ASYNC_FILE_PARSE_LENGTH) {
+
+            if (c == '.')
+                data->parse_state = GUAC_SOCKET_ASYNC_FILE_PARSE_VALUE;
+            else
+                data->parse_length = data->parse_length * 10 + (c - '0');
+
+            continue;
+
+        }
+
+        /* Lengths are in characters, continuation bytes of UTF-8 are part
+         * of the character before them */
+        if ((c & 0xC0) == 0x80)
+            continue;
+
+        if (data->parse_length > 0) {
+            data->parse_length--;
+            continue;
+        }
+
+        /* The terminator of the element, ending the instruction if ';' */
+        if (c == ';')
+            data->complete = data->size - count + i + 1;
+
+        data->parse_state = GUAC_SOCKET_ASYNC_FILE_PARSE_LENGTH;
+        data->parse_length = 0;
+
+    }
+
+}
+
+/**
+ * The main function of the writer thread, writing the ring buffer to the
+ * file in large sequential writes until the socket is freed.
+ *
+ * @param data
+ *     The data of the async file socket.
+ */
+static void __guac_socket_async_file_run(guac_socket_async_file_data* data) {
+
+    boost::mutex::scoped_lock lock(data->lock);
+
+    for (;;) {
+
+        while (__guac_socket_async_file_writable(data) == 0
+                && !data->flush_requested && !data->stopping)
+            data->changed.wait(lock);
+
+        /* Everything was written */
+        if (data->size == 0 && data->stopping)
+            break;
+
+        int error;
+        size_t writable = __guac_socket_async_file_writable(data);
+
+        /* Flush only once everything requested so far was written */
+        if (writable == 0) {
+            data->flush_requested = false;
+            lock.unlock();
+            error = __guac_socket_async_file_sync(data);
+            lock.lock();
+        }
+
+        /* The written region is not touched by writers until released */
+        else {
+            size_t chunk = std::min(writable, data->ring.size() - data->head);
+            chunk = std::min<size_t>(chunk, GUAC_SOCKET_ASYNC_FILE_WRITE_SIZE);
+
+            data->writing = chunk;
+            lock.unlock();
+            error = __guac_socket_async_file_write(data,
+                    &data->ring[data->head], chunk, Z_NO_FLUSH);
+            lock.lock();
+            data->writing = 0;
+
+            data->head = (data->head + chunk) % data->ring.size();
+            data->size -= chunk;
+            data->complete -= std::min(chunk, data->complete);
+            data->released.notify_all();
+        }
+
+        /* Nothing more can be recorded once the file fails */
+        if (error) {
+            data->failed = true;
+            data->size = 0;
+            data->complete = 0;
+            data->released.notify_all();
+            break;
+        }
+
+    }
+
+}
+
+/**
+ * Copies the given data into the ring buffer, applying the overflow policy
+ * if it does not fit. The data is silently discarded once recording failed,
+ * such that the connection is not affected. If the stop policy applies, the
+ * part of the current instruction already buffered is discarded too, such
+ * that the recording ends with the last complete instruction.
+ */
+static size_t guac_socket_async_file_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_async_file_data* data =
+        static_cast<guac_socket_async_file_data*>(socket->data);
+
+    const char* current = static_cast<const char*>(buf);
+    size_t remaining = count;
+
+    boost::mutex::scoped_lock lock(data->lock);
+
+    while (remaining > 0 && !data->failed && !data->overflowed) {
+
+        size_t available = data->ring.size() - data->size;
+
+        /* The ring is full, the storage is not keeping up */
+        if (available < remaining
+                && data->policy == GUAC_RECORDING_OVERFLOW_STOP) {
+            guac_metrics_counter_add("guac_recording_overflows_total", 1);
+            data->overflowed = true;
+
+            /* Part of an instruction larger than the ring may already be
+             * being written, which cannot be taken back */
+            data->size = std::max(data->complete, data->writing);
+            data->changed.notify_one();
+            break;
+        }
+
+        if (available == 0) {
+            int64_t blocked = guac_metrics_time_usec();
+            while (data->size == data->ring.size() && !data->failed)
+                data->released.wait(lock);
+            guac_metrics_histogram_observe("guac_recording_blocked_milliseconds",
+                    (guac_metrics_time_usec() - blocked) / 1000.0);
+            continue;
+        }
+
+        /* Copy as much as fits, wrapping around the end of the ring */
+        size_t tail = (data->head + data->size) % data->ring.size();
+        size_t chunk = std::min(remaining, available);
+        size_t first = std::min(chunk, data->ring.size() - tail);
+
+        memcpy(&data->ring[tail], current, first);
+        memcpy(&data->ring[0], current + first, chunk - first);
+
+        data->size += chunk;
+        __guac_socket_async_file_parse(data, current, chunk);
+        current += chunk;
+        remaining -= chunk;
+
+        data->changed.notify_one();
+
+    }
+
+    return count;
+
+}
+
+static size_t guac_socket_async_file_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+    return -1;
+}
+
+static int guac_socket_async_file_select_handler(guac_socket* socket,
+        int usec_timeout) {
+    return -1;
+}
+
+/**
+ * Requests that the writer thread flush the file once everything written so
+ * far is written, without waiting for it.
+ */
+static size_t guac_socket_async_file_flush_handler(guac_socket* socket) {
+
+    guac_socket_async_file_data* data =
+        static_cast<guac_socket_async_file_data*>(socket->data);
+
+    boost::mutex::scoped_lock lock(data->lock);
+    data->flush_requested = true;
+    data->changed.notify_one();
+
+    return 0;
+
+}
+
+static int guac_socket_async_file_queue_depth_handler(guac_socket* socket) {
+
+    guac_socket_async_file_data* data =
+        static_cast<guac_socket_async_file_data*>(socket->data);
+
+    boost::mutex::scoped_lock lock(data->lock);
+    return (int) data->size;
+
+}
+
+/**
+ * Waits for the writer thread to write everything buffered, then completes
+ * and closes the file.
+ */
+static int guac_socket_async_file_free_handler(guac_socket* socket) {
+
+    guac_socket_async_file_data* data =
+        static_cast<guac_socket_async_file_data*>(socket->data);
+
+    {
+        boost::mutex::scoped_lock lock(data->lock);
+        data->stopping = true;
+        data->changed.notify_one();
+    }
+
+    data->writer.join();
+
+    if (data->compress) {
+        if (!data->failed)
+            __guac_socket_async_file_write(data, NULL, 0, Z_FINISH);
+        deflateEnd(&data->deflater);
+    }
+
+    data->file.close();
+    delete data;
+
+    return 0;
+
+}
+
+int guac_socket_async_file_stopped(guac_socket* socket) {
+
+    guac_socket_async_file_data* data =
+        static_cast<guac_socket_async_file_data*>(socket->data);
+
+    boost::mutex::scoped_lock lock(data->lock);
+    return data->failed || data->overflowed;
+
+}
+
+guac_socket* guac_socket_async_file(const char* file, size_t buffer_size,
+        guac_recording_overflow_policy policy, int compress) {
+
+    guac_socket_async_file_data* data = new guac_socket_async_file_data();
+
+    data->file.open(boost::filesystem::path(file),
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!data->file.is_open()) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to create file";
+        delete data;
+        return NULL;
+    }
+
+    /* A gzip header is written around the deflate stream */
+    data->compress = compress != 0;
+    if (data->compress) {
+
+        memset(&data->deflater, 0, sizeof(data->deflater));
+        if (deflateInit2(&data->deflater,
+                    GUAC_SOCKET_ASYNC_FILE_COMPRESSION_LEVEL, Z_DEFLATED,
+                    15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            guac_error = GUAC_STATUS_INTERNAL_ERROR;
+            guac_error_message = "Unable to initialize compression";
+            delete data;
+            return NULL;
+        }
+
+        data->deflated.resize(GUAC_SOCKET_ASYNC_FILE_WRITE_SIZE);
+        data->last_sync = guac_timestamp_current();
+
+    }
+
+    data->policy = policy;
+    data->ring.resize(std::max<size_t>(buffer_size,
+                GUAC_SOCKET_OUTPUT_BUFFER_SIZE));
+    data->head = 0;
+    data->size = 0;
+    data->complete = 0;
+    data->writing = 0;
+    data->parse_state = GUAC_SOCKET_ASYNC_FILE_PARSE_LENGTH;
+    data->parse_length = 0;
+    data->flush_requested = false;
+    data->failed = false;
+    data->overflowed = false;
+    data->stopping = false;
+    data->writer = boost::thread(__guac_socket_async_file_run, data);
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = data;
+
+    /* Assign handlers */
+    socket->read_handler = guac_socket_async_file_read_handler;
+    socket->write_handler = guac_socket_async_file_write_handler;
+    socket->select_handler = guac_socket_async_file_select_handler;
+    socket->flush_handler = guac_socket_async_file_flush_handler;
+    socket->queue_depth_handler = guac_socket_async_file_queue_depth_handler;
+    socket->free_handler = guac_socket_async_file_free_handler;
+
+    return socket;
+
+}
+#endif
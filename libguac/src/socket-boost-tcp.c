@@ -24,6 +24,8 @@
 #include <boost/shared_ptr.hpp>
 #include <guacamole/socket.h>
 
+#include <string.h>
+
 typedef struct guac_socket_boost_tcp_data
 {
 	boost::asio::io_service ios;
@@ -34,6 +36,15 @@ typedef struct guac_socket_boost_tcp_data
 	boost::mutex socket_mutex;
 	boost::mutex select_mutex;
 
+   // Protects the output buffer, guaranteeing atomicity of writes and flushes
+   boost::mutex buffer_mutex;
+
+   // The output buffer, bytes written are collected here until a flush or until the buffer is full
+   char out_buf[GUAC_SOCKET_OUTPUT_BUFFER_SIZE];
+
+   // The number of bytes currently in the output buffer
+   int written;
+
    bool is_ssl;
 } guac_socket_boost_tcp_data;
 
@@ -60,7 +71,8 @@ static size_t guac_socket_boost_tcp_socket_read_handler(guac_socket * socket,
 	return retval;
 }
 
-static size_t guac_socket_boost_tcp_socket_write_handler(guac_socket* socket,
+// Writes the whole given buffer directly to the underlying socket, blocking until all is written
+static size_t guac_socket_boost_tcp_socket_write(guac_socket* socket,
 	const void* buf, size_t count)
 {
    guac_socket_boost_tcp_data * data = static_cast<guac_socket_boost_tcp_data*>(
@@ -77,13 +89,84 @@ static size_t guac_socket_boost_tcp_socket_write_handler(guac_socket* socket,
    {
       guac_error = GUAC_STATUS_SEE_ERRNO;
 	  guac_error_message = "Error writing data to socket";
-	  return retval;
+	  return -1;
    }
 
    // Return amount written
    return retval;
 }
 
+// Drains the output buffer to the underlying socket
+// Must ONLY be called while the buffer mutex is held
+static size_t guac_socket_boost_tcp_socket_flush(guac_socket* socket)
+{
+   guac_socket_boost_tcp_data * data = static_cast<guac_socket_boost_tcp_data*>(
+      socket->data);
+
+   // Nothing buffered, nothing to do
+   if (data->written == 0)
+   {
+      return 0;
+   }
+
+   // Write all the buffered bytes at once, a single syscall (and a single TLS record) per drain
+   size_t retval = guac_socket_boost_tcp_socket_write(socket, data->out_buf, data->written);
+   data->written = 0;
+
+   return retval == (size_t)-1 ? 1 : 0;
+}
+
+static size_t guac_socket_boost_tcp_socket_write_handler(guac_socket* socket,
+	const void* buf, size_t count)
+{
+   guac_socket_boost_tcp_data * data = static_cast<guac_socket_boost_tcp_data*>(
+      socket->data);
+
+   boost::mutex::scoped_lock lock(data->buffer_mutex);
+
+   const char* current = (const char *)buf;
+   size_t original_count = count;
+
+   // Append to the output buffer, draining it whenever it fills up
+   while (count > 0)
+   {
+      int remaining = sizeof(data->out_buf) - data->written;
+
+      // No space left, drain and retry
+      if (remaining == 0)
+      {
+         if (guac_socket_boost_tcp_socket_flush(socket))
+         {
+            return -1;
+         }
+
+         continue;
+      }
+
+      // Big writes with an empty buffer skip the copy and go to the socket as is
+      if (data->written == 0 && count >= sizeof(data->out_buf))
+      {
+         if (guac_socket_boost_tcp_socket_write(socket, current, count) == (size_t)-1)
+         {
+            return -1;
+         }
+
+         break;
+      }
+
+      int chunk_size = count < (size_t)remaining ? (int)count : remaining;
+
+      memcpy(data->out_buf + data->written, current, chunk_size);
+      data->written += chunk_size;
+
+      current += chunk_size;
+      count -= chunk_size;
+   }
+
+   // All bytes were written, possibly some only to the output buffer
+   return original_count;
+}
+
 static void guac_socket_boost_tcp_socket_lock_handler(guac_socket * socket)
 {
 	guac_socket_boost_tcp_data * data = static_cast<guac_socket_boost_tcp_data*>(
@@ -116,49 +199,55 @@ static size_t guac_socket_boost_tcp_socket_flush_handler(guac_socket* socket)
    guac_socket_boost_tcp_data * data = static_cast<guac_socket_boost_tcp_data*>(
       socket->data);
 
-   return 0;
+   boost::mutex::scoped_lock lock(data->buffer_mutex);
+
+   return guac_socket_boost_tcp_socket_flush(socket);
 }
 
-static int guac_socket_boost_tcp_socket_select_handler(guac_socket* socket,
-	int usec_timeout)
+// The state of a single select, shared with its completion handler which may outlive the select on a timeout
+typedef struct guac_socket_boost_tcp_select_state
 {
+   boost::mutex mutex;
    boost::condition_variable cond;
+   boost::system::error_code error;
+   bool done;
+} guac_socket_boost_tcp_select_state;
 
+static int guac_socket_boost_tcp_socket_select_handler(guac_socket* socket,
+	int usec_timeout)
+{
 	guac_socket_boost_tcp_data * data = static_cast<guac_socket_boost_tcp_data*>(socket->data);
 
-   // Lock the select mutex for the condition
-	boost::mutex::scoped_lock lock(data->select_mutex);
+   // Only a single select at a time
+	boost::mutex::scoped_lock select_lock(data->select_mutex);
 
-	boost::system::error_code async_error;
+   boost::shared_ptr<guac_socket_boost_tcp_select_state> state(new guac_socket_boost_tcp_select_state());
+   state->done = false;
 
    // Define the handler for the async read some callback
-   auto handler = [&](const boost::system::error_code & error, size_t bytes) {
-      // Re-lock the select mutex and notify the conditional variable that new data is ready
-      boost::mutex::scoped_lock lambda_lock(data->select_mutex);
-      async_error = error;
-      cond.notify_all();
+   auto handler = [state](const boost::system::error_code & error, size_t bytes) {
+      // Lock the state and notify the waiting select that new data is ready
+      boost::mutex::scoped_lock lambda_lock(state->mutex);
+      state->error = error;
+      state->done = true;
+      state->cond.notify_all();
    };
-   
-   // Add an async read some job to the io service with empty buffers to only peek for data
+
+   // Add an async read some job with empty buffers to only peek for data
+   // The io service of the socket is run by its owner, so the handler is called without running it here
    data->is_ssl ? data->ssl_socket->async_read_some(boost::asio::null_buffers(), handler) :
       data->socket->async_read_some(boost::asio::null_buffers(), handler);
 
-   // Create a thread which will run the io service to perform the job
-   boost::thread runner([&]()
-   {
-      // Run IO service depending if SSL or not
-      data->is_ssl ? data->ssl_socket->get_io_service().run_one() :
-         data->socket->get_io_service().run_one();
-   });
-
    // Wait for either a notification from the handler or a timeout pop
-	if(!cond.timed_wait(lock, boost::posix_time::milliseconds(usec_timeout)))
+   boost::mutex::scoped_lock lock(state->mutex);
+   if(!state->cond.timed_wait(lock, boost::posix_time::milliseconds(usec_timeout),
+                              [&state]() { return state->done; }))
 	{
       guac_error = GUAC_STATUS_TIMEOUT;
       guac_error_message = "Timeout while waiting for data on socket";
       return 0;
 	}
-   else if(async_error)
+   else if(state->error)
    {
       guac_error = GUAC_STATUS_SEE_ERRNO;
       guac_error_message = "Error while waiting for data on socket";
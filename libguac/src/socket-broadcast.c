@@ -24,7 +24,10 @@
 #include <guacamole/socket.h>
 #include <guacamole/user.h>
 #ifdef HAVE_BOOST
+#include <guacamole/send-queue.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
 #elif defined HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -48,6 +51,18 @@ typedef struct guac_socket_broadcast_data {
      */
 #ifdef HAVE_BOOST
 	boost::mutex socket_lock;
+
+    /**
+     * The thread currently holding socket_lock, if any.
+     */
+    boost::thread::id owner;
+
+    /**
+     * The instruction currently being written. Each instruction is broadcast
+     * as a whole once complete, such that a single buffer can be shared by
+     * the send queues of all users.
+     */
+    std::vector<char> instruction;
 #elif defined HAVE_LIBPTHREAD
     pthread_mutex_t socket_lock;
 #endif
@@ -69,6 +84,13 @@ typedef struct __write_chunk {
      */
     size_t length;
 
+#ifdef HAVE_BOOST
+    /**
+     * The same buffer, shared with the send queues of all users having one.
+     */
+    guac_send_chunk shared;
+#endif
+
 } __write_chunk;
 
 /**
@@ -115,6 +137,14 @@ static void* __write_chunk_callback(guac_user* user, void* data) {
 
     __write_chunk* chunk = (__write_chunk*) data;
 
+#ifdef HAVE_BOOST
+    /* Hand over to the user's writer thread, if any */
+    if (user->__send_queue != NULL) {
+        guac_send_queue_push(user->__send_queue, chunk->shared);
+        return NULL;
+    }
+#endif
+
     /* Attempt write, disconnect on failure */
     if (guac_socket_write(user->socket, chunk->buffer, chunk->length))
         guac_user_stop(user);
@@ -123,10 +153,28 @@ static void* __write_chunk_callback(guac_user* user, void* data) {
 
 }
 
+/**
+ * Writes the given data to all connected users, either directly or via their
+ * send queues.
+ *
+ * @param data
+ *     The data associated with the broadcast socket.
+ *
+ * @param chunk
+ *     The chunk of data to broadcast.
+ */
+static void __guac_socket_broadcast_chunk(guac_socket_broadcast_data* data,
+        __write_chunk* chunk) {
+
+    guac_client_foreach_user(data->client, __write_chunk_callback, chunk);
+
+}
+
 /**
  * Socket write handler which operates on each of the sockets of all connected
  * users. This write handler will always succeed, but any failing user-specific
- * writes will invoke guac_user_stop() on the failing user.
+ * writes will invoke guac_user_stop() on the failing user. Data written within
+ * an instruction is broadcast once that instruction is complete.
  *
  * @param socket
  *     The socket to which the given data must be written.
@@ -148,13 +196,29 @@ static size_t __guac_socket_broadcast_write_handler(guac_socket* socket,
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
+#ifdef HAVE_BOOST
+    /* Defer until the current instruction is complete */
+    if (data->owner == boost::this_thread::get_id()) {
+        const char* buffer = (const char*) buf;
+        data->instruction.insert(data->instruction.end(), buffer,
+                buffer + count);
+        return count;
+    }
+#endif
+
     /* Build chunk */
     __write_chunk chunk;
     chunk.buffer = buf;
     chunk.length = count;
 
+#ifdef HAVE_BOOST
+    /* Data written outside an instruction must be copied for queueing */
+    const char* buffer = (const char*) buf;
+    chunk.shared.reset(new std::vector<char>(buffer, buffer + count));
+#endif
+
     /* Broadcast chunk to all users */
-    guac_client_foreach_user(data->client, __write_chunk_callback, &chunk);
+    __guac_socket_broadcast_chunk(data, &chunk);
 
     return count;
 
@@ -177,6 +241,14 @@ static size_t __guac_socket_broadcast_write_handler(guac_socket* socket,
  */
 static void* __flush_callback(guac_user* user, void* data) {
 
+#ifdef HAVE_BOOST
+    /* Flush once everything queued has been written */
+    if (user->__send_queue != NULL) {
+        guac_send_queue_flush(user->__send_queue);
+        return NULL;
+    }
+#endif
+
     /* Attempt flush, disconnect on failure */
     if (guac_socket_flush(user->socket))
         guac_user_stop(user);
@@ -226,6 +298,12 @@ static size_t __guac_socket_broadcast_flush_handler(guac_socket* socket) {
  */
 static void* __lock_callback(guac_user* user, void* data) {
 
+#ifdef HAVE_BOOST
+    /* Queued instructions are written whole by the user's writer thread */
+    if (user->__send_queue != NULL)
+        return NULL;
+#endif
+
     /* Lock socket */
     guac_socket_instruction_begin(user->socket);
 
@@ -250,6 +328,7 @@ static void __guac_socket_broadcast_lock_handler(guac_socket* socket) {
     /* Acquire exclusive access to socket */
 #ifdef HAVE_BOOST
 	data->socket_lock.lock();
+	data->owner = boost::this_thread::get_id();
 #elif defined HAVE_LIBPTHREAD
     pthread_mutex_lock(&(data->socket_lock));
 #endif
@@ -275,6 +354,12 @@ static void __guac_socket_broadcast_lock_handler(guac_socket* socket) {
  */
 static void* __unlock_callback(guac_user* user, void* data) {
 
+#ifdef HAVE_BOOST
+    /* Sockets of users with send queues were never locked */
+    if (user->__send_queue != NULL)
+        return NULL;
+#endif
+
     /* Unlock socket */
     guac_socket_instruction_end(user->socket);
 
@@ -295,11 +380,29 @@ static void __guac_socket_broadcast_unlock_handler(guac_socket* socket) {
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
+#ifdef HAVE_BOOST
+    /* Broadcast the completed instruction as a single shared buffer */
+    if (!data->instruction.empty()) {
+
+        std::vector<char>* instruction = new std::vector<char>();
+        instruction->swap(data->instruction);
+
+        __write_chunk chunk;
+        chunk.shared.reset(instruction);
+        chunk.buffer = instruction->data();
+        chunk.length = instruction->size();
+
+        __guac_socket_broadcast_chunk(data, &chunk);
+
+    }
+#endif
+
     /* Unlock sockets of all users */
     guac_client_foreach_user(data->client, __unlock_callback, NULL);
 
     /* Relinquish exclusive access to socket */
 #ifdef HAVE_BOOST
+	data->owner = boost::thread::id();
 	data->socket_lock.unlock();
 #elif defined HAVE_LIBPTHREAD
     pthread_mutex_unlock(&(data->socket_lock));
@@ -307,6 +410,85 @@ static void __guac_socket_broadcast_unlock_handler(guac_socket* socket) {
 
 }
 
+/**
+ * Callback which is invoked by guac_client_foreach_user() to update the
+ * deepest queue depth seen so far with the queue depth of the given user's
+ * socket.
+ *
+ * @param user
+ *     The user whose socket queue depth should be considered.
+ *
+ * @param data
+ *     Pointer to an array of two ints, the first containing the deepest
+ *     socket queue depth seen so far, and the second containing the
+ *     shallowest send queue depth seen so far (-1 if none). The relevant int
+ *     will be updated according to the given user's queue depth.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __queue_depth_callback(guac_user* user, void* data) {
+
+    int* queue_depth = (int*) data;
+
+#ifdef HAVE_BOOST
+    /* Users with send queues are tracked separately */
+    if (user->__send_queue != NULL) {
+
+        int user_queue_depth = guac_send_queue_depth(user->__send_queue);
+
+        /* Keep the shallowest send queue */
+        if (queue_depth[1] < 0 || user_queue_depth < queue_depth[1])
+            queue_depth[1] = user_queue_depth;
+
+        return NULL;
+
+    }
+#endif
+
+    int user_queue_depth = guac_socket_queue_depth(user->socket);
+
+    /* Keep the deepest queue */
+    if (user_queue_depth > *queue_depth)
+        *queue_depth = user_queue_depth;
+
+    return NULL;
+
+}
+
+/**
+ * Socket queue depth handler which reports the queue depth of the most
+ * backed-up user. As every user receives every instruction, the slowest user
+ * is the one which determines how much more can be written. Users with send
+ * queues are the exception: as users who fall behind are resynchronized or
+ * disconnected once their queue is full, only the least backed-up of those
+ * users is considered, such that a slow user cannot pace all others.
+ *
+ * @param socket
+ *     The broadcast socket to query.
+ *
+ * @return
+ *     The deepest queue depth among the sockets of all connected users.
+ */
+static int __guac_socket_broadcast_queue_depth_handler(guac_socket* socket) {
+
+    guac_socket_broadcast_data* data =
+        (guac_socket_broadcast_data*) socket->data;
+
+    /* Deepest socket, and shallowest send queue (-1 if none) */
+    int queue_depth[2] = { 0, -1 };
+
+    /* Find the deepest queue among all users */
+    guac_client_foreach_user(data->client, __queue_depth_callback,
+            queue_depth);
+
+    if (queue_depth[1] > queue_depth[0])
+        return queue_depth[1];
+
+    return queue_depth[0];
+
+}
+
 /**
  * Callback which handles select operations on the broadcast socket, waiting
  * for data to become available such that the next read operation will not
@@ -351,11 +533,12 @@ static int __guac_socket_broadcast_free_handler(guac_socket* socket) {
         (guac_socket_broadcast_data*) socket->data;
 
     /* Destroy locks */
-#ifdef HAVE_LIBPTHREAD
+#ifdef HAVE_BOOST
+    delete data;
+#elif defined HAVE_LIBPTHREAD
     pthread_mutex_destroy(&(data->socket_lock));
-#endif
-
     free(data);
+#endif
     return 0;
 
 }
@@ -368,8 +551,12 @@ guac_socket* guac_socket_broadcast(guac_client* client)
 
     /* Allocate socket and associated data */
     guac_socket* socket = guac_socket_alloc();
+#ifdef HAVE_BOOST
+    guac_socket_broadcast_data* data = new guac_socket_broadcast_data();
+#elif defined HAVE_LIBPTHREAD
     guac_socket_broadcast_data* data =
         static_cast<guac_socket_broadcast_data*>(malloc(sizeof(guac_socket_broadcast_data)));
+#endif
 
     /* Store client as socket data */
     data->client = client;
@@ -389,6 +576,7 @@ guac_socket* guac_socket_broadcast(guac_client* client)
     socket->lock_handler   = __guac_socket_broadcast_lock_handler;
     socket->unlock_handler = __guac_socket_broadcast_unlock_handler;
     socket->free_handler   = __guac_socket_broadcast_free_handler;
+    socket->queue_depth_handler = __guac_socket_broadcast_queue_depth_handler;
 
     return socket;
 
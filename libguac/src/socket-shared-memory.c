@@ -2697,11 +2697,14 @@ guac_socket * guac_socket_shared_memory_socket_join(const std::string & shname,
 #include <boost/interprocess/sync/interprocess_upgradable_mutex.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
 #include <boost/interprocess/sync/upgradable_lock.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
 
+#include <atomic>
 #include <boost/date_time.hpp>
 #include <boost/shared_ptr.hpp>
 #include <guacamole/error.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 //#ifdef WIN32
 //   #include <boost/interprocess/managed_windows_shared_memory.hpp>
 //   typedef boost::interprocess::managed_windows_shared_memory ManagedSharedMemoryType;
@@ -2713,6 +2716,13 @@ typedef boost::interprocess::managed_shared_memory ManagedSharedMemoryType;
 
 #define SHARED_MEMORY_INITIALIZED_SIZE 4*1024*1024
 #define QUEUE_SHARED_MEMORY_NAME "RegionQueue"
+#define RING_SHARED_MEMORY_NAME "RegionRing"
+
+// The maximum time in MS a writer blocks on a full queue waiting for the reader to make room
+#define SHARED_MEMORY_WRITE_TIMEOUT 15000
+
+// Extra room given to the managed shared memory on top of the ring buffer itself for the segment bookkeeping
+#define RING_SHARED_MEMORY_OVERHEAD 64*1024
 
 typedef struct guac_socket_shared_memory_region_packet
 {
@@ -2724,6 +2734,7 @@ typedef struct guac_socket_shared_memory_region_queue
 {
 	boost::interprocess::interprocess_upgradable_mutex queue_mutex;
 	boost::interprocess::interprocess_condition_any queue_condition;
+	boost::interprocess::interprocess_condition_any queue_space_condition;
 	int queue_current_size;
 	int queue_max_size;
 	int queue_packet_size;
@@ -2731,10 +2742,25 @@ typedef struct guac_socket_shared_memory_region_queue
 	int queue_write_marker;
 	boost::interprocess::offset_ptr<guac_socket_shared_memory_region_packet> queue;
 } guac_socket_shared_memory_region_queue;
+// Byte granular single producer single consumer ring buffer
+// The head and tail are free running counters, the ring capacity is a power of two so they can wrap safely
+// Only the reader ever moves the head and only the writer ever moves the tail, no lock is taken to move data
+// The mutex and the conditions are only used to put an idle reader or a blocked writer to sleep and to wake it up
+typedef struct guac_socket_shared_memory_region_ring
+{
+	std::atomic<unsigned int> ring_head;
+	std::atomic<unsigned int> ring_tail;
+	unsigned int ring_capacity;
+	boost::interprocess::interprocess_mutex ring_mutex;
+	boost::interprocess::interprocess_condition ring_condition;
+	boost::interprocess::interprocess_condition ring_space_condition;
+	boost::interprocess::offset_ptr<char> ring_buffer;
+} guac_socket_shared_memory_region_ring;
 typedef struct guac_socket_shared_memory_region_data
 {
 	boost::shared_ptr<ManagedSharedMemoryType> managed_shm;
 	boost::interprocess::offset_ptr<guac_socket_shared_memory_region_queue> region_queue;
+	boost::interprocess::offset_ptr<guac_socket_shared_memory_region_ring> region_ring;
 } guac_socket_shared_memory_region_data;
 typedef struct guac_socket_shared_memory_data
 {
@@ -2745,6 +2771,7 @@ typedef struct guac_socket_shared_memory_data
 	bool is_parent;
 	bool multi_packet_read;
 	bool streamlined;
+	bool ring_buffer;
 } guac_socket_shared_memory_data;
 
 bool guac_socket_shared_memory_socket_queue_create(guac_socket_shared_memory_region_data * region_data,
@@ -2838,6 +2865,9 @@ void guac_socket_shared_memory_socket_queue_pop(guac_socket_shared_memory_region
 	// Decrease the queue size since the packet has been popped
 	shm_queue->queue_current_size--;
 
+	// A writer might be blocked on the full queue, there is room for it now
+	shm_queue->queue_space_condition.notify_all();
+
 	// If the queue is empty, reset the markers
 	if (shm_queue->queue_current_size == 0)
 	{
@@ -2904,6 +2934,250 @@ int guac_socket_shared_memory_socket_queue_free_size(guac_socket_shared_memory_r
 	return shm_queue->queue_max_size - shm_queue->queue_current_size;
 }
 
+bool guac_socket_shared_memory_socket_ring_create(guac_socket_shared_memory_region_data * region_data,
+	const std::string & shname, std::size_t size)
+{
+	// Round the capacity up to a power of two, the free running head and tail counters rely on it when wrapping
+	unsigned int capacity = 1;
+	while (capacity < size)
+	{
+		capacity <<= 1;
+	}
+
+	try
+	{
+		// Remove stale shared memory before creation, this rmeoves all the constructions aswell
+		boost::interprocess::shared_memory_object::remove(shname.c_str());
+
+		region_data->managed_shm.reset(new ManagedSharedMemoryType(boost::interprocess::create_only, shname.c_str(),
+			std::max<std::size_t>(SHARED_MEMORY_INITIALIZED_SIZE, capacity + RING_SHARED_MEMORY_OVERHEAD)));
+
+		// Allocate the ring and its buffer
+		region_data->region_ring = region_data->managed_shm->construct<guac_socket_shared_memory_region_ring>(
+			RING_SHARED_MEMORY_NAME)();
+		region_data->region_ring->ring_head = 0;
+		region_data->region_ring->ring_tail = 0;
+		region_data->region_ring->ring_capacity = capacity;
+		region_data->region_ring->ring_buffer = region_data->managed_shm->construct<char>(
+			boost::interprocess::anonymous_instance)[capacity](0);
+
+		// Shrink the region to the exect needed size
+		region_data->managed_shm->get_segment_manager()->shrink_to_fit();
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+bool guac_socket_shared_memory_socket_ring_join(guac_socket_shared_memory_region_data * region_data,
+	const std::string & shname)
+{
+	try
+	{
+		// Joins the shared memory of this region, the ring must have been created by the other side
+		region_data->managed_shm.reset(new ManagedSharedMemoryType(boost::interprocess::open_only, shname.c_str()));
+		region_data->region_ring = region_data->managed_shm->find<guac_socket_shared_memory_region_ring>(
+			RING_SHARED_MEMORY_NAME).first;
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return region_data->region_ring != nullptr;
+}
+
+void guac_socket_shared_memory_socket_ring_clear(guac_socket_shared_memory_region_ring * shm_ring)
+{
+	// Resetting the counters, no need to clear the buffer
+	shm_ring->ring_head = 0;
+	shm_ring->ring_tail = 0;
+}
+
+void guac_socket_shared_memory_socket_ring_notify(guac_socket_shared_memory_region_ring * shm_ring)
+{
+	// Taking the mutex makes sure a reader which just found the ring empty is already waiting on the condition
+	boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(shm_ring->ring_mutex);
+	shm_ring->ring_condition.notify_all();
+}
+
+void guac_socket_shared_memory_socket_ring_notify_space(guac_socket_shared_memory_region_ring * shm_ring)
+{
+	// Taking the mutex makes sure a writer which just found the ring full is already waiting on the condition
+	boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(shm_ring->ring_mutex);
+	shm_ring->ring_space_condition.notify_all();
+}
+
+void guac_socket_shared_memory_socket_ring_commit(guac_socket_shared_memory_region_ring * shm_ring, size_t count)
+{
+	// Only the consumer moves the head, the tail is published by the producer
+	unsigned int head = shm_ring->ring_head.load(std::memory_order_relaxed);
+	unsigned int tail = shm_ring->ring_tail.load(std::memory_order_seq_cst);
+
+	// Release the consumed bytes back to the producer
+	shm_ring->ring_head.store(head + (unsigned int)count, std::memory_order_seq_cst);
+
+	// Only wake the writer if the ring was full before this read, it never waits while there is any free space
+	if (tail - head == shm_ring->ring_capacity)
+	{
+		guac_socket_shared_memory_socket_ring_notify_space(shm_ring);
+	}
+}
+
+size_t guac_socket_shared_memory_socket_ring_spans(guac_socket_shared_memory_region_ring * shm_ring,
+	const char ** first, size_t * first_size, const char ** second, size_t * second_size)
+{
+	unsigned int head = shm_ring->ring_head.load(std::memory_order_relaxed);
+	unsigned int tail = shm_ring->ring_tail.load(std::memory_order_seq_cst);
+
+	// The readable bytes are in two parts if they wrap around the end of the ring
+	unsigned int offset = head & (shm_ring->ring_capacity - 1);
+	size_t size = tail - head;
+
+	*first = shm_ring->ring_buffer.get() + offset;
+	*first_size = std::min<size_t>(size, shm_ring->ring_capacity - offset);
+	*second = shm_ring->ring_buffer.get();
+	*second_size = size - *first_size;
+
+	return size;
+}
+
+size_t guac_socket_shared_memory_socket_ring_read(guac_socket * socket, void * buf, size_t count)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(
+		socket->data);
+
+	// Get the working ring
+	guac_socket_shared_memory_region_ring * ring = data->is_parent ? data->child_to_parent_queue->region_ring.get()
+		: data->parent_to_child_queue->region_ring.get();
+
+	const char * first;
+	const char * second;
+	size_t first_size;
+	size_t second_size;
+
+	// Drain everything available that fits the buffer
+	size_t size = std::min<size_t>(count,
+		guac_socket_shared_memory_socket_ring_spans(ring, &first, &first_size, &second, &second_size));
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	// Copy out both parts of the readable bytes
+	first_size = std::min(first_size, size);
+	std::memcpy(buf, first, first_size);
+	std::memcpy((char *)buf + first_size, second, size - first_size);
+
+	guac_socket_shared_memory_socket_ring_commit(ring, size);
+
+	return size;
+}
+
+size_t guac_socket_shared_memory_socket_ring_write(guac_socket * socket, const void * buf, size_t count)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(
+		socket->data);
+
+	// Get the working ring
+	guac_socket_shared_memory_region_ring * ring = data->is_parent ? data->parent_to_child_queue->region_ring.get()
+		: data->child_to_parent_queue->region_ring.get();
+
+	// The ring has a single producer, serialize the local writers only, the consumer is never blocked
+	boost::mutex::scoped_lock lock(data->local_mutex);
+
+	// Only the producer moves the tail, the head is published by the consumer
+	unsigned int tail = ring->ring_tail.load(std::memory_order_relaxed);
+	unsigned int head = ring->ring_head.load(std::memory_order_acquire);
+
+	// The ring is full, block until the reader makes room instead of letting guac_socket_write spin
+	if (tail - head == ring->ring_capacity)
+	{
+		boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> space_lock(ring->ring_mutex);
+
+		boost::posix_time::ptime target_time = boost::posix_time::microsec_clock::universal_time() +
+			boost::posix_time::milliseconds(SHARED_MEMORY_WRITE_TIMEOUT);
+
+		// Re-check under the mutex, the reader notifies under it so the wakeup cannot be lost in between
+		while ((head = ring->ring_head.load(std::memory_order_seq_cst), tail - head == ring->ring_capacity))
+		{
+			if (!ring->ring_space_condition.timed_wait(space_lock, target_time) &&
+				tail - ring->ring_head.load(std::memory_order_seq_cst) == ring->ring_capacity)
+			{
+				guac_error = GUAC_STATUS_TIMEOUT;
+				guac_error_message = "Timeout while waiting for space on socket";
+				return -1;
+			}
+		}
+	}
+
+	// Write as much as there is free space for
+	size_t size = std::min<size_t>(count, ring->ring_capacity - (tail - head));
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	// Copy in, in two parts if the free space wraps around the end of the ring
+	unsigned int offset = tail & (ring->ring_capacity - 1);
+	size_t first = std::min<size_t>(size, ring->ring_capacity - offset);
+	std::memcpy(ring->ring_buffer.get() + offset, buf, first);
+	std::memcpy(ring->ring_buffer.get(), (const char *)buf + first, size - first);
+
+	// Publish the written bytes to the consumer
+	ring->ring_tail.store(tail + (unsigned int)size, std::memory_order_seq_cst);
+
+	// Only wake the reader if the ring was empty before this write, otherwise it is still draining and will see the data
+	// The head is re-read after publishing the tail so a reader which emptied the ring meanwhile is never missed
+	if (ring->ring_head.load(std::memory_order_seq_cst) == tail)
+	{
+		guac_socket_shared_memory_socket_ring_notify(ring);
+	}
+
+	return size;
+}
+
+int guac_socket_shared_memory_socket_ring_select(guac_socket * socket, int usec_timeout)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
+
+	// Get the working ring
+	guac_socket_shared_memory_region_ring * ring = data->is_parent ? data->child_to_parent_queue->region_ring.get()
+		: data->parent_to_child_queue->region_ring.get();
+
+	// First check if there is already data in the ring, which does not need any lock
+	if (ring->ring_tail.load(std::memory_order_seq_cst) != ring->ring_head.load(std::memory_order_relaxed))
+	{
+		return 1;
+	}
+
+	boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(ring->ring_mutex);
+
+	// Get the target time which is the current time and the given extra MS
+	boost::posix_time::ptime target_time = boost::posix_time::microsec_clock::universal_time() +
+		boost::posix_time::milliseconds(usec_timeout);
+
+	// Re-check under the mutex, the writer notifies under it so the wakeup cannot be lost in between
+	while (ring->ring_tail.load(std::memory_order_seq_cst) == ring->ring_head.load(std::memory_order_relaxed))
+	{
+		if (!ring->ring_condition.timed_wait(lock, target_time))
+		{
+			// Make sure that there is actually no data on the ring
+			if (ring->ring_tail.load(std::memory_order_seq_cst) != ring->ring_head.load(std::memory_order_relaxed))
+			{
+				return 1;
+			}
+
+			guac_error = GUAC_STATUS_TIMEOUT;
+			guac_error_message = "Timeout while waiting for data on socket";
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 size_t guac_socket_shared_memory_socket_multi_packet_read(guac_socket * socket, void * buf, size_t count)
 {
 	// No buffer size, ignoring
@@ -3011,8 +3285,13 @@ static size_t guac_socket_shared_memory_socket_read_handler(guac_socket * socket
 {
 	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
 
+	// Ring buffer, drain everything available to the buffer at once
+	if (data->ring_buffer)
+	{
+		return guac_socket_shared_memory_socket_ring_read(socket, buf, count);
+	}
 	// Multi packet read, fill as much as possible to the buffer from the readable packets
-	if (data->multi_packet_read)
+	else if (data->multi_packet_read)
 	{
 		return guac_socket_shared_memory_socket_multi_packet_read(socket, buf, count);
 	}
@@ -3035,6 +3314,12 @@ static size_t guac_socket_shared_memory_socket_write_handler(guac_socket * socke
 	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(
 		socket->data);
 
+	// Ring buffer, lock free copy into the free space
+	if (data->ring_buffer)
+	{
+		return guac_socket_shared_memory_socket_ring_write(socket, buf, count);
+	}
+
 	// Get the working queue
 	guac_socket_shared_memory_region_queue * queue = data->is_parent ? data->parent_to_child_queue->region_queue.get()
 		: data->child_to_parent_queue->region_queue.get();
@@ -3047,11 +3332,28 @@ static size_t guac_socket_shared_memory_socket_write_handler(guac_socket * socke
 	int allocated_packets = std::min((int)std::ceil((double)count / (double)queue->queue_packet_size),
 		guac_socket_shared_memory_socket_queue_free_size(queue));
 
-	// No place to write packets, notify the condition and finish
+	// No place to write packets, wake the reader and block until it makes room
+	// The wait releases the queue lock so the reader can pop meanwhile
 	if (allocated_packets == 0)
 	{
 		queue->queue_condition.notify_all();
-		return 0;
+
+		boost::posix_time::ptime target_time = boost::posix_time::microsec_clock::universal_time() +
+			boost::posix_time::milliseconds(SHARED_MEMORY_WRITE_TIMEOUT);
+
+		while (guac_socket_shared_memory_socket_queue_free_size(queue) == 0)
+		{
+			if (!queue->queue_space_condition.timed_wait(lock, target_time) &&
+				guac_socket_shared_memory_socket_queue_free_size(queue) == 0)
+			{
+				guac_error = GUAC_STATUS_TIMEOUT;
+				guac_error_message = "Timeout while waiting for space on socket";
+				return -1;
+			}
+		}
+
+		allocated_packets = std::min((int)std::ceil((double)count / (double)queue->queue_packet_size),
+			guac_socket_shared_memory_socket_queue_free_size(queue));
 	}
 
 	char * buffer = (char *)buf;
@@ -3115,6 +3417,18 @@ static void guac_socket_shared_memory_socket_reset_handler(guac_socket * socket)
 {
 	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
 
+	// Empty the rings and wake up the blocked readers
+	if (data->ring_buffer)
+	{
+		guac_socket_shared_memory_socket_ring_clear(data->child_to_parent_queue->region_ring.get());
+		guac_socket_shared_memory_socket_ring_clear(data->parent_to_child_queue->region_ring.get());
+		guac_socket_shared_memory_socket_ring_notify(data->child_to_parent_queue->region_ring.get());
+		guac_socket_shared_memory_socket_ring_notify(data->parent_to_child_queue->region_ring.get());
+		guac_socket_shared_memory_socket_ring_notify_space(data->child_to_parent_queue->region_ring.get());
+		guac_socket_shared_memory_socket_ring_notify_space(data->parent_to_child_queue->region_ring.get());
+		return;
+	}
+
 	// Empty the queues      
 	guac_socket_shared_memory_socket_queue_clear(data->child_to_parent_queue->region_queue.get());
 	guac_socket_shared_memory_socket_queue_clear(data->parent_to_child_queue->region_queue.get());
@@ -3124,11 +3438,13 @@ static void guac_socket_shared_memory_socket_reset_handler(guac_socket * socket)
 		boost::interprocess::sharable_lock<boost::interprocess::interprocess_upgradable_mutex> lock(
 			data->child_to_parent_queue->region_queue->queue_mutex);
 		data->child_to_parent_queue->region_queue->queue_condition.notify_all();
+		data->child_to_parent_queue->region_queue->queue_space_condition.notify_all();
 	}
 	{
 		boost::interprocess::sharable_lock<boost::interprocess::interprocess_upgradable_mutex> lock(
 			data->parent_to_child_queue->region_queue->queue_mutex);
 		data->parent_to_child_queue->region_queue->queue_condition.notify_all();
+		data->parent_to_child_queue->region_queue->queue_space_condition.notify_all();
 	}
 }
 
@@ -3164,11 +3480,37 @@ static size_t guac_socket_shared_memory_socket_flush_handler(guac_socket * socke
 	return 0;
 }
 
+static int guac_socket_shared_memory_socket_queue_depth_handler(guac_socket * socket)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
+
+	// The depth is what this side wrote and the other side did not consume yet
+	if (data->ring_buffer)
+	{
+		guac_socket_shared_memory_region_ring * ring = data->is_parent ?
+			data->parent_to_child_queue->region_ring.get() : data->child_to_parent_queue->region_ring.get();
+
+		return ring->ring_tail.load(std::memory_order_relaxed) - ring->ring_head.load(std::memory_order_relaxed);
+	}
+
+	guac_socket_shared_memory_region_queue * queue = data->is_parent ?
+		data->parent_to_child_queue->region_queue.get() : data->child_to_parent_queue->region_queue.get();
+
+	// Packets are not necessarily full, this is an upper bound
+	return queue->queue_current_size * queue->queue_packet_size;
+}
+
 static int guac_socket_shared_memory_socket_select_handler(guac_socket * socket,
 	int usec_timeout)
 {
 	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
 
+	// Ring buffer, sleeps only while the ring is empty
+	if (data->ring_buffer)
+	{
+		return guac_socket_shared_memory_socket_ring_select(socket, usec_timeout);
+	}
+
 	// Get the working queue
 	guac_socket_shared_memory_region_queue * queue = data->is_parent ? data->child_to_parent_queue->region_queue.get()
 		: data->parent_to_child_queue->region_queue.get();
@@ -3183,24 +3525,112 @@ static int guac_socket_shared_memory_socket_select_handler(guac_socket * socket,
 	boost::interprocess::sharable_lock<boost::interprocess::interprocess_upgradable_mutex> lock(queue->queue_mutex);
 
 	// Get the target time which is the current time and the given extra MS
-	boost::posix_time::ptime target_time = boost::posix_time::second_clock::local_time() +
+	boost::posix_time::ptime target_time = boost::posix_time::microsec_clock::universal_time() +
 		boost::posix_time::milliseconds(usec_timeout);
 
-	// Wait for the interprocess lock to receive a notification that there are packets ready
-	if (!queue->queue_condition.timed_wait(lock, target_time))
+	// Re-check under the lock, the writer notifies under it so a packet pushed since the check above is not missed
+	while (guac_socket_shared_memory_socket_queue_empty(queue))
+	{
+		// Wait for the interprocess lock to receive a notification that there are packets ready
+		if (!queue->queue_condition.timed_wait(lock, target_time))
+		{
+			// Make sure that there is actually no data on the queue
+			if (!guac_socket_shared_memory_socket_queue_empty(queue))
+			{
+				return 1;
+			}
+
+			guac_error = GUAC_STATUS_TIMEOUT;
+			guac_error_message = "Timeout while waiting for data on socket";
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+size_t guac_socket_shared_memory_socket_peek_spans(guac_socket * socket, const char ** first, size_t * first_size,
+	const char ** second, size_t * second_size)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
+
+	*first_size = 0;
+	*second_size = 0;
+
+	// Only the ring buffer is contiguous, packets have to be read through the read handler
+	if (!data->ring_buffer)
 	{
-		guac_error = GUAC_STATUS_TIMEOUT;
-		guac_error_message = "Timeout while waiting for data on socket";
 		return 0;
 	}
 
-	// Make sure that there is actually data on the queue
-	return !guac_socket_shared_memory_socket_queue_empty(queue);
+	// Get the working ring
+	guac_socket_shared_memory_region_ring * ring = data->is_parent ? data->child_to_parent_queue->region_ring.get()
+		: data->parent_to_child_queue->region_ring.get();
+
+	return guac_socket_shared_memory_socket_ring_spans(ring, first, first_size, second, second_size);
+}
+
+void guac_socket_shared_memory_socket_commit_read(guac_socket * socket, size_t count)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
+
+	// Nothing was peeked if this is not a ring buffer
+	if (!data->ring_buffer || count == 0)
+	{
+		return;
+	}
+
+	// Get the working ring
+	guac_socket_shared_memory_region_ring * ring = data->is_parent ? data->child_to_parent_queue->region_ring.get()
+		: data->parent_to_child_queue->region_ring.get();
+
+	guac_socket_shared_memory_socket_ring_commit(ring, count);
+}
+
+size_t guac_socket_shared_memory_socket_try_write(guac_socket * socket, const void * buf, size_t count)
+{
+	guac_socket_shared_memory_data * data = static_cast<guac_socket_shared_memory_data *>(socket->data);
+
+	// Only this side writes, so the free space can only grow until the write handler takes it
+	bool full;
+	if (data->ring_buffer)
+	{
+		guac_socket_shared_memory_region_ring * ring = data->is_parent ?
+			data->parent_to_child_queue->region_ring.get() : data->child_to_parent_queue->region_ring.get();
+
+		full = ring->ring_tail.load(std::memory_order_relaxed) - ring->ring_head.load(std::memory_order_acquire) ==
+			ring->ring_capacity;
+	}
+	else
+	{
+		guac_socket_shared_memory_region_queue * queue = data->is_parent ?
+			data->parent_to_child_queue->region_queue.get() : data->child_to_parent_queue->region_queue.get();
+
+		boost::interprocess::sharable_lock<boost::interprocess::interprocess_upgradable_mutex> lock(queue->queue_mutex);
+		full = guac_socket_shared_memory_socket_queue_free_size(queue) == 0;
+	}
+
+	// The write handler only blocks when there is no room at all, otherwise it writes what fits
+	if (full || count == 0)
+	{
+		return 0;
+	}
+
+	socket->last_write_timestamp = guac_timestamp_current();
+
+	size_t written = guac_socket_shared_memory_socket_write_handler(socket, buf, count);
+	if (written == static_cast<size_t>(-1))
+	{
+		return written;
+	}
+
+	socket->bytes_written += written;
+	return written;
 }
 
 guac_socket *
 guac_socket_shared_memory_socket_create(const std::string & shname, bool multi_read, bool streamlined, int queue_size,
-	int packet_size)
+	int packet_size, bool ring_buffer)
 {
 	guac_socket_shared_memory_data * data = new guac_socket_shared_memory_data();
 
@@ -3209,11 +3639,24 @@ guac_socket_shared_memory_socket_create(const std::string & shname, bool multi_r
 	data->is_parent = true;
 	data->multi_packet_read = multi_read;
 	data->streamlined = streamlined;
+	data->ring_buffer = ring_buffer;
 	data->parent_to_child_queue = new guac_socket_shared_memory_region_data();
 	data->child_to_parent_queue = new guac_socket_shared_memory_region_data();
 
+	// Ring buffer, the queue dimensions only give its byte capacity
+	if (ring_buffer)
+	{
+		if (!guac_socket_shared_memory_socket_ring_create(data->parent_to_child_queue, shname + "_PTC",
+			(std::size_t)queue_size * packet_size) ||
+			!guac_socket_shared_memory_socket_ring_create(data->child_to_parent_queue, shname + "_CTP",
+			(std::size_t)queue_size * packet_size))
+		{
+			delete data;
+			return nullptr;
+		}
+	}
 	// Create shared memory for each queue, to seperate workloads
-	if (!guac_socket_shared_memory_socket_queue_create(data->parent_to_child_queue, shname + "_PTC", queue_size,packet_size) || !
+	else if (!guac_socket_shared_memory_socket_queue_create(data->parent_to_child_queue, shname + "_PTC", queue_size,packet_size) || !
 		guac_socket_shared_memory_socket_queue_create(data->child_to_parent_queue, shname + "_CTP", queue_size,packet_size))
 	{
 		delete data;
@@ -3232,11 +3675,13 @@ guac_socket_shared_memory_socket_create(const std::string & shname, bool multi_r
 	socket->unlock_handler = guac_socket_shared_memory_socket_unlock_handler;
 	socket->free_handler = guac_socket_shared_memory_socket_free_handler;
 	socket->reset_handler = guac_socket_shared_memory_socket_reset_handler;
+	socket->queue_depth_handler = guac_socket_shared_memory_socket_queue_depth_handler;
 
 	return socket;
 }
 
-guac_socket * guac_socket_shared_memory_socket_join(const std::string & shname, bool multi_read, bool streamlined)
+guac_socket * guac_socket_shared_memory_socket_join(const std::string & shname, bool multi_read, bool streamlined,
+	bool ring_buffer)
 {
 	guac_socket_shared_memory_data * data = new guac_socket_shared_memory_data();
 
@@ -3245,11 +3690,22 @@ guac_socket * guac_socket_shared_memory_socket_join(const std::string & shname,
 	data->is_parent = false;
 	data->multi_packet_read = multi_read;
 	data->streamlined = streamlined;
+	data->ring_buffer = ring_buffer;
 	data->parent_to_child_queue = new guac_socket_shared_memory_region_data();
 	data->child_to_parent_queue = new guac_socket_shared_memory_region_data();
 
+	// Join the rings, they must have been created in ring buffer mode aswell
+	if (ring_buffer)
+	{
+		if (!guac_socket_shared_memory_socket_ring_join(data->parent_to_child_queue, shname + "_PTC") ||
+			!guac_socket_shared_memory_socket_ring_join(data->child_to_parent_queue, shname + "_CTP"))
+		{
+			delete data;
+			return nullptr;
+		}
+	}
 	// Join the shared memory for each queue
-	if (!guac_socket_shared_memory_socket_queue_join(data->parent_to_child_queue, shname + "_PTC") || !
+	else if (!guac_socket_shared_memory_socket_queue_join(data->parent_to_child_queue, shname + "_PTC") || !
 		guac_socket_shared_memory_socket_queue_join(data->child_to_parent_queue, shname + "_CTP"))
 	{
 		delete data;
@@ -3268,6 +3724,7 @@ guac_socket * guac_socket_shared_memory_socket_join(const std::string & shname,
 	socket->unlock_handler = guac_socket_shared_memory_socket_unlock_handler;
 	socket->free_handler = guac_socket_shared_memory_socket_free_handler;
 	socket->reset_handler = guac_socket_shared_memory_socket_reset_handler;
+	socket->queue_depth_handler = guac_socket_shared_memory_socket_queue_depth_handler;
 
 	return socket;
 }
@@ -181,6 +181,28 @@ static int __guac_socket_tee_select_handler(guac_socket* socket,
 
 }
 
+/**
+ * Callback function which reports the queue depth of the primary socket
+ * alone. The secondary socket is typically a session recording, whose backlog
+ * is handled by its own overflow policy and should not slow the display
+ * updates sent to users.
+ *
+ * @param socket
+ *     The tee socket on which guac_socket_queue_depth() was invoked.
+ *
+ * @return
+ *     The value returned by guac_socket_queue_depth() when invoked on the
+ *     primary socket.
+ */
+static int __guac_socket_tee_queue_depth_handler(guac_socket* socket) {
+
+    guac_socket_tee_data* data = (guac_socket_tee_data*) socket->data;
+
+    /* Delegate queue depth to wrapped socket */
+    return guac_socket_queue_depth(data->primary);
+
+}
+
 /**
  * Callback function which frees all underlying data associated with the
  * given tee socket, including both primary and secondary sockets.
@@ -225,6 +247,8 @@ guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary) {
     socket->unlock_handler = __guac_socket_tee_unlock_handler;
     socket->free_handler   = __guac_socket_tee_free_handler;
 
+    socket->queue_depth_handler = __guac_socket_tee_queue_depth_handler;
+
     return socket;
 
 }
@@ -18,6 +18,7 @@
  */
 #include <guacamole/config.h>
 
+#include <guacamole/base64.h>
 #include <guacamole/error.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
@@ -117,6 +118,7 @@ size_t guac_socket_write(guac_socket* socket,
         /* Advance buffer as data written */
         buffer += written;
         count  -= written;
+        socket->bytes_written += written;
 
     }
 
@@ -167,6 +169,7 @@ guac_socket* guac_socket_alloc() {
     socket->data = NULL;
     socket->state = GUAC_SOCKET_OPEN;
     socket->last_write_timestamp = guac_timestamp_current();
+    socket->bytes_written = 0;
 
     /* No keep alive ping by default */
     socket->__keep_alive_enabled = 0;
@@ -179,6 +182,8 @@ guac_socket* guac_socket_alloc() {
     socket->flush_handler  = NULL;
     socket->lock_handler   = NULL;
     socket->unlock_handler = NULL;
+    socket->reset_handler  = NULL;
+    socket->queue_depth_handler = NULL;
 
     return socket;
 
@@ -358,9 +363,36 @@ size_t guac_socket_write_base64(guac_socket* socket, const void* buf, size_t cou
 
     int retval;
 
+    char output[GUAC_BASE64_CHUNK_SIZE];
+
     const unsigned char* char_buf = (const unsigned char*) buf;
     const unsigned char* end = char_buf + count;
 
+    /* Complete any partial triplet carried over from a previous write */
+    while (socket->__ready > 0 && char_buf < end) {
+
+        retval = __guac_socket_write_base64_byte(socket, *(char_buf++));
+        if (retval < 0)
+            return retval;
+
+    }
+
+    /* Encode all complete triplets in bulk, one chunk at a time */
+    while (end - char_buf >= 3) {
+
+        size_t length = end - char_buf;
+        if (length > GUAC_BASE64_CHUNK_SIZE / 4 * 3)
+            length = GUAC_BASE64_CHUNK_SIZE / 4 * 3;
+
+        size_t encoded = guac_base64_encode(output, char_buf, length);
+        if (guac_socket_write(socket, output, encoded / 3 * 4))
+            return -1;
+
+        char_buf += encoded;
+
+    }
+
+    /* Hold any remaining bytes until more data arrives or is flushed */
     while (char_buf < end) {
 
         retval = __guac_socket_write_base64_byte(socket, *(char_buf++));
@@ -384,6 +416,17 @@ size_t guac_socket_flush(guac_socket* socket) {
 
 }
 
+int guac_socket_queue_depth(guac_socket* socket) {
+
+    /* If handler defined, call it. */
+    if (socket->queue_depth_handler)
+        return socket->queue_depth_handler(socket);
+
+    /* Otherwise, nothing is known to be queued */
+    return 0;
+
+}
+
 size_t guac_socket_flush_base64(guac_socket* socket) {
 
     int retval;
@@ -0,0 +1,415 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <guacamole/protocol-types.h>
+#include <guacamole/stream-window.h>
+#include <guacamole/timestamp.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef HAVE_BOOST
+#include <boost/thread.hpp>
+#elif defined HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+/**
+ * The state recorded for each blob while it is in flight.
+ */
+typedef struct guac_stream_window_blob {
+
+    /**
+     * The time the blob was sent.
+     */
+    guac_timestamp sent;
+
+    /**
+     * The number of blobs which had been acknowledged when the blob was sent.
+     */
+    int64_t acked;
+
+    /**
+     * Whether the window was full once the blob was sent. Only such blobs
+     * measure the capacity of the connection, rather than the rate at which
+     * data was produced.
+     */
+    int window_full;
+
+} guac_stream_window_blob;
+
+struct guac_stream_window {
+
+    /**
+     * The maximum number of blobs which may ever be in flight. This is also
+     * the number of entries in the blobs array.
+     */
+    int max_blobs;
+
+    /**
+     * The number of blobs which may currently be in flight.
+     */
+    int window;
+
+    /**
+     * The time the window was allocated, used to measure the round trip of
+     * the acknowledgement opening the stream.
+     */
+    guac_timestamp allocated;
+
+    /**
+     * The shortest round trip observed, in milliseconds, or zero if not yet
+     * measured.
+     */
+    int min_round_trip;
+
+    /**
+     * Whether the stream has been acknowledged and blobs may be sent.
+     */
+    int open;
+
+    /**
+     * Whether the stream has been closed, either due to an error
+     * acknowledgement or explicitly.
+     */
+    int closed;
+
+    /**
+     * The number of blobs sent. This is also the sequence position of the
+     * next blob sent.
+     */
+    int64_t sent;
+
+    /**
+     * The number of blobs acknowledged. This is also the sequence position
+     * of the oldest in-flight blob.
+     */
+    int64_t acked;
+
+    /**
+     * Ring of in-flight blobs, indexed by sequence position modulo max_blobs.
+     */
+    guac_stream_window_blob* blobs;
+
+#ifdef HAVE_BOOST
+    /**
+     * Lock which is acquired prior to accessing any of the above.
+     */
+    boost::mutex lock;
+
+    /**
+     * Signalled whenever room becomes available or the window is closed.
+     */
+    boost::condition_variable modified;
+#elif defined HAVE_LIBPTHREAD
+    /**
+     * Lock which is acquired prior to accessing any of the above.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Signalled whenever room becomes available or the window is closed.
+     */
+    pthread_cond_t modified;
+#endif
+
+};
+
+/**
+ * Acquires the lock of the given window.
+ *
+ * @param window
+ *     The guac_stream_window to lock.
+ */
+static void __guac_stream_window_lock(guac_stream_window* window) {
+#ifdef HAVE_BOOST
+    window->lock.lock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&window->lock);
+#endif
+}
+
+/**
+ * Releases the lock of the given window.
+ *
+ * @param window
+ *     The guac_stream_window to unlock.
+ */
+static void __guac_stream_window_unlock(guac_stream_window* window) {
+#ifdef HAVE_BOOST
+    window->lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&window->lock);
+#endif
+}
+
+/**
+ * Returns the number of blobs which may be sent immediately. The window lock
+ * must be held.
+ *
+ * @param window
+ *     The guac_stream_window to query.
+ *
+ * @return
+ *     The number of blobs which may be sent.
+ */
+static int __guac_stream_window_available(guac_stream_window* window) {
+
+    if (!window->open || window->closed)
+        return 0;
+
+    int available = window->window - (int) (window->sent - window->acked);
+    return available > 0 ? available : 0;
+
+}
+
+/**
+ * Resizes the window using the acknowledgement of the given blob. The number
+ * of blobs acknowledged while the blob was in flight, over its round trip,
+ * gives the rate at which the connection delivers blobs. Scaled by the
+ * shortest round trip, this is the number of blobs the connection can hold
+ * without queueing. The window is set to twice that, growing as quickly as
+ * the measurements allow and shrinking gradually. The window lock must be
+ * held.
+ *
+ * @param window
+ *     The guac_stream_window to resize.
+ *
+ * @param blob
+ *     The blob which was just acknowledged.
+ *
+ * @param now
+ *     The time the acknowledgement was received.
+ */
+static void __guac_stream_window_resize(guac_stream_window* window,
+        const guac_stream_window_blob* blob, guac_timestamp now) {
+
+    int round_trip = (int) (now - blob->sent);
+    if (round_trip < 1)
+        round_trip = 1;
+
+    if (window->min_round_trip == 0 || round_trip < window->min_round_trip)
+        window->min_round_trip = round_trip;
+
+    int64_t delivered = window->acked - blob->acked;
+    int target = (int) ((delivered * window->min_round_trip * 2
+                + round_trip - 1) / round_trip);
+
+    /* Grow immediately */
+    if (target > window->window)
+        window->window = target;
+
+    /* Shrink only if the window actually limited the transfer */
+    else if (blob->window_full)
+        window->window = (window->window * 3 + target) / 4;
+
+    if (window->window < GUAC_STREAM_WINDOW_MIN_BLOBS)
+        window->window = GUAC_STREAM_WINDOW_MIN_BLOBS;
+
+    if (window->window > window->max_blobs)
+        window->window = window->max_blobs;
+
+}
+
+/**
+ * Wakes any thread waiting within guac_stream_window_wait(). The window lock
+ * must be held.
+ *
+ * @param window
+ *     The guac_stream_window which changed.
+ */
+static void __guac_stream_window_signal(guac_stream_window* window) {
+#ifdef HAVE_BOOST
+    window->modified.notify_all();
+#elif defined HAVE_LIBPTHREAD
+    pthread_cond_broadcast(&window->modified);
+#endif
+}
+
+guac_stream_window* guac_stream_window_alloc(int max_blobs) {
+
+    if (max_blobs < GUAC_STREAM_WINDOW_MIN_BLOBS)
+        max_blobs = GUAC_STREAM_WINDOW_MIN_BLOBS;
+
+#ifdef HAVE_BOOST
+    guac_stream_window* window = new guac_stream_window();
+#elif defined HAVE_LIBPTHREAD
+    guac_stream_window* window = static_cast<guac_stream_window*>(
+            malloc(sizeof(guac_stream_window)));
+    pthread_mutex_init(&window->lock, NULL);
+    pthread_cond_init(&window->modified, NULL);
+#endif
+
+    window->max_blobs = max_blobs;
+    window->window = GUAC_STREAM_WINDOW_INITIAL_BLOBS;
+    if (window->window > max_blobs)
+        window->window = max_blobs;
+
+    window->allocated = guac_timestamp_current();
+    window->min_round_trip = 0;
+    window->open = 0;
+    window->closed = 0;
+    window->sent = 0;
+    window->acked = 0;
+    window->blobs = static_cast<guac_stream_window_blob*>(
+            calloc(max_blobs, sizeof(guac_stream_window_blob)));
+
+    return window;
+
+}
+
+void guac_stream_window_free(guac_stream_window* window) {
+
+    free(window->blobs);
+
+#ifdef HAVE_BOOST
+    delete window;
+#elif defined HAVE_LIBPTHREAD
+    pthread_cond_destroy(&window->modified);
+    pthread_mutex_destroy(&window->lock);
+    free(window);
+#endif
+
+}
+
+int guac_stream_window_available(guac_stream_window* window) {
+
+    __guac_stream_window_lock(window);
+    int available = __guac_stream_window_available(window);
+    __guac_stream_window_unlock(window);
+
+    return available;
+
+}
+
+int guac_stream_window_pending(guac_stream_window* window) {
+
+    __guac_stream_window_lock(window);
+    int pending = (int) (window->sent - window->acked);
+    __guac_stream_window_unlock(window);
+
+    return pending;
+
+}
+
+void guac_stream_window_sent(guac_stream_window* window) {
+
+    __guac_stream_window_lock(window);
+
+    guac_stream_window_blob* blob =
+        &window->blobs[window->sent % window->max_blobs];
+
+    blob->sent = guac_timestamp_current();
+    blob->acked = window->acked;
+
+    window->sent++;
+    blob->window_full = (__guac_stream_window_available(window) == 0);
+
+    __guac_stream_window_unlock(window);
+
+}
+
+int guac_stream_window_ack(guac_stream_window* window,
+        guac_protocol_status status) {
+
+    guac_timestamp now = guac_timestamp_current();
+
+    __guac_stream_window_lock(window);
+
+    /* Any failure ends the stream */
+    if (status != GUAC_PROTOCOL_STATUS_SUCCESS)
+        window->closed = 1;
+
+    /* The first acknowledgement opens the stream */
+    else if (!window->open) {
+        window->open = 1;
+        window->min_round_trip = (int) (now - window->allocated);
+        if (window->min_round_trip < 1)
+            window->min_round_trip = 1;
+    }
+
+    /* Each further acknowledgement releases the oldest blob */
+    else if (window->acked < window->sent) {
+        window->acked++;
+        __guac_stream_window_resize(window,
+                &window->blobs[(window->acked - 1) % window->max_blobs], now);
+    }
+
+    int closed = window->closed;
+    __guac_stream_window_signal(window);
+
+    __guac_stream_window_unlock(window);
+
+    return closed;
+
+}
+
+int guac_stream_window_wait(guac_stream_window* window) {
+
+#ifdef HAVE_BOOST
+    boost::unique_lock<boost::mutex> lock(window->lock);
+    while (!window->closed && __guac_stream_window_available(window) == 0)
+        window->modified.wait(lock);
+
+    return !window->closed;
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&window->lock);
+    while (!window->closed && __guac_stream_window_available(window) == 0)
+        pthread_cond_wait(&window->modified, &window->lock);
+
+    int open = !window->closed;
+    pthread_mutex_unlock(&window->lock);
+    return open;
+#endif
+
+}
+
+int guac_stream_window_drain(guac_stream_window* window) {
+
+#ifdef HAVE_BOOST
+    boost::unique_lock<boost::mutex> lock(window->lock);
+    while (!window->closed && window->acked < window->sent)
+        window->modified.wait(lock);
+
+    return !window->closed;
+#elif defined HAVE_LIBPTHREAD
+    pthread_mutex_lock(&window->lock);
+    while (!window->closed && window->acked < window->sent)
+        pthread_cond_wait(&window->modified, &window->lock);
+
+    int open = !window->closed;
+    pthread_mutex_unlock(&window->lock);
+    return open;
+#endif
+
+}
+
+void guac_stream_window_close(guac_stream_window* window) {
+
+    __guac_stream_window_lock(window);
+
+    window->closed = 1;
+    __guac_stream_window_signal(window);
+
+    __guac_stream_window_unlock(window);
+
+}
+
@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <guacamole/config.h>
+
+#include <guacamole/audio.h>
+#include <guacamole/ulaw_encoder.h>
+
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifdef HAVE_BOOST
+#include <sstream>
+#endif
+
+/**
+ * Encodes a single 16-bit linear PCM sample as G.711 µ-law.
+ *
+ * @param sample
+ *     The sample to encode.
+ *
+ * @return
+ *     The µ-law encoding of the given sample.
+ */
+static unsigned char ulaw_encode_sample(int sample) {
+
+    int sign = 0;
+    int exponent = 7;
+    int mask;
+
+    /* Encode magnitude, recording sign separately */
+    if (sample < 0) {
+        sign = 0x80;
+        sample = -sample;
+    }
+
+    /* Clip such that the biased magnitude fits within 15 bits */
+    if (sample > 32635)
+        sample = 32635;
+
+    sample += 0x84;
+
+    /* Exponent is the position of the highest set bit above bit 7 */
+    for (mask = 0x4000; (sample & mask) == 0 && exponent > 0; mask >>= 1)
+        exponent--;
+
+    int mantissa = (sample >> (exponent + 3)) & 0x0F;
+
+    return (unsigned char) ~(sign | (exponent << 4) | mantissa);
+
+}
+
+static void ulaw_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+#ifdef HAVE_BOOST
+    std::stringstream ss;
+    ss << GUAC_ULAW_ENCODER_MIMETYPE << ";rate=" << audio->rate << ",channels=" << audio->channels;
+    guac_protocol_send_audio(socket, audio->stream, ss.str().c_str());
+#elif defined HAVE_LIBPTHREAD
+    char mimetype[256];
+
+    /* Produce mimetype string from format info */
+    snprintf(mimetype, sizeof(mimetype), GUAC_ULAW_ENCODER_MIMETYPE
+            ";rate=%i,channels=%i", audio->rate, audio->channels);
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, mimetype);
+#endif
+}
+
+static void ulaw_encoder_begin_handler(guac_audio_stream* audio) {
+
+    ulaw_encoder_state* state;
+
+    /* Broadcast existence of stream */
+    ulaw_encoder_send_audio(audio, audio->client->socket);
+
+    /* Allocate and init encoder state */
+    audio->data = state = static_cast<ulaw_encoder_state*>(malloc(sizeof(ulaw_encoder_state)));
+    state->written = 0;
+    state->length = GUAC_ULAW_ENCODER_BUFFER_SIZE
+                    * audio->rate * audio->channels / 1000;
+
+    state->buffer = (unsigned char*) malloc(state->length);
+
+}
+
+static void ulaw_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    ulaw_encoder_send_audio(audio, user->socket);
+
+}
+
+static void ulaw_encoder_end_handler(guac_audio_stream* audio) {
+
+    ulaw_encoder_state* state = (ulaw_encoder_state*) audio->data;
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    /* Free state information */
+    free(state->buffer);
+    free(state);
+
+}
+
+static void ulaw_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    ulaw_encoder_state* state = (ulaw_encoder_state*) audio->data;
+    int bytes_per_sample = audio->bps / 8;
+
+    while (length >= bytes_per_sample) {
+
+        /* If no space remains, flush and retry */
+        if (state->written == state->length) {
+            guac_audio_stream_flush(audio);
+            continue;
+        }
+
+        /* Read little-endian 16-bit or signed 8-bit sample */
+        int sample;
+        if (bytes_per_sample == 2)
+            sample = (int16_t) (pcm_data[0] | (pcm_data[1] << 8));
+        else
+            sample = ((int8_t) pcm_data[0]) * 256;
+
+        state->buffer[state->written++] = ulaw_encode_sample(sample);
+
+        pcm_data += bytes_per_sample;
+        length -= bytes_per_sample;
+
+    }
+
+}
+
+static void ulaw_encoder_flush_handler(guac_audio_stream* audio) {
+
+    ulaw_encoder_state* state = (ulaw_encoder_state*) audio->data;
+    guac_socket* socket = audio->client->socket;
+    guac_stream* stream = audio->stream;
+
+    unsigned char* current = state->buffer;
+    int remaining = state->written;
+
+    /* Flush all data in buffer as blobs */
+    while (remaining > 0) {
+
+        /* Determine size of blob to be written */
+        int chunk_size = remaining;
+        if (chunk_size > GUAC_ULAW_ENCODER_BLOB_SIZE)
+            chunk_size = GUAC_ULAW_ENCODER_BLOB_SIZE;
+
+        /* Send audio data */
+        guac_protocol_send_blob(socket, stream, current, chunk_size);
+
+        /* Advance to next blob */
+        current += chunk_size;
+        remaining -= chunk_size;
+
+    }
+
+    /* All data has been flushed */
+    state->written = 0;
+
+}
+
+#ifdef HAVE_BOOST
+guac_audio_encoder _ulaw_encoder = {GUAC_ULAW_ENCODER_MIMETYPE,
+	ulaw_encoder_begin_handler,
+	ulaw_encoder_write_handler,
+	ulaw_encoder_flush_handler,
+	ulaw_encoder_end_handler,
+	ulaw_encoder_join_handler
+};
+#elif defined HAVE_LIBPTHREAD
+/* µ-law encoder handlers */
+guac_audio_encoder _ulaw_encoder = {
+    .mimetype      = GUAC_ULAW_ENCODER_MIMETYPE,
+    .begin_handler = ulaw_encoder_begin_handler,
+    .write_handler = ulaw_encoder_write_handler,
+    .flush_handler = ulaw_encoder_flush_handler,
+    .join_handler  = ulaw_encoder_join_handler,
+    .end_handler   = ulaw_encoder_end_handler
+};
+#endif
+
+/* Actual encoder definition */
+guac_audio_encoder* ulaw_encoder = &_ulaw_encoder;
+
@@ -20,8 +20,11 @@
 #include <guacamole/config.h>
 
 #include <guacamole/client.h>
+#include <guacamole/metrics.h>
 #include <guacamole/object.h>
 #include <guacamole/protocol.h>
+#include <guacamole/quality.h>
+#include <guacamole/socket.h>
 #include <guacamole/stream.h>
 #include <guacamole/timestamp.h>
 #include <guacamole/user.h>
@@ -30,26 +33,73 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+__guac_instruction_handler* __guac_get_instruction_handler(const char* opcode) {
+
+    /* Narrow down by first character, and by second character where the
+     * first is shared, such that at most one opcode is compared in full */
+    switch (opcode[0]) {
+
+        case 'm':
+            if (strcmp(opcode, "mouse") == 0) return __guac_handle_mouse;
+            break;
+
+        case 'k':
+            if (strcmp(opcode, "key") == 0) return __guac_handle_key;
+            break;
+
+        case 's':
+            if (opcode[1] == 'y') {
+                if (strcmp(opcode, "sync") == 0) return __guac_handle_sync;
+            }
+            else if (strcmp(opcode, "size") == 0) return __guac_handle_size;
+            break;
+
+        case 'a':
+            if (opcode[1] == 'c') {
+                if (strcmp(opcode, "ack") == 0) return __guac_handle_ack;
+            }
+            else if (strcmp(opcode, "audio") == 0) return __guac_handle_audio;
+            break;
+
+        case 'b':
+            if (strcmp(opcode, "blob") == 0) return __guac_handle_blob;
+            break;
+
+        case 'e':
+            if (strcmp(opcode, "end") == 0) return __guac_handle_end;
+            break;
+
+        case 'c':
+            if (strcmp(opcode, "clipboard") == 0) return __guac_handle_clipboard;
+            break;
+
+        case 'd':
+            if (strcmp(opcode, "disconnect") == 0) return __guac_handle_disconnect;
+            break;
+
+        case 'f':
+            if (strcmp(opcode, "file") == 0) return __guac_handle_file;
+            break;
+
+        case 'p':
+            if (opcode[1] == 'i') {
+                if (strcmp(opcode, "pipe") == 0) return __guac_handle_pipe;
+            }
+            else if (strcmp(opcode, "put") == 0) return __guac_handle_put;
+            break;
+
+        case 'g':
+            if (strcmp(opcode, "get") == 0) return __guac_handle_get;
+            break;
 
-/* Guacamole instruction handler map */
-
-__guac_instruction_handler_mapping __guac_instruction_handler_map[] = {
-   {"sync",       __guac_handle_sync},
-   {"mouse",      __guac_handle_mouse},
-   {"key",        __guac_handle_key},
-   {"clipboard",  __guac_handle_clipboard},
-   {"disconnect", __guac_handle_disconnect},
-   {"size",       __guac_handle_size},
-   {"file",       __guac_handle_file},
-   {"pipe",       __guac_handle_pipe},
-   {"ack",        __guac_handle_ack},
-   {"blob",       __guac_handle_blob},
-   {"end",        __guac_handle_end},
-   {"get",        __guac_handle_get},
-   {"put",        __guac_handle_put},
-   {"audio",      __guac_handle_audio},
-   {NULL,         NULL}
-};
+    }
+
+    /* Unrecognized */
+    return NULL;
+
+}
 
 /**
  * Parses a 64-bit integer from the given string. It is assumed that the string
@@ -116,12 +166,34 @@ int __guac_handle_sync(guac_user* user, int argc, char** argv) {
                 processing_lag = 0;
 
             user->processing_lag = processing_lag;
+            guac_metrics_histogram_observe(
+                    "guac_user_processing_lag_milliseconds", processing_lag);
 
         }
 
         /* Record baseline duration of frame by excluding lag */
         user->last_frame_duration = frame_duration - user->processing_lag;
 
+        /* Adapt quality to the measured round trip and throughput */
+        guac_client* client = user->client;
+        int64_t acked_bytes = guac_client_get_sync_bytes(client, timestamp);
+        int64_t sent_bytes = client->socket->bytes_written;
+
+#ifdef HAVE_BOOST
+        client->__quality_lock.lock();
+#elif defined HAVE_LIBPTHREAD
+        pthread_mutex_lock(&(client->__quality_lock));
+#endif
+        guac_quality_update(&user->quality, current, frame_duration,
+                acked_bytes, sent_bytes);
+#ifdef HAVE_BOOST
+        client->__quality_lock.unlock();
+#elif defined HAVE_LIBPTHREAD
+        pthread_mutex_unlock(&(client->__quality_lock));
+#endif
+
+        guac_client_update_quality(client);
+
     }
 
     if (user->sync_handler)
@@ -54,6 +54,7 @@ guac_user* guac_user_alloc() {
     user->last_received_timestamp = guac_timestamp_current();
     user->last_frame_duration = 0;
     user->processing_lag = 0;
+    guac_quality_init(&user->quality);
     user->active = 1;
 
     /* Allocate stream pool */
@@ -172,16 +173,10 @@ void guac_user_free_object(guac_user* user, guac_object* object) {
 
 int guac_user_handle_instruction(guac_user* user, const char* opcode, int argc, char** argv) {
 
-    /* For each defined instruction */
-    __guac_instruction_handler_mapping* current = __guac_instruction_handler_map;
-    while (current->opcode != NULL) {
-
-        /* If recognized, call handler */
-        if (strcmp(opcode, current->opcode) == 0)
-            return current->handler(user, argc, argv);
-
-        current++;
-    }
+    /* If recognized, call handler */
+    __guac_instruction_handler* handler = __guac_get_instruction_handler(opcode);
+    if (handler != NULL)
+        return handler(user, argc, argv);
 
     /* If unrecognized, ignore */
     return 0;
@@ -254,7 +249,7 @@ void guac_user_stream_png(guac_user* user, guac_socket* socket,
     guac_protocol_send_img(socket, stream, mode, layer, "image/png", x, y);
 
     /* Write PNG data */
-    guac_png_write(socket, stream, surface);
+    guac_png_write(socket, stream, surface, GUAC_PNG_PROFILE_DEFAULT);
 
     /* Terminate stream */
     guac_protocol_send_end(socket, stream);
@@ -20,6 +20,9 @@
 #ifndef GUAC_RDP_INPUT_H
 #define GUAC_RDP_INPUT_H
 
+#include <guacamole/config.h>
+
+#include <guacamole/client.h>
 #include <guacamole/user.h>
 
 /**
@@ -37,5 +40,31 @@ guac_user_key_handler guac_rdp_user_key_handler;
  */
 guac_user_size_handler guac_rdp_user_size_handler;
 
+#ifdef HAVE_BOOST
+/**
+ * Forwards all mouse and key events queued by the handlers above to the RDP
+ * server, in the order received. Consecutive moves which change no buttons
+ * are sent as the last of those moves alone. This function may only be
+ * invoked by the RDP client thread, and must not be invoked while holding
+ * rdp_lock.
+ *
+ * @param client
+ *     The guac_client associated with the RDP connection.
+ */
+void guac_rdp_handle_input(guac_client* client);
+
+/**
+ * Queues the departure of the given user behind any of its events not yet
+ * forwarded, such that the user is removed from the shared cursor only after
+ * its last move. Removing the user directly would let such a move associate
+ * the cursor with the user again once it is gone, and with any new user later
+ * allocated at the same address.
+ *
+ * @param user
+ *     The user leaving the RDP connection.
+ */
+void guac_rdp_input_user_left(guac_user* user);
+#endif
+
 #endif
 
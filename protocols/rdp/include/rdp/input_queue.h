@@ -0,0 +1,198 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RDP_INPUT_QUEUE_H
+#define GUAC_RDP_INPUT_QUEUE_H
+
+#include <guacamole/config.h>
+
+#include <guacamole/user.h>
+
+#ifdef HAVE_BOOST
+#include <atomic>
+
+/**
+ * The type of a queued input event.
+ */
+typedef enum guac_rdp_input_event_type {
+
+    /**
+     * The mouse was moved, or its buttons were pressed or released.
+     */
+    GUAC_RDP_INPUT_EVENT_MOUSE,
+
+    /**
+     * A key was pressed or released.
+     */
+    GUAC_RDP_INPUT_EVENT_KEY,
+
+    /**
+     * The user left the connection. Each user pushes this after all of its
+     * other events, so no event of the user follows it.
+     */
+    GUAC_RDP_INPUT_EVENT_LEAVE
+
+} guac_rdp_input_event_type;
+
+/**
+ * An input event received from a user, to be forwarded to the RDP server by
+ * the RDP client thread.
+ */
+typedef struct guac_rdp_input_event {
+
+    /**
+     * The type of this event, which determines which of the other members are
+     * meaningful.
+     */
+    guac_rdp_input_event_type type;
+
+    /**
+     * The user that sent this event. As the user may leave before the event
+     * is handled, this pointer may only be compared, never dereferenced.
+     */
+    guac_user* user;
+
+    /**
+     * The X coordinate of the mouse, for mouse events.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the mouse, for mouse events.
+     */
+    int y;
+
+    /**
+     * The mask of all currently pressed mouse buttons, for mouse events.
+     */
+    int mask;
+
+    /**
+     * The keysym of the key, for key events.
+     */
+    int keysym;
+
+    /**
+     * Non-zero if the key was pressed, zero if released, for key events.
+     */
+    int pressed;
+
+} guac_rdp_input_event;
+
+/**
+ * A single queued input event, linked to the event queued after it.
+ */
+typedef struct guac_rdp_input_node guac_rdp_input_node;
+
+/**
+ * Lock-free queue of input events, pushed by the threads of any number of
+ * users and popped by the RDP client thread alone. Pushing never waits, thus
+ * users are never held up by the RDP client thread while it handles server
+ * messages.
+ */
+typedef struct guac_rdp_input_queue {
+
+    /**
+     * The most recently pushed node. Producers swap themselves in here, then
+     * link the previous node to their own.
+     */
+    std::atomic<guac_rdp_input_node*> head;
+
+    /**
+     * The most recently popped node, whose successor is the next to pop. Only
+     * the consumer touches this.
+     */
+    guac_rdp_input_node* tail;
+
+    /**
+     * Non-zero if the wake event has been set since the consumer last
+     * acknowledged the queue, such that each batch of pushes sets the event
+     * once.
+     */
+    std::atomic<int> signalled;
+
+    /**
+     * Windows auto-reset event which is set when events are pushed, for the
+     * RDP client thread to wait on alongside the RDP file descriptors.
+     */
+    void* wake;
+
+} guac_rdp_input_queue;
+
+/**
+ * Allocates a new, empty input queue.
+ *
+ * @return
+ *     The new input queue.
+ */
+guac_rdp_input_queue* guac_rdp_input_queue_alloc();
+
+/**
+ * Frees the given input queue, along with any events still queued. No other
+ * thread may be using the queue.
+ *
+ * @param queue
+ *     The input queue to free.
+ */
+void guac_rdp_input_queue_free(guac_rdp_input_queue* queue);
+
+/**
+ * Pushes a copy of the given event onto the given queue, setting the wake
+ * event of the queue if not already set. This function may be invoked by any
+ * thread, and never blocks.
+ *
+ * @param queue
+ *     The input queue to push onto.
+ *
+ * @param event
+ *     The event to push.
+ */
+void guac_rdp_input_queue_push(guac_rdp_input_queue* queue,
+        const guac_rdp_input_event* event);
+
+/**
+ * Acknowledges the wake event of the given queue, such that the next push
+ * sets it again. The consumer must invoke this before popping, so that no
+ * event pushed after the final pop goes unnoticed.
+ *
+ * @param queue
+ *     The input queue to acknowledge.
+ */
+void guac_rdp_input_queue_acknowledge(guac_rdp_input_queue* queue);
+
+/**
+ * Pops the oldest event from the given queue, in the order pushed. This
+ * function may only be invoked by the RDP client thread.
+ *
+ * @param queue
+ *     The input queue to pop from.
+ *
+ * @param event
+ *     Storage for the popped event.
+ *
+ * @return
+ *     Non-zero if an event was popped, zero if the queue is empty. An event
+ *     whose push has not yet completed is popped once it has.
+ */
+int guac_rdp_input_queue_pop(guac_rdp_input_queue* queue,
+        guac_rdp_input_event* event);
+
+#endif
+
+#endif
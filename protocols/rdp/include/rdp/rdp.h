@@ -26,7 +26,9 @@
 #include <common/clipboard.h>
 #include <common/display.h>
 #include <common/list.h>
+#include <common/recording.h>
 #include <common/surface.h>
+#include <rdp/input_queue.h>
 #include <rdp/keyboard.h>
 #include <rdp/rdp_disp.h>
 #include <rdp/rdp_fs.h>
@@ -90,6 +92,12 @@ typedef struct guac_rdp_client {
      */
     guac_common_display* display;
 
+    /**
+     * The in-progress session recording, or NULL if the session is not being
+     * recorded.
+     */
+    guac_common_recording* recording;
+
     /**
      * The surface that GDI operations should draw to. RDP messages exist which
      * change this surface to allow drawing to occur off-screen.
@@ -101,6 +109,14 @@ typedef struct guac_rdp_client {
      */
     guac_rdp_keyboard* keyboard;
 
+#ifdef HAVE_BOOST
+    /**
+     * Mouse and key events received from users, to be forwarded to the RDP
+     * server by the RDP client thread.
+     */
+    guac_rdp_input_queue* input_queue;
+#endif
+
     /**
      * The current clipboard contents.
      */
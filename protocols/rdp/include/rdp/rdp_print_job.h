@@ -24,6 +24,7 @@
 
 #include <guacamole/client.h>
 #include <guacamole/stream.h>
+#include <guacamole/stream-window.h>
 #include <guacamole/user.h>
 #ifdef HAVE_BOOST
 #include <boost/thread.hpp>
@@ -52,31 +53,10 @@ typedef int pid_t;
 #define GUAC_RDP_PRINT_JOB_TITLE_SEARCH_LENGTH 2048
 
 /**
- * The current state of an RDP print job.
+ * The maximum number of blobs of print output which may be awaiting
+ * acknowledgement at any one time.
  */
-typedef enum guac_rdp_print_job_state {
-
-    /**
-     * The print stream has been opened with the Guacamole client, but the
-     * client has not yet confirmed that it is ready to receive data.
-     */
-    GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK,
-
-    /**
-     * The print stream has been opened with the Guacamole client, and the
-     * client has responded with an "ack", confirming that it is ready to
-     * receive data (or that data has been received and it is ready to receive
-     * more).
-     */
-    GUAC_RDP_PRINT_JOB_ACK_RECEIVED,
-
-    /**
-     * The print stream has been closed or the printer is terminating, and no
-     * further data should be sent to the client.
-     */
-    GUAC_RDP_PRINT_JOB_CLOSED
-
-} guac_rdp_print_job_state;
+#define GUAC_RDP_PRINT_JOB_MAX_BLOBS GUAC_STREAM_WINDOW_DEFAULT_MAX_BLOBS
 
 /**
  * Data specific to an instance of the printer device.
@@ -120,30 +100,15 @@ typedef struct guac_rdp_print_job {
     int output_fd;
 
     /**
-     * The current state of the print stream, dependent on whether the client
-     * has acknowledged creation of the stream, whether the client has
-     * acknowledged receipt of data along the steam, and whether the print
-     * stream itself has closed.
+     * Flow control state of the print stream, determining how many blobs of
+     * output may be sent ahead of their acknowledgements. The window is
+     * closed if the print stream is closed or the printer is terminating.
      */
-    guac_rdp_print_job_state state;
+    guac_stream_window* window;
 
 #ifdef HAVE_BOOST
-	boost::mutex state_lock;
-	boost::condition_variable state_modified;
 	boost::shared_ptr<boost::thread> output_thread;
 #elif defined HAVE_LIBPTHREAD
-    /**
-     * Lock which is acquired prior to modifying the state property or waiting
-     * on the state_modified conditional.
-     */
-    pthread_mutex_t state_lock;
-
-    /**
-     * Conditional which signals modification to the state property of this
-     * structure.
-     */
-    pthread_cond_t state_modified;
-
     /**
      * Thread which transfers data from the printer to the Guacamole client.
      */
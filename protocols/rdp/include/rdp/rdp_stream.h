@@ -28,10 +28,22 @@
 #include <guacamole/user.h>
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
+#include <guacamole/stream-window.h>
 
 #include <stdint.h>
 #include <rdp/rdp_fs.h>
 
+/**
+ * The number of bytes of file data sent within each blob of a download.
+ */
+#define GUAC_RDP_DOWNLOAD_BLOB_SIZE 4096
+
+/**
+ * The maximum number of blobs of a download which may be awaiting
+ * acknowledgement at any one time.
+ */
+#define GUAC_RDP_DOWNLOAD_MAX_BLOBS GUAC_STREAM_WINDOW_DEFAULT_MAX_BLOBS
+
 /**
  * The transfer status of a file being downloaded.
  */
@@ -47,6 +59,12 @@ typedef struct guac_rdp_download_status {
      */
     uint64_t offset;
 
+    /**
+     * Flow control state of the download stream, determining how many blobs
+     * may be sent ahead of their acknowledgements.
+     */
+    guac_stream_window* window;
+
 } guac_rdp_download_status;
 
 /**
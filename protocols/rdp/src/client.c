@@ -20,6 +20,7 @@
 #include <guacamole/config.h>
 
 #include <rdp/audio_input.h>
+#include <rdp/input_queue.h>
 #include <rdp/client.h>
 #include <rdp/rdp.h>
 #include <rdp/rdp_disp.h>
@@ -76,6 +77,11 @@ int guac_client_init(guac_client* client, int argc, char** argv)
     /* Init display update module */
     rdp_client->disp = guac_rdp_disp_alloc();
 
+#ifdef HAVE_BOOST
+    /* Init queue of user input */
+    rdp_client->input_queue = guac_rdp_input_queue_alloc();
+#endif
+
 #ifdef HAVE_LIBPTHREAD
     /* Recursive attribute for locks */
     pthread_mutexattr_init(&(rdp_client->attributes));
@@ -87,6 +93,9 @@ int guac_client_init(guac_client* client, int argc, char** argv)
 #endif
     /* Set handlers */
     client->join_handler = guac_rdp_user_join_handler;
+#ifdef HAVE_BOOST
+    client->resync_handler = guac_rdp_user_resync_handler;
+#endif
     client->free_handler = guac_rdp_client_free_handler;
 
 #ifdef ENABLE_COMMON_SSH
@@ -115,6 +124,11 @@ int guac_rdp_client_free_handler(guac_client* client) {
     /* Free display update module */
     guac_rdp_disp_free(rdp_client->disp);
 
+#ifdef HAVE_BOOST
+    /* Free any input not yet forwarded */
+    guac_rdp_input_queue_free(rdp_client->input_queue);
+#endif
+
     /* Clean up filesystem, if allocated */
     if (rdp_client->filesystem != NULL)
         guac_rdp_fs_free(rdp_client->filesystem);
@@ -143,6 +157,10 @@ int guac_rdp_client_free_handler(guac_client* client) {
     if (rdp_client->audio_input != NULL)
         guac_rdp_audio_buffer_free(rdp_client->audio_input);
 
+    /* Close the recording index, if recording */
+    if (rdp_client->recording != NULL)
+        guac_common_recording_free(rdp_client->recording);
+
     /* Free client data */
     guac_common_clipboard_free(rdp_client->clipboard);
     free(rdp_client);
@@ -274,6 +274,8 @@ static void* guac_rdpdr_download_to_owner(guac_user* owner, void* data) {
         rdp_stream->type = GUAC_RDP_DOWNLOAD_STREAM;
         rdp_stream->download_status.file_id = file_id;
         rdp_stream->download_status.offset = 0;
+        rdp_stream->download_status.window =
+            guac_stream_window_alloc(GUAC_RDP_DOWNLOAD_MAX_BLOBS);
 
         /* Get basename from absolute path */
         i=0;
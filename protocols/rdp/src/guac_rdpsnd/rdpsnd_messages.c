@@ -308,13 +308,6 @@ void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
     /* Copy over first four bytes */
     memcpy(buffer, rdpsnd->initial_wave_data, 4);
 
-    /* Write rest of audio packet */
-    if (audio != NULL) {
-        guac_audio_stream_write_pcm(audio, buffer,
-                rdpsnd->incoming_wave_size + 4);
-        guac_audio_stream_flush(audio);
-    }
-
     /* Write Wave Confirmation PDU */
     Stream_Write_UINT8(output_stream, SNDC_WAVECONFIRM);
     Stream_Write_UINT8(output_stream, 0);
@@ -323,7 +316,8 @@ void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
     Stream_Write_UINT8(output_stream, rdpsnd->waveinfo_block_number);
     Stream_Write_UINT8(output_stream, 0);
 
-    /* Send Wave Confirmation PDU */
+    /* Send Wave Confirmation PDU before encoding, such that the server's
+     * playback timing is unaffected by any aggregation of the audio */
 #ifdef HAVE_BOOST
 	rdp_client->rdp_lock.lock();
 	svc_plugin_send(plugin, output_stream);
@@ -333,6 +327,14 @@ void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
 	svc_plugin_send(plugin, output_stream);
 	pthread_mutex_unlock(&(rdp_client->rdp_lock));
 #endif
+
+    /* Write rest of audio packet, to be sent once enough has accumulated */
+    if (audio != NULL) {
+        guac_audio_stream_write_pcm(audio, buffer,
+                rdpsnd->incoming_wave_size + 4);
+        guac_audio_stream_end_packet(audio);
+    }
+
     /* We no longer expect to receive wave data */
     rdpsnd->next_pdu_is_wave = FALSE;
 
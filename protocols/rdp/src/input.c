@@ -21,10 +21,13 @@
 
 #include <rdp/client.h>
 #include <rdp/input.h>
+#include <rdp/input_queue.h>
 #include <rdp/keyboard.h>
 #include <rdp/rdp.h>
 #include <rdp/rdp_disp.h>
 
+#include <common/cursor.h>
+
 #include <freerdp/freerdp.h>
 #include <freerdp/input.h>
 #include <guacamole/client.h>
@@ -37,9 +40,30 @@
 
 #include <stdlib.h>
 
-int guac_rdp_user_mouse_handler(guac_user* user, int x, int y, int mask) {
+/**
+ * Sends the given mouse event to the RDP server, translating any change in
+ * button state into the corresponding press, release and scroll events. The
+ * location of the mouse cursor is sent to the other users with the next
+ * frame.
+ *
+ * @param client
+ *     The guac_client associated with the RDP connection.
+ *
+ * @param user
+ *     The user that moved the mouse.
+ *
+ * @param x
+ *     The X coordinate of the mouse.
+ *
+ * @param y
+ *     The Y coordinate of the mouse.
+ *
+ * @param mask
+ *     The mask of all currently pressed mouse buttons.
+ */
+static void guac_rdp_send_mouse_event(guac_client* client, guac_user* user,
+        int x, int y, int mask) {
 
-    guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
 #ifdef HAVE_BOOST
@@ -55,11 +79,11 @@ int guac_rdp_user_mouse_handler(guac_user* user, int x, int y, int mask) {
 #elif defined HAVE_LIBPTHREAD
         pthread_mutex_unlock(&(rdp_client->rdp_lock));
 #endif
-        return 0;
+        return;
     }
 
     /* Store current mouse location */
-    guac_common_cursor_move(rdp_client->display->cursor, user, x, y);
+    guac_common_cursor_update(rdp_client->display->cursor, user, x, y);
 
     /* If button mask unchanged, just send move event */
     if (mask == rdp_client->mouse_button_mask)
@@ -129,6 +153,27 @@ int guac_rdp_user_mouse_handler(guac_user* user, int x, int y, int mask) {
 #elif defined HAVE_LIBPTHREAD
 	pthread_mutex_unlock(&(rdp_client->rdp_lock));
 #endif
+}
+
+int guac_rdp_user_mouse_handler(guac_user* user, int x, int y, int mask) {
+
+    guac_client* client = user->client;
+
+#ifdef HAVE_BOOST
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    /* Leave the event for the RDP client thread */
+    guac_rdp_input_event event;
+    event.type = GUAC_RDP_INPUT_EVENT_MOUSE;
+    event.user = user;
+    event.x = x;
+    event.y = y;
+    event.mask = mask;
+    guac_rdp_input_queue_push(rdp_client->input_queue, &event);
+#else
+    guac_rdp_send_mouse_event(client, user, x, y, mask);
+#endif
+
     return 0;
 }
 
@@ -137,6 +182,16 @@ int guac_rdp_user_key_handler(guac_user* user, int keysym, int pressed) {
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
+#ifdef HAVE_BOOST
+    /* Leave the event for the RDP client thread */
+    guac_rdp_input_event event;
+    event.type = GUAC_RDP_INPUT_EVENT_KEY;
+    event.user = user;
+    event.keysym = keysym;
+    event.pressed = pressed;
+    guac_rdp_input_queue_push(rdp_client->input_queue, &event);
+    return 0;
+#else
     /* Skip if keyboard not yet ready */
     if (rdp_client->keyboard == NULL)
         return 0;
@@ -144,9 +199,76 @@ int guac_rdp_user_key_handler(guac_user* user, int keysym, int pressed) {
     /* Update keysym state */
     return guac_rdp_keyboard_update_keysym(rdp_client->keyboard,
             keysym, pressed);
+#endif
 
 }
 
+#ifdef HAVE_BOOST
+void guac_rdp_handle_input(guac_client* client) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_input_queue* queue = rdp_client->input_queue;
+
+    /* Any events pushed from here on wake the RDP client thread again */
+    guac_rdp_input_queue_acknowledge(queue);
+
+    /* The latest move not yet sent, superseding any earlier moves */
+    guac_rdp_input_event move;
+    int move_pending = 0;
+
+    guac_rdp_input_event event;
+    while (guac_rdp_input_queue_pop(queue, &event)) {
+
+        /* Hold back moves which change no buttons, in case of more */
+        if (event.type == GUAC_RDP_INPUT_EVENT_MOUSE
+                && event.mask == rdp_client->mouse_button_mask) {
+            move = event;
+            move_pending = 1;
+            continue;
+        }
+
+        /* All other events are sent in order, after any held move */
+        if (move_pending) {
+            guac_rdp_send_mouse_event(client, move.user,
+                    move.x, move.y, move.mask);
+            move_pending = 0;
+        }
+
+        if (event.type == GUAC_RDP_INPUT_EVENT_MOUSE)
+            guac_rdp_send_mouse_event(client, event.user,
+                    event.x, event.y, event.mask);
+
+        /* No event of the user follows, nor can any still move the cursor */
+        else if (event.type == GUAC_RDP_INPUT_EVENT_LEAVE)
+            guac_common_cursor_remove_user(rdp_client->display->cursor,
+                    event.user);
+
+        /* Skip keys if keyboard not yet ready */
+        else if (rdp_client->keyboard != NULL)
+            guac_rdp_keyboard_update_keysym(rdp_client->keyboard,
+                    event.keysym, event.pressed);
+
+    }
+
+    /* Send the final location of the mouse */
+    if (move_pending)
+        guac_rdp_send_mouse_event(client, move.user,
+                move.x, move.y, move.mask);
+
+}
+
+void guac_rdp_input_user_left(guac_user* user) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) user->client->data;
+
+    guac_rdp_input_event event;
+    event.type = GUAC_RDP_INPUT_EVENT_LEAVE;
+    event.user = user;
+    guac_rdp_input_queue_push(rdp_client->input_queue, &event);
+
+}
+#endif
+
 int guac_rdp_user_size_handler(guac_user* user, int width, int height) {
 
     guac_client* client = user->client;
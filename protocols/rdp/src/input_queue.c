@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <guacamole/config.h>
+
+#include <rdp/input_queue.h>
+
+#ifdef HAVE_BOOST
+#include <windows.h>
+
+struct guac_rdp_input_node {
+
+    /**
+     * The queued event. Unused for the node preceding the first queued event.
+     */
+    guac_rdp_input_event event;
+
+    /**
+     * The node queued after this node, or NULL if this is the most recently
+     * queued node, or if the node queued after it is still being linked.
+     */
+    std::atomic<guac_rdp_input_node*> next;
+
+};
+
+/**
+ * Allocates a node holding a copy of the given event, not yet linked to any
+ * other node.
+ *
+ * @param event
+ *     The event to copy, or NULL to leave the event of the node unset.
+ *
+ * @return
+ *     The new node.
+ */
+static guac_rdp_input_node* guac_rdp_input_node_alloc(
+        const guac_rdp_input_event* event) {
+
+    guac_rdp_input_node* node = new guac_rdp_input_node;
+    if (event != NULL)
+        node->event = *event;
+
+    node->next.store(NULL, std::memory_order_relaxed);
+    return node;
+
+}
+
+guac_rdp_input_queue* guac_rdp_input_queue_alloc() {
+
+    guac_rdp_input_queue* queue = new guac_rdp_input_queue;
+
+    /* Both ends start at a node which holds no event */
+    guac_rdp_input_node* stub = guac_rdp_input_node_alloc(NULL);
+    queue->head.store(stub, std::memory_order_relaxed);
+    queue->tail = stub;
+
+    queue->signalled.store(0, std::memory_order_relaxed);
+    queue->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    return queue;
+
+}
+
+void guac_rdp_input_queue_free(guac_rdp_input_queue* queue) {
+
+    /* Free the last popped node and all nodes after it */
+    guac_rdp_input_node* current = queue->tail;
+    while (current != NULL) {
+        guac_rdp_input_node* next = current->next.load(std::memory_order_relaxed);
+        delete current;
+        current = next;
+    }
+
+    CloseHandle(queue->wake);
+    delete queue;
+
+}
+
+void guac_rdp_input_queue_push(guac_rdp_input_queue* queue,
+        const guac_rdp_input_event* event) {
+
+    guac_rdp_input_node* node = guac_rdp_input_node_alloc(event);
+
+    /* Claim the head, then link the previous head to the new node, which
+     * publishes the event to the consumer */
+    guac_rdp_input_node* previous = queue->head.exchange(node,
+            std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+
+    /* Wake the consumer, once per batch of events */
+    if (!queue->signalled.exchange(1))
+        SetEvent(queue->wake);
+
+}
+
+void guac_rdp_input_queue_acknowledge(guac_rdp_input_queue* queue) {
+    queue->signalled.store(0);
+}
+
+int guac_rdp_input_queue_pop(guac_rdp_input_queue* queue,
+        guac_rdp_input_event* event) {
+
+    guac_rdp_input_node* tail = queue->tail;
+    guac_rdp_input_node* next = tail->next.load(std::memory_order_acquire);
+
+    /* Empty, or the next push is not yet linked, in which case its producer
+     * sets the wake event once it is */
+    if (next == NULL)
+        return 0;
+
+    /* The popped node becomes the node preceding the next event */
+    *event = next->event;
+    queue->tail = next;
+    delete tail;
+
+    return 1;
+
+}
+
+#endif
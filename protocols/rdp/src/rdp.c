@@ -25,6 +25,8 @@
 #include <common/display.h>
 #include <common/recording.h>
 #include <rdp/dvc.h>
+#include <rdp/input.h>
+#include <rdp/input_queue.h>
 #include <rdp/keyboard.h>
 #include <rdp/rdp.h>
 #include <rdp/rdp_bitmap.h>
@@ -558,7 +560,7 @@ static void rdp_freerdp_context_free(freerdp* instance, rdpContext* context) {
  */
 static int rdp_guac_client_wait_for_messages(guac_client* client,
         int timeout_msecs) {
-	static HANDLE handles[GUAC_RDP_MAX_FILE_DESCRIPTORS];
+	static HANDLE handles[GUAC_RDP_MAX_FILE_DESCRIPTORS + 1];
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
     freerdp* rdp_inst = rdp_client->rdp_inst;
     rdpChannels* channels = rdp_inst->context->channels;
@@ -606,7 +608,10 @@ static int rdp_guac_client_wait_for_messages(guac_client* client,
 	{
 	   handles[i] = (HANDLE)read_fds[i];
 	}
-    DWORD dwResult = WaitForMultipleObjects(read_count, handles, false, timeout_msecs);
+
+    /* Also wake for input queued by users */
+    handles[read_count] = (HANDLE) rdp_client->input_queue->wake;
+    DWORD dwResult = WaitForMultipleObjects(read_count + 1, handles, false, timeout_msecs);
     if(dwResult == WAIT_TIMEOUT)
     {
        result = 0;
@@ -681,9 +686,10 @@ static int guac_rdp_handle_connection(guac_client* client) {
 #else
 	srand(time(NULL));
 #endif
-    /* Set up screen recording, if requested */
-    if (settings->recording_path != NULL) {
-        guac_common_recording_create(client,
+    /* Set up screen recording, if requested and not already set up by a
+     * previous connection attempt */
+    if (settings->recording_path != NULL && rdp_client->recording == NULL) {
+        rdp_client->recording = guac_common_recording_create(client,
                 settings->recording_path,
                 settings->recording_name,
                 settings->create_recording_path);
@@ -767,12 +773,18 @@ static int guac_rdp_handle_connection(guac_client* client) {
         guac_rdp_disp_update_size(rdp_client->disp, settings, rdp_inst);
         pthread_mutex_unlock(&(rdp_client->rdp_lock));
 #endif
+        /* Wake no later than any aggregated audio is due to be sent */
+        int start_timeout = GUAC_RDP_FRAME_START_TIMEOUT;
+        if (rdp_client->audio != NULL) {
+            int audio_due = guac_audio_stream_flush_pending(rdp_client->audio);
+            if (audio_due >= 0 && audio_due < start_timeout)
+                start_timeout = audio_due;
+        }
+
         /* Wait for data and construct a reasonable frame */
         int wait_result = rdp_guac_client_wait_for_messages(client,
-			GUAC_RDP_FRAME_START_TIMEOUT);
+			start_timeout);
         if (wait_result > 0) {
-            int processing_lag = guac_client_get_processing_lag(client);
-
             guac_timestamp frame_start = guac_timestamp_current();
 
             /* Read server messages until frame is built */
@@ -847,16 +859,24 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
 #ifdef HAVE_BOOST
 				rdp_client->rdp_lock.unlock();
+
+                /* Forward input queued by users since the last check */
+                guac_rdp_handle_input(client);
 #elif defined HAVE_LIBPTHREAD
 				pthread_mutex_unlock(&(rdp_client->rdp_lock));
 #endif
 
                 /* Calculate time remaining in frame */
                 frame_end = guac_timestamp_current();
-                frame_remaining = frame_start + GUAC_RDP_FRAME_DURATION
+                frame_remaining = frame_start
+                                + guac_client_get_frame_duration(client,
+                                        GUAC_RDP_FRAME_DURATION)
                                 - frame_end;
 
-                /* Calculate time that client needs to catch up */
+                /* Calculate time that client needs to catch up. The lag is
+                 * re-read on each pass as it includes the data still queued
+                 * for the users, which drains while the frame is built */
+                int processing_lag = guac_client_get_processing_lag(client);
                 int time_elapsed = frame_end - last_frame_end;
                 int required_wait = processing_lag - time_elapsed;
 
@@ -886,11 +906,20 @@ static int guac_rdp_handle_connection(guac_client* client) {
             guac_client_abort(client, GUAC_PROTOCOL_STATUS_UPSTREAM_ERROR,
                     "Connection closed.");
 
+        /* Send any aggregated audio which has waited long enough */
+        if (rdp_client->audio != NULL)
+            guac_audio_stream_flush_pending(rdp_client->audio);
+
         /* Flush frame */
         guac_common_display_flush(rdp_client->display);
         guac_client_end_frame(client);
         guac_socket_flush(client->socket);
 
+        /* Write a keyframe to the recording, if one is due */
+        if (rdp_client->recording != NULL)
+            guac_common_recording_keyframe(rdp_client->recording,
+                    rdp_client->display);
+
 #ifdef HAVE_BOOST
 		// Added for FPS Control
 		// FPS is controlled by the guac config
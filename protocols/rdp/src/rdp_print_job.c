@@ -59,78 +59,6 @@ char* const guac_rdp_pdf_filter_command[] = {
     NULL
 };
 
-/**
- * Updates the state of the given print job. Any threads currently blocked by a
- * call to guac_rdp_print_job_wait_for_ack() will be unblocked.
- *
- * @param job
- *     The print job whose state should be updated.
- *
- * @param state
- *     The new state to assign to the given print job.
- */
-static void guac_rdp_print_job_set_state(guac_rdp_print_job* job,
-        guac_rdp_print_job_state state) {
-
-#ifdef HAVE_BOOST
-	boost::mutex::scoped_lock lock(job->state_lock);
-	job->state = state;
-	job->state_modified.notify_all();
-#elif defined HAVE_LIBPTHREAD
-    pthread_mutex_lock(&(job->state_lock));
-
-    /* Update stream state, signalling modification */
-    job->state = state;
-    pthread_cond_signal(&(job->state_modified));
-
-    pthread_mutex_unlock(&(job->state_lock));
-#endif
-}
-
-/**
- * Suspends execution of the current thread until the state of the given print
- * job is not GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK. If the state of the print
- * job is GUAC_RDP_PRINT_JOB_ACK_RECEIVED, the state is automatically reset
- * back to GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK prior to returning.
- *
- * @param job
- *     The print job to wait for.
- *
- * @return
- *     Zero if the state of the print job is GUAC_RDP_PRINT_JOB_CLOSED,
- *     non-zero if the state was GUAC_RDP_PRINT_JOB_ACK_RECEIVED and has been
- *     automatically reset to GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK.
- */
-static int guac_rdp_print_job_wait_for_ack(guac_rdp_print_job* job) {
-
-#ifdef HAVE_BOOST
-	boost::mutex::scoped_lock lock(job->state_lock);
-	if (job->state == GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK)
-		job->state_modified.wait(lock);
-
-	/* Reset state if ack received */
-	int got_ack = (job->state == GUAC_RDP_PRINT_JOB_ACK_RECEIVED);
-	if (got_ack)
-		job->state = GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK;
-	return got_ack;
-#elif defined HAVE_LIBPTHREAD
-    /* Wait for ack if stream open and not yet received */
-    pthread_mutex_lock(&(job->state_lock));
-    if (job->state == GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK)
-        pthread_cond_wait(&job->state_modified, &job->state_lock);
-
-    /* Reset state if ack received */
-    int got_ack = (job->state == GUAC_RDP_PRINT_JOB_ACK_RECEIVED);
-    if (got_ack)
-        job->state = GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK;
-
-    /* Return whether ack was successfully received */
-    pthread_mutex_unlock(&(job->state_lock));
-    return got_ack;
-#endif
-
-}
-
 /**
  * Sends a "file" instruction to the given user describing the PDF file that
  * will be sent using the output of the given print job. If the given user no
@@ -274,12 +202,9 @@ static int guac_rdp_print_filter_ack_handler(guac_user* user,
 
     guac_rdp_print_job* job = (guac_rdp_print_job*) stream->data;
 
-    /* Update state for successful acks */
-    if (status == GUAC_PROTOCOL_STATUS_SUCCESS)
-        guac_rdp_print_job_set_state(job, GUAC_RDP_PRINT_JOB_ACK_RECEIVED);
-
-    /* Terminate stream if ack signals an error */
-    else {
+    /* Release window space for successful acks, terminating stream if ack
+     * signals an error */
+    if (guac_stream_window_ack(job->window, status)) {
 
         /* Note that the stream was aborted by the user */
         guac_client_log(job->client, GUAC_LOG_INFO, "User explicitly aborted "
@@ -427,8 +352,8 @@ static void* guac_rdp_print_job_output_thread(void* data) {
     /* Read continuously while data remains */
     while ((length = read(job->output_fd, buffer, sizeof(buffer))) > 0) {
 
-        /* Wait for client to be ready for blob */
-        if (guac_rdp_print_job_wait_for_ack(job)) {
+        /* Wait for room within the window for another blob */
+        if (guac_stream_window_wait(job->window)) {
 #ifdef HAVE_BOOST
 			guac_rdp_print_blob blob = {job,buffer,length};
 #elif defined HAVE_LIBPTHREAD
@@ -439,7 +364,9 @@ static void* guac_rdp_print_job_output_thread(void* data) {
             };
 #endif
 
-            /* Write a single blob of output */
+            /* Write a single blob of output, recording it first such that
+             * its acknowledgement cannot arrive before it is recorded */
+            guac_stream_window_sent(job->window);
             guac_client_for_user(job->client, job->user,
                     guac_rdp_print_job_send_blob, &blob);
 
@@ -459,6 +386,10 @@ static void* guac_rdp_print_job_output_thread(void* data) {
         guac_client_log(job->client, GUAC_LOG_ERROR,
                 "Error reading from filter: %s", strerror(errno));
 
+    /* Wait for outstanding blobs, such that no acknowledgement arrives after
+     * the stream has been freed */
+    guac_stream_window_drain(job->window);
+
     /* Terminate stream */
     guac_client_for_user(job->client, job->user,
             guac_rdp_print_job_end_stream, job);
@@ -514,15 +445,12 @@ void* guac_rdp_print_job_alloc(guac_user* user, void* data) {
         return NULL;
     }
 
-    /* Init stream state signal and lock */
-    job->state = GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK;
+    /* Init flow control for the print stream */
+    job->window = guac_stream_window_alloc(GUAC_RDP_PRINT_JOB_MAX_BLOBS);
 #ifdef HAVE_BOOST
 	job->output_thread.reset(
 		new boost::thread(boost::bind(guac_rdp_print_job_output_thread, job)));
 #elif defined HAVE_LIBPTHREAD
-    pthread_cond_init(&job->state_modified, NULL);
-    pthread_mutex_init(&job->state_lock, NULL);
-
     /* Start output thread */
     pthread_create(&job->output_thread, NULL,
             guac_rdp_print_job_output_thread, job);
@@ -673,6 +601,7 @@ void guac_rdp_print_job_free(guac_rdp_print_job* job) {
     pthread_join(job->output_thread, NULL);
 #endif
     /* Free base structure */
+    guac_stream_window_free(job->window);
     free(job);
 #endif
 }
@@ -684,7 +613,7 @@ void guac_rdp_print_job_kill(guac_rdp_print_job* job) {
     close(job->output_fd);
 
     /* Mark stream as closed */
-    guac_rdp_print_job_set_state(job, GUAC_RDP_PRINT_JOB_CLOSED);
+    guac_stream_window_close(job->window);
 #endif
 }
 
@@ -331,35 +331,44 @@ int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
         return 0;
     }
 
-    /* If successful, read data */
-    if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
-
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = guac_rdp_fs_read(fs,
-                rdp_stream->download_status.file_id,
-                rdp_stream->download_status.offset, buffer, sizeof(buffer));
-
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            rdp_stream->download_status.offset += bytes_read;
+    guac_rdp_download_status* download = &rdp_stream->download_status;
+
+    /* If successful, send as much data as the window allows */
+    if (!guac_stream_window_ack(download->window, status)) {
+
+        char buffer[GUAC_RDP_DOWNLOAD_BLOB_SIZE];
+        int bytes_read = 0;
+
+        while (guac_stream_window_available(download->window) > 0) {
+
+            /* Attempt read into buffer */
+            bytes_read = guac_rdp_fs_read(fs, download->file_id,
+                    download->offset, buffer, sizeof(buffer));
+
+            /* Stop at EOF or error */
+            if (bytes_read <= 0)
+                break;
+
+            /* Send as blob */
+            download->offset += bytes_read;
             guac_protocol_send_blob(user->socket, stream,
                     buffer, bytes_read);
-        }
+            guac_stream_window_sent(download->window);
 
-        /* If EOF, send end */
-        else if (bytes_read == 0) {
-            guac_protocol_send_end(user->socket, stream);
-            guac_user_free_stream(user, stream);
-            free(rdp_stream);
         }
 
-        /* Otherwise, fail stream */
-        else {
+        /* Fail stream on error */
+        if (bytes_read < 0)
             guac_user_log(user, GUAC_LOG_ERROR,
                     "Error reading file for download");
+
+        /* Send end once all data has been acknowledged, such that no
+         * acknowledgement can arrive after the stream index is reused */
+        if (bytes_read < 0 || (bytes_read == 0
+                    && guac_stream_window_pending(download->window) == 0)) {
             guac_protocol_send_end(user->socket, stream);
             guac_user_free_stream(user, stream);
+            guac_stream_window_free(download->window);
             free(rdp_stream);
         }
 
@@ -368,8 +377,11 @@ int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
     }
 
     /* Otherwise, return stream to user */
-    else
+    else {
         guac_user_free_stream(user, stream);
+        guac_stream_window_free(download->window);
+        free(rdp_stream);
+    }
 
     return 0;
 
@@ -535,6 +547,8 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
         rdp_stream->type = GUAC_RDP_DOWNLOAD_STREAM;
         rdp_stream->download_status.file_id = file_id;
         rdp_stream->download_status.offset = 0;
+        rdp_stream->download_status.window =
+            guac_stream_window_alloc(GUAC_RDP_DOWNLOAD_MAX_BLOBS);
 
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
@@ -146,12 +146,31 @@ int guac_rdp_user_file_handler(guac_user* user, guac_stream* stream,
     return 0;
 }
 
+int guac_rdp_user_resync_handler(guac_user* user, guac_socket* socket) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) user->client->data;
+
+    /* Nothing to resend until the display exists */
+    if (rdp_client->display == NULL)
+        return 0;
+
+    /* Resend the current display, exactly as for a newly-joined user */
+    guac_common_display_dup(rdp_client->display, user, socket);
+    guac_socket_flush(socket);
+
+    return 0;
+}
+
 int guac_rdp_user_leave_handler(guac_user* user) {
 
     guac_rdp_client* rdp_client = (guac_rdp_client*) user->client->data;
 
-    /* Update shared cursor state */
+    /* Update shared cursor state, once any queued moves of the user ran */
+#ifdef HAVE_BOOST
+    guac_rdp_input_user_left(user);
+#else
     guac_common_cursor_remove_user(rdp_client->display->cursor, user);
+#endif
 
     /* Free settings if not owner (owner settings will be freed with client) */
     if (!user->owner) {
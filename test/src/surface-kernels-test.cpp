@@ -0,0 +1,422 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Verifies that every set of surface kernels supported by the current CPU
+ * produces bit-for-bit the same results as the scalar kernels. Each kernel is
+ * run over rows of random pixels of every width up to a few vector lengths,
+ * and of random larger widths, starting at every alignment within a vector.
+ * Destination rows are surrounded by guard pixels, such that writes beyond
+ * the end of a row are caught. The pixels are generated from a fixed seed, so
+ * failures are reproducible.
+ *
+ * Exits with a non-zero status if any kernel differs from the scalar kernels.
+ *
+ * Usage: guac-surface-kernels-test [ROUNDS]
+ */
+
+#include <guacamole/config.h>
+
+#include <common/surface_kernels.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The seed of the generator of all pixels.
+ */
+#define GUAC_TEST_SEED 0x4755u
+
+/**
+ * Every width from zero up to this width is tested, covering the vector
+ * bodies and scalar tails of the kernels.
+ */
+#define GUAC_TEST_SMALL_WIDTH 80
+
+/**
+ * The largest width tested.
+ */
+#define GUAC_TEST_MAX_WIDTH 1024
+
+/**
+ * The number of random widths tested beyond GUAC_TEST_SMALL_WIDTH.
+ */
+#define GUAC_TEST_LARGE_WIDTHS 200
+
+/**
+ * The number of pixels by which the start of each row is offset, from zero
+ * up to this value exclusive, covering every alignment within a 256-bit
+ * vector.
+ */
+#define GUAC_TEST_ALIGNMENTS 8
+
+/**
+ * The number of guard pixels before and after each destination row.
+ */
+#define GUAC_TEST_GUARD 8
+
+/**
+ * The value of guard pixels, which must never change.
+ */
+#define GUAC_TEST_GUARD_PIXEL 0xA5C3E1F7u
+
+/**
+ * The number of pixels allocated for each row, including the alignment
+ * offset and guards.
+ */
+#define GUAC_TEST_ROW_SIZE \
+    (GUAC_TEST_MAX_WIDTH + GUAC_TEST_ALIGNMENTS + 2 * GUAC_TEST_GUARD)
+
+/**
+ * The maximum number of mismatches reported for each kernel before further
+ * mismatches are only counted.
+ */
+#define GUAC_TEST_MAX_REPORTS 10
+
+/**
+ * The state of the pixel generator.
+ */
+static uint32_t guac_test_random_state = GUAC_TEST_SEED;
+
+/**
+ * The number of mismatches found for the kernel currently being tested.
+ */
+static int guac_test_mismatches;
+
+/**
+ * Returns the next value of a xorshift generator.
+ */
+static uint32_t guac_test_random() {
+
+    uint32_t x = guac_test_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    guac_test_random_state = x;
+    return x;
+
+}
+
+/**
+ * Returns a random alpha component, favoring fully transparent and fully
+ * opaque pixels, which the kernels handle as special cases.
+ */
+static uint32_t guac_test_random_alpha() {
+
+    switch (guac_test_random() % 4) {
+        case 0: return 0x00;
+        case 1: return 0xFF;
+        default: return guac_test_random() & 0xFF;
+    }
+
+}
+
+/**
+ * Returns a random pre-multiplied ARGB pixel, whose color components do not
+ * exceed its alpha component, as Cairo produces.
+ */
+static uint32_t guac_test_random_pixel() {
+
+    uint32_t alpha = guac_test_random_alpha();
+    uint32_t r = alpha ? guac_test_random() % (alpha + 1) : 0;
+    uint32_t g = alpha ? guac_test_random() % (alpha + 1) : 0;
+    uint32_t b = alpha ? guac_test_random() % (alpha + 1) : 0;
+
+    return (alpha << 24) | (r << 16) | (g << 8) | b;
+
+}
+
+/**
+ * Fills the given row with random pixels. Pixels are repeated in runs,
+ * sometimes differing only in alpha, such that both unchanged spans and
+ * neighbouring equal pixels occur as they would in real content.
+ */
+static void guac_test_random_row(uint32_t* row, int width) {
+
+    int x;
+
+    for (x = 0; x < width; x++) {
+
+        uint32_t choice = guac_test_random() % 8;
+
+        /* Repeat the previous pixel */
+        if (x > 0 && choice < 3)
+            row[x] = row[x - 1];
+
+        /* Repeat the previous pixel with another alpha component */
+        else if (x > 0 && choice == 3)
+            row[x] = (row[x - 1] & 0x00FFFFFF)
+                   | (guac_test_random_alpha() << 24);
+
+        else
+            row[x] = guac_test_random_pixel();
+
+    }
+
+}
+
+/**
+ * Returns a destination row of random pixels, surrounded by guard pixels,
+ * within the given buffer.
+ */
+static uint32_t* guac_test_dst_row(uint32_t* buffer, int width,
+        int alignment) {
+
+    int i;
+
+    for (i = 0; i < GUAC_TEST_ROW_SIZE; i++)
+        buffer[i] = GUAC_TEST_GUARD_PIXEL;
+
+    uint32_t* row = buffer + GUAC_TEST_GUARD + alignment;
+    guac_test_random_row(row, width);
+
+    return row;
+
+}
+
+/**
+ * Records and, if within GUAC_TEST_MAX_REPORTS, reports a mismatch between
+ * the scalar kernel and the kernel being tested.
+ */
+static void guac_test_mismatch(const guac_common_surface_kernels* kernels,
+        const char* kernel, int width, int alignment, const char* detail) {
+
+    if (guac_test_mismatches++ < GUAC_TEST_MAX_REPORTS)
+        fprintf(stderr, "%s %s: width %d, alignment %d: %s\n",
+                kernels->name, kernel, width, alignment, detail);
+
+}
+
+/**
+ * Compares the given destination buffers, written by the scalar kernel and
+ * the kernel being tested, including their guard pixels.
+ */
+static void guac_test_compare_rows(const guac_common_surface_kernels* kernels,
+        const char* kernel, int width, int alignment,
+        const uint32_t* expected, const uint32_t* actual) {
+
+    int i;
+    char detail[128];
+
+    for (i = 0; i < GUAC_TEST_ROW_SIZE; i++) {
+        if (expected[i] != actual[i]) {
+            snprintf(detail, sizeof(detail),
+                    "pixel %d is 0x%08X, expected 0x%08X",
+                    i - GUAC_TEST_GUARD - alignment, actual[i], expected[i]);
+            guac_test_mismatch(kernels, kernel, width, alignment, detail);
+            return;
+        }
+    }
+
+}
+
+/**
+ * Tests a put kernel against the corresponding scalar kernel for a single
+ * row, comparing the result, the reported range of changed pixels and the
+ * resulting destination row.
+ */
+static void guac_test_put(const guac_common_surface_kernels* kernels,
+        const char* kernel, guac_common_surface_put_kernel* scalar_put,
+        guac_common_surface_put_kernel* put, int width, int alignment) {
+
+    static uint32_t expected[GUAC_TEST_ROW_SIZE];
+    static uint32_t actual[GUAC_TEST_ROW_SIZE];
+    static uint32_t src[GUAC_TEST_ROW_SIZE];
+
+    uint32_t* expected_row = guac_test_dst_row(expected, width, alignment);
+    uint32_t* actual_row = actual + GUAC_TEST_GUARD + alignment;
+    memcpy(actual, expected, sizeof(expected));
+
+    /* Leave some source pixels equal to the destination, such that only
+     * parts of the row change */
+    uint32_t* src_row = src + alignment;
+    guac_test_random_row(src_row, width);
+    int x;
+    for (x = 0; x < width; x++) {
+        if (guac_test_random() % 4 == 0)
+            src_row[x] = expected_row[x];
+    }
+
+    int expected_first = -1, expected_last = -1;
+    int actual_first = -1, actual_last = -1;
+
+    int expected_changed = scalar_put(expected_row, src_row, width,
+            &expected_first, &expected_last);
+    int actual_changed = put(actual_row, src_row, width,
+            &actual_first, &actual_last);
+
+    char detail[128];
+
+    if (!expected_changed != !actual_changed) {
+        snprintf(detail, sizeof(detail), "returned %d, expected %d",
+                actual_changed, expected_changed);
+        guac_test_mismatch(kernels, kernel, width, alignment, detail);
+    }
+
+    /* The changed range is only defined if any pixel changed */
+    else if (expected_changed && (expected_first != actual_first
+                || expected_last != actual_last)) {
+        snprintf(detail, sizeof(detail), "changed %d-%d, expected %d-%d",
+                actual_first, actual_last, expected_first, expected_last);
+        guac_test_mismatch(kernels, kernel, width, alignment, detail);
+    }
+
+    guac_test_compare_rows(kernels, kernel, width, alignment,
+            expected, actual);
+
+}
+
+/**
+ * Tests the fill_mask kernel against the scalar kernel for a single row.
+ */
+static void guac_test_fill_mask(const guac_common_surface_kernels* kernels,
+        int width, int alignment) {
+
+    static uint32_t expected[GUAC_TEST_ROW_SIZE];
+    static uint32_t actual[GUAC_TEST_ROW_SIZE];
+    static uint32_t mask[GUAC_TEST_ROW_SIZE];
+
+    uint32_t* expected_row = guac_test_dst_row(expected, width, alignment);
+    uint32_t* actual_row = actual + GUAC_TEST_GUARD + alignment;
+    memcpy(actual, expected, sizeof(expected));
+
+    uint32_t* mask_row = mask + alignment;
+    guac_test_random_row(mask_row, width);
+
+    uint32_t color = guac_test_random();
+
+    guac_common_surface_scalar_kernels.fill_mask(expected_row, mask_row,
+            width, color);
+    kernels->fill_mask(actual_row, mask_row, width, color);
+
+    guac_test_compare_rows(kernels, "fill_mask", width, alignment,
+            expected, actual);
+
+}
+
+/**
+ * Tests the count_same kernel against the scalar kernel for a single row.
+ */
+static void guac_test_count_same(const guac_common_surface_kernels* kernels,
+        int width, int alignment) {
+
+    static uint32_t row[GUAC_TEST_ROW_SIZE];
+
+    uint32_t* test_row = row + alignment;
+    guac_test_random_row(test_row, width);
+
+    int expected = guac_common_surface_scalar_kernels.count_same(test_row,
+            width);
+    int actual = kernels->count_same(test_row, width);
+
+    if (expected != actual) {
+        char detail[128];
+        snprintf(detail, sizeof(detail), "counted %d, expected %d",
+                actual, expected);
+        guac_test_mismatch(kernels, "count_same", width, alignment, detail);
+    }
+
+}
+
+/**
+ * Tests every kernel of the given set against the scalar kernels for rows of
+ * the given width at every alignment.
+ */
+static void guac_test_width(const guac_common_surface_kernels* kernels,
+        int width, int rounds) {
+
+    const guac_common_surface_kernels* scalar =
+        &guac_common_surface_scalar_kernels;
+
+    int alignment, round;
+
+    for (alignment = 0; alignment < GUAC_TEST_ALIGNMENTS; alignment++) {
+        for (round = 0; round < rounds; round++) {
+            guac_test_put(kernels, "put_opaque", scalar->put_opaque,
+                    kernels->put_opaque, width, alignment);
+            guac_test_put(kernels, "put_blend", scalar->put_blend,
+                    kernels->put_blend, width, alignment);
+            guac_test_fill_mask(kernels, width, alignment);
+            guac_test_count_same(kernels, width, alignment);
+        }
+    }
+
+}
+
+/**
+ * Tests every kernel of the given set against the scalar kernels, returning
+ * the number of mismatches found.
+ */
+static int guac_test_kernels(const guac_common_surface_kernels* kernels,
+        int rounds) {
+
+    int width, i;
+
+    guac_test_random_state = GUAC_TEST_SEED;
+    guac_test_mismatches = 0;
+
+    for (width = 0; width <= GUAC_TEST_SMALL_WIDTH; width++)
+        guac_test_width(kernels, width, rounds);
+
+    for (i = 0; i < GUAC_TEST_LARGE_WIDTHS; i++) {
+        width = GUAC_TEST_SMALL_WIDTH + 1 + guac_test_random()
+              % (GUAC_TEST_MAX_WIDTH - GUAC_TEST_SMALL_WIDTH);
+        guac_test_width(kernels, width, 1);
+    }
+
+    return guac_test_mismatches;
+
+}
+
+int main(int argc, char** argv) {
+
+    int rounds = argc > 1 ? atoi(argv[1]) : 4;
+
+    if (rounds <= 0) {
+        fprintf(stderr, "Usage: %s [ROUNDS]\n", argv[0]);
+        return 1;
+    }
+
+    int count;
+    const guac_common_surface_kernels* const* supported =
+        guac_common_surface_get_supported_kernels(&count);
+
+    int failed = 0;
+
+    for (int i = 0; i < count; i++) {
+
+        int mismatches = guac_test_kernels(supported[i], rounds);
+        if (mismatches) {
+            printf("%-8s FAILED (%d mismatches)\n", supported[i]->name,
+                    mismatches);
+            failed++;
+        }
+        else
+            printf("%-8s OK\n", supported[i]->name);
+
+    }
+
+    printf("Selected: %s\n", guac_common_surface_get_kernels()->name);
+
+    return failed ? 1 : 0;
+
+}